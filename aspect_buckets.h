@@ -0,0 +1,181 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <algorithm>
+
+enum class image_orientation : std::uint8_t {
+	portrait = 0,
+	landscape,
+};
+
+/// <summary>
+/// Display shapes that images are sorted into.
+/// </summary>
+enum class aspect_bucket : std::uint8_t {
+	landscape = 0,	// 16:9, and any landscape image that matches no other bucket
+	portrait,		// 9:16, and any portrait image that matches no other bucket
+	ultrawide,		// 21:9
+	wide,			// 16:10
+	standard,		// 4:3
+	phone,			// 9:19.5
+	none,			// square images, which are not Spotlight wallpapers
+};
+
+/// <summary>
+/// The definition of a bucket.
+/// </summary>
+struct aspect_bucket_spec {
+	aspect_bucket bucket;
+	const char* folder;		// sub-folder of the library, also used as the display name
+	unsigned int ratio_width;
+	unsigned int ratio_height;
+	unsigned int min_short_side;	// smaller images are not fetched, in pixels
+	image_orientation orientation;
+};
+
+/// <summary>
+/// The buckets, in the order of the aspect_bucket enumeration.
+/// </summary>
+/// 
+/// <remarks>
+/// The Landscape and Portrait folders predate the other buckets and keep their
+/// names so that existing libraries stay where they are.
+/// </remarks>
+constexpr aspect_bucket_spec aspect_buckets[] = {
+	{ aspect_bucket::landscape, "Landscape", 16, 9, 700, image_orientation::landscape },
+	{ aspect_bucket::portrait, "Portrait", 9, 16, 700, image_orientation::portrait },
+	{ aspect_bucket::ultrawide, "Ultrawide", 21, 9, 700, image_orientation::landscape },
+	{ aspect_bucket::wide, "Wide 16x10", 16, 10, 700, image_orientation::landscape },
+	{ aspect_bucket::standard, "Standard 4x3", 4, 3, 700, image_orientation::landscape },
+	{ aspect_bucket::phone, "Phone", 18, 39, 700, image_orientation::portrait },
+};
+
+constexpr size_t aspect_bucket_count = sizeof(aspect_buckets) / sizeof(aspect_buckets[0]);
+
+/// <summary>
+/// How far an image's aspect ratio may be from a bucket's, in thousandths of
+/// the bucket's ratio.
+/// </summary>
+constexpr unsigned int aspect_tolerance = 40;
+
+namespace aspect_detail {
+	// aspect ratios as width * ratio_one / height
+	constexpr std::uint64_t ratio_one = 1 << 16;
+
+	struct ratio_range {
+		std::uint64_t low;
+		std::uint64_t high;
+	};
+
+	constexpr std::array<ratio_range, aspect_bucket_count> make_ranges() {
+		std::array<ratio_range, aspect_bucket_count> ranges{};
+
+		for (size_t i = 0; i < aspect_bucket_count; i++) {
+			const std::uint64_t centre = aspect_buckets[i].ratio_width * ratio_one / aspect_buckets[i].ratio_height;
+			ranges[i] = { centre * (1000 - aspect_tolerance) / 1000, centre * (1000 + aspect_tolerance) / 1000 };
+		}
+
+		return ranges;
+	}
+
+	// computed at compile time, so classifying is a multiply, a divide and a
+	// couple of comparisons per bucket
+	constexpr auto ranges = make_ranges();
+
+	constexpr bool check_table() {
+		for (size_t i = 0; i < aspect_bucket_count; i++)
+			if (static_cast<size_t>(aspect_buckets[i].bucket) != i)
+				return false;
+
+		return true;
+	}
+
+	static_assert(check_table(), "aspect_buckets must be in the order of the aspect_bucket enumeration");
+}
+
+/// <summary>
+/// Get the bucket an image belongs in.
+/// </summary>
+/// 
+/// <param name="width">The width of the image, in pixels.</param>
+/// <param name="height">The height of the image, in pixels.</param>
+/// 
+/// <returns>
+/// The first bucket whose aspect ratio is within the tolerance of the image's,
+/// else landscape or portrait. Square and empty images return none.
+/// </returns>
+constexpr aspect_bucket classify_aspect(unsigned int width, unsigned int height) {
+	if (width == height || width == 0 || height == 0)
+		return aspect_bucket::none;
+
+	const std::uint64_t ratio = width * aspect_detail::ratio_one / height;
+
+	for (size_t i = 0; i < aspect_bucket_count; i++)
+		if (ratio >= aspect_detail::ranges[i].low && ratio <= aspect_detail::ranges[i].high)
+			return aspect_buckets[i].bucket;
+
+	return width > height ? aspect_bucket::landscape : aspect_bucket::portrait;
+}
+
+/// <summary>
+/// Get the definition of a bucket. Must not be called with none.
+/// </summary>
+constexpr const aspect_bucket_spec& bucket_spec(aspect_bucket bucket) {
+	return aspect_buckets[static_cast<size_t>(bucket)];
+}
+
+/// <summary>
+/// Find a bucket by its folder name, ignoring case.
+/// </summary>
+/// 
+/// <returns>
+/// The bucket, or none if no bucket has the name.
+/// </returns>
+inline aspect_bucket find_bucket(std::string_view folder) {
+	auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+
+	for (const auto& it : aspect_buckets) {
+		const std::string_view name(it.folder);
+
+		if (name.size() == folder.size() &&
+			std::equal(name.begin(), name.end(), folder.begin(), [&lower](char a, char b) { return lower(a) == lower(b); }))
+			return it.bucket;
+	}
+
+	return aspect_bucket::none;
+}
+
+static_assert(classify_aspect(1920, 1080) == aspect_bucket::landscape, "16:9");
+static_assert(classify_aspect(1080, 1920) == aspect_bucket::portrait, "9:16");
+static_assert(classify_aspect(3440, 1440) == aspect_bucket::ultrawide, "21:9");
+static_assert(classify_aspect(1920, 1200) == aspect_bucket::wide, "16:10");
+static_assert(classify_aspect(1600, 1200) == aspect_bucket::standard, "4:3");
+static_assert(classify_aspect(1170, 2532) == aspect_bucket::phone, "9:19.5");
+static_assert(classify_aspect(1000, 1000) == aspect_bucket::none, "square");
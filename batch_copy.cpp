@@ -0,0 +1,714 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "batch_copy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr const char* stopped_message = "The copy was stopped";
+
+	void copy_on_thread_pool(std::vector<copy_request>& requests, fetch_job* job, io_scheduler* io,
+		copy_engine* engine, copy_batch_stats& stats) {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> files_copied{ 0 };
+		std::atomic<unsigned long long> bytes_copied{ 0 };
+
+		auto work = [&]() {
+			io_priority_scope priority(io ? io->limits().priority : io_priority::normal);
+
+			for (size_t i = next++; i < requests.size(); i = next++) {
+				auto& request = requests[i];
+
+				if (job && job->stop_requested()) {
+					request.error = stopped_message;
+					continue;
+				}
+
+				request.succeeded = copy_if_newer(request.source, request.destination, job, io, engine,
+					request.copied, request.error);
+
+				if (request.copied) {
+					if (job)
+						job->file_copied();
+
+					std::error_code ec;
+					const auto size = std::filesystem::file_size(request.destination, ec);
+					files_copied++;
+					bytes_copied += ec ? 0 : size;
+				}
+			}
+		};
+
+		const size_t threads = (std::min)(requests.size(), copy_batch_threads);
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threads; i++)
+			workers.emplace_back(work);
+
+		work();
+
+		for (auto& it : workers)
+			it.join();
+
+		stats.files_copied = files_copied;
+		stats.bytes_copied = bytes_copied;
+	}
+
+#ifdef __linux__
+	std::string error_message(const std::string& what, int error) {
+		return what + ": " + std::error_code(error, std::generic_category()).message();
+	}
+
+	/// <summary>
+	/// A submission and completion queue pair, set up with the raw system calls
+	/// so that there is nothing to link against.
+	/// </summary>
+	class ring {
+	public:
+		explicit ring(unsigned int entries) {
+			io_uring_params params{};
+			_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+			if (_fd < 0)
+				return;
+
+			_sq_size = params.sq_off.array + params.sq_entries * sizeof(__u32);
+			_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+			if (single_mmap)
+				_sq_size = _cq_size = (std::max)(_sq_size, _cq_size);
+
+			_sq = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+			_cq = single_mmap ? _sq :
+				mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+			_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+			_calls += single_mmap ? 3 : 4;
+
+			if (_sq == MAP_FAILED || _cq == MAP_FAILED || sqes == MAP_FAILED) {
+				if (sqes != MAP_FAILED)
+					munmap(sqes, _sqes_size);
+
+				release();
+				return;
+			}
+
+			auto* sq = static_cast<char*>(_sq);
+			auto* cq = static_cast<char*>(_cq);
+			_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+			_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			_sq_entries = params.sq_entries;
+			_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+			_sqes = static_cast<io_uring_sqe*>(sqes);
+		}
+
+		~ring() {
+			if (_sqes)
+				munmap(_sqes, _sqes_size);
+
+			release();
+		}
+
+		ring(const ring&) = delete;
+		ring& operator=(const ring&) = delete;
+
+		bool valid() const { return _sqes != nullptr; }
+		int fd() const { return _fd; }
+
+		/// <summary>
+		/// Get a cleared submission queue entry, or null if the queue is full.
+		/// </summary>
+		io_uring_sqe* next_entry() {
+			const unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+			if (_tail - head >= _sq_entries)
+				return nullptr;
+
+			const unsigned index = _tail & _sq_mask;
+			_sq_array[index] = index;
+			_tail++;
+			_queued++;
+
+			auto* entry = &_sqes[index];
+			memset(entry, 0, sizeof(*entry));
+			return entry;
+		}
+
+		/// <summary>
+		/// Submit the queued entries and wait for at least one completion.
+		/// </summary>
+		/// 
+		/// <returns>
+		/// Returns 0 if successful, else the error number.
+		/// </returns>
+		int submit_and_wait() {
+			__atomic_store_n(_sq_tail, _tail, __ATOMIC_RELEASE);
+
+			for (;;) {
+				const long submitted = syscall(__NR_io_uring_enter, _fd, _queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+				_calls++;
+
+				if (submitted >= 0) {
+					_queued -= static_cast<unsigned>(submitted);
+					return 0;
+				}
+
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+					return errno;
+			}
+		}
+
+		/// <summary>
+		/// Call a function on each available completion.
+		/// </summary>
+		template <typename function>
+		void for_each_completion(function&& handle) {
+			unsigned head = *_cq_head;
+			const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+
+			for (; head != tail; head++) {
+				const io_uring_cqe completion = _cqes[head & _cq_mask];
+				__atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+				handle(completion);
+			}
+		}
+
+		/// <summary>
+		/// Get the number of system calls made to set up the ring and submit to it.
+		/// </summary>
+		unsigned long long calls() const { return _calls; }
+
+	private:
+		void release() {
+			if (_cq && _cq != MAP_FAILED && _cq != _sq)
+				munmap(_cq, _cq_size);
+
+			if (_sq && _sq != MAP_FAILED)
+				munmap(_sq, _sq_size);
+
+			_sq = _cq = nullptr;
+			_sqes = nullptr;
+
+			if (_fd >= 0)
+				close(_fd);
+
+			_fd = -1;
+		}
+
+		int _fd = -1;
+		void* _sq = nullptr;
+		void* _cq = nullptr;
+		size_t _sq_size = 0;
+		size_t _cq_size = 0;
+		size_t _sqes_size = 0;
+		unsigned* _sq_head = nullptr;
+		unsigned* _sq_tail = nullptr;
+		unsigned* _sq_array = nullptr;
+		unsigned _sq_mask = 0;
+		unsigned _sq_entries = 0;
+		unsigned* _cq_head = nullptr;
+		unsigned* _cq_tail = nullptr;
+		unsigned _cq_mask = 0;
+		io_uring_cqe* _cqes = nullptr;
+		io_uring_sqe* _sqes = nullptr;
+		unsigned _tail = 0;
+		unsigned _queued = 0;
+		unsigned long long _calls = 0;
+	};
+
+	constexpr __u8 required_operations[] = {
+		IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE
+	};
+
+	bool supports_required_operations(const ring& uring) {
+		constexpr size_t operations = 256;
+		std::vector<char> buffer(sizeof(io_uring_probe) + operations * sizeof(io_uring_probe_op));
+		auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+		if (syscall(__NR_io_uring_register, uring.fd(), IORING_REGISTER_PROBE, probe, operations) < 0)
+			return false;
+
+		for (const auto operation : required_operations)
+			if (operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED))
+				return false;
+
+		return true;
+	}
+
+	// the I/O priority of reads and writes, as ioprio_set takes it
+	__u16 request_priority(const io_scheduler* io) {
+		constexpr int class_shift = 13;
+		constexpr int class_best_effort = 2;
+		constexpr int class_idle = 3;
+
+		switch (io ? io->limits().priority : io_priority::normal) {
+		case io_priority::background:
+			return class_idle << class_shift;
+		case io_priority::low:
+			return class_best_effort << class_shift | 7;
+		default:
+			return 0;
+		}
+	}
+
+	/// <summary>
+	/// One file in flight. Each stage submits a pair of operations, or one
+	/// for the transfer, and moves on when they have all completed.
+	/// </summary>
+	struct transfer {
+		enum class stage { stat, open, copy, close };
+
+		copy_request* request = nullptr;
+		stage current = stage::stat;
+		unsigned int pending = 0;
+
+		std::string source;
+		std::string partial;
+		struct statx source_stat {};
+		struct statx destination_stat {};
+		int destination_result = 0;
+
+		int input = -1;
+		int output = -1;
+		unsigned long long offset = 0;
+		unsigned int buffered = 0;	// bytes read into the buffer
+		unsigned int written = 0;	// of those, bytes written
+		std::vector<char> buffer;
+
+		bool created = false;	// whether the part file was created
+		bool failed = false;
+	};
+
+	// the transfer's index and the operation, in a completion's user data
+	enum class operation : __u64 { stat_source, stat_destination, open_source, open_destination, read, write, close };
+
+	__u64 user_data(size_t slot, operation kind) {
+		return static_cast<__u64>(slot) << 8 | static_cast<__u64>(kind);
+	}
+
+	class uring_copier {
+	public:
+		uring_copier(ring& uring, std::vector<copy_request>& requests, fetch_job* job, io_scheduler* io,
+			copy_batch_stats& stats) :
+			_uring(uring), _requests(requests), _job(job), _io(io), _stats(stats), _priority(request_priority(io)),
+			_slots(copy_batch_files_in_flight) {}
+
+		void run() {
+			size_t next = 0;
+			size_t active = 0;
+
+			for (;;) {
+				// a file can be done as soon as it starts, when the fetch is stopped
+				for (size_t slot = 0; slot < _slots.size(); slot++)
+					while (!_slots[slot].request && next < _requests.size()) {
+						start(slot, _requests[next++]);
+
+						if (_slots[slot].request)
+							active++;
+					}
+
+				if (!active)
+					break;
+
+				const int error = _uring.submit_and_wait();
+				if (error) {
+					// nothing more completes, so fail what is left without touching the ring
+					for (auto& it : _slots)
+						if (it.request)
+							it.request->error = error_message("io_uring", error);
+
+					for (; next < _requests.size(); next++)
+						_requests[next].error = error_message("io_uring", error);
+
+					break;
+				}
+
+				_uring.for_each_completion([&](const io_uring_cqe& completion) {
+					const size_t slot = static_cast<size_t>(completion.user_data >> 8);
+					complete(slot, static_cast<operation>(completion.user_data & 0xff), completion.res);
+
+					if (!_slots[slot].request)
+						active--;
+					});
+			}
+
+			_stats.system_calls += _uring.calls();
+		}
+
+	private:
+		bool stopped() const {
+			return _job && _job->stop_requested();
+		}
+
+		// the ring has twice as many entries as there can be operations in flight
+		io_uring_sqe& entry(size_t slot, operation kind, __u8 opcode) {
+			auto* sqe = _uring.next_entry();
+			sqe->opcode = opcode;
+			sqe->user_data = user_data(slot, kind);
+			_slots[slot].pending++;
+			return *sqe;
+		}
+
+		void submit_stat(size_t slot, operation kind, const std::string& path, struct statx& result) {
+			auto& sqe = entry(slot, kind, IORING_OP_STATX);
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<__u64>(path.c_str());
+			sqe.len = STATX_MTIME | STATX_SIZE;
+			sqe.off = reinterpret_cast<__u64>(&result);
+		}
+
+		void submit_open(size_t slot, operation kind, const std::string& path, int flags, unsigned int mode) {
+			auto& sqe = entry(slot, kind, IORING_OP_OPENAT);
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<__u64>(path.c_str());
+			sqe.len = mode;
+			sqe.open_flags = static_cast<__u32>(flags | O_CLOEXEC);
+		}
+
+		void submit_close(size_t slot, int& descriptor) {
+			if (descriptor < 0)
+				return;
+
+			auto& sqe = entry(slot, operation::close, IORING_OP_CLOSE);
+			sqe.fd = descriptor;
+			descriptor = -1;
+		}
+
+		void start(size_t slot, copy_request& request) {
+			auto& file = _slots[slot];
+			file = transfer();
+			file.request = &request;
+			file.source = request.source.string();
+			file.partial = request.destination.string() + ".part";
+
+			if (stopped()) {
+				fail(slot, stopped_message);
+				return;
+			}
+
+			// the destination's path lives in the request, the source's and the part file's in the transfer
+			submit_stat(slot, operation::stat_source, file.source, file.source_stat);
+			submit_stat(slot, operation::stat_destination, request.destination.native(), file.destination_stat);
+		}
+
+		void read_next(size_t slot) {
+			auto& file = _slots[slot];
+			const auto remaining = file.source_stat.stx_size - file.offset;
+
+			if (!remaining) {
+				finish(slot);
+				return;
+			}
+
+			const auto chunk = static_cast<unsigned int>((std::min)(remaining, static_cast<unsigned long long>(copy_chunk_size)));
+
+			if (stopped() || (_io && !_io->acquire(chunk, _job))) {
+				fail(slot, stopped_message);
+				return;
+			}
+
+			file.buffer.resize(copy_chunk_size);
+			file.buffered = file.written = 0;
+
+			auto& sqe = entry(slot, operation::read, IORING_OP_READ);
+			sqe.fd = file.input;
+			sqe.ioprio = _priority;
+			sqe.addr = reinterpret_cast<__u64>(file.buffer.data());
+			sqe.len = chunk;
+			sqe.off = file.offset;
+		}
+
+		void write_next(size_t slot) {
+			auto& file = _slots[slot];
+
+			auto& sqe = entry(slot, operation::write, IORING_OP_WRITE);
+			sqe.fd = file.output;
+			sqe.ioprio = _priority;
+			sqe.addr = reinterpret_cast<__u64>(file.buffer.data() + file.written);
+			sqe.len = file.buffered - file.written;
+			sqe.off = file.offset + file.written;
+		}
+
+		void finish(size_t slot) {
+			auto& file = _slots[slot];
+
+			// keep the source's write time so the next fetch sees the copy as up to date
+			const timespec times[2] = {
+				{ 0, UTIME_OMIT },
+				{ static_cast<time_t>(file.source_stat.stx_mtime.tv_sec), static_cast<long>(file.source_stat.stx_mtime.tv_nsec) }
+			};
+
+			_stats.system_calls++;
+			if (futimens(file.output, times) != 0) {
+				fail(slot, error_message(file.partial, errno));
+				return;
+			}
+
+			file.current = transfer::stage::close;
+			submit_close(slot, file.input);
+			submit_close(slot, file.output);
+		}
+
+		void fail(size_t slot, const std::string& error) {
+			fail_after(slot, error);
+			fail_or_done(slot);
+		}
+
+		void done(size_t slot) {
+			auto& file = _slots[slot];
+			auto& request = *file.request;
+
+			if (file.current == transfer::stage::close) {
+				if (!file.failed) {
+					_stats.system_calls++;
+					if (rename(file.partial.c_str(), request.destination.c_str()) == 0) {
+						request.succeeded = request.copied = true;
+						_stats.files_copied++;
+
+						if (_job)
+							_job->file_copied();
+						_stats.bytes_copied += file.source_stat.stx_size;
+					}
+					else
+						request.error = error_message(request.destination.string(), errno);
+				}
+
+				if (!request.succeeded && file.created) {
+					_stats.system_calls++;
+					unlink(file.partial.c_str());
+				}
+			}
+
+			file.request = nullptr;
+		}
+
+		void complete(size_t slot, operation kind, int result) {
+			auto& file = _slots[slot];
+			file.pending--;
+
+			switch (kind) {
+			case operation::stat_source:
+				if (result < 0)
+					fail_after(slot, error_message(file.source, -result));
+				break;
+
+			case operation::stat_destination:
+				file.destination_result = result;
+				break;
+
+			case operation::open_source:
+				if (result >= 0)
+					file.input = result;
+				else
+					fail_after(slot, error_message(file.source, -result));
+				break;
+
+			case operation::open_destination:
+				if (result >= 0) {
+					file.output = result;
+					file.created = true;
+				}
+				else
+					fail_after(slot, error_message(file.partial, -result));
+				break;
+
+			case operation::read:
+				if (result < 0)
+					fail_after(slot, error_message(file.source, -result));
+				else if (!result)
+					file.source_stat.stx_size = file.offset;	// the source got shorter
+				else
+					file.buffered = static_cast<unsigned int>(result);
+				break;
+
+			case operation::write:
+				if (result <= 0)
+					fail_after(slot, error_message(file.partial, result ? -result : EIO));
+				else {
+					file.written += static_cast<unsigned int>(result);
+					if (_job)
+						_job->add_bytes_copied(static_cast<unsigned long long>(result));
+				}
+				break;
+
+			case operation::close:
+				break;
+			}
+
+			if (!file.pending)
+				advance(slot);
+		}
+
+		// remember a failure until the stage's other operation completes
+		void fail_after(size_t slot, const std::string& error) {
+			auto& file = _slots[slot];
+			if (!file.failed) {
+				file.failed = true;
+				file.request->error = error;
+			}
+		}
+
+		void advance(size_t slot) {
+			auto& file = _slots[slot];
+
+			if (file.failed || file.current == transfer::stage::close) {
+				fail_or_done(slot);
+				return;
+			}
+
+			switch (file.current) {
+			case transfer::stage::stat: {
+				const auto& source = file.source_stat.stx_mtime;
+				const auto& destination = file.destination_stat.stx_mtime;
+
+				if (!file.destination_result && (destination.tv_sec > source.tv_sec ||
+					(destination.tv_sec == source.tv_sec && destination.tv_nsec >= source.tv_nsec))) {
+					file.request->succeeded = true;
+					file.request = nullptr;
+					return;
+				}
+
+				file.current = transfer::stage::open;
+				submit_open(slot, operation::open_source, file.source, O_RDONLY, 0);
+				submit_open(slot, operation::open_destination, file.partial, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+				break;
+			}
+
+			case transfer::stage::open:
+				file.current = transfer::stage::copy;
+				read_next(slot);
+				break;
+
+			case transfer::stage::copy:
+				if (file.written < file.buffered)
+					write_next(slot);
+				else {
+					file.offset += file.written;
+					read_next(slot);
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		void fail_or_done(size_t slot) {
+			auto& file = _slots[slot];
+
+			if (file.current != transfer::stage::close) {
+				file.current = transfer::stage::close;
+				submit_close(slot, file.input);
+				submit_close(slot, file.output);
+			}
+
+			if (!file.pending)
+				done(slot);
+		}
+
+		ring& _uring;
+		std::vector<copy_request>& _requests;
+		fetch_job* _job;
+		io_scheduler* _io;
+		copy_batch_stats& _stats;
+		const __u16 _priority;
+		std::vector<transfer> _slots;
+	};
+#endif
+}
+
+const char* copy_backend_name(copy_backend backend) {
+	switch (backend) {
+	case copy_backend::io_uring:
+		return "io_uring";
+	case copy_backend::thread_pool:
+	default:
+		return "thread_pool";
+	}
+}
+
+bool io_uring_supported() {
+#ifdef __linux__
+	static const bool supported = []() {
+		ring uring(4);
+		return uring.valid() && supports_required_operations(uring);
+	}();
+
+	return supported;
+#else
+	return false;
+#endif
+}
+
+void copy_if_newer_batch(std::vector<copy_request>& requests,
+	copy_backend backend,
+	fetch_job* job,
+	io_scheduler* io,
+	copy_engine* engine,
+	copy_batch_stats& stats) {
+	stats = copy_batch_stats();
+
+	for (auto& it : requests) {
+		it.succeeded = it.copied = false;
+		it.error.clear();
+	}
+
+	if (requests.empty())
+		return;
+
+#ifdef __linux__
+	if (backend == copy_backend::io_uring && io_uring_supported()) {
+		// two entries for each file in flight, with room to spare
+		ring uring(static_cast<unsigned int>(copy_batch_files_in_flight * 4));
+
+		if (uring.valid()) {
+			stats.backend = copy_backend::io_uring;
+			uring_copier(uring, requests, job, io, stats).run();
+			return;
+		}
+	}
+#endif
+
+	stats.backend = copy_backend::thread_pool;
+	copy_on_thread_pool(requests, job, io, engine, stats);
+}
@@ -0,0 +1,122 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "fetch_job.h"
+#include "file_copy.h"
+#include "io_scheduler.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// How a batch of files is copied.
+/// </summary>
+/// 
+/// <remarks>
+/// The thread pool is the default: with the source files in the page cache,
+/// as Spotlight's usually are, it measured faster than io_uring, which is
+/// only used when asked for.
+/// </remarks>
+enum class copy_backend {
+	thread_pool = 0,	// copy_if_newer() on a few threads, with the copy engine's strategy
+	io_uring,			// Linux: statx, open, read, write and close for many files per submission
+};
+
+/// <summary>
+/// Get the name of a copy backend.
+/// </summary>
+const char* copy_backend_name(copy_backend backend);
+
+/// <summary>
+/// Check whether io_uring can be used: the kernel has it, it isn't blocked,
+/// and it supports every operation the io_uring backend needs.
+/// </summary>
+bool io_uring_supported();
+
+/// <summary>
+/// A file to copy in a batch, and how the copy went.
+/// </summary>
+struct copy_request {
+	std::filesystem::path source;
+	std::filesystem::path destination;
+	bool succeeded = false;
+	bool copied = false;	// false if the destination was up to date
+	std::string error;
+};
+
+/// <summary>
+/// What copying a batch took.
+/// </summary>
+struct copy_batch_stats {
+	copy_backend backend = copy_backend::thread_pool;	// the backend that did the copies
+	size_t files_copied = 0;
+	unsigned long long bytes_copied = 0;
+
+	/// <summary>
+	/// The system calls the io_uring backend made: setting up the ring, one
+	/// per submission, and setting write times, renaming and cleaning up.
+	/// Zero for the thread pool, which makes at least one per file operation.
+	/// </summary>
+	unsigned long long system_calls = 0;
+};
+
+/// <summary>
+/// The number of files the io_uring backend keeps in flight.
+/// </summary>
+constexpr size_t copy_batch_files_in_flight = 16;
+
+/// <summary>
+/// The number of threads the thread pool backend copies on.
+/// </summary>
+constexpr size_t copy_batch_threads = 4;
+
+/// <summary>
+/// Copy many files, each unless its destination is at least as new as its
+/// source. Each file is copied as by copy_if_newer(), and counted as copied
+/// by the job.
+/// </summary>
+/// 
+/// <param name="requests">The files to copy. Their results are filled in.</param>
+/// <param name="backend">How to copy them.</param>
+/// <param name="job">For stop requests and progress. Can be null.</param>
+/// <param name="io">Paces the copies and sets their priority. Can be null.</param>
+/// <param name="engine">
+/// Picks how the thread pool copies bytes. Can be null. The io_uring backend
+/// always reads and writes.
+/// </param>
+/// <param name="stats">What the batch took.</param>
+/// 
+/// <remarks>
+/// If io_uring is asked for but not supported, the thread pool is used.
+/// Requests not done when the job is asked to stop fail.
+/// </remarks>
+void copy_if_newer_batch(std::vector<copy_request>& requests,
+	copy_backend backend,
+	fetch_job* job,
+	io_scheduler* io,
+	copy_engine* engine,
+	copy_batch_stats& stats);
@@ -0,0 +1,907 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "benchmark.h"
+#include "batch_copy.h"
+#include "colour_stats.h"
+#include "file_copy.h"
+#include "image_quality.h"
+#include "image_sources.h"
+#include "path_utils.h"
+#include "resampler.h"
+#include "scan_arena.h"
+#include "search_index.h"
+#include "similarity.h"
+#include "smart_crop.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory_resource>
+
+namespace {
+	/// <summary>
+	/// Passes allocations on to another memory resource, counting them.
+	/// </summary>
+	class counting_resource : public std::pmr::memory_resource {
+	public:
+		explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+			_upstream(upstream) {}
+
+		size_t allocations() const {
+			return _allocations;
+		}
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override {
+			_allocations++;
+			return _upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+			_upstream->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+
+		std::pmr::memory_resource* _upstream;
+		size_t _allocations = 0;
+	};
+
+	/// <summary>
+	/// Time a function, repeating it until the total takes long enough to
+	/// measure reliably.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The average time per call, in milliseconds.
+	/// </returns>
+	double time_it(const std::function<void()>& function) {
+		using clock = std::chrono::steady_clock;
+
+		function();	// warm up caches
+
+		size_t iterations = 1;
+		for (;;) {
+			const auto start = clock::now();
+
+			for (size_t i = 0; i < iterations; i++)
+				function();
+
+			const double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			if (elapsed >= 200. || iterations >= (1u << 20))
+				return elapsed / iterations;
+
+			iterations *= 2;
+		}
+	}
+
+	/// <summary>
+	/// Deterministic pseudo-random bytes, so every run measures the same data.
+	/// </summary>
+	void fill_random(std::vector<std::uint8_t>& buffer, std::uint32_t seed) {
+		for (auto& it : buffer) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			it = static_cast<std::uint8_t>(seed);
+		}
+	}
+
+	void benchmark_colour_stats(std::vector<benchmark_result>& results) {
+		// a thumbnail sized image, which is what ingest analyzes
+		constexpr size_t pixel_count = 256 * 256;
+		std::vector<std::uint8_t> pixels(pixel_count * 4);
+		fill_random(pixels, 0x9e3779b9u);
+
+		colour_stats reference;
+		compute_colour_stats(pixels.data(), pixel_count, simd_level::scalar, reference);
+
+		for (const auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::neon }) {
+			if (!simd_supported(level))
+				continue;
+
+			colour_stats stats;
+			const double ms = time_it([&]() {
+				compute_colour_stats(pixels.data(), pixel_count, level, stats);
+				});
+
+			benchmark_result result;
+			result.name = "colour_stats";
+			result.variant = to_string(level);
+			result.milliseconds = ms;
+			result.items_per_second = pixel_count / (ms / 1000.);
+			result.matches_reference = memcmp(&stats, &reference, sizeof(stats)) == 0;
+			results.push_back(result);
+		}
+	}
+
+	void benchmark_quality(std::vector<benchmark_result>& results) {
+		// a 16:9 image at the size ingest analyzes
+		constexpr unsigned int width = 512, height = 288;
+		std::vector<std::uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+		fill_random(pixels, 0x85ebca6bu);
+
+		quality_scores reference;
+		compute_quality(pixels.data(), width, height, simd_level::scalar, reference);
+
+		for (const auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::neon }) {
+			if (!simd_supported(level))
+				continue;
+
+			quality_scores scores;
+			const double ms = time_it([&]() {
+				compute_quality(pixels.data(), width, height, level, scores);
+				});
+
+			benchmark_result result;
+			result.name = "quality";
+			result.variant = to_string(level);
+			result.milliseconds = ms;
+			result.items_per_second = static_cast<double>(width) * height / (ms / 1000.);
+			result.matches_reference = memcmp(&scores, &reference, sizeof(scores)) == 0;
+			results.push_back(result);
+		}
+	}
+
+	void benchmark_saliency(std::vector<benchmark_result>& results) {
+		// the luminance of a 16:9 image at the size ingest analyzes
+		constexpr unsigned int width = 512, height = 288;
+		std::vector<std::uint8_t> luma(static_cast<size_t>(width) * height);
+		fill_random(luma, 0x27d4eb2fu);
+
+		std::vector<std::uint8_t> reference(luma.size());
+		edge_energy(luma.data(), width, height, simd_level::scalar, reference.data());
+
+		for (const auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::neon }) {
+			if (!simd_supported(level))
+				continue;
+
+			std::vector<std::uint8_t> energy(luma.size());
+			const double ms = time_it([&]() {
+				edge_energy(luma.data(), width, height, level, energy.data());
+				});
+
+			benchmark_result result;
+			result.name = "saliency";
+			result.variant = to_string(level);
+			result.milliseconds = ms;
+			result.items_per_second = static_cast<double>(width) * height / (ms / 1000.);
+			result.matches_reference = energy == reference;
+			results.push_back(result);
+		}
+	}
+
+	void benchmark_resample(std::vector<benchmark_result>& results) {
+		// a Spotlight landscape image to the smallest common variant, on one
+		// thread so that the kernels are compared rather than the core count
+		bitmap source;
+		source.width = 1920;
+		source.height = 1080;
+		source.pixels.resize(static_cast<size_t>(source.width) * source.height * 4);
+		fill_random(source.pixels, 0xc2b2ae35u);
+
+		constexpr unsigned int width = 1280, height = 720;
+
+		bitmap reference;
+		resample(source, width, height, resample_filter::lanczos3, simd_level::scalar, 1, reference);
+
+		for (const auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::neon }) {
+			if (!simd_supported(level))
+				continue;
+
+			bitmap target;
+			const double ms = time_it([&]() {
+				resample(source, width, height, resample_filter::lanczos3, level, 1, target);
+				});
+
+			// kernels may round differently by one
+			bool matches = target.pixels.size() == reference.pixels.size();
+			for (size_t i = 0; matches && i < target.pixels.size(); i++)
+				matches = std::abs(target.pixels[i] - reference.pixels[i]) <= 1;
+
+			benchmark_result result;
+			result.name = "resample";
+			result.variant = to_string(level);
+			result.milliseconds = ms;
+			result.items_per_second = static_cast<double>(width) * height / (ms / 1000.);
+			result.matches_reference = matches;
+			results.push_back(result);
+		}
+
+		// all cores, with the best kernel
+		bitmap target;
+		const double ms = time_it([&]() {
+			resample(source, width, height, resample_filter::lanczos3, target);
+			});
+
+		benchmark_result result;
+		result.name = "resample";
+		result.variant = std::string(to_string(detect_simd_level())) + " threaded";
+		result.milliseconds = ms;
+		result.items_per_second = static_cast<double>(width) * height / (ms / 1000.);
+		results.push_back(result);
+	}
+
+	void benchmark_similarity(std::vector<benchmark_result>& results) {
+		// a large library: clusters of similar images, as a library of
+		// daily wallpapers has, queried with images near the clusters
+		constexpr size_t image_count = 50000, cluster_count = 500, query_count = 64, top = 20;
+
+		std::vector<std::uint8_t> centres(cluster_count * feature_size);
+		fill_random(centres, 0x165667b1u);
+
+		std::vector<std::uint8_t> noise(image_count * feature_size);
+		fill_random(noise, 0xd3a2646cu);
+
+		auto near_centre = [&](size_t cluster, const std::uint8_t* offsets) {
+			feature_vector features;
+			for (size_t i = 0; i < feature_size; i++) {
+				const int value = centres[cluster * feature_size + i] + (offsets[i] % 25) - 12;
+				features[i] = static_cast<std::uint8_t>((std::min)((std::max)(value, 0), 255));
+			}
+			return features;
+		};
+
+		std::vector<image_id> ids(image_count);
+		std::vector<feature_vector> vectors(image_count);
+		for (size_t i = 0; i < image_count; i++) {
+			ids[i] = static_cast<image_id>(i);
+			vectors[i] = near_centre(i % cluster_count, noise.data() + i * feature_size);
+		}
+
+		std::vector<feature_vector> queries(query_count);
+		for (size_t i = 0; i < query_count; i++)
+			queries[i] = near_centre((i * 7) % cluster_count, noise.data() + (image_count - 1 - i) * feature_size);
+
+		auto run = [&](const similarity_index& index, bool tree, std::vector<std::vector<similar_image>>& found) {
+			for (size_t i = 0; i < query_count; i++)
+				found[i] = tree ? index.query(queries[i], top) : index.brute_force(queries[i], top);
+		};
+
+		similarity_index index;
+		index.build(ids, vectors, simd_level::scalar);
+
+		std::vector<std::vector<similar_image>> reference(query_count);
+		run(index, false, reference);
+
+		auto matches = [&](const std::vector<std::vector<similar_image>>& found) {
+			for (size_t i = 0; i < query_count; i++) {
+				if (found[i].size() != reference[i].size())
+					return false;
+
+				for (size_t j = 0; j < found[i].size(); j++)
+					if (found[i][j].id != reference[i][j].id || found[i][j].distance != reference[i][j].distance)
+						return false;
+			}
+
+			return true;
+		};
+
+		for (const auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::neon }) {
+			if (!simd_supported(level))
+				continue;
+
+			index.build(ids, vectors, level);
+
+			for (const bool tree : { false, true }) {
+				std::vector<std::vector<similar_image>> found(query_count);
+				const double ms = time_it([&]() { run(index, tree, found); }) / query_count;
+
+				benchmark_result result;
+				result.name = "similarity";
+				result.variant = std::string(tree ? "vp-tree " : "brute force ") + to_string(level);
+				result.milliseconds = ms;
+				result.items_per_second = 1000. / ms;	// queries
+				result.matches_reference = matches(found);
+				results.push_back(result);
+			}
+		}
+	}
+
+	void benchmark_search(std::vector<benchmark_result>& results) {
+		// a large library with Spotlight's hexadecimal file names and a mix of
+		// sizes, resolutions and colours
+		constexpr size_t image_count = 50000;
+
+		std::vector<std::uint8_t> random(image_count * 16);
+		fill_random(random, 0x61c88647u);
+
+		const std::pair<unsigned int, unsigned int> resolutions[] = {
+			{ 1920, 1080 }, { 1080, 1920 }, { 3840, 2160 }, { 2560, 1080 }, { 1280, 800 }, { 1024, 768 }
+		};
+
+		image_catalog pictures;
+		pictures.reserve(image_count);
+
+		for (size_t i = 0; i < image_count; i++) {
+			const auto* bytes = random.data() + i * 16;
+
+			std::string name;
+			for (size_t j = 0; j < 8; j++) {
+				name += "0123456789abcdef"[bytes[j] >> 4];
+				name += "0123456789abcdef"[bytes[j] & 15];
+			}
+
+			colour_stats colours;
+			colours.computed = 1;
+			colours.luminance = bytes[8];
+			colours.histogram[bytes[9] % 64] = 128;
+			colours.histogram[bytes[10] % 64] = 64;
+
+			const auto& resolution = resolutions[bytes[11] % 6];
+			pictures.add("C:\\Pictures\\Landscape", name + ".jpg",
+				resolution.first >= resolution.second ? image_orientation::landscape : image_orientation::portrait,
+				100000ull + bytes[12] * 16384ull, resolution.first, resolution.second,
+				1600000000ll + static_cast<long long>(i) * 3600, colours);
+		}
+
+		search_index index;
+		index.reset(pictures);
+
+		struct search {
+			const char* text;
+			std::vector<std::string> words;
+			std::function<bool(image_id)> condition;
+		};
+
+		const std::vector<search> searches = {
+			{ "a", { "a" }, nullptr },
+			{ "land blue", { "land", "blue" }, nullptr },
+			{ "fhd size>=2mb", { "fhd" }, [&](image_id id) { return pictures.file_size(id) >= 2ull * 1024 * 1024; } },
+			{ "width>=2560 after:2021-01-01", {}, [&](image_id id) {
+				return pictures.width(id) >= 2560 && pictures.fetched(id) >= 1609459200ll; } },
+		};
+
+		std::vector<std::string> tags;
+
+		for (const auto& it : searches) {
+			// the same search as a scan over every image's tags
+			std::vector<image_id> reference;
+			for (image_id id = 0; id < pictures.size(); id++) {
+				image_tags(pictures, id, tags);
+
+				bool match = !it.condition || it.condition(id);
+				for (const auto& word : it.words)
+					match = match && std::any_of(tags.begin(), tags.end(), [&word](const std::string& tag) {
+					return tag.compare(0, word.size(), word) == 0;
+						});
+
+				if (match)
+					reference.push_back(id);
+			}
+
+			std::vector<image_id> all(pictures.size());
+			for (image_id id = 0; id < all.size(); id++)
+				all[id] = id;
+
+			image_set found;
+			const double ms = time_it([&]() { found = index.query(it.text); });
+
+			benchmark_result result;
+			result.name = "search";
+			result.variant = std::string("\"") + it.text + "\", " + std::to_string(found.count()) + " found";
+			result.milliseconds = ms;
+			result.items_per_second = pictures.size() / (ms / 1000.);
+			result.matches_reference = found.filter(all) == reference;
+			results.push_back(result);
+		}
+	}
+
+	void benchmark_copy(std::vector<benchmark_result>& results) {
+		// what the copy engine measures for a volume, here the temporary folder's;
+		// strategies the volume doesn't support are left out, and items are bytes
+		std::error_code ec;
+		const auto folder = std::filesystem::temp_directory_path(ec);
+		if (ec)
+			return;
+
+		std::vector<copy_measurement> measurements;
+		std::string error;
+		if (!measure_copy_strategies(folder.string(), copy_engine::calibration_bytes, measurements, error))
+			return;
+
+		for (const auto& it : measurements) {
+			if (!it.succeeded)
+				continue;
+
+			benchmark_result result;
+			result.name = "copy";
+			result.variant = copy_strategy_name(it.strategy);
+			result.milliseconds = it.milliseconds;
+			result.items_per_second = copy_engine::calibration_bytes / (it.milliseconds / 1000.);
+			result.matches_reference = it.identical;
+			results.push_back(result);
+		}
+	}
+
+	void benchmark_ingest(std::vector<benchmark_result>& results) {
+		// a fetch's worth of Spotlight sized files copied from one temporary folder to another
+		constexpr size_t file_count = 64;
+
+		std::error_code ec;
+		const auto folder = std::filesystem::temp_directory_path(ec) / "spotlight_images_ingest";
+		if (ec)
+			return;
+
+		const auto sources = folder / "sources";
+		const auto library = folder / "library";
+		std::filesystem::remove_all(folder, ec);
+		std::filesystem::create_directories(sources, ec);
+		if (ec)
+			return;
+
+		std::vector<copy_request> requests(file_count);
+		std::vector<std::vector<std::uint8_t>> contents(file_count);
+		unsigned long long chunks = 0;
+
+		for (size_t i = 0; i < file_count; i++) {
+			contents[i].resize(256 * 1024 + i * 20 * 1024);
+			fill_random(contents[i], static_cast<std::uint32_t>(0x85ebca6bu + i));
+			chunks += (contents[i].size() + copy_chunk_size - 1) / copy_chunk_size;
+
+			requests[i].source = sources / std::to_string(i);
+			requests[i].destination = library / (std::to_string(i) + ".jpg");
+
+			std::ofstream file(requests[i].source, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(contents[i].data()), static_cast<std::streamsize>(contents[i].size()));
+		}
+
+		// the thread pool copies with read_write: per file two stats, two opens, a
+		// stat and an advice, a read and a write per chunk, two closes, setting the
+		// write time and a rename
+		const unsigned long long thread_pool_calls = file_count * 10 + chunks * 2;
+
+		std::vector<copy_backend> backends = { copy_backend::thread_pool };
+		if (io_uring_supported())
+			backends.push_back(copy_backend::io_uring);
+
+		for (const auto backend : backends) {
+			copy_batch_stats stats;
+			double ms = 0.;
+
+			for (int run = 0; run < 3; run++) {
+				std::filesystem::remove_all(library, ec);
+				std::filesystem::create_directories(library, ec);
+
+				const auto start = std::chrono::steady_clock::now();
+				copy_if_newer_batch(requests, backend, nullptr, nullptr, nullptr, stats);
+				const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				ms = run ? (std::min)(ms, elapsed) : elapsed;
+			}
+
+			bool matches = true;
+			for (size_t i = 0; matches && i < file_count; i++) {
+				std::ifstream file(requests[i].destination, std::ios::binary);
+				const std::vector<char> copy((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				matches = requests[i].copied && copy.size() == contents[i].size() &&
+					std::equal(copy.begin(), copy.end(), reinterpret_cast<const char*>(contents[i].data()));
+			}
+
+			const auto calls = backend == copy_backend::io_uring ? stats.system_calls : thread_pool_calls;
+
+			benchmark_result result;
+			result.name = "ingest";
+			result.variant = std::string(copy_backend_name(backend)) + ", " + std::to_string(calls) + " system calls";
+			result.milliseconds = ms;
+			result.items_per_second = file_count / (ms / 1000.);
+			result.matches_reference = matches;
+			results.push_back(result);
+		}
+
+		std::filesystem::remove_all(folder, ec);
+	}
+
+	void benchmark_sources(std::vector<benchmark_result>& results) {
+		// a Spotlight folder and two drop folders in plain temporary folders: the
+		// drop folders hold copies of some assets, with .jpg added and the same
+		// write time, and different photos that share their names
+		constexpr size_t asset_count = 200;
+		constexpr size_t copy_count = 50;
+		constexpr size_t photo_count = 20;
+
+		std::error_code ec;
+		const auto folder = std::filesystem::temp_directory_path(ec) / "spotlight_images_sources";
+		if (ec)
+			return;
+
+		const auto spotlight = folder / "spotlight";
+		const auto camera = folder / "camera";
+		const auto phone = folder / "phone" / "2024";
+		std::filesystem::remove_all(folder, ec);
+		std::filesystem::create_directories(spotlight, ec);
+		std::filesystem::create_directories(camera, ec);
+		std::filesystem::create_directories(phone, ec);
+		if (ec)
+			return;
+
+		auto write = [](const std::filesystem::path& path, size_t size, std::uint32_t seed) {
+			std::vector<std::uint8_t> contents(size);
+			fill_random(contents, seed);
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		};
+
+		for (size_t i = 0; i < asset_count; i++) {
+			const auto asset = spotlight / ("asset" + std::to_string(i));
+			write(asset, 1024 + i, static_cast<std::uint32_t>(0x27d4eb2fu + i));
+
+			if (i < copy_count) {
+				const auto copy = camera / ("asset" + std::to_string(i) + ".jpg");
+				std::filesystem::copy_file(asset, copy, ec);
+				std::filesystem::last_write_time(copy, std::filesystem::last_write_time(asset, ec), ec);
+			}
+		}
+
+		for (size_t i = 0; i < photo_count; i++) {
+			const auto name = "IMG_" + std::to_string(1000 + i) + ".jpg";
+			write(camera / name, 2048 + i, static_cast<std::uint32_t>(0x165667b1u + i));
+			write(phone / name, 4096 + i, static_cast<std::uint32_t>(0x9e3779b1u + i));
+		}
+
+		const std::vector<image_source> sources = {
+			{ spotlight.string(), "Spotlight", false },
+			{ camera.string(), camera.string(), true },
+			{ (folder / "phone").string(), (folder / "phone").string(), true },
+		};
+
+		const size_t file_count = asset_count + copy_count + 2 * photo_count;
+
+		// the files listed one source after the other, without looking for duplicates
+		size_t listed = 0;
+		const double reference_ms = time_it([&]() {
+			listed = 0;
+			for (const auto& source : sources)
+				for (std::filesystem::recursive_directory_iterator it(source.root, ec), end; !ec && it != end; it.increment(ec))
+					listed += it->is_regular_file(ec);
+			});
+
+		size_t queued = 0, duplicates = 0;
+		const double ms = time_it([&]() {
+			ingest_queue queue;
+			source_scan scan(sources, queue);
+
+			queued = 0;
+			source_file file;
+			while (queue.pop(file))
+				queued++;
+
+			scan.wait();
+			duplicates = queue.duplicates();
+			});
+
+		benchmark_result result;
+		result.name = "sources";
+		result.variant = "directory_iterator, " + std::to_string(listed) + " files";
+		result.milliseconds = reference_ms;
+		result.items_per_second = file_count / (reference_ms / 1000.);
+		result.matches_reference = listed == file_count;
+		results.push_back(result);
+
+		// only the copies of the assets are duplicates
+		result.variant = "source_scan, " + std::to_string(queued) + " queued, " + std::to_string(duplicates) + " duplicates";
+		result.milliseconds = ms;
+		result.items_per_second = file_count / (ms / 1000.);
+		result.matches_reference = queued == asset_count + 2 * photo_count && duplicates == copy_count;
+		results.push_back(result);
+
+		// the photos that share a name are different files, so they must still go
+		// to different library files: the phone's are renamed, the camera's are not
+		std::vector<source_file> files;
+		{
+			ingest_queue queue;
+			source_scan scan(sources, queue);
+
+			source_file file;
+			while (queue.pop(file))
+				files.push_back(std::move(file));
+
+			scan.wait();
+		}
+
+		const image_catalog known;
+		const std::unordered_set<std::string> excluded;
+		size_t renamed = 0, renamed_phone = 0;
+		std::unordered_set<std::string> library_files;
+		const double naming_ms = time_it([&]() {
+			scan_arena arena;
+			const library_lookup lookup((folder / "library").string(), known, excluded, arena);
+
+			std::pmr::vector<library_name> names(arena.scan());
+			names.reserve(files.size());
+			for (const auto& it : files)
+				names.push_back({ aspect_bucket::landscape, lookup.file_name(lookup.source_name(it.path)), &it.path, it.source });
+
+			const std::pmr::vector<library_name> original(names, arena.scan());
+			renamed = lookup.unique_names(names);
+
+			renamed_phone = 0;
+			library_files.clear();
+			for (size_t i = 0; i < names.size(); i++) {
+				renamed_phone += names[i].file_name != original[i].file_name && names[i].source_index == 2;
+				library_files.emplace(lookup.library_path(names[i].bucket, names[i].file_name));
+			}
+			});
+
+		result.variant = "unique_names, " + std::to_string(renamed) + " renamed, " +
+			std::to_string(library_files.size()) + " library files";
+		result.milliseconds = naming_ms;
+		result.items_per_second = files.size() / (naming_ms / 1000.);
+		result.matches_reference = renamed == photo_count && renamed_phone == photo_count &&
+			library_files.size() == files.size();
+		results.push_back(result);
+
+		std::filesystem::remove_all(folder, ec);
+	}
+
+	void benchmark_scan(std::vector<benchmark_result>& results) {
+		// the per file lookups of a fetch: a library of 50000 images, and as many
+		// source files, half of them already in the library and some evicted
+		constexpr size_t image_count = 50000;
+		const std::string folder = "C:\\Users\\User\\Pictures\\Spotlight Images";
+
+		std::vector<std::uint8_t> random(image_count * 17);
+		fill_random(random, 0x27d4eb2fu);
+
+		image_catalog known;
+		std::vector<std::filesystem::path> sources;
+		std::vector<aspect_bucket> buckets;
+		std::unordered_set<std::string> excluded;
+
+		for (size_t i = 0; i < image_count; i++) {
+			const auto* bytes = random.data() + i * 17;
+
+			// Spotlight's long hexadecimal asset names
+			std::string name;
+			for (size_t j = 0; j < 16; j++) {
+				name += "0123456789abcdef"[bytes[j] >> 4];
+				name += "0123456789abcdef"[bytes[j] & 15];
+			}
+
+			const auto bucket = aspect_buckets[bytes[16] % aspect_bucket_count].bucket;
+			const std::string library_folder = join_path(folder, bucket_spec(bucket).folder);
+
+			if (i % 2)
+				known.add(library_folder, name + ".jpg", bucket_spec(bucket).orientation, 1, 1, 1, 1);
+			else if (i % 10 == 0)
+				excluded.insert(join_path(library_folder, name + ".jpg"));
+
+			sources.push_back("/sources/Assets/" + name);
+			buckets.push_back(bucket);
+		}
+
+		// the lookups with plain strings, as fetches made them before the arena;
+		// its strings allocate through a counter, but the std::filesystem::path
+		// temporaries cannot, so its count is a lower bound
+		std::vector<image_id> reference(image_count);
+		size_t reference_allocations = 0;
+		const double reference_ms = time_it([&]() {
+			std::unordered_map<std::pmr::string, image_id> known_paths;
+			known_paths.reserve(known.size());
+			for (image_id id = 0; id < known.size(); id++)
+				known_paths.emplace(known.full_path(id), id);
+
+			std::unordered_set<std::pmr::string> excluded_paths;
+			for (const auto& it : excluded)
+				excluded_paths.emplace(it);
+
+			counting_resource counter;
+
+			for (size_t i = 0; i < image_count; i++) {
+				std::pmr::string file_name(sources[i].filename().string(), &counter);
+				auto extension = sources[i].extension().string();
+				std::transform(extension.begin(), extension.end(), extension.begin(),
+					[](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+				if (extension != ".jpg" && extension != ".jpeg")
+					file_name += ".jpg";
+
+				std::pmr::string new_file(folder.c_str(), &counter);
+				new_file += path_separator;
+				new_file += bucket_spec(buckets[i]).folder;
+				new_file += path_separator;
+				new_file += file_name;
+				const auto it = known_paths.find(new_file);
+				reference[i] = excluded_paths.count(new_file) ? invalid_image_id - 1 :
+					it == known_paths.end() ? invalid_image_id : it->second;
+			}
+
+			reference_allocations = counter.allocations();
+			});
+
+		// as in a fetch, the names of the new images are kept as candidates
+		struct candidate {
+			std::string_view asset;
+			std::string_view file_name;
+		};
+
+		std::vector<image_id> found(image_count);
+		size_t heap_allocations = 0;
+		const double ms = time_it([&]() {
+			counting_resource counter;
+			scan_arena arena(&counter);
+			const library_lookup lookup(folder, known, excluded, arena);
+			std::pmr::vector<candidate> candidates(arena.scan());
+			const size_t before = counter.allocations();
+
+			for (size_t i = 0; i < image_count; i++) {
+				arena.next_file();
+
+				candidate image;
+				image.asset = lookup.source_name(sources[i]);
+				image.file_name = lookup.file_name(image.asset);
+
+				const auto new_file = lookup.library_path(buckets[i], image.file_name);
+				found[i] = lookup.excluded(new_file) ? invalid_image_id - 1 : lookup.find(new_file);
+
+				if (found[i] == invalid_image_id)
+					candidates.push_back(image);
+			}
+
+			heap_allocations = counter.allocations() - before;
+			});
+
+		// the arena's chunks, which are all it takes from the heap
+		auto per_file = [](size_t allocations) {
+			char text[32];
+			snprintf(text, sizeof(text), "%.5f", static_cast<double>(allocations) / image_count);
+			return std::string(text) + " heap allocations per file";
+		};
+
+		benchmark_result result;
+		result.name = "scan";
+		result.variant = "std::string, " + per_file(reference_allocations);
+		result.milliseconds = reference_ms;
+		result.items_per_second = image_count / (reference_ms / 1000.);
+		results.push_back(result);
+
+		result.variant = "arena, " + per_file(heap_allocations);
+		result.milliseconds = ms;
+		result.items_per_second = image_count / (ms / 1000.);
+		result.matches_reference = found == reference;
+		results.push_back(result);
+	}
+
+	void benchmark_paths(std::vector<benchmark_result>& results) {
+		// the directory and file name of every image in a library of 50000
+		constexpr size_t image_count = 50000;
+#ifdef _WIN32
+		const std::string folder = "C:\\Users\\User\\Pictures\\Spotlight Images";
+#else
+		const std::string folder = "/home/user/Pictures/Spotlight Images";
+#endif
+
+		std::vector<std::uint8_t> random(image_count * 17);
+		fill_random(random, 0x165667b1u);
+
+		std::vector<std::string> paths;
+		paths.reserve(image_count);
+
+		for (size_t i = 0; i < image_count; i++) {
+			const auto* bytes = random.data() + i * 17;
+
+			std::string name;
+			for (size_t j = 0; j < 16; j++) {
+				name += "0123456789abcdef"[bytes[j] >> 4];
+				name += "0123456789abcdef"[bytes[j] & 15];
+			}
+
+			paths.push_back(join_path(join_path(folder, bucket_spec(aspect_buckets[bytes[16] % aspect_bucket_count].bucket).folder),
+				name + ".jpg"));
+		}
+
+		// the copying helpers that path_utils replaced, which only understood one separator
+		auto get_directory = [](const std::string& full_path, std::pmr::string& directory) {
+			directory.clear();
+			const size_t last_slash_index = full_path.rfind(path_separator);
+			if (std::string::npos != last_slash_index)
+				directory.assign(full_path, 0, last_slash_index);
+		};
+
+		auto get_filename = [](const std::string& full_path, std::pmr::string& file_name) {
+			file_name.clear();
+			const size_t last_slash_idx = full_path.rfind(path_separator);
+			if (std::string::npos != last_slash_idx) {
+				file_name.assign(full_path);
+				file_name.erase(0, last_slash_idx + 1);
+			}
+		};
+
+		std::vector<size_t> reference(image_count);
+		size_t reference_allocations = 0;
+		const double reference_ms = time_it([&]() {
+			counting_resource counter;
+
+			for (size_t i = 0; i < image_count; i++) {
+				std::pmr::string directory(&counter), file_name(&counter);
+				get_directory(paths[i], directory);
+				get_filename(paths[i], file_name);
+
+				reference[i] = std::hash<std::pmr::string>()(directory) ^ (std::hash<std::pmr::string>()(file_name) << 1);
+			}
+
+			reference_allocations = counter.allocations();
+			});
+
+		// views into the path, so nothing to count
+		std::vector<size_t> found(image_count);
+		const double ms = time_it([&]() {
+			for (size_t i = 0; i < image_count; i++)
+				found[i] = std::hash<std::string_view>()(path_directory(paths[i])) ^
+				(std::hash<std::string_view>()(path_filename(paths[i])) << 1);
+			});
+
+		char per_path[32];
+		snprintf(per_path, sizeof(per_path), "%.2f", static_cast<double>(reference_allocations) / image_count);
+
+		benchmark_result result;
+		result.name = "paths";
+		result.variant = std::string("std::string, ") + per_path + " heap allocations per path";
+		result.milliseconds = reference_ms;
+		result.items_per_second = image_count / (reference_ms / 1000.);
+		results.push_back(result);
+
+		result.variant = "std::string_view, 0 heap allocations per path";
+		result.milliseconds = ms;
+		result.items_per_second = image_count / (ms / 1000.);
+		result.matches_reference = found == reference;
+		results.push_back(result);
+	}
+}
+
+std::vector<benchmark_result> run_benchmarks(const std::string& filter) {
+	const std::vector<std::pair<const char*, std::function<void(std::vector<benchmark_result>&)>>> benchmarks = {
+		{ "colour_stats", benchmark_colour_stats },
+		{ "quality", benchmark_quality },
+		{ "saliency", benchmark_saliency },
+		{ "resample", benchmark_resample },
+		{ "similarity", benchmark_similarity },
+		{ "search", benchmark_search },
+		{ "copy", benchmark_copy },
+		{ "ingest", benchmark_ingest },
+		{ "sources", benchmark_sources },
+		{ "scan", benchmark_scan },
+		{ "paths", benchmark_paths },
+	};
+
+	std::vector<benchmark_result> results;
+
+	for (const auto& it : benchmarks)
+		if (filter.empty() || std::string(it.first).find(filter) != std::string::npos)
+			it.second(results);
+
+	return results;
+}
@@ -0,0 +1,58 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The result of timing one variant of a benchmark.
+/// </summary>
+struct benchmark_result {
+	std::string name;		// what is measured, e.g. "colour_stats"
+	std::string variant;	// the implementation, e.g. "AVX2"
+	double milliseconds = 0.;	// time per iteration
+	double items_per_second = 0.;
+	bool matches_reference = true;	// whether the variant agrees with the reference implementation
+};
+
+/// <summary>
+/// Run the micro-benchmarks of the engine.
+/// </summary>
+/// 
+/// <param name="filter">
+/// Only run benchmarks whose name contains this string. Runs all of them if empty.
+/// </param>
+/// 
+/// <returns>
+/// The results, with the reference implementation of each benchmark first.
+/// </returns>
+/// 
+/// <remarks>
+/// Works on synthetic data, so the results don't depend on the images in the
+/// library. The copy, ingest and sources benchmarks write their test files to
+/// the temporary folder.
+/// </remarks>
+std::vector<benchmark_result> run_benchmarks(const std::string& filter);
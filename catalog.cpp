@@ -0,0 +1,331 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "catalog.h"
+#include "path_utils.h"
+
+#include <algorithm>
+
+string_pool::string_pool(const string_pool& other) :
+	_strings(other._strings) {
+	_lookup.reserve(_strings.size());
+
+	for (size_t i = 0; i < _strings.size(); i++)
+		_lookup.emplace(_strings[i], static_cast<id>(i));
+}
+
+string_pool& string_pool::operator=(const string_pool& other) {
+	if (this != &other)
+		*this = string_pool(other);
+
+	return *this;
+}
+
+string_pool::id string_pool::intern(std::string_view value) {
+	const auto it = _lookup.find(value);
+
+	if (it != _lookup.end())
+		return it->second;
+
+	const id string_id = static_cast<id>(_strings.size());
+	_strings.emplace_back(value);
+	_lookup.emplace(_strings.back(), string_id);
+	return string_id;
+}
+
+std::string_view string_pool::get(id string_id) const {
+	return _strings[string_id];
+}
+
+size_t string_pool::size() const {
+	return _strings.size();
+}
+
+size_t string_pool::memory_usage() const {
+	size_t bytes = 0;
+
+	for (const auto& it : _strings)
+		bytes += sizeof(it) + (it.capacity() + 1);
+
+	// approximate the hash table as one node and one bucket per entry
+	bytes += _lookup.size() * (sizeof(std::string_view) + sizeof(id) + 2 * sizeof(void*));
+	bytes += _lookup.bucket_count() * sizeof(void*);
+	return bytes;
+}
+
+void string_pool::clear() {
+	_lookup.clear();
+	_strings.clear();
+}
+
+image_id image_catalog::add(std::string_view directory,
+	std::string_view file_name,
+	image_orientation orientation,
+	unsigned long long file_size,
+	unsigned int width,
+	unsigned int height,
+	long long fetched,
+	const colour_stats& colours,
+	const quality_scores& quality,
+	const crop_set& crops,
+	const image_signature& signature) {
+	const image_id id = static_cast<image_id>(_orientations.size());
+
+	_names.append(file_name);
+	_name_offsets.push_back(static_cast<std::uint32_t>(_names.size()));
+	_directory_ids.push_back(_directories.intern(directory));
+	_orientations.push_back(orientation);
+	_file_sizes.push_back(file_size);
+	_widths.push_back(width);
+	_heights.push_back(height);
+	_fetched.push_back(fetched);
+	_colours.push_back(colours);
+	_quality.push_back(quality);
+	_crops.push_back(crops);
+	_signatures.push_back(signature);
+
+	return id;
+}
+
+image_id image_catalog::add(const image_catalog& other, image_id id) {
+	return add(other.directory(id), other.name(id), other.orientation(id), other.file_size(id),
+		other.width(id), other.height(id), other.fetched(id),
+		other.colours(id), other.quality(id), other.crops(id), other.signature(id));
+}
+
+void image_catalog::reserve(size_t count) {
+	_name_offsets.reserve(count + 1);
+	_directory_ids.reserve(count);
+	_orientations.reserve(count);
+	_file_sizes.reserve(count);
+	_widths.reserve(count);
+	_heights.reserve(count);
+	_fetched.reserve(count);
+	_colours.reserve(count);
+	_quality.reserve(count);
+	_crops.reserve(count);
+	_signatures.reserve(count);
+}
+
+void image_catalog::shrink_to_fit() {
+	_names.shrink_to_fit();
+	_name_offsets.shrink_to_fit();
+	_directory_ids.shrink_to_fit();
+	_orientations.shrink_to_fit();
+	_file_sizes.shrink_to_fit();
+	_widths.shrink_to_fit();
+	_heights.shrink_to_fit();
+	_fetched.shrink_to_fit();
+	_colours.shrink_to_fit();
+	_quality.shrink_to_fit();
+	_crops.shrink_to_fit();
+	_signatures.shrink_to_fit();
+}
+
+void image_catalog::clear() {
+	_directories.clear();
+	_names.clear();
+	_name_offsets.assign(1, 0);
+	_directory_ids.clear();
+	_orientations.clear();
+	_file_sizes.clear();
+	_widths.clear();
+	_heights.clear();
+	_fetched.clear();
+	_colours.clear();
+	_quality.clear();
+	_crops.clear();
+	_signatures.clear();
+}
+
+size_t image_catalog::size() const {
+	return _orientations.size();
+}
+
+bool image_catalog::empty() const {
+	return _orientations.empty();
+}
+
+image_info image_catalog::get(image_id id) const {
+	return {
+		_orientations[id],
+		full_path(id),
+		_file_sizes[id],
+		_widths[id],
+		_heights[id],
+		_fetched[id]
+	};
+}
+
+std::string image_catalog::full_path(image_id id) const {
+	const auto dir = directory(id);
+	const auto file_name = name(id);
+
+	return join_path(dir, file_name);
+}
+
+std::string_view image_catalog::name(image_id id) const {
+	const auto first = _name_offsets[id];
+	return std::string_view(_names).substr(first, _name_offsets[id + 1] - first);
+}
+
+std::string_view image_catalog::directory(image_id id) const {
+	return _directories.get(_directory_ids[id]);
+}
+
+image_orientation image_catalog::orientation(image_id id) const {
+	return _orientations[id];
+}
+
+unsigned long long image_catalog::file_size(image_id id) const {
+	return _file_sizes[id];
+}
+
+unsigned int image_catalog::width(image_id id) const {
+	return _widths[id];
+}
+
+unsigned int image_catalog::height(image_id id) const {
+	return _heights[id];
+}
+
+long long image_catalog::fetched(image_id id) const {
+	return _fetched[id];
+}
+
+const colour_stats& image_catalog::colours(image_id id) const {
+	return _colours[id];
+}
+
+const quality_scores& image_catalog::quality(image_id id) const {
+	return _quality[id];
+}
+
+const crop_set& image_catalog::crops(image_id id) const {
+	return _crops[id];
+}
+
+const image_signature& image_catalog::signature(image_id id) const {
+	return _signatures[id];
+}
+
+const std::vector<image_orientation>& image_catalog::orientations() const {
+	return _orientations;
+}
+
+const std::vector<unsigned long long>& image_catalog::file_sizes() const {
+	return _file_sizes;
+}
+
+const std::vector<unsigned int>& image_catalog::widths() const {
+	return _widths;
+}
+
+const std::vector<unsigned int>& image_catalog::heights() const {
+	return _heights;
+}
+
+const std::vector<long long>& image_catalog::fetched_times() const {
+	return _fetched;
+}
+
+const std::vector<colour_stats>& image_catalog::colours() const {
+	return _colours;
+}
+
+const std::vector<quality_scores>& image_catalog::qualities() const {
+	return _quality;
+}
+
+const std::vector<crop_set>& image_catalog::crops() const {
+	return _crops;
+}
+
+const std::vector<image_signature>& image_catalog::signatures() const {
+	return _signatures;
+}
+
+size_t image_catalog::count(image_orientation orientation) const {
+	return static_cast<size_t>(std::count(_orientations.begin(), _orientations.end(), orientation));
+}
+
+size_t image_catalog::memory_usage() const {
+	return sizeof(*this) +
+		_directories.memory_usage() +
+		_names.capacity() +
+		_name_offsets.capacity() * sizeof(std::uint32_t) +
+		_directory_ids.capacity() * sizeof(string_pool::id) +
+		_orientations.capacity() * sizeof(image_orientation) +
+		_file_sizes.capacity() * sizeof(unsigned long long) +
+		_widths.capacity() * sizeof(unsigned int) +
+		_heights.capacity() * sizeof(unsigned int) +
+		_fetched.capacity() * sizeof(long long) +
+		_colours.capacity() * sizeof(colour_stats) +
+		_quality.capacity() * sizeof(quality_scores) +
+		_crops.capacity() * sizeof(crop_set) +
+		_signatures.capacity() * sizeof(image_signature);
+}
+
+catalog_changes compare_catalogs(const image_catalog& before, const image_catalog& after) {
+	catalog_changes changes;
+
+	// key each image on its directory and name without building full paths
+	struct key_hash {
+		size_t operator()(const std::pair<std::string_view, std::string_view>& key) const {
+			const size_t h = std::hash<std::string_view>()(key.first);
+			return h ^ (std::hash<std::string_view>()(key.second) + static_cast<size_t>(0x9e3779b97f4a7c15ull) + (h << 6) + (h >> 2));
+		}
+	};
+
+	std::unordered_map<std::pair<std::string_view, std::string_view>, image_id, key_hash> lookup;
+	lookup.reserve(before.size());
+
+	for (image_id id = 0; id < before.size(); id++)
+		lookup.emplace(std::make_pair(before.directory(id), before.name(id)), id);
+
+	std::vector<bool> matched(before.size(), false);
+
+	for (image_id id = 0; id < after.size(); id++) {
+		const auto it = lookup.find(std::make_pair(after.directory(id), after.name(id)));
+
+		if (it == lookup.end()) {
+			changes.added.push_back(id);
+			continue;
+		}
+
+		matched[it->second] = true;
+
+		if (before.file_size(it->second) != after.file_size(id) ||
+			before.width(it->second) != after.width(id) ||
+			before.height(it->second) != after.height(id) ||
+			before.fetched(it->second) != after.fetched(id))
+			changes.modified.push_back(id);
+	}
+
+	for (image_id id = 0; id < before.size(); id++)
+		if (!matched[id])
+			changes.removed.push_back(id);
+
+	return changes;
+}
@@ -0,0 +1,273 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "colour_stats.h"
+#include "image_quality.h"
+#include "smart_crop.h"
+#include "image_signature.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+struct image_info {
+	image_orientation orientation;
+	std::string full_path;
+	unsigned long long file_size = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	long long fetched = 0;
+};
+
+/// <summary>
+/// Stable identifier of an image in an image_catalog.
+/// </summary>
+using image_id = std::uint32_t;
+constexpr image_id invalid_image_id = ~static_cast<image_id>(0);
+
+/// <summary>
+/// Interns strings so that each distinct string is stored once.
+/// </summary>
+class string_pool {
+public:
+	using id = std::uint32_t;
+
+	string_pool() = default;
+
+	/// <summary>
+	/// Copy a pool. The lookup is rebuilt so that it refers to the copy's own
+	/// strings rather than to the other pool's.
+	/// </summary>
+	string_pool(const string_pool& other);
+	string_pool& operator=(const string_pool& other);
+
+	// moving a deque hands over its storage, so the views stay valid
+	string_pool(string_pool&&) = default;
+	string_pool& operator=(string_pool&&) = default;
+
+	/// <summary>
+	/// Add a string to the pool.
+	/// </summary>
+	/// 
+	/// <param name="value">The string.</param>
+	/// 
+	/// <returns>
+	/// The id of the string. Interning an equal string returns the same id.
+	/// </returns>
+	id intern(std::string_view value);
+
+	/// <summary>
+	/// Get a string from the pool.
+	/// </summary>
+	/// 
+	/// <param name="string_id">The id returned by intern().</param>
+	/// 
+	/// <returns>
+	/// A view of the string, valid for the lifetime of the pool.
+	/// </returns>
+	std::string_view get(id string_id) const;
+
+	/// <summary>
+	/// Get the number of distinct strings in the pool.
+	/// </summary>
+	size_t size() const;
+
+	/// <summary>
+	/// Get the approximate number of bytes used by the pool.
+	/// </summary>
+	size_t memory_usage() const;
+
+	void clear();
+
+private:
+	// a deque never relocates its elements, so the views in _lookup stay valid
+	std::deque<std::string> _strings;
+	std::unordered_map<std::string_view, id> _lookup;
+};
+
+/// <summary>
+/// Compact catalog of images, stored as one column per attribute.
+/// </summary>
+/// 
+/// <remarks>
+/// Directories are interned, so the folder prefix shared by all images in a
+/// sub-folder is stored once. File names are packed into a single buffer.
+/// Image ids are indices into the columns and remain valid until clear() is
+/// called. Scans over a single attribute (counting, sorting, filtering) touch
+/// only that attribute's column.
+/// </remarks>
+class image_catalog {
+public:
+	/// <summary>
+	/// Add an image to the catalog.
+	/// </summary>
+	/// 
+	/// <param name="directory">The directory the image is in, without a trailing separator.</param>
+	/// <param name="file_name">The file name of the image, including the extension.</param>
+	/// <param name="orientation">The orientation of the image.</param>
+	/// <param name="file_size">The size of the file, in bytes.</param>
+	/// <param name="width">The width of the image, in pixels.</param>
+	/// <param name="height">The height of the image, in pixels.</param>
+	/// <param name="fetched">When the image was fetched, in seconds since the Unix epoch.</param>
+	/// <param name="colours">The colour statistics of the image, if they are known.</param>
+	/// <param name="quality">The quality scores of the image, if they are known.</param>
+	/// <param name="crops">The smart crop windows of the image, if they are known.</param>
+	/// <param name="signature">The luminance signature of the image, if it is known.</param>
+	/// 
+	/// <returns>
+	/// The id of the new image.
+	/// </returns>
+	image_id add(std::string_view directory,
+		std::string_view file_name,
+		image_orientation orientation,
+		unsigned long long file_size,
+		unsigned int width,
+		unsigned int height,
+		long long fetched,
+		const colour_stats& colours = colour_stats(),
+		const quality_scores& quality = quality_scores(),
+		const crop_set& crops = crop_set(),
+		const image_signature& signature = image_signature());
+
+	/// <summary>
+	/// Add an image from another catalog, with all its attributes.
+	/// </summary>
+	/// 
+	/// <param name="other">The other catalog. It can't be this one.</param>
+	/// <param name="id">The id of the image in the other catalog.</param>
+	/// 
+	/// <returns>
+	/// The id of the new image.
+	/// </returns>
+	image_id add(const image_catalog& other, image_id id);
+
+	void reserve(size_t count);
+	void shrink_to_fit();
+	void clear();
+
+	/// <summary>
+	/// Get the number of images in the catalog.
+	/// </summary>
+	size_t size() const;
+	bool empty() const;
+
+	/// <summary>
+	/// Get the full details of an image.
+	/// </summary>
+	/// 
+	/// <param name="id">The id of the image.</param>
+	/// 
+	/// <returns>
+	/// The image information, with the full path assembled from the interned
+	/// directory and the file name.
+	/// </returns>
+	image_info get(image_id id) const;
+
+	std::string full_path(image_id id) const;
+	std::string_view name(image_id id) const;
+	std::string_view directory(image_id id) const;
+	image_orientation orientation(image_id id) const;
+	unsigned long long file_size(image_id id) const;
+	unsigned int width(image_id id) const;
+	unsigned int height(image_id id) const;
+	long long fetched(image_id id) const;
+	const colour_stats& colours(image_id id) const;
+	const quality_scores& quality(image_id id) const;
+	const crop_set& crops(image_id id) const;
+	const image_signature& signature(image_id id) const;
+
+	const std::vector<image_orientation>& orientations() const;
+	const std::vector<unsigned long long>& file_sizes() const;
+	const std::vector<unsigned int>& widths() const;
+	const std::vector<unsigned int>& heights() const;
+	const std::vector<long long>& fetched_times() const;
+	const std::vector<colour_stats>& colours() const;
+	const std::vector<quality_scores>& qualities() const;
+	const std::vector<crop_set>& crops() const;
+	const std::vector<image_signature>& signatures() const;
+
+	/// <summary>
+	/// Count the images with a given orientation.
+	/// </summary>
+	size_t count(image_orientation orientation) const;
+
+	/// <summary>
+	/// Get the approximate number of bytes used by the catalog.
+	/// </summary>
+	size_t memory_usage() const;
+
+private:
+	friend bool save_snapshot(const image_catalog& images,
+		const std::string& full_path,
+		std::string& error);
+	friend bool load_snapshot(const std::string& full_path,
+		image_catalog& images,
+		std::string& error);
+
+	string_pool _directories;
+	std::string _names;
+
+	// columns
+	std::vector<std::uint32_t> _name_offsets{ 0 };
+	std::vector<string_pool::id> _directory_ids;
+	std::vector<image_orientation> _orientations;
+	std::vector<unsigned long long> _file_sizes;
+	std::vector<unsigned int> _widths;
+	std::vector<unsigned int> _heights;
+	std::vector<long long> _fetched;
+	std::vector<colour_stats> _colours;
+	std::vector<quality_scores> _quality;
+	std::vector<crop_set> _crops;
+	std::vector<image_signature> _signatures;
+};
+
+/// <summary>
+/// Differences between two catalogs.
+/// </summary>
+struct catalog_changes {
+	std::vector<image_id> added;	// ids in the newer catalog
+	std::vector<image_id> removed;	// ids in the older catalog
+	std::vector<image_id> modified;	// ids in the newer catalog
+
+	bool empty() const {
+		return added.empty() && removed.empty() && modified.empty();
+	}
+};
+
+/// <summary>
+/// Compare two catalogs.
+/// </summary>
+/// 
+/// <param name="before">The older catalog.</param>
+/// <param name="after">The newer catalog.</param>
+/// 
+/// <returns>
+/// The images added, removed and modified, matched by full path.
+/// </returns>
+catalog_changes compare_catalogs(const image_catalog& before, const image_catalog& after);
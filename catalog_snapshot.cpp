@@ -0,0 +1,269 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "catalog_snapshot.h"
+#include "mapped_file.h"
+#include "path_utils.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace {
+	constexpr char snapshot_magic[4] = { 'S', 'P', 'I', 'C' };
+	constexpr std::uint32_t snapshot_version = 5;
+
+	struct snapshot_header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t count;
+		std::uint32_t directory_count;
+		std::uint64_t directories_bytes;
+		std::uint64_t names_bytes;
+	};
+
+	template <typename T>
+	void write_column(std::ofstream& file, const std::vector<T>& column) {
+		if (!column.empty())
+			file.write(reinterpret_cast<const char*>(column.data()),
+				static_cast<std::streamsize>(column.size() * sizeof(T)));
+	}
+
+	/// <summary>
+	/// Sequential reader over a mapped snapshot that refuses to read past the end.
+	/// </summary>
+	class snapshot_reader {
+	public:
+		snapshot_reader(const unsigned char* data, size_t size) :
+			_data(data), _size(size) {}
+
+		bool read(void* destination, size_t bytes) {
+			if (bytes > _size - _offset)
+				return false;
+
+			if (bytes)
+				memcpy(destination, _data + _offset, bytes);
+
+			_offset += bytes;
+			return true;
+		}
+
+		template <typename T>
+		bool read_column(std::vector<T>& column, size_t count) {
+			if (count > (_size - _offset) / sizeof(T))
+				return false;
+
+			column.resize(count);
+			return read(column.data(), count * sizeof(T));
+		}
+
+		bool at_end() const {
+			return _offset == _size;
+		}
+
+	private:
+		const unsigned char* _data;
+		size_t _size;
+		size_t _offset = 0;
+	};
+
+	// the columns are copied as is, so every flag and enum is checked before
+	// anything branches on it or uses it as an index
+	bool is_flag(std::uint8_t value) {
+		return value <= 1;
+	}
+
+	bool valid(image_orientation orientation) {
+		return orientation == image_orientation::portrait || orientation == image_orientation::landscape;
+	}
+
+	bool valid(const colour_stats& colours) {
+		return is_flag(colours.computed);
+	}
+
+	bool valid(const quality_scores& quality) {
+		return is_flag(quality.computed) && is_flag(quality.truncated) &&
+			std::isfinite(quality.sharpness) && std::isfinite(quality.entropy);
+	}
+
+	// the boxes need no check, crop_bitmap clamps them to the image
+	bool valid(const crop_set& crops) {
+		return is_flag(crops.computed);
+	}
+}
+
+bool save_snapshot(const image_catalog& images,
+	const std::string& full_path,
+	std::string& error) {
+	// lay out the interned directories as offsets into a single buffer
+	std::vector<std::uint32_t> directory_offsets{ 0 };
+	std::string directories;
+
+	for (string_pool::id i = 0; i < images._directories.size(); i++) {
+		directories.append(images._directories.get(i));
+		directory_offsets.push_back(static_cast<std::uint32_t>(directories.size()));
+	}
+
+	snapshot_header header = {};
+	memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.version = snapshot_version;
+	header.count = static_cast<std::uint32_t>(images.size());
+	header.directory_count = static_cast<std::uint32_t>(images._directories.size());
+	header.directories_bytes = directories.size();
+	header.names_bytes = images._names.size();
+
+	const std::string temp_path = full_path + ".tmp";
+
+	try {
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+			if (!file) {
+				error = "Unable to create " + temp_path;
+				return false;
+			}
+
+			// 8 byte columns first, then 4 byte columns, then bytes
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			write_column(file, images._file_sizes);
+			write_column(file, images._fetched);
+			write_column(file, images._name_offsets);
+			write_column(file, images._directory_ids);
+			write_column(file, images._widths);
+			write_column(file, images._heights);
+			write_column(file, images._colours);
+			write_column(file, images._quality);
+			write_column(file, images._crops);
+			write_column(file, images._signatures);
+			write_column(file, directory_offsets);
+			write_column(file, images._orientations);
+			file.write(directories.data(), static_cast<std::streamsize>(directories.size()));
+			file.write(images._names.data(), static_cast<std::streamsize>(images._names.size()));
+
+			if (!file) {
+				error = "Unable to write " + temp_path;
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temp_path, full_path);
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		return false;
+	}
+
+	return true;
+}
+
+bool load_snapshot(const std::string& full_path,
+	image_catalog& images,
+	std::string& error) {
+	images.clear();
+
+	mapped_file file;
+	if (!file.open(full_path, error))
+		return false;
+
+	snapshot_reader reader(file.data(), file.size());
+
+	snapshot_header header;
+	if (!reader.read(&header, sizeof(header)) ||
+		memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0) {
+		error = "Not a catalog snapshot";
+		return false;
+	}
+
+	if (header.version != snapshot_version) {
+		error = "Unsupported catalog snapshot version";
+		return false;
+	}
+
+	const size_t count = header.count;
+	std::vector<std::uint32_t> directory_offsets;
+	std::string directories;
+
+	bool ok = reader.read_column(images._file_sizes, count) &&
+		reader.read_column(images._fetched, count) &&
+		reader.read_column(images._name_offsets, count + 1) &&
+		reader.read_column(images._directory_ids, count) &&
+		reader.read_column(images._widths, count) &&
+		reader.read_column(images._heights, count) &&
+		reader.read_column(images._colours, count) &&
+		reader.read_column(images._quality, count) &&
+		reader.read_column(images._crops, count) &&
+		reader.read_column(images._signatures, count) &&
+		reader.read_column(directory_offsets, static_cast<size_t>(header.directory_count) + 1) &&
+		reader.read_column(images._orientations, count);
+
+	if (ok && header.directories_bytes <= file.size() && header.names_bytes <= file.size()) {
+		directories.resize(static_cast<size_t>(header.directories_bytes));
+		images._names.resize(static_cast<size_t>(header.names_bytes));
+		ok = reader.read(&directories[0], directories.size()) &&
+			reader.read(&images._names[0], images._names.size()) &&
+			reader.at_end();
+	}
+	else
+		ok = false;
+
+	// validate the offsets and ids before anything dereferences them
+	for (size_t i = 0; ok && i < count; i++)
+		ok = images._name_offsets[i] <= images._name_offsets[i + 1] &&
+		images._directory_ids[i] < header.directory_count &&
+		valid(images._orientations[i]) &&
+		valid(images._colours[i]) &&
+		valid(images._quality[i]) &&
+		valid(images._crops[i]);
+
+	ok = ok && images._name_offsets.front() == 0 && images._name_offsets.back() == images._names.size();
+
+	for (size_t i = 0; ok && i < header.directory_count; i++)
+		ok = directory_offsets[i] <= directory_offsets[i + 1] && directory_offsets[i + 1] <= directories.size();
+
+	if (!ok) {
+		images.clear();
+		error = "The catalog snapshot is corrupt";
+		return false;
+	}
+
+	// interning in snapshot order reproduces the original directory ids, unless
+	// a directory is repeated, which would leave ids past the end of the pool
+	for (size_t i = 0; i < header.directory_count; i++)
+		images._directories.intern(std::string_view(directories).substr(directory_offsets[i],
+			directory_offsets[i + 1] - directory_offsets[i]));
+
+	if (images._directories.size() != header.directory_count) {
+		images.clear();
+		error = "The catalog snapshot is corrupt";
+		return false;
+	}
+
+	return true;
+}
+
+std::string snapshot_path(const std::string& folder) {
+	return join_path(folder, ".catalog");
+}
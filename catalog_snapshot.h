@@ -0,0 +1,75 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "catalog.h"
+
+#include <string>
+
+/// <summary>
+/// Save a catalog as a compact binary snapshot.
+/// </summary>
+/// 
+/// <param name="images">The catalog.</param>
+/// <param name="full_path">The full path to the snapshot file.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// The snapshot is written to a temporary file which then replaces the
+/// existing snapshot, so a reader never sees a partially written file.
+/// </remarks>
+bool save_snapshot(const image_catalog& images,
+	const std::string& full_path,
+	std::string& error);
+
+/// <summary>
+/// Load a catalog from a binary snapshot.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the snapshot file.</param>
+/// <param name="images">The catalog.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false. A snapshot written by a different
+/// version of the catalog format is rejected.
+/// </returns>
+/// 
+/// <remarks>
+/// The file is memory-mapped and its columns are copied directly into the
+/// catalog, so loading does not touch the images themselves.
+/// </remarks>
+bool load_snapshot(const std::string& full_path,
+	image_catalog& images,
+	std::string& error);
+
+/// <summary>
+/// Get the path of a library's catalog snapshot.
+/// </summary>
+std::string snapshot_path(const std::string& folder);
@@ -0,0 +1,336 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "colour_stats.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLOUR_STATS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define COLOUR_STATS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	// Rec. 709 luma weights scaled to add up to 256, so luminance * 256 fits in 16 bits
+	constexpr unsigned int weight_b = 19;
+	constexpr unsigned int weight_g = 183;
+	constexpr unsigned int weight_r = 54;
+	constexpr unsigned int dark_threshold = colour_stats::dark_luminance * 256;
+
+	constexpr size_t bin_count = colour_stats().histogram.size();
+
+	// pixels are classified in blocks so that the bin indices stay in the L1 cache
+	// and the 32 bit vector accumulators cannot overflow
+	constexpr size_t block_pixels = 1024;
+
+	struct accumulator {
+		std::uint64_t luminance = 0;	// sum of luminance * 256
+		std::uint64_t dark = 0;
+		std::array<std::uint32_t, bin_count> bins{};
+	};
+
+	/// <summary>
+	/// Reference implementation, also used for the pixels left over by the
+	/// vector kernels.
+	/// </summary>
+	void accumulate_scalar(const std::uint8_t* bgra, size_t count, accumulator& acc) {
+		for (size_t i = 0; i < count; i++, bgra += 4) {
+			const unsigned int b = bgra[0], g = bgra[1], r = bgra[2];
+			const unsigned int y = b * weight_b + g * weight_g + r * weight_r;
+
+			acc.luminance += y;
+			acc.dark += y < dark_threshold;
+			acc.bins[(r >> 6) << 4 | (g >> 6) << 2 | (b >> 6)]++;
+		}
+	}
+
+	/// <summary>
+	/// Count bin indices, spreading consecutive pixels over separate tables so
+	/// that runs of the same colour don't serialize on one counter.
+	/// </summary>
+	void count_bins(const std::uint8_t* indices, size_t count, accumulator& acc) {
+		std::uint32_t tables[4][bin_count] = {};
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			tables[0][indices[i]]++;
+			tables[1][indices[i + 1]]++;
+			tables[2][indices[i + 2]]++;
+			tables[3][indices[i + 3]]++;
+		}
+
+		for (; i < count; i++)
+			tables[0][indices[i]]++;
+
+		for (size_t bin = 0; bin < bin_count; bin++)
+			acc.bins[bin] += tables[0][bin] + tables[1][bin] + tables[2][bin] + tables[3][bin];
+	}
+
+#if defined(COLOUR_STATS_X86)
+	void accumulate_sse2(const std::uint8_t* bgra, size_t count, accumulator& acc) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weights = _mm_setr_epi16(weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0);
+		const __m128i threshold = _mm_set1_epi32(dark_threshold);
+		const __m128i two_bits = _mm_set1_epi8(3);
+		const __m128i b_mask = _mm_set1_epi32(0x03);
+		const __m128i g_mask = _mm_set1_epi32(0x0c);
+		const __m128i r_mask = _mm_set1_epi32(0x30);
+
+		alignas(16) std::uint8_t indices[block_pixels];
+		size_t done = 0;
+
+		while (count - done >= 16) {
+			const size_t block = (std::min)(block_pixels, (count - done) & ~size_t(15));
+			__m128i sum = zero, dark = zero;
+
+			for (size_t i = 0; i < block; i += 16) {
+				const std::uint8_t* pixels = bgra + (done + i) * 4;
+				__m128i bins[4];
+
+				// four pixels per register
+				for (int k = 0; k < 4; k++) {
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k * 16));
+
+					// b * wb + g * wg and r * wr for each pixel, then add the pairs
+					const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights);
+					const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights);
+					const __m128i y = _mm_add_epi32(
+						_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))),
+						_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1))));
+
+					sum = _mm_add_epi32(sum, y);
+					dark = _mm_sub_epi32(dark, _mm_cmplt_epi32(y, threshold));
+
+					// top two bits of each channel, then gather them into the low byte
+					const __m128i q = _mm_and_si128(_mm_srli_epi16(v, 6), two_bits);
+					bins[k] = _mm_or_si128(_mm_and_si128(q, b_mask),
+						_mm_or_si128(_mm_and_si128(_mm_srli_epi32(q, 6), g_mask),
+							_mm_and_si128(_mm_srli_epi32(q, 12), r_mask)));
+				}
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i),
+					_mm_packus_epi16(_mm_packs_epi32(bins[0], bins[1]), _mm_packs_epi32(bins[2], bins[3])));
+			}
+
+			alignas(16) std::uint32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+			acc.luminance += static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), dark);
+			acc.dark += static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+
+			count_bins(indices, block, acc);
+			done += block;
+		}
+
+		accumulate_scalar(bgra + done * 4, count - done, acc);
+	}
+
+	TARGET_AVX2
+	void accumulate_avx2(const std::uint8_t* bgra, size_t count, accumulator& acc) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i weights = _mm256_setr_epi16(
+			weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0,
+			weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0);
+		const __m256i threshold = _mm256_set1_epi32(dark_threshold);
+		const __m256i two_bits = _mm256_set1_epi8(3);
+		const __m256i b_mask = _mm256_set1_epi32(0x03);
+		const __m256i g_mask = _mm256_set1_epi32(0x0c);
+		const __m256i r_mask = _mm256_set1_epi32(0x30);
+
+		alignas(32) std::uint8_t indices[block_pixels];
+		size_t done = 0;
+
+		while (count - done >= 32) {
+			const size_t block = (std::min)(block_pixels, (count - done) & ~size_t(31));
+			__m256i sum = zero, dark = zero;
+
+			for (size_t i = 0; i < block; i += 32) {
+				const std::uint8_t* pixels = bgra + (done + i) * 4;
+				__m256i bins[4];
+
+				// eight pixels per register; the unpacks and shuffles work within
+				// 128 bit lanes, which reorders pixels but doesn't change the totals
+				for (int k = 0; k < 4; k++) {
+					const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + k * 32));
+
+					const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), weights);
+					const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), weights);
+					const __m256i y = _mm256_add_epi32(
+						_mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))),
+						_mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1))));
+
+					sum = _mm256_add_epi32(sum, y);
+					dark = _mm256_sub_epi32(dark, _mm256_cmpgt_epi32(threshold, y));
+
+					const __m256i q = _mm256_and_si256(_mm256_srli_epi16(v, 6), two_bits);
+					bins[k] = _mm256_or_si256(_mm256_and_si256(q, b_mask),
+						_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(q, 6), g_mask),
+							_mm256_and_si256(_mm256_srli_epi32(q, 12), r_mask)));
+				}
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + i),
+					_mm256_packus_epi16(_mm256_packs_epi32(bins[0], bins[1]), _mm256_packs_epi32(bins[2], bins[3])));
+			}
+
+			alignas(32) std::uint32_t lanes[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+			for (const auto lane : lanes)
+				acc.luminance += lane;
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), dark);
+			for (const auto lane : lanes)
+				acc.dark += lane;
+
+			count_bins(indices, block, acc);
+			done += block;
+		}
+
+		accumulate_scalar(bgra + done * 4, count - done, acc);
+	}
+#endif
+
+#if defined(COLOUR_STATS_NEON)
+	void accumulate_neon(const std::uint8_t* bgra, size_t count, accumulator& acc) {
+		const uint8x8_t wb = vdup_n_u8(weight_b);
+		const uint8x8_t wg = vdup_n_u8(weight_g);
+		const uint8x8_t wr = vdup_n_u8(weight_r);
+		const uint16x8_t threshold = vdupq_n_u16(dark_threshold);
+
+		alignas(16) std::uint8_t indices[block_pixels];
+		size_t done = 0;
+
+		while (count - done >= 16) {
+			const size_t block = (std::min)(block_pixels, (count - done) & ~size_t(15));
+			uint32x4_t sum = vdupq_n_u32(0);
+			uint16x8_t dark = vdupq_n_u16(0);
+
+			for (size_t i = 0; i < block; i += 16) {
+				// de-interleave sixteen pixels into one register per channel
+				const uint8x16x4_t v = vld4q_u8(bgra + (done + i) * 4);
+
+				uint16x8_t y_lo = vmull_u8(vget_low_u8(v.val[0]), wb);
+				y_lo = vmlal_u8(y_lo, vget_low_u8(v.val[1]), wg);
+				y_lo = vmlal_u8(y_lo, vget_low_u8(v.val[2]), wr);
+
+				uint16x8_t y_hi = vmull_u8(vget_high_u8(v.val[0]), wb);
+				y_hi = vmlal_u8(y_hi, vget_high_u8(v.val[1]), wg);
+				y_hi = vmlal_u8(y_hi, vget_high_u8(v.val[2]), wr);
+
+				sum = vpadalq_u16(sum, y_lo);
+				sum = vpadalq_u16(sum, y_hi);
+				dark = vsubq_u16(dark, vcltq_u16(y_lo, threshold));
+				dark = vsubq_u16(dark, vcltq_u16(y_hi, threshold));
+
+				const uint8x16_t bins = vorrq_u8(vshrq_n_u8(v.val[0], 6),
+					vorrq_u8(vshlq_n_u8(vshrq_n_u8(v.val[1], 6), 2),
+						vshlq_n_u8(vshrq_n_u8(v.val[2], 6), 4)));
+				vst1q_u8(indices + i, bins);
+			}
+
+			acc.luminance += vaddlvq_u32(sum);
+			acc.dark += vaddlvq_u16(dark);
+
+			count_bins(indices, block, acc);
+			done += block;
+		}
+
+		accumulate_scalar(bgra + done * 4, count - done, acc);
+	}
+#endif
+
+	void finish(const accumulator& acc, size_t count, colour_stats& stats) {
+		stats = colour_stats();
+
+		if (count == 0)
+			return;
+
+		stats.computed = 1;
+		stats.luminance = static_cast<std::uint8_t>((acc.luminance + count * 128) / (count * 256));
+		stats.dark_share = static_cast<std::uint8_t>((acc.dark * 255 + count / 2) / count);
+
+		for (size_t bin = 0; bin < bin_count; bin++)
+			stats.histogram[bin] = static_cast<std::uint8_t>((acc.bins[bin] * 255ull + count / 2) / count);
+
+		// the dominant colours are the centres of the fullest bins
+		std::array<std::uint8_t, bin_count> order;
+		for (size_t bin = 0; bin < bin_count; bin++)
+			order[bin] = static_cast<std::uint8_t>(bin);
+
+		std::partial_sort(order.begin(), order.begin() + stats.dominant.size(), order.end(),
+			[&acc](std::uint8_t a, std::uint8_t b) {
+				return acc.bins[a] != acc.bins[b] ? acc.bins[a] > acc.bins[b] : a < b;
+			});
+
+		for (size_t i = 0; i < stats.dominant.size(); i++) {
+			const unsigned int bin = order[i];
+			if (acc.bins[bin] == 0)
+				break;
+
+			const std::uint32_t r = (bin >> 4) * 64 + 32;
+			const std::uint32_t g = ((bin >> 2) & 3) * 64 + 32;
+			const std::uint32_t b = (bin & 3) * 64 + 32;
+			stats.dominant[i] = r << 16 | g << 8 | b;
+		}
+	}
+}
+
+void compute_colour_stats(const bitmap& image, colour_stats& stats) {
+	compute_colour_stats(image.pixels.data(),
+		(std::min)(static_cast<size_t>(image.width) * image.height, image.pixels.size() / 4),
+		detect_simd_level(), stats);
+}
+
+void compute_colour_stats(const std::uint8_t* bgra,
+	size_t pixel_count,
+	simd_level level,
+	colour_stats& stats) {
+	accumulator acc;
+
+	switch (level) {
+#if defined(COLOUR_STATS_X86)
+	case simd_level::sse2:
+		accumulate_sse2(bgra, pixel_count, acc);
+		break;
+	case simd_level::avx2:
+		accumulate_avx2(bgra, pixel_count, acc);
+		break;
+#elif defined(COLOUR_STATS_NEON)
+	case simd_level::neon:
+		accumulate_neon(bgra, pixel_count, acc);
+		break;
+#endif
+	default:
+		accumulate_scalar(bgra, pixel_count, acc);
+		break;
+	}
+
+	finish(acc, pixel_count, stats);
+}
@@ -0,0 +1,108 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+#include "cpu_features.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/// <summary>
+/// Colour statistics of an image, computed from a downscaled decode.
+/// </summary>
+/// 
+/// <remarks>
+/// Plain data so that it can be stored as a catalog column and written to
+/// snapshots as is.
+/// </remarks>
+struct colour_stats {
+	/// <summary>
+	/// The number of bins per channel in the colour histogram.
+	/// </summary>
+	static constexpr unsigned int channel_bins = 4;
+
+	/// <summary>
+	/// Pixels with a luminance below this are counted as dark.
+	/// </summary>
+	static constexpr unsigned int dark_luminance = 64;
+
+	std::uint8_t computed = 0;	// 0 if the image could not be analyzed
+	std::uint8_t luminance = 0;	// mean luminance, 0 - 255
+	std::uint8_t dark_share = 0;	// share of dark pixels, 0 - 255
+	std::uint8_t reserved = 0;	// keeps the layout free of padding
+
+	/// <summary>
+	/// The share of pixels in each colour bin, 0 - 255. The bin of a colour is
+	/// (r / 64) * 16 + (g / 64) * 4 + b / 64.
+	/// </summary>
+	std::array<std::uint8_t, channel_bins * channel_bins * channel_bins> histogram{};
+
+	/// <summary>
+	/// The most common colours as 0xRRGGBB, most common first. Unused entries
+	/// are zero.
+	/// </summary>
+	std::array<std::uint32_t, 3> dominant{};
+
+	/// <summary>
+	/// Check whether the image is dark enough to go with the dark theme.
+	/// </summary>
+	bool suits_dark_theme() const {
+		return computed && (luminance < 96 || dark_share >= 160);
+	}
+};
+
+static_assert(std::is_trivially_copyable<colour_stats>::value && sizeof(colour_stats) == 80,
+	"colour_stats is written to snapshots byte for byte");
+
+/// <summary>
+/// Compute the colour statistics of an image using the best instruction set
+/// available.
+/// </summary>
+/// 
+/// <param name="image">The image, ideally downscaled to a few thousand pixels.</param>
+/// <param name="stats">The statistics.</param>
+void compute_colour_stats(const bitmap& image, colour_stats& stats);
+
+/// <summary>
+/// Compute the colour statistics of BGRA pixels with a specific instruction set.
+/// </summary>
+/// 
+/// <param name="bgra">The pixels, four bytes each.</param>
+/// <param name="pixel_count">The number of pixels.</param>
+/// <param name="level">
+/// The instruction set to use. It must be supported, see simd_supported().
+/// </param>
+/// <param name="stats">The statistics.</param>
+/// 
+/// <remarks>
+/// Every instruction set produces exactly the same statistics.
+/// </remarks>
+void compute_colour_stats(const std::uint8_t* bgra,
+	size_t pixel_count,
+	simd_level level,
+	colour_stats& stats);
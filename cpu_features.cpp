@@ -0,0 +1,107 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define CPU_FEATURES_NEON
+#endif
+
+namespace {
+#if defined(CPU_FEATURES_X86)
+	bool has_avx2() {
+#if defined(_MSC_VER)
+		int info[4] = {};
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// the OS has to save the AVX registers on context switches
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+}
+
+simd_level detect_simd_level() {
+	static const simd_level level = []() {
+#if defined(CPU_FEATURES_X86)
+		return has_avx2() ? simd_level::avx2 : simd_level::sse2;
+#elif defined(CPU_FEATURES_NEON)
+		return simd_level::neon;
+#else
+		return simd_level::scalar;
+#endif
+	}();
+
+	return level;
+}
+
+bool simd_supported(simd_level level) {
+	switch (level) {
+	case simd_level::scalar:
+		return true;
+#if defined(CPU_FEATURES_X86)
+	case simd_level::sse2:
+		return true;
+	case simd_level::avx2:
+		return detect_simd_level() == simd_level::avx2;
+#elif defined(CPU_FEATURES_NEON)
+	case simd_level::neon:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* to_string(simd_level level) {
+	switch (level) {
+	case simd_level::sse2:
+		return "SSE2";
+	case simd_level::avx2:
+		return "AVX2";
+	case simd_level::neon:
+		return "NEON";
+	case simd_level::scalar:
+	default:
+		return "scalar";
+	}
+}
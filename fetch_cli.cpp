@@ -0,0 +1,446 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "fetch_cli.h"
+#include "version_info.h"
+#include "spotlight_images.h"
+#include "catalog_snapshot.h"
+#include "aspect_buckets.h"
+#include "helper_functions.h"
+#include "benchmark.h"
+#include "retention.h"
+#include "install_mode.h"
+
+// leccore
+#include <liblec/leccore/settings.h>
+#include <liblec/leccore/system.h>
+
+// STL
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+#include <Windows.h>
+
+using namespace liblec;
+
+namespace {
+	bool has_argument(int argc, char* argv[], const char* argument) {
+		for (int i = 1; i < argc; i++)
+			if (_stricmp(argv[i], argument) == 0)
+				return true;
+
+		return false;
+	}
+
+	std::string argument_value(int argc, char* argv[], const char* argument) {
+		for (int i = 1; i + 1 < argc; i++)
+			if (_stricmp(argv[i], argument) == 0)
+				return argv[i + 1];
+
+		return std::string();
+	}
+
+	// the paths are in the ANSI code page, JSON is UTF-8
+	std::string to_utf8(const std::string& value) {
+		if (value.empty())
+			return value;
+
+		const int wide_size = MultiByteToWideChar(CP_ACP, 0, value.data(), static_cast<int>(value.size()), NULL, 0);
+		std::wstring wide(wide_size, L'\0');
+		MultiByteToWideChar(CP_ACP, 0, value.data(), static_cast<int>(value.size()), &wide[0], wide_size);
+
+		const int size = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wide_size, NULL, 0, NULL, NULL);
+		std::string utf8(size, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, wide.data(), wide_size, &utf8[0], size, NULL, NULL);
+		return utf8;
+	}
+
+	std::string json_escape(const std::string& value) {
+		const auto utf8 = to_utf8(value);
+		std::string escaped;
+		escaped.reserve(utf8.size());
+
+		for (const char c : utf8) {
+			switch (c) {
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+					escaped += buffer;
+				}
+				else
+					escaped += c;
+				break;
+			}
+		}
+
+		return escaped;
+	}
+
+	void write_output(const std::string& text) {
+		// a GUI subsystem app only has a standard output if it was redirected or
+		// if it can attach to the console of the process that started it
+		HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+		bool close_handle = false;
+
+		if (handle == NULL || handle == INVALID_HANDLE_VALUE) {
+			if (!AttachConsole(ATTACH_PARENT_PROCESS))
+				return;
+
+			handle = CreateFileA("CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+			if (handle == INVALID_HANDLE_VALUE)
+				return;
+
+			close_handle = true;
+		}
+
+		DWORD written = 0;
+		WriteFile(handle, text.data(), static_cast<DWORD>(text.size()), &written, NULL);
+
+		if (close_handle)
+			CloseHandle(handle);
+	}
+
+	std::string settings_folder() {
+		// a portable app keeps its library in the current directory, as in main_form::on_initialize
+		if (!get_install_mode().installed)
+			return get_current_folder() + "\\Spotlight Images";
+
+		// same location as the app settings of the installed app
+		leccore::registry_settings reg_settings{ leccore::registry::scope::current_user };
+		reg_settings.set_registry_path("Software\\com.github.alecmus\\" + std::string(appname));
+
+		std::string value, error;
+		if (!reg_settings.read_value("", "folder", value, error) || value.empty())
+			value = leccore::user_folder::pictures() + "\\Spotlight Images";
+
+		return value;
+	}
+
+	// /background and /maxmbps, normal priority and no cap by default
+	io_limits argument_io_limits(int argc, char* argv[]) {
+		io_limits limits;
+		if (has_argument(argc, argv, "/background"))
+			limits.priority = io_priority::background;
+
+		// std::stoull accepts a sign and wraps negative values, so only digits
+		const auto max_mbps = argument_value(argc, argv, "/maxmbps");
+		if (!max_mbps.empty()) {
+			if (max_mbps.find_first_not_of("0123456789") != std::string::npos)
+				throw std::invalid_argument("Invalid bandwidth cap");
+
+			const auto value = std::stoull(max_mbps);
+			if (value > (std::numeric_limits<unsigned long long>::max)() / (1024 * 1024))
+				throw std::out_of_range("Invalid bandwidth cap");
+
+			limits.bytes_per_second = value * 1024 * 1024;
+		}
+
+		return limits;
+	}
+
+	int run_fetch(int argc, char* argv[]) {
+		std::string folder = argument_value(argc, argv, "/folder");
+
+		if (folder.empty())
+			folder = settings_folder();
+
+		// the app's snapshot saves analyzing the images it has already seen
+		image_catalog known, images;
+		std::string error;
+		if (!load_snapshot(snapshot_path(folder), known, error)) {}
+
+		fetch_options options;
+		io_limits limits;
+		try {
+			limits = argument_io_limits(argc, argv);
+
+			const auto min_sharpness = argument_value(argc, argv, "/minsharpness");
+			const auto min_entropy = argument_value(argc, argv, "/minentropy");
+
+			if (!min_sharpness.empty())
+				options.min_sharpness = std::stof(min_sharpness);
+
+			if (!min_entropy.empty())
+				options.min_entropy = std::stof(min_entropy);
+
+			options.variants.widths = parse_variant_widths(argument_value(argc, argv, "/variants"));
+
+			if (_stricmp(argument_value(argc, argv, "/filter").c_str(), "mitchell") == 0)
+				options.variants.filter = resample_filter::mitchell;
+
+			options.variants.crop = find_bucket(argument_value(argc, argv, "/crop"));
+			options.optimize_jpeg = has_argument(argc, argv, "/optimize");
+
+			// every profile's Spotlight folder, or the current user's, then any drop folders
+			if (has_argument(argc, argv, "/allprofiles"))
+				options.sources = profile_sources(profiles_folder());
+
+			const auto folders = parse_source_folders(argument_value(argc, argv, "/sources"));
+			if (!folders.empty() && options.sources.empty())
+				options.sources.push_back({ spotlight_assets_folder(), "Spotlight", false });
+
+			options.sources.insert(options.sources.end(), folders.begin(), folders.end());
+		}
+		catch (const std::exception&) {
+			write_output("{\"status\":\"error\",\"folder\":\"" + json_escape(folder) +
+				"\",\"error\":\"Invalid quality threshold or bandwidth cap\",\"elapsed_ms\":" +
+				std::to_string(get_process_uptime()) + "}\n");
+			return 1;
+		}
+
+		// the app's ledger says which images its retention policy removed, and
+		// learns about the images fetched here
+		retention_ledger retention;
+		if (!retention.load(retention_ledger_path(folder), error) &&
+			!retention.scan(folder, error)) {}
+
+		for (auto& it : retention.evicted_paths())
+			options.excluded.insert(std::move(it));
+
+		image_history history;
+		if (history.open(image_history_path(folder), error))
+			options.history = &history;
+
+		io_scheduler io(limits);
+		options.io = &io;
+
+		copy_engine copier;
+		if (!copier.load(copy_engine_path(folder), error)) {}
+		options.copier = &copier;
+
+		// the thread pool unless io_uring is asked for, see copy_backend
+		if (has_argument(argc, argv, "/iouring"))
+			options.backend = copy_backend::io_uring;
+
+		std::vector<jpeg_optimize_result> optimized;
+		if (!fetch_images(folder, known, options, images, optimized, error)) {
+			write_output("{\"status\":\"error\",\"folder\":\"" + json_escape(folder) +
+				"\",\"error\":\"" + json_escape(error) +
+				"\",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+			return 1;
+		}
+
+		// accounting only, evictions are left to the app
+		std::vector<std::string> removed;
+		if (!apply_retention(retention_policies(), options.variants, retention, images, removed)) {}
+		if (!retention.save(retention_ledger_path(folder), error)) {}
+		if (!copier.save(copy_engine_path(folder), error)) {}
+
+		// so that the app paints the new images at once, and the next fetch
+		// doesn't analyze them again
+		if (!save_snapshot(images, snapshot_path(folder), error)) {}
+
+		unsigned long long bytes = 0;
+		for (const auto& it : images.file_sizes())
+			bytes += it;
+
+		unsigned long long bytes_saved = 0;
+		for (const auto& it : optimized)
+			bytes_saved += it.saved();
+
+		const auto landscape = images.count(image_orientation::landscape);
+
+		// images per aspect ratio bucket, by folder name
+		size_t bucket_counts[aspect_bucket_count] = {};
+		for (image_id id = 0; id < images.size(); id++) {
+			const auto bucket = classify_aspect(images.width(id), images.height(id));
+			if (bucket != aspect_bucket::none)
+				bucket_counts[static_cast<size_t>(bucket)]++;
+		}
+
+		std::string buckets;
+		for (size_t i = 0; i < aspect_bucket_count; i++)
+			buckets += std::string(i ? "," : "") + "\"" + json_escape(aspect_buckets[i].folder) +
+			"\":" + std::to_string(bucket_counts[i]);
+
+		write_output("{\"status\":\"ok\",\"folder\":\"" + json_escape(folder) +
+			"\",\"images\":" + std::to_string(images.size()) +
+			",\"landscape\":" + std::to_string(landscape) +
+			",\"portrait\":" + std::to_string(images.size() - landscape) +
+			",\"buckets\":{" + buckets + "}" +
+			",\"bytes\":" + std::to_string(bytes) +
+			",\"bytes_saved\":" + std::to_string(bytes_saved) +
+			",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+
+		return images.empty() ? 2 : 0;
+	}
+
+	int run_optimize(int argc, char* argv[]) {
+		std::string folder = argument_value(argc, argv, "/folder");
+
+		if (folder.empty())
+			folder = settings_folder();
+
+		io_limits limits;
+		try {
+			limits = argument_io_limits(argc, argv);
+		}
+		catch (const std::exception&) {
+			write_output("{\"status\":\"error\",\"folder\":\"" + json_escape(folder) +
+				"\",\"error\":\"Invalid bandwidth cap\",\"elapsed_ms\":" +
+				std::to_string(get_process_uptime()) + "}\n");
+			return 1;
+		}
+
+		io_scheduler io(limits);
+
+		std::vector<jpeg_optimize_result> results;
+		std::string error;
+		if (!optimize_library(folder, !has_argument(argc, argv, "/keepmetadata"), results, error, &io)) {
+			write_output("{\"status\":\"error\",\"folder\":\"" + json_escape(folder) +
+				"\",\"error\":\"" + json_escape(error) +
+				"\",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+			return 1;
+		}
+
+		std::string files;
+		unsigned long long bytes_before = 0, bytes_saved = 0;
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const auto& it = results[i];
+			bytes_before += it.bytes_before;
+			bytes_saved += it.saved();
+
+			files += std::string(i ? ",\n" : "\n") +
+				"{\"file\":\"" + json_escape(it.full_path) +
+				"\",\"bytes\":" + std::to_string(it.bytes_before) +
+				",\"bytes_saved\":" + std::to_string(it.saved()) +
+				(it.error.empty() ? "" : ",\"error\":\"" + json_escape(it.error) + "\"") + "}";
+		}
+
+		write_output("{\"status\":\"ok\",\"folder\":\"" + json_escape(folder) +
+			"\",\"files\":[" + files + "\n]" +
+			",\"bytes\":" + std::to_string(bytes_before) +
+			",\"bytes_saved\":" + std::to_string(bytes_saved) +
+			",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+
+		return 0;
+	}
+
+	int run_history(int argc, char* argv[]) {
+		std::string folder = argument_value(argc, argv, "/folder");
+
+		if (folder.empty())
+			folder = settings_folder();
+
+		image_history history;
+		std::string error;
+		if (!history.open(image_history_path(folder), error)) {
+			write_output("{\"status\":\"error\",\"folder\":\"" + json_escape(folder) +
+				"\",\"error\":\"" + json_escape(error) +
+				"\",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+			return 1;
+		}
+
+		// a single asset is looked up rather than listing them all
+		std::vector<history_entry> entries;
+		const auto asset = argument_value(argc, argv, "/asset");
+
+		if (asset.empty())
+			entries = history.entries();
+		else {
+			history_entry entry;
+			if (history.find(asset, entry))
+				entries.push_back(entry);
+		}
+
+		std::string images;
+		for (size_t i = 0; i < entries.size(); i++) {
+			const auto& it = entries[i];
+			images += std::string(i ? ",\n" : "\n") +
+				"{\"asset\":\"" + json_escape(it.asset) +
+				"\",\"bucket\":\"" + (it.bucket == aspect_bucket::none ? "" : json_escape(bucket_spec(it.bucket).folder)) +
+				"\",\"width\":" + std::to_string(it.width) +
+				",\"height\":" + std::to_string(it.height) +
+				",\"bytes\":" + std::to_string(it.file_size) +
+				",\"fetched\":" + std::to_string(it.fetched) +
+				",\"first_seen\":" + std::to_string(it.first_seen) +
+				",\"last_seen\":" + std::to_string(it.last_seen) + "}";
+		}
+
+		write_output("{\"status\":\"ok\",\"folder\":\"" + json_escape(folder) +
+			"\",\"count\":" + std::to_string(history.size()) +
+			",\"images\":[" + images + "\n]" +
+			",\"elapsed_ms\":" + std::to_string(get_process_uptime()) + "}\n");
+
+		return asset.empty() || !entries.empty() ? 0 : 2;
+	}
+
+	int run_benchmark(int argc, char* argv[]) {
+		const auto results = run_benchmarks(argument_value(argc, argv, "/benchmark"));
+
+		std::string output = "[";
+		bool all_match = true;
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const auto& it = results[i];
+			all_match = all_match && it.matches_reference;
+
+			char numbers[128];
+			snprintf(numbers, sizeof(numbers), "\"ms\":%.6f,\"items_per_second\":%.0f",
+				it.milliseconds, it.items_per_second);
+
+			output += std::string(i ? ",\n" : "\n") +
+				"{\"name\":\"" + json_escape(it.name) +
+				"\",\"variant\":\"" + json_escape(it.variant) +
+				"\"," + numbers +
+				",\"matches_reference\":" + (it.matches_reference ? "true" : "false") + "}";
+		}
+
+		write_output(output + "\n]\n");
+		return all_match ? 0 : 1;
+	}
+}
+
+bool is_headless_command(int argc, char* argv[]) {
+	return has_argument(argc, argv, "/fetch") ||
+		has_argument(argc, argv, "/optimize") ||
+		has_argument(argc, argv, "/history") ||
+		has_argument(argc, argv, "/benchmark");
+}
+
+int run_headless_command(int argc, char* argv[]) {
+	if (has_argument(argc, argv, "/fetch"))
+		return run_fetch(argc, argv);
+
+	if (has_argument(argc, argv, "/optimize"))
+		return run_optimize(argc, argv);
+
+	if (has_argument(argc, argv, "/history"))
+		return run_history(argc, argv);
+
+	if (has_argument(argc, argv, "/benchmark"))
+		return run_benchmark(argc, argv);
+
+	return 1;
+}
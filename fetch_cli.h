@@ -0,0 +1,77 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+/// <summary>
+/// Check whether the command line asks for a headless command.
+/// </summary>
+/// 
+/// <param name="argc">The number of command-line arguments.</param>
+/// <param name="argv">The command-line arguments.</param>
+/// 
+/// <returns>
+/// Returns true if the app should run without creating any UI, else false.
+/// </returns>
+bool is_headless_command(int argc, char* argv[]);
+
+/// <summary>
+/// Run a headless command.
+/// </summary>
+/// 
+/// <param name="argc">The number of command-line arguments.</param>
+/// <param name="argv">The command-line arguments.</param>
+/// 
+/// <returns>
+/// The process exit code. For /fetch: 0 if images were fetched, 1 if an error
+/// was encountered and 2 if no images were found. For /history: 0 if
+/// successful, 1 if the history could not be opened and 2 if the asset asked
+/// for was never fetched. For /benchmark: 0 if every
+/// variant agreed with its reference implementation, else 1.
+/// </returns>
+/// 
+/// <remarks>
+/// Supported commands:
+/// /fetch [/folder path] [/minsharpness value] [/minentropy value]
+/// [/variants widths] [/filter lanczos|mitchell] [/crop bucket] [/optimize]
+/// [/allprofiles] [/sources folders] [/background] [/maxmbps value] [/iouring]:
+/// fetch images that meet the quality thresholds into the folder (or the
+/// folder in the app settings if none is given), from the current user's
+/// Spotlight folder or every profile's, and from semicolon separated drop
+/// folders, optionally with resized variants such as "1280,1920,2560" smart
+/// cropped to a bucket such as "Ultrawide", losslessly optimizing the new
+/// files if asked to, and write a JSON summary to the standard output.
+/// /optimize [/folder path] [/keepmetadata] [/background] [/maxmbps value]:
+/// losslessly optimize every image already in the library and write the
+/// bytes saved per image and in total.
+/// With /background the file work runs at background I/O priority, and
+/// /maxmbps caps it at the given MB per second. Where the kernel supports
+/// it, /iouring copies the new files with io_uring instead of a thread pool.
+/// /history [/folder path] [/asset name]: write every image ever fetched into
+/// the library, or only the given Spotlight asset, with when it was first and
+/// last seen.
+/// /benchmark [name]: run the engine micro-benchmarks whose name contains
+/// the given string, or all of them, and write the results as JSON.
+/// </remarks>
+int run_headless_command(int argc, char* argv[]);
@@ -0,0 +1,62 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "fetch_job.h"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_POINTER_LOCK_FREE == 2,
+	"the progress counters are read from the UI thread without locking");
+
+void fetch_job::request_stop() {
+	_stop.store(true, std::memory_order_relaxed);
+}
+
+bool fetch_job::stop_requested() const {
+	return _stop.load(std::memory_order_relaxed);
+}
+
+fetch_progress fetch_job::progress() const {
+	// each counter is exact, but they may be read a file apart
+	fetch_progress progress;
+	progress.files_seen = _files_seen.load(std::memory_order_relaxed);
+	progress.files_accepted = _files_accepted.load(std::memory_order_relaxed);
+	progress.files_copied = _files_copied.load(std::memory_order_relaxed);
+	progress.bytes_copied = _bytes_copied.load(std::memory_order_relaxed);
+	return progress;
+}
+
+void fetch_job::file_seen() {
+	_files_seen.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fetch_job::file_accepted() {
+	_files_accepted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fetch_job::file_copied() {
+	_files_copied.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fetch_job::add_bytes_copied(unsigned long long bytes) {
+	_bytes_copied.fetch_add(bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,75 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/// <summary>
+/// A snapshot of the progress of a fetch.
+/// </summary>
+struct fetch_progress {
+	size_t files_seen = 0;	// files listed in the sources
+	size_t files_accepted = 0;	// images that passed the checks and the quality thresholds
+	size_t files_copied = 0;	// images copied into the library, not counting ones already there
+	unsigned long long bytes_copied = 0;
+};
+
+/// <summary>
+/// Handle for stopping a running fetch and reading its progress from another
+/// thread.
+/// </summary>
+/// 
+/// <remarks>
+/// The fetch checks for a stop request between files and between the chunks
+/// of each copy, so it stops within one chunk of the request. The counters
+/// are atomics, so reading them never blocks the fetch.
+/// </remarks>
+class fetch_job {
+public:
+	/// <summary>
+	/// Ask the fetch to stop. It returns false with partial results.
+	/// </summary>
+	void request_stop();
+	bool stop_requested() const;
+
+	/// <summary>
+	/// Read the counters.
+	/// </summary>
+	fetch_progress progress() const;
+
+	// called by the fetch
+	void file_seen();
+	void file_accepted();
+	void file_copied();
+	void add_bytes_copied(unsigned long long bytes);
+
+private:
+	std::atomic<bool> _stop{ false };
+	std::atomic<size_t> _files_seen{ 0 };
+	std::atomic<size_t> _files_accepted{ 0 };
+	std::atomic<size_t> _files_copied{ 0 };
+	std::atomic<unsigned long long> _bytes_copied{ 0 };
+};
@@ -0,0 +1,785 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "file_copy.h"
+#include "image_sources.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+namespace {
+	constexpr const char* engine_header = "spotlight_images copy strategies 1";
+	constexpr const char* stopped_message = "The copy was stopped";
+
+	const std::pair<copy_strategy, const char*> strategy_names[] = {
+		{ copy_strategy::read_write, "read_write" },
+		{ copy_strategy::copy_file_range, "copy_file_range" },
+		{ copy_strategy::sendfile, "sendfile" },
+		{ copy_strategy::reflink, "reflink" },
+		{ copy_strategy::mmap, "mmap" },
+		{ copy_strategy::copy_file_ex, "copy_file_ex" },
+		{ copy_strategy::unbuffered, "unbuffered" },
+	};
+
+	long long unix_now() {
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// Wait for the next chunk of a copy.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// Returns false if the job was asked to stop, else true.
+	/// </returns>
+	bool next_chunk(fetch_job* job, io_scheduler* io, unsigned long long bytes) {
+		return !(job && job->stop_requested()) && !(io && !io->acquire(bytes, job));
+	}
+
+	void count_bytes(fetch_job* job, unsigned long long bytes) {
+		if (job)
+			job->add_bytes_copied(bytes);
+	}
+
+#ifdef _WIN32
+	std::string last_error(const std::string& what) {
+		return what + ": " + std::error_code(static_cast<int>(GetLastError()), std::system_category()).message();
+	}
+
+	class file_handle {
+	public:
+		explicit file_handle(HANDLE handle) : _handle(handle) {}
+		~file_handle() { close(); }
+
+		file_handle(const file_handle&) = delete;
+		file_handle& operator=(const file_handle&) = delete;
+
+		bool valid() const { return _handle != INVALID_HANDLE_VALUE; }
+		HANDLE get() const { return _handle; }
+
+		bool close() {
+			const bool closed = !valid() || CloseHandle(_handle);
+			_handle = INVALID_HANDLE_VALUE;
+			return closed;
+		}
+
+	private:
+		HANDLE _handle;
+	};
+
+	bool write_all(HANDLE file, const char* data, DWORD bytes, const std::filesystem::path& destination, std::string& error) {
+		while (bytes) {
+			DWORD written = 0;
+			if (!WriteFile(file, data, bytes, &written, NULL) || !written) {
+				error = last_error(destination.string());
+				return false;
+			}
+
+			data += written;
+			bytes -= written;
+		}
+
+		return true;
+	}
+
+	struct copy_file_ex_context {
+		fetch_job* job;
+		io_scheduler* io;
+		unsigned long long reported;
+	};
+
+	DWORD CALLBACK copy_file_ex_progress(LARGE_INTEGER, LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER,
+		DWORD, DWORD, HANDLE, HANDLE, LPVOID data) {
+		auto& context = *static_cast<copy_file_ex_context*>(data);
+
+		// CopyFileEx reports after each chunk, so the bytes are paced after the fact
+		const auto bytes = static_cast<unsigned long long>(transferred.QuadPart) - context.reported;
+		context.reported += bytes;
+		count_bytes(context.job, bytes);
+
+		return next_chunk(context.job, context.io, bytes) ? PROGRESS_CONTINUE : PROGRESS_CANCEL;
+	}
+
+	bool copy_with_copy_file_ex(const std::filesystem::path& source, const std::filesystem::path& destination,
+		fetch_job* job, io_scheduler* io, std::string& error) {
+		if (!next_chunk(job, io, 0)) {
+			error = stopped_message;
+			return false;
+		}
+
+		// CopyFileEx opens the files itself, so they only get the thread's
+		// priority, which is lowered in background mode but not at low
+		copy_file_ex_context context{ job, io, 0 };
+		if (!CopyFileExW(source.wstring().c_str(), destination.wstring().c_str(), copy_file_ex_progress, &context, NULL, 0)) {
+			error = GetLastError() == ERROR_REQUEST_ABORTED ? stopped_message : last_error(source.string());
+			return false;
+		}
+
+		return true;
+	}
+
+	bool copy_with_handles(copy_strategy strategy, const std::filesystem::path& source, const std::filesystem::path& destination,
+		fetch_job* job, io_scheduler* io, std::string& error) {
+		// unbuffered transfers must be whole sectors from sector aligned memory; pages are both
+		const bool unbuffered = strategy == copy_strategy::unbuffered;
+		constexpr DWORD sector = 4096;
+		const DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN | (unbuffered ? FILE_FLAG_NO_BUFFERING : 0);
+
+		file_handle input(CreateFileW(source.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, flags, NULL));
+		if (!input.valid()) {
+			error = last_error(source.string());
+			return false;
+		}
+
+		set_io_priority_hint(input.get());
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(input.get(), &size)) {
+			error = last_error(source.string());
+			return false;
+		}
+
+		file_handle output(CreateFileW(destination.wstring().c_str(), GENERIC_WRITE, 0, NULL,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | (unbuffered ? FILE_FLAG_NO_BUFFERING : 0), NULL));
+		if (!output.valid()) {
+			error = last_error(destination.string());
+			return false;
+		}
+
+		set_io_priority_hint(output.get());
+
+		std::unique_ptr<char, decltype(&_aligned_free)> buffer(
+			static_cast<char*>(_aligned_malloc(copy_chunk_size, sector)), &_aligned_free);
+		if (!buffer) {
+			error = "Out of memory";
+			return false;
+		}
+
+		const auto total = static_cast<unsigned long long>(size.QuadPart);
+		for (unsigned long long done = 0; done < total;) {
+			const auto chunk = static_cast<DWORD>((std::min)(static_cast<unsigned long long>(copy_chunk_size), total - done));
+
+			if (!next_chunk(job, io, chunk)) {
+				error = stopped_message;
+				return false;
+			}
+
+			// an unbuffered read of whole sectors stops short at the end of the file
+			const DWORD request = unbuffered ? (chunk + sector - 1) / sector * sector : chunk;
+			DWORD read = 0;
+			if (!ReadFile(input.get(), buffer.get(), request, &read, NULL)) {
+				error = last_error(source.string());
+				return false;
+			}
+
+			if (!read)
+				break;
+
+			if (!write_all(output.get(), buffer.get(), unbuffered ? (read + sector - 1) / sector * sector : read,
+				destination, error))
+				return false;
+
+			done += read;
+			count_bytes(job, read);
+		}
+
+		// drop the padding of the last unbuffered write
+		if (unbuffered) {
+			FILE_END_OF_FILE_INFO end_of_file;
+			end_of_file.EndOfFile = size;
+			if (!SetFileInformationByHandle(output.get(), FileEndOfFileInfo, &end_of_file, sizeof(end_of_file))) {
+				error = last_error(destination.string());
+				return false;
+			}
+		}
+
+		if (!output.close()) {
+			error = last_error(destination.string());
+			return false;
+		}
+
+		return true;
+	}
+#else
+	std::string last_error(const std::string& what) {
+		return what + ": " + std::error_code(errno, std::generic_category()).message();
+	}
+
+	class file_descriptor {
+	public:
+		explicit file_descriptor(int descriptor) : _descriptor(descriptor) {}
+		~file_descriptor() { close(); }
+
+		file_descriptor(const file_descriptor&) = delete;
+		file_descriptor& operator=(const file_descriptor&) = delete;
+
+		bool valid() const { return _descriptor >= 0; }
+		int get() const { return _descriptor; }
+
+		bool close() {
+			const bool closed = !valid() || ::close(_descriptor) == 0;
+			_descriptor = -1;
+			return closed;
+		}
+
+	private:
+		int _descriptor;
+	};
+
+	bool write_all(int file, const char* data, size_t bytes, const std::filesystem::path& destination, std::string& error) {
+		while (bytes) {
+			const ssize_t written = write(file, data, bytes);
+			if (written < 0 && errno == EINTR)
+				continue;
+
+			if (written <= 0) {
+				error = last_error(destination.string());
+				return false;
+			}
+
+			data += written;
+			bytes -= static_cast<size_t>(written);
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Copy between open files a chunk at a time with one of the strategies
+	/// that move a chunk with a single call.
+	/// </summary>
+	bool copy_chunks(copy_strategy strategy, int input, int output, unsigned long long total,
+		const std::filesystem::path& source, const std::filesystem::path& destination,
+		fetch_job* job, io_scheduler* io, std::string& error) {
+		std::vector<char> buffer(strategy == copy_strategy::read_write ? copy_chunk_size : 0);
+
+		for (unsigned long long done = 0; done < total;) {
+			const auto chunk = static_cast<size_t>((std::min)(static_cast<unsigned long long>(copy_chunk_size), total - done));
+
+			if (!next_chunk(job, io, chunk)) {
+				error = stopped_message;
+				return false;
+			}
+
+			ssize_t moved = 0;
+			switch (strategy) {
+#ifdef __linux__
+			case copy_strategy::copy_file_range:
+				moved = copy_file_range(input, nullptr, output, nullptr, chunk, 0);
+				break;
+
+			case copy_strategy::sendfile:
+				moved = sendfile(output, input, nullptr, chunk);
+				break;
+#endif
+			default:
+				moved = read(input, buffer.data(), chunk);
+				if (moved > 0 && !write_all(output, buffer.data(), static_cast<size_t>(moved), destination, error))
+					return false;
+				break;
+			}
+
+			if (moved < 0 && errno == EINTR)
+				continue;
+
+			if (moved < 0) {
+				error = last_error(source.string());
+				return false;
+			}
+
+			// the source got shorter
+			if (!moved)
+				break;
+
+			done += static_cast<unsigned long long>(moved);
+			count_bytes(job, static_cast<unsigned long long>(moved));
+		}
+
+		return true;
+	}
+
+	bool copy_mapped(int input, int output, unsigned long long total,
+		const std::filesystem::path& source, const std::filesystem::path& destination,
+		fetch_job* job, io_scheduler* io, std::string& error) {
+		if (!total)
+			return true;
+
+		if (total > (std::numeric_limits<size_t>::max)()) {
+			error = source.string() + ": Too large to map";
+			return false;
+		}
+
+		const auto size = static_cast<size_t>(total);
+		void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, input, 0);
+		if (view == MAP_FAILED) {
+			error = last_error(source.string());
+			return false;
+		}
+
+		std::unique_ptr<void, std::function<void(void*)>> mapping(view, [size](void* view) { munmap(view, size); });
+		madvise(view, size, MADV_SEQUENTIAL);
+
+		const auto* data = static_cast<const char*>(view);
+		for (size_t done = 0; done < size;) {
+			const size_t chunk = (std::min)(copy_chunk_size, size - done);
+
+			if (!next_chunk(job, io, chunk)) {
+				error = stopped_message;
+				return false;
+			}
+
+			if (!write_all(output, data + done, chunk, destination, error))
+				return false;
+
+			done += chunk;
+			count_bytes(job, chunk);
+		}
+
+		return true;
+	}
+
+	bool copy_with_descriptors(copy_strategy strategy, const std::filesystem::path& source, const std::filesystem::path& destination,
+		fetch_job* job, io_scheduler* io, std::string& error) {
+		file_descriptor input(open(source.c_str(), O_RDONLY | O_CLOEXEC));
+		if (!input.valid()) {
+			error = last_error(source.string());
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(input.get(), &info) != 0) {
+			error = last_error(source.string());
+			return false;
+		}
+
+		file_descriptor output(open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+		if (!output.valid()) {
+			error = last_error(destination.string());
+			return false;
+		}
+
+		const auto total = static_cast<unsigned long long>(info.st_size);
+		bool copied = false;
+
+		switch (strategy) {
+#ifdef __linux__
+		case copy_strategy::reflink:
+			// one call whatever the size, and no data is written
+			if (!next_chunk(job, io, io_scheduler::metadata_cost)) {
+				error = stopped_message;
+				return false;
+			}
+
+			copied = ioctl(output.get(), FICLONE, input.get()) == 0;
+			if (!copied)
+				error = last_error(destination.string());
+			else
+				count_bytes(job, total);
+			break;
+#endif
+		case copy_strategy::mmap:
+			copied = copy_mapped(input.get(), output.get(), total, source, destination, job, io, error);
+			break;
+
+		default:
+#ifdef POSIX_FADV_SEQUENTIAL
+			posix_fadvise(input.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+			copied = copy_chunks(strategy, input.get(), output.get(), total, source, destination, job, io, error);
+			break;
+		}
+
+		if (!copied)
+			return false;
+
+		if (!output.close()) {
+			error = last_error(destination.string());
+			return false;
+		}
+
+		return true;
+	}
+#endif
+
+	bool same_contents(const std::filesystem::path& first, const std::filesystem::path& second) {
+		std::ifstream a(first, std::ios::binary), b(second, std::ios::binary);
+		if (!a || !b)
+			return false;
+
+		std::vector<char> chunk_a(64 * 1024), chunk_b(chunk_a.size());
+		for (;;) {
+			a.read(chunk_a.data(), static_cast<std::streamsize>(chunk_a.size()));
+			b.read(chunk_b.data(), static_cast<std::streamsize>(chunk_b.size()));
+
+			if (a.gcount() != b.gcount() ||
+				!std::equal(chunk_a.begin(), chunk_a.begin() + a.gcount(), chunk_b.begin()))
+				return false;
+
+			if (!a || !b)
+				return !a && !b;
+		}
+	}
+}
+
+const char* copy_strategy_name(copy_strategy strategy) {
+	for (const auto& it : strategy_names)
+		if (it.first == strategy)
+			return it.second;
+
+	return "";
+}
+
+bool parse_copy_strategy(const std::string& name, copy_strategy& strategy) {
+	for (const auto& it : strategy_names)
+		if (name == it.second) {
+			strategy = it.first;
+			return true;
+		}
+
+	return false;
+}
+
+std::vector<copy_strategy> copy_strategies() {
+#ifdef _WIN32
+	return { copy_strategy::read_write, copy_strategy::copy_file_ex, copy_strategy::unbuffered };
+#elif defined(__linux__)
+	return { copy_strategy::read_write, copy_strategy::copy_file_range, copy_strategy::sendfile,
+		copy_strategy::reflink, copy_strategy::mmap };
+#else
+	return { copy_strategy::read_write, copy_strategy::mmap };
+#endif
+}
+
+bool copy_file_using(copy_strategy strategy,
+	const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	fetch_job* job,
+	io_scheduler* io,
+	std::string& error) {
+	const auto supported = copy_strategies();
+	if (std::find(supported.begin(), supported.end(), strategy) == supported.end()) {
+		error = std::string("The ") + copy_strategy_name(strategy) + " copy strategy is not supported on this system";
+		return false;
+	}
+
+#ifdef _WIN32
+	const bool copied = strategy == copy_strategy::copy_file_ex ?
+		copy_with_copy_file_ex(source, destination, job, io, error) :
+		copy_with_handles(strategy, source, destination, job, io, error);
+#else
+	const bool copied = copy_with_descriptors(strategy, source, destination, job, io, error);
+#endif
+
+	if (!copied) {
+		std::error_code ec;
+		std::filesystem::remove(destination, ec);
+	}
+
+	return copied;
+}
+
+bool measure_copy_strategies(const std::string& folder,
+	size_t bytes,
+	std::vector<copy_measurement>& measurements,
+	std::string& error) {
+	measurements.clear();
+
+	const auto source = std::filesystem::path(folder) / ".copy_benchmark";
+	auto destination = source;
+	destination += ".out";
+
+	{
+		// incompressible, in case the volume compresses
+		std::vector<char> data(bytes);
+		std::uint32_t seed = 0x2545f491u;
+		for (auto& it : data) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			it = static_cast<char>(seed);
+		}
+
+		std::ofstream file(source, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), static_cast<std::streamsize>(data.size()));
+		file.close();
+
+		if (!file) {
+			std::error_code ec;
+			std::filesystem::remove(source, ec);
+			error = "Unable to write " + source.string();
+			return false;
+		}
+	}
+
+	using clock = std::chrono::steady_clock;
+
+	for (const auto strategy : copy_strategies()) {
+		copy_measurement measurement;
+		measurement.strategy = strategy;
+		measurement.milliseconds = (std::numeric_limits<double>::max)();
+
+		// the first run also pays for allocating the destination's blocks
+		for (int run = 0; run < 3; run++) {
+			const auto start = clock::now();
+			measurement.succeeded = copy_file_using(strategy, source, destination, nullptr, nullptr, measurement.error);
+			const double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			if (!measurement.succeeded)
+				break;
+
+			measurement.milliseconds = (std::min)(measurement.milliseconds, elapsed);
+		}
+
+		if (measurement.succeeded)
+			measurement.identical = same_contents(source, destination);
+		else
+			measurement.milliseconds = 0.;
+
+		std::error_code ec;
+		std::filesystem::remove(destination, ec);
+		measurements.push_back(std::move(measurement));
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(source, ec);
+	return true;
+}
+
+copy_strategy copy_engine::strategy_for(const std::string& folder) {
+	std::string volume = volume_of(folder);
+	if (volume.empty())
+		volume = folder;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	const long long now = unix_now();
+
+	for (;;) {
+		const auto it = _choices.find(volume);
+		if (it != _choices.end() && now - it->second.calibrated < calibration_lifetime)
+			return it->second.strategy;
+
+		if (!_measuring.count(volume))
+			break;
+
+		// another copy is measuring this volume, so wait for its choice
+		_measured.wait(lock);
+	}
+
+	// measured without the lock, so that copies to other volumes go on meanwhile
+	_measuring.insert(volume);
+	lock.unlock();
+
+	std::vector<copy_measurement> measurements;
+	std::string error;
+	const bool measured = measure_copy_strategies(folder, calibration_bytes, measurements, error);
+
+	lock.lock();
+	_measuring.erase(volume);
+	_measured.notify_all();
+
+	if (!measured)
+		return copy_strategy::read_write;
+
+	const copy_measurement* fastest = nullptr;
+	for (const auto& measurement : measurements)
+		if (measurement.succeeded && measurement.identical &&
+			(!fastest || measurement.milliseconds < fastest->milliseconds))
+			fastest = &measurement;
+
+	choice chosen;
+	chosen.strategy = fastest ? fastest->strategy : copy_strategy::read_write;
+	chosen.calibrated = now;
+	_choices[volume] = chosen;
+
+	return chosen.strategy;
+}
+
+bool copy_engine::copy(const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	fetch_job* job,
+	io_scheduler* io,
+	std::string& error) {
+	const auto strategy = strategy_for(destination.parent_path().string());
+
+	if (copy_file_using(strategy, source, destination, job, io, error))
+		return true;
+
+	// the strategy may not work between these two volumes
+	if (strategy == copy_strategy::read_write || (job && job->stop_requested()))
+		return false;
+
+	return copy_file_using(copy_strategy::read_write, source, destination, job, io, error);
+}
+
+bool copy_engine::save(const std::string& full_path, std::string& error) const {
+	const std::string temp_path = full_path + ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::trunc);
+		if (!file) {
+			error = "Unable to write " + temp_path;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		file << engine_header << '\n';
+
+		// tab separated, with the volume last since it may contain anything but a tab or newline
+		for (const auto& it : _choices)
+			file << copy_strategy_name(it.second.strategy) << '\t' << it.second.calibrated << '\t' << it.first << '\n';
+
+		if (!file) {
+			error = "Unable to write " + temp_path;
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, full_path, ec);
+	if (ec) {
+		error = full_path + ": " + ec.message();
+		return false;
+	}
+
+	return true;
+}
+
+bool copy_engine::load(const std::string& full_path, std::string& error) {
+	std::ifstream file(full_path);
+	if (!file) {
+		error = "Unable to read " + full_path;
+		return false;
+	}
+
+	std::string line;
+	if (!std::getline(file, line) || line != engine_header) {
+		error = "Unsupported copy strategy file";
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_choices.clear();
+
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string name, volume;
+		choice loaded;
+
+		if (!std::getline(fields, name, '\t') || !parse_copy_strategy(name, loaded.strategy))
+			continue;
+
+		fields >> loaded.calibrated;
+		fields.ignore(1);
+
+		if (!fields || !std::getline(fields, volume))
+			continue;
+
+		// a choice made on another system may not be supported here
+		const auto supported = copy_strategies();
+		if (std::find(supported.begin(), supported.end(), loaded.strategy) != supported.end())
+			_choices[volume] = loaded;
+	}
+
+	return true;
+}
+
+std::string copy_engine_path(const std::string& folder) {
+	return join_path(folder, ".copy_strategies");
+}
+
+bool copy_if_newer(const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	fetch_job* job,
+	io_scheduler* io,
+	copy_engine* engine,
+	bool& copied,
+	std::string& error) {
+	copied = false;
+
+	std::error_code ec;
+	const auto source_time = std::filesystem::last_write_time(source, ec);
+	if (ec) {
+		error = source.string() + ": " + ec.message();
+		return false;
+	}
+
+	const auto destination_time = std::filesystem::last_write_time(destination, ec);
+	if (!ec && destination_time >= source_time)
+		return true;
+
+	auto partial = destination;
+	partial += ".part";
+
+	const bool written = engine ?
+		engine->copy(source, partial, job, io, error) :
+		copy_file_using(copy_strategy::read_write, source, partial, job, io, error);
+
+	if (!written)
+		return false;
+
+	auto fail = [&](const std::string& message) {
+		std::error_code remove_ec;
+		std::filesystem::remove(partial, remove_ec);
+		error = message;
+		return false;
+	};
+
+	// keep the source's write time so the next fetch sees the copy as up to date
+	std::filesystem::last_write_time(partial, source_time, ec);
+	if (ec)
+		return fail(partial.string() + ": " + ec.message());
+
+	std::filesystem::rename(partial, destination, ec);
+	if (ec)
+		return fail(destination.string() + ": " + ec.message());
+
+	copied = true;
+	return true;
+}
@@ -0,0 +1,230 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "fetch_job.h"
+#include "io_scheduler.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The size of the chunks files are copied in, which bounds how long a
+/// copy takes to notice a stop request.
+/// </summary>
+constexpr size_t copy_chunk_size = 1024 * 1024;
+
+/// <summary>
+/// How the bytes of a file are copied.
+/// </summary>
+enum class copy_strategy : std::uint8_t {
+	read_write = 0,		// read into a buffer and write it out, works everywhere
+	copy_file_range,	// Linux: copy_file_range, the data stays in the kernel
+	sendfile,			// Linux: sendfile, the data stays in the kernel
+	reflink,			// Linux: FICLONE, shares the source's blocks on copy-on-write file systems
+	mmap,				// POSIX: write from a memory mapping of the source
+	copy_file_ex,		// Windows: CopyFileEx
+	unbuffered,			// Windows: unbuffered reads and writes that bypass the file cache
+};
+
+/// <summary>
+/// Get the name of a copy strategy, as used in settings and benchmark results.
+/// </summary>
+const char* copy_strategy_name(copy_strategy strategy);
+
+/// <summary>
+/// Parse a copy strategy name.
+/// </summary>
+/// 
+/// <returns>
+/// Returns false if the name is not a strategy, else true.
+/// </returns>
+bool parse_copy_strategy(const std::string& name, copy_strategy& strategy);
+
+/// <summary>
+/// Get the copy strategies this system supports, read_write first.
+/// </summary>
+std::vector<copy_strategy> copy_strategies();
+
+/// <summary>
+/// Copy a file with a given strategy, replacing the destination.
+/// </summary>
+/// 
+/// <param name="strategy">How to copy the bytes. Must be one of copy_strategies().</param>
+/// <param name="source">The file to copy.</param>
+/// <param name="destination">The full path to copy it to.</param>
+/// <param name="job">The fetch the copy is part of, for stop requests and progress. Can be null.</param>
+/// <param name="io">Paces the copy, one chunk at a time. Can be null.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false, including when the job was asked
+/// to stop. The destination is removed if the copy fails.
+/// </returns>
+bool copy_file_using(copy_strategy strategy,
+	const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	fetch_job* job,
+	io_scheduler* io,
+	std::string& error);
+
+/// <summary>
+/// The time one strategy took to copy a test file.
+/// </summary>
+struct copy_measurement {
+	copy_strategy strategy = copy_strategy::read_write;
+	bool succeeded = false;
+	bool identical = false;		// whether the copy matched the source byte for byte
+	double milliseconds = 0.;	// the best of a few runs
+	std::string error;
+};
+
+/// <summary>
+/// Time every supported copy strategy on a test file in a folder.
+/// </summary>
+/// 
+/// <param name="folder">The folder to write the test file and its copies to.</param>
+/// <param name="bytes">The size of the test file.</param>
+/// <param name="measurements">One measurement per strategy, in the order of copy_strategies().</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns false if the test file could not be written, else true. A strategy
+/// that fails is reported as such in its measurement.
+/// </returns>
+/// 
+/// <remarks>
+/// The copies are made right after the test file is written, so they read
+/// from the file cache. That is also where the fetch reads its sources from,
+/// since it has just analyzed them.
+/// </remarks>
+bool measure_copy_strategies(const std::string& folder,
+	size_t bytes,
+	std::vector<copy_measurement>& measurements,
+	std::string& error);
+
+/// <summary>
+/// Copies files with the fastest strategy for the volume they are copied to.
+/// </summary>
+/// 
+/// <remarks>
+/// The first copy to a volume times every strategy with
+/// measure_copy_strategies() and remembers the fastest one that made an
+/// identical copy. The choices can be saved and loaded so that the benchmark
+/// only runs again when a choice is older than calibration_lifetime. A copy
+/// that fails with the chosen strategy, such as a reflink across volumes, is
+/// retried with read_write. All member functions are thread-safe.
+/// </remarks>
+class copy_engine {
+public:
+	/// <summary>
+	/// The size of the test file, large enough to hide the cost of opening files.
+	/// </summary>
+	static constexpr size_t calibration_bytes = 8 * 1024 * 1024;
+
+	/// <summary>
+	/// How long a choice is kept, in seconds, in case the volume changes under
+	/// the same name.
+	/// </summary>
+	static constexpr long long calibration_lifetime = 30 * 24 * 60 * 60;
+
+	/// <summary>
+	/// Get the strategy for copying into a folder, timing the strategies first
+	/// if there is no choice for its volume yet.
+	/// </summary>
+	copy_strategy strategy_for(const std::string& folder);
+
+	/// <summary>
+	/// Copy a file with the strategy for the destination's folder, replacing
+	/// the destination. See copy_file_using().
+	/// </summary>
+	bool copy(const std::filesystem::path& source,
+		const std::filesystem::path& destination,
+		fetch_job* job,
+		io_scheduler* io,
+		std::string& error);
+
+	/// <summary>
+	/// Save the choices to a file.
+	/// </summary>
+	bool save(const std::string& full_path, std::string& error) const;
+
+	/// <summary>
+	/// Load choices saved with save(), replacing any in memory.
+	/// </summary>
+	bool load(const std::string& full_path, std::string& error);
+
+private:
+	struct choice {
+		copy_strategy strategy = copy_strategy::read_write;
+		long long calibrated = 0;
+	};
+
+	mutable std::mutex _mutex;
+	std::condition_variable _measured;
+	std::map<std::string, choice> _choices;	// by volume
+	std::set<std::string> _measuring;	// volumes being measured
+};
+
+/// <summary>
+/// Get the path of a library's saved copy strategy choices.
+/// </summary>
+std::string copy_engine_path(const std::string& folder);
+
+/// <summary>
+/// Copy a file unless the destination is at least as new as the source.
+/// </summary>
+/// 
+/// <param name="source">The file to copy.</param>
+/// <param name="destination">The full path to copy it to.</param>
+/// <param name="job">The fetch the copy is part of, for stop requests and progress. Can be null.</param>
+/// <param name="io">Paces the copy, one chunk at a time. Can be null.</param>
+/// <param name="engine">Picks how to copy the bytes. Uses read_write if null.</param>
+/// <param name="copied">Whether the file was copied, false if the destination was up to date.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false, including when the job was asked
+/// to stop.
+/// </returns>
+/// 
+/// <remarks>
+/// The copy is written next to the destination and then renamed over it, so
+/// a stopped or failed copy leaves the destination as it was. The copy keeps
+/// the source's write time.
+/// </remarks>
+bool copy_if_newer(const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	fetch_job* job,
+	io_scheduler* io,
+	copy_engine* engine,
+	bool& copied,
+	std::string& error);
@@ -27,6 +27,14 @@
 #include "version_info.h"
 #include "resource.h"
 #include "spotlight_images.h"
+#include "library_view.h"
+#include "sort_engine.h"
+#include "startup_trace.h"
+#include "preview_loader.h"
+#include "retention.h"
+#include "similarity.h"
+#include "search_index.h"
+#include "install_mode.h"
 
 // lecui
 #include <liblec/lecui/instance.h>
@@ -42,6 +50,10 @@
 #include <liblec/leccore/settings.h>
 #include <liblec/leccore/web_update.h>
 
+// STL
+#include <future>
+#include <memory>
+
 using namespace liblec;
 using snap_type = lecui::rect::snap_type;
 
@@ -54,19 +66,17 @@ using snap_type = lecui::rect::snap_type;
 // the main form
 class main_form : public lecui::form {
 	const std::string _instance_guid = "{24DE7949-0EB7-4086-85F0-76D10191E633}";
-	const std::string _install_guid_32 = "{3FA54748-169E-4B63-9871-1D3367545A9A}";
-	const std::string _install_guid_64 = "{7BC77A87-2034-4483-94A8-2774D1A3C494}";
+	const std::string _install_guid_32 = install_guid_32;
+	const std::string _install_guid_64 = install_guid_64;
 	const std::string _update_xml_url = "https://raw.githubusercontent.com/alecmus/spotlight_images/master/latest_update.xml";
 
+	// declared first so it is constructed before anything else in the form
+	startup_trace _startup_trace;
+
 	static const float _margin;
 	static const float _icon_size;
 	static const float _info_size;
-
-#ifdef _WIN64
-	unsigned long long gdi_plus_token_;
-#else
-	unsigned long gdi_plus_token_;
-#endif
+	static const size_t _list_page_size;
 
 	lecui::controls _ctrls{ *this };
 	lecui::page_manager _page_man{ *this };
@@ -77,16 +87,28 @@ class main_form : public lecui::form {
 	lecui::timer_manager _timer_man{ *this };
 	lecui::splash _splash{ *this };
 
-	std::vector<image_info> _pictures;
+	image_catalog _pictures;
+	std::future<image_catalog> _fetch;
+	std::shared_ptr<fetch_job> _fetch_job = std::make_shared<fetch_job>();	// shared with the fetch task
 	image_info _displayed_image;
+	image_id _displayed_id = invalid_image_id;
+	std::unique_ptr<preview_loader> _previews;
+	library_view _library;
+	sort_engine _sort_engine;
+	search_index _search;
+	std::string _search_text;
+	std::vector<image_id> _sorted;	// the sorted ids, which searches filter without sorting again
+	size_t _sort_preset = 0;
+	size_t _filter_preset = 0;
+	size_t _list_first = 0;
+
+	// built when first needed, cleared whenever the catalog changes
+	similarity_index _similarity;
+	std::vector<image_id> _similar_ids;	// shown instead of the sort and filter presets when not empty
 
 	bool _restart_now = false;
 
-	// 1. If application is installed and running from an install directory this will be true.
-	// 2. If application is installed and not running from an install directory this will also
-	// be true unless there is a .portable file in the same directory.
-	// 3. If application is not installed then portable mode will be used whether or not a .portable
-	// file exists in the same directory.
+	// see install_mode
 	bool _installed;
 	bool _real_portable_mode;
 	bool _system_tray_mode;
@@ -104,24 +126,46 @@ class main_form : public lecui::form {
 	std::string _update_directory;
 	bool _setting_autostart = false;
 	std::string _folder;
+	size_t _setting_preview_cache_mb = 64;
+	fetch_options _setting_fetch_options;
+	retention_policies _setting_retention;
+	io_limits _setting_io;
+
+	// shared with the fetch task, which loads it, and saved when the form closes
+	std::shared_ptr<retention_ledger> _retention = std::make_shared<retention_ledger>();
+	bool _retention_loaded = false;
 
 	const bool _cleanup_mode;
 	const bool _update_mode;
 	const bool _recent_update_mode;
+	const bool _trace_mode;
 
 	lecui::tray_icon _tray_icon{ *this };
 
 	bool _update_details_displayed = false;
+	bool _settings_page_added = false;
+	bool _help_page_added = false;
 
 	bool on_initialize(std::string& error);
 	bool on_layout(std::string& error);
 	void on_start();
+	void on_deferred_start();
+	void on_fetch();
+	void update_caption(bool scanning);
 	void on_close();
 	void add_side_pane();
 	void add_back_button();
+	void show_page(const std::string& name);
 	void add_home_page();
 	void add_help_page();
 	void add_settings_page();
+	void populate_list();
+	void request_preview(image_id id);
+	void on_preview();
+	void sort_list(bool keep_page = false);
+	void filter_list(bool keep_page = false);
+	void show_similar();
+	void end_similar();
 
 	void updates();
 	void on_update_check();
@@ -36,13 +36,10 @@
 // STL
 #include <filesystem>
 
-// GDI+
-#include <Windows.h>
-#include <GdiPlus.h>
-
 const float main_form::_margin = 10.f;
 const float main_form::_icon_size = 32.f;
 const float main_form::_info_size = 20.f;
+const size_t main_form::_list_page_size = 100;
 
 void main_form::on_close() {
 	if (_installed)
@@ -324,48 +321,11 @@ void main_form::on_update_download() {
 }
 
 bool main_form::installed() {
-	// check if application is installed
-	std::string error;
-	leccore::registry reg(leccore::registry::scope::current_user);
-	if (!reg.do_read("Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + _install_guid_32 + "_is1",
-		"InstallLocation", _install_location_32, error)) {
-	}
-	if (!reg.do_read("Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + _install_guid_64 + "_is1",
-		"InstallLocation", _install_location_64, error)) {
-	}
-
-	_installed = !_install_location_32.empty() || !_install_location_64.empty();
-
-	auto portable_file_exists = []()->bool {
-		try {
-			std::filesystem::path path(".portable");
-			return std::filesystem::exists(path) && std::filesystem::is_regular_file(path);
-		}
-		catch (const std::exception&) {
-			return false;
-		}
-	};
-
-	if (_installed) {
-		// check if app is running from the install location
-		try {
-			const auto current_path = std::filesystem::current_path().string() + "\\";
-
-			if (current_path != _install_location_32 &&
-				current_path != _install_location_64) {
-				if (portable_file_exists()) {
-					_real_portable_mode = true;
-					_installed = false;	// run in portable mode
-				}
-			}
-		}
-		catch (const std::exception&) {}
-	}
-	else {
-		if (portable_file_exists())
-			_real_portable_mode = true;
-	}
-
+	const auto mode = get_install_mode();
+	_install_location_32 = mode.install_location_32;
+	_install_location_64 = mode.install_location_64;
+	_real_portable_mode = mode.real_portable_mode;
+	_installed = mode.installed;
 	return _installed;
 }
 
@@ -430,6 +390,7 @@ main_form::main_form(const std::string& caption, bool restarted) :
 	_update_mode(restarted ? false : leccore::commandline_arguments::contains("/update")),
 	_recent_update_mode(restarted ? false : leccore::commandline_arguments::contains("/recentupdate")),
 	_system_tray_mode(restarted ? false : leccore::commandline_arguments::contains("/systemtray")),
+	_trace_mode(leccore::commandline_arguments::contains("/trace")),
 	_settings(installed() ? _reg_settings.base() : _ini_settings.base()),
 	form(caption) {
 	_installed = installed();
@@ -444,14 +405,12 @@ main_form::main_form(const std::string& caption, bool restarted) :
 	if (_cleanup_mode || _update_mode || _recent_update_mode)
 		force_instance();
 
-	// initialize GDI+
-	Gdiplus::GdiplusStartupInput gdiplus_startup_input;
-	GdiplusStartup(&gdi_plus_token_, &gdiplus_startup_input, NULL);
+	_startup_trace.mark("constructor");
 
 	// caption event
 	events().caption = [this]() {
 		add_back_button();
-		_page_man.show("help");
+		show_page("help");
 	};
 
 	// initialize event
@@ -476,8 +435,15 @@ main_form::main_form(const std::string& caption, bool restarted) :
 }
 
 main_form::~main_form() {
-	if (gdi_plus_token_) {
-		// shut down GDI+
-		Gdiplus::GdiplusShutdown(gdi_plus_token_);
+	// stop a fetch that is still running rather than wait for it, it stops
+	// within one copy chunk
+	_fetch_job->request_stop();
+	if (_fetch.valid())
+		_fetch.wait();
+
+	// keep the view times recorded since the fetch
+	if (_retention_loaded) {
+		std::string error;
+		if (!_retention->save(retention_ledger_path(_folder), error)) {}
 	}
 }
@@ -25,6 +25,8 @@
 #include "../gui.h"
 #include "../helper_functions.h"
 #include <filesystem>
+#include <algorithm>
+#include <stdexcept>
 #include <liblec/leccore/zip.h>
 #include <liblec/leccore/file.h>
 #include <liblec/leccore/system.h>
@@ -38,6 +40,8 @@ bool main_form::on_initialize(std::string& error) {
 			_splash.display(splash_image_256, false, error);
 	}
 
+	_startup_trace.mark("splash");
+
 	if (_cleanup_mode) {
 		if (prompt("Would you like to delete the app settings?")) {
 			// cleanup application settings
@@ -171,11 +175,13 @@ bool main_form::on_initialize(std::string& error) {
 						std::string target(value);
 						if (!target.empty()) {
 							try {
-								// overrwrite the files in target with the files in raw_files_directory
+								// overrwrite the files in target with the files in raw_files_directory; a
+								// fixed strategy, so that no test files are written among the app's files
 								for (const auto& path : std::filesystem::directory_iterator(raw_files_directory)) {
 									std::filesystem::path p(path);
 									const std::string dest_file = target + p.filename().string();
-									std::filesystem::copy_file(path, dest_file, std::filesystem::copy_options::overwrite_existing);
+									if (!copy_file_using(copy_strategy::read_write, path, dest_file, nullptr, nullptr, error))
+										throw std::runtime_error(error);
 								}
 
 								// files copied successfully, now execute the app in the target directory
@@ -245,6 +251,8 @@ bool main_form::on_initialize(std::string& error) {
 				}
 	}
 
+	_startup_trace.mark("update handling");
+
 	// read application settings
 	std::string value;
 	if (!_settings.read_value("", "darktheme", value, error))
@@ -255,38 +263,10 @@ bool main_form::on_initialize(std::string& error) {
 
 	if (!_settings.read_value("updates", "autocheck", value, error))
 		return false;
-	else {
+	else
 		// default to yes
 		_setting_autocheck_updates = value != "no";
 
-		if (_setting_autocheck_updates) {
-			if (!_settings.read_value("updates", "did_run_once", value, error))
-				return false;
-			else {
-				if (value != "yes") {
-					// do nothing ... for better first time impression
-					if (!_settings.write_value("updates", "did_run_once", "yes", error)) {}
-				}
-				else {
-					// schedule checking for updates (5 minutes if in system tray mode, and 5 seconds otherwise)
-					_timer_man.add("start_update_check", _system_tray_mode ? 5 * 60 * 1000 : 5 * 1000, [this]() {
-						// stop the start update check timer
-						_timer_man.stop("start_update_check");
-
-						// create update status
-						create_update_status();
-
-						// start checking for updates
-						_check_update.start();
-
-						// start timer to keep progress of the update check (every 1.5 seconds)
-						_timer_man.add("update_check", 1500, [&]() { on_update_check(); });
-						});
-				}
-			}
-		}
-	}
-
 	if (!_settings.read_value("updates", "autodownload", value, error))
 		return false;
 	else
@@ -299,23 +279,6 @@ bool main_form::on_initialize(std::string& error) {
 		// default to no
 		_setting_autostart = value == "yes";
 
-	if (_setting_autostart) {
-		std::string command;
-#ifdef _WIN64
-		command = "\"" + _install_location_64 + "spotlight_images64.exe\"";
-#else
-		command = "\"" + _install_location_32 + "spotlight_images32.exe\"";
-#endif
-		command += " /systemtray";
-
-		leccore::registry reg(leccore::registry::scope::current_user);
-		if (!reg.do_write("Software\\Microsoft\\Windows\\CurrentVersion\\Run", "spotlight_images", command, error)) {}
-	}
-	else {
-		leccore::registry reg(leccore::registry::scope::current_user);
-		if (!reg.do_delete("Software\\Microsoft\\Windows\\CurrentVersion\\Run", "spotlight_images", error)) {}
-	}
-
 	if (!_settings.read_value("", "folder", value, error))
 		return false;
 	else {
@@ -327,6 +290,165 @@ bool main_form::on_initialize(std::string& error) {
 			_folder = get_current_folder() + "\\Spotlight Images";
 	}
 
+	if (!_settings.read_value("", "previewcache", value, error))
+		return false;
+	else {
+		// memory budget for decoded previews in MB, default to 64
+		try {
+			if (!value.empty())
+				_setting_preview_cache_mb = static_cast<size_t>(std::stoul(value));
+		}
+		catch (const std::exception&) {}
+	}
+
+	// quality thresholds for fetching, default to only skipping truncated files
+	if (!_settings.read_value("quality", "minsharpness", value, error))
+		return false;
+	else {
+		try {
+			if (!value.empty())
+				_setting_fetch_options.min_sharpness = std::stof(value);
+		}
+		catch (const std::exception&) {}
+	}
+
+	if (!_settings.read_value("quality", "minentropy", value, error))
+		return false;
+	else {
+		try {
+			if (!value.empty())
+				_setting_fetch_options.min_entropy = std::stof(value);
+		}
+		catch (const std::exception&) {}
+	}
+
+	if (!_settings.read_value("quality", "skiptruncated", value, error))
+		return false;
+	else
+		// default to yes
+		_setting_fetch_options.skip_truncated = value != "no";
+
+	// resized variants, default to none
+	if (!_settings.read_value("variants", "widths", value, error))
+		return false;
+	else
+		_setting_fetch_options.variants.widths = parse_variant_widths(value);
+
+	if (!_settings.read_value("variants", "filter", value, error))
+		return false;
+	else
+		// default to lanczos
+		_setting_fetch_options.variants.filter = value == "mitchell" ?
+		resample_filter::mitchell : resample_filter::lanczos3;
+
+	if (!_settings.read_value("variants", "crop", value, error))
+		return false;
+	else
+		// default to the whole image, else the folder name of a bucket
+		_setting_fetch_options.variants.crop = find_bucket(value);
+
+	// lossless optimization of newly fetched files, default to no
+	if (!_settings.read_value("library", "optimize", value, error))
+		return false;
+	else
+		_setting_fetch_options.optimize_jpeg = value == "yes";
+
+	// where to fetch from, default to the current user's Spotlight folder only
+	if (!_settings.read_value("sources", "allprofiles", value, error))
+		return false;
+	else if (value == "yes")
+		_setting_fetch_options.sources = profile_sources(profiles_folder());
+
+	if (!_settings.read_value("sources", "folders", value, error))
+		return false;
+	else {
+		// semicolon separated drop folders, in addition to the Spotlight folders
+		auto folders = parse_source_folders(value);
+
+		if (!folders.empty() && _setting_fetch_options.sources.empty())
+			_setting_fetch_options.sources.push_back({ spotlight_assets_folder(), "Spotlight", false });
+
+		_setting_fetch_options.sources.insert(_setting_fetch_options.sources.end(), folders.begin(), folders.end());
+	}
+
+	// how hard background file work may use the disk, default to low priority, or to
+	// background priority pausing on battery and when the processor is busy in tray mode
+	_setting_io.priority = _system_tray_mode ? io_priority::background : io_priority::low;
+	_setting_io.pause_on_battery = _system_tray_mode;
+	_setting_io.pause_above_load = _system_tray_mode ? 80 : 0;
+
+	if (!_settings.read_value("io", "priority", value, error))
+		return false;
+	else if (!value.empty() && !parse_io_priority(value, _setting_io.priority)) {}
+
+	if (!_settings.read_value("io", "maxmbps", value, error))
+		return false;
+	else {
+		// bandwidth cap in MB per second, default to none
+		try {
+			if (!value.empty())
+				_setting_io.bytes_per_second = std::stoull(value) * 1024 * 1024;
+		}
+		catch (const std::exception&) {}
+	}
+
+	if (!_settings.read_value("io", "pauseonbattery", value, error))
+		return false;
+	else if (!value.empty())
+		_setting_io.pause_on_battery = value == "yes";
+
+	if (!_settings.read_value("io", "pauseload", value, error))
+		return false;
+	else {
+		// processor load percentage above which to pause, 0 to never pause
+		try {
+			if (!value.empty())
+				_setting_io.pause_above_load = (std::min)(100u, static_cast<unsigned int>(std::stoul(value)));
+		}
+		catch (const std::exception&) {}
+	}
+
+	// retention policies, defaults for every bucket then any overrides, default to keeping everything
+	auto read_policy = [this](const std::string& section, retention_policy& policy, std::string& error) {
+		std::string value;
+
+		try {
+			if (!_settings.read_value(section, "maxcount", value, error))
+				return false;
+			else if (!value.empty())
+				policy.max_count = static_cast<size_t>(std::stoull(value));
+
+			if (!_settings.read_value(section, "maxmb", value, error))
+				return false;
+			else if (!value.empty())
+				policy.max_bytes = std::stoull(value) * 1024 * 1024;
+
+			if (!_settings.read_value(section, "maxdays", value, error))
+				return false;
+			else if (!value.empty())
+				policy.max_age = std::stoll(value) * 24 * 60 * 60;
+		}
+		catch (const std::exception&) {}
+
+		if (!_settings.read_value(section, "order", value, error))
+			return false;
+		else if (!value.empty())
+			policy.order = value == "viewed" ?
+			retention_order::least_recently_viewed : retention_order::oldest_fetched;
+
+		return true;
+	};
+
+	retention_policy default_policy;
+	if (!read_policy("retention", default_policy, error))
+		return false;
+
+	for (size_t i = 0; i < aspect_bucket_count; i++) {
+		_setting_retention[i] = default_policy;
+		if (!read_policy("retention/" + std::string(aspect_buckets[i].folder), _setting_retention[i], error))
+			return false;
+	}
+
 	// size and stuff
 	_ctrls
 		.allow_resize(false)
@@ -339,5 +461,6 @@ bool main_form::on_initialize(std::string& error) {
 
 	_dim.set_size(lecui::size().width(800.f).height(500.f));
 
+	_startup_trace.mark("settings");
 	return true;
 }
@@ -38,12 +38,11 @@ bool main_form::on_layout(std::string& error) {
 	// add side pane
 	add_side_pane();
 
-	// add pages
+	// add pages (the settings and help pages are added on first use by show_page())
 	add_home_page();
-	add_settings_page();
-	add_help_page();
 
 	_page_man.show("home");
+	_startup_trace.mark("layout");
 	return true;
 }
 
@@ -75,3 +74,29 @@ void main_form::add_back_button() {
 		}
 	};
 }
+
+void main_form::show_page(const std::string& name) {
+	if (name == "settings" && !_settings_page_added) {
+		add_settings_page();
+		_settings_page_added = true;
+
+		std::string error;
+		// disable autodownload_updates toggle button if autocheck_updates is off
+		if (_setting_autocheck_updates)
+			_widget_man.enable("settings/autodownload_updates", error);
+		else
+			_widget_man.disable("settings/autodownload_updates", error);
+
+		if (_installed)
+			_widget_man.enable("settings/autostart", error);
+		else
+			_widget_man.disable("settings/autostart", error);
+	}
+	else
+		if (name == "help" && !_help_page_added) {
+			add_help_page();
+			_help_page_added = true;
+		}
+
+	_page_man.show(name);
+}
@@ -27,67 +27,72 @@
 #include <liblec/lecui/widgets/label.h>
 #include <liblec/lecui/widgets/table_view.h>
 
+// leccore
+#include <liblec/leccore/system.h>
+
+#include "../catalog_snapshot.h"
+
 #include <algorithm>
+#include <chrono>
 
 void main_form::on_start() {
-	_pictures = fetch_images(_folder);
+	// paint the catalog saved by the previous run without waiting for a scan
+	std::string error;
+	if (!load_snapshot(snapshot_path(_folder), _pictures, error)) {}
+	_startup_trace.mark("snapshot");
 
-	// display caption
-	std::string message = std::to_string(_pictures.size()) + " image";
-	if (_pictures.size() != 1) message += "s";
+	// populate tableview
+	_library.reset(_pictures);
+	_sort_engine.reset(_pictures);
+	_search.reset(_pictures);
+	sort_list();
+	update_caption(true);
+	_startup_trace.mark("populate");
 
-	message += " copied.";
+	// scan for new images in the background, reusing the image statistics in the snapshot
+	const std::string folder = _folder;
+	_fetch = std::async(std::launch::async, [folder, known = _pictures, options = _setting_fetch_options,
+		policies = _setting_retention, retention = _retention, job = _fetch_job, limits = _setting_io]() mutable {
+		// the ledger is only built from the folder the first time
+		std::string error;
+		if (!retention->load(retention_ledger_path(folder), error) &&
+			!retention->scan(folder, error)) {}
 
-	if (_pictures.size() == 0) {
-		message = "No images were copied.";
+		// don't copy back images the retention policy removed
+		for (auto& it : retention->evicted_paths())
+			options.excluded.insert(std::move(it));
 
-		_timer_man.add("no_images_timer", 100, [&]() {
-			_timer_man.stop("no_images_timer");
-			std::string display_text = "No images were found. Kindly check the following:\n\n"
-				"1. Is Windows Spotlight enabled for the current user profile? Check under "
-				"Settings - Personalization - Lock screen. After enabling Spotlight "
-				"it may take up to 24 hours for the first image to show up.\n\n"
-				"2. Is your internet connection set to metered? Check under "
-				"Settings - Network and Internet - Properties. When the connection is metered Windows"
-				" might not update the images in order to save data.";
-			form::message(display_text);
-			});
-	}
+		// keep a record of every image ever fetched
+		image_history history;
+		if (history.open(image_history_path(folder), error))
+			options.history = &history;
 
-	if (_pictures.size() != 0) {
-		auto landscape = std::count_if(_pictures.begin(), _pictures.end(),
-			[](image_info p) {
-				return p.orientation == image_orientation::landscape;
-			});
+		// so that closing the app doesn't wait for the whole fetch
+		options.job = job.get();
 
-		message += " " + std::to_string(landscape) + " Landscape, " + std::to_string(_pictures.size() - landscape) + " Portrait.";
-		message += " Select to preview.";
-	}
+		// stay out of the way of the foreground, especially in tray mode
+		io_scheduler io(limits);
+		options.io = &io;
 
-	try {
-		auto& caption = get_label("home/caption");
-		caption.text(message);
-	}
-	catch (const std::exception&) {}
+		// the copy strategy for the library's volume is only measured once in a while
+		copy_engine copier;
+		if (!copier.load(copy_engine_path(folder), error)) {}
+		options.copier = &copier;
 
-	// populate tableview
-	try {
-		auto& list = get_table_view("home/list");
+		image_catalog images;
+		if (fetch_images(folder, known, options, images, error)) {
+			std::vector<std::string> removed;
+			if (!apply_retention(policies, options.variants, *retention, images, removed, &io, options.job)) {}
+			if (!retention->save(retention_ledger_path(folder), error)) {}
+			if (!save_snapshot(images, snapshot_path(folder), error)) {}
+		}
 
-		for (const auto& pic : _pictures) {
-			std::string file_name;
-			get_filename_from_full_path(pic.full_path, file_name);
+		if (!copier.save(copy_engine_path(folder), error)) {}
 
-			lecui::table_row row = {
-				{ "Name", file_name },
-				{ "Size", leccore::format_size(pic.file_size) },
-				{ "Orientation", std::string(pic.orientation == image_orientation::landscape ? "Landscape" : "Portrait") }
-			};
+		return images;
+		});
 
-			list.data().push_back(row);
-		}
-	}
-	catch (const std::exception&) {}
+	_timer_man.add("fetch", 100, [this]() { on_fetch(); });
 
 	if (_installed) {
 		std::string error;
@@ -103,7 +108,7 @@ void main_form::on_start() {
 			{ "" },
 			{ "Settings", [this]() {
 				add_back_button();
-				_page_man.show("settings");
+				show_page("settings");
 
 				if (minimized())
 					restore();
@@ -129,7 +134,7 @@ void main_form::on_start() {
 			} },
 			{ "About", [this]() {
 				add_back_button();
-				_page_man.show("help");
+				show_page("help");
 
 				if (minimized())
 					restore();
@@ -144,17 +149,163 @@ void main_form::on_start() {
 		}
 	}
 
-	std::string error;
-	// disable autodownload_updates toggle button if autocheck_updates is off
-	if (_setting_autocheck_updates)
-		_widget_man.enable("settings/autodownload_updates", error);
-	else
-		_widget_man.disable("settings/autodownload_updates", error);
+	_splash.remove();
+	_startup_trace.mark("start");
+
+	// work that is not needed for the first paint
+	_timer_man.add("deferred_start", 100, [this]() { on_deferred_start(); });
+}
 
-	if (_installed)
-		_widget_man.enable("settings/autostart", error);
-	else
-		_widget_man.disable("settings/autostart", error);
+void main_form::on_fetch() {
+	if (_fetch.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		update_caption(true);
+		return;
+	}
 
-	_splash.remove();
+	_timer_man.stop("fetch");
+
+	image_catalog images = _fetch.get();
+	_retention_loaded = true;
+	_startup_trace.mark("fetch");
+
+	// only touch the table if the scan found something the snapshot didn't have
+	const auto changes = compare_catalogs(_pictures, images);
+
+	if (!changes.empty()) {
+		if (changes.removed.empty() && changes.modified.empty()) {
+			// only new images, the usual case: append them, so that only they are indexed
+			_pictures.reserve(_pictures.size() + changes.added.size());
+			for (const auto id : changes.added)
+				_pictures.add(images, id);
+
+			_search.update();
+		}
+		else {
+			_pictures = std::move(images);
+			_search.reset(_pictures);
+		}
+
+		_library.reset(_pictures);
+		_sort_engine.reset(_pictures);
+		_similarity.clear();
+
+		// images that failed to decode may have been fetched again
+		if (_previews)
+			_previews->reset();
+		end_similar();
+		sort_list(true);
+	}
+
+	update_caption(false);
+
+	if (_pictures.size() == 0) {
+		_timer_man.add("no_images_timer", 100, [&]() {
+			_timer_man.stop("no_images_timer");
+			std::string display_text = "No images were found. Kindly check the following:\n\n"
+				"1. Is Windows Spotlight enabled for the current user profile? Check under "
+				"Settings - Personalization - Lock screen. After enabling Spotlight "
+				"it may take up to 24 hours for the first image to show up.\n\n"
+				"2. Is your internet connection set to metered? Check under "
+				"Settings - Network and Internet - Properties. When the connection is metered Windows"
+				" might not update the images in order to save data.";
+			form::message(display_text);
+			});
+	}
+}
+
+void main_form::update_caption(bool scanning) {
+	std::string message;
+
+	if (scanning) {
+		message = "Checking for new images ...";
+
+		if (_pictures.size() != 0)
+			message = std::to_string(_pictures.size()) + " image" + (_pictures.size() != 1 ? "s. " : ". ") + message;
+
+		// the counters are atomics, reading them doesn't hold up the fetch
+		const auto progress = _fetch_job->progress();
+		if (progress.files_seen)
+			message += " " + std::to_string(progress.files_seen) + " files checked, " +
+			std::to_string(progress.files_copied) + " new.";
+	}
+	else {
+		// display caption
+		message = std::to_string(_pictures.size()) + " image";
+		if (_pictures.size() != 1) message += "s";
+
+		message += " copied.";
+
+		if (_pictures.size() == 0)
+			message = "No images were copied.";
+		else {
+			const auto landscape = _pictures.count(image_orientation::landscape);
+
+			message += " " + std::to_string(landscape) + " Landscape, " + std::to_string(_pictures.size() - landscape) + " Portrait.";
+			message += " Select to preview.";
+		}
+	}
+
+	try {
+		auto& caption = get_label("home/caption");
+
+		if (caption.text() != message) {
+			caption.text(message);
+			update();
+		}
+	}
+	catch (const std::exception&) {}
+}
+
+void main_form::on_deferred_start() {
+	_timer_man.stop("deferred_start");
+
+	std::string error, value;
+
+	if (_setting_autocheck_updates) {
+		if (_settings.read_value("updates", "did_run_once", value, error)) {
+			if (value != "yes") {
+				// do nothing ... for better first time impression
+				if (!_settings.write_value("updates", "did_run_once", "yes", error)) {}
+			}
+			else {
+				// schedule checking for updates (5 minutes if in system tray mode, and 5 seconds otherwise)
+				_timer_man.add("start_update_check", _system_tray_mode ? 5 * 60 * 1000 : 5 * 1000, [this]() {
+					// stop the start update check timer
+					_timer_man.stop("start_update_check");
+
+					// create update status
+					create_update_status();
+
+					// start checking for updates
+					_check_update.start();
+
+					// start timer to keep progress of the update check (every 1.5 seconds)
+					_timer_man.add("update_check", 1500, [&]() { on_update_check(); });
+					});
+			}
+		}
+	}
+
+	if (_setting_autostart) {
+		std::string command;
+#ifdef _WIN64
+		command = "\"" + _install_location_64 + "spotlight_images64.exe\"";
+#else
+		command = "\"" + _install_location_32 + "spotlight_images32.exe\"";
+#endif
+		command += " /systemtray";
+
+		leccore::registry reg(leccore::registry::scope::current_user);
+		if (!reg.do_write("Software\\Microsoft\\Windows\\CurrentVersion\\Run", "spotlight_images", command, error)) {}
+	}
+	else {
+		leccore::registry reg(leccore::registry::scope::current_user);
+		if (!reg.do_delete("Software\\Microsoft\\Windows\\CurrentVersion\\Run", "spotlight_images", error)) {}
+	}
+
+	_startup_trace.mark("deferred start");
+
+	if (_trace_mode) {
+		if (!_startup_trace.save(leccore::user_folder::temp() + "\\spotlight_images_startup.txt", error)) {}
+	}
 }
@@ -23,15 +23,70 @@
 */
 
 #include "../../gui.h"
-#include "../../helper_functions.h"
+#include "../../path_utils.h"
+#include "../../aspect_buckets.h"
 
 #include <liblec/lecui/widgets/label.h>
 #include <liblec/lecui/widgets/table_view.h>
 #include <liblec/lecui/widgets/image_view.h>
 #include <liblec/lecui/widgets/icon.h>
+#include <liblec/lecui/widgets/text_field.h>
 
 #include <liblec/leccore/system.h>
 
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	struct sort_preset {
+		const char* caption;
+		std::vector<sort_order> order;
+	};
+
+	const std::vector<sort_preset>& sort_presets() {
+		static const std::vector<sort_preset> presets = {
+			{ "orientation, resolution, size, date", {
+				{ sort_key::orientation },
+				{ sort_key::resolution, true },
+				{ sort_key::size, true },
+				{ sort_key::date, true } } },
+			{ "date (newest first)", { { sort_key::date, true } } },
+			{ "resolution (largest first)", { { sort_key::resolution, true }, { sort_key::date, true } } },
+			{ "size (largest first)", { { sort_key::size, true } } },
+			{ "sharpness (sharpest first)", { { sort_key::sharpness, true }, { sort_key::date, true } } },
+			{ "name", { { sort_key::name } } }
+		};
+
+		return presets;
+	}
+
+	struct filter_preset {
+		std::string caption;
+		library_filter filter;
+	};
+
+	const std::vector<filter_preset>& filter_presets() {
+		static const std::vector<filter_preset> presets = []() {
+			std::vector<filter_preset> presets(2);
+			presets[0].caption = "all images";
+			presets[1].caption = "images for the dark theme";
+			presets[1].filter.dark_theme_only = true;
+
+			// one view per aspect ratio bucket
+			for (const auto& it : aspect_buckets) {
+				filter_preset preset;
+				preset.caption = std::string(it.folder) + " images";
+				preset.filter.buckets = 1u << static_cast<unsigned int>(it.bucket);
+				presets.push_back(preset);
+			}
+
+			return presets;
+		}();
+
+		return presets;
+	}
+}
+
 void main_form::add_home_page() {
 	auto& home = _page_man.add("home");
 
@@ -42,6 +97,76 @@ void main_form::add_home_page() {
 		.rect(lecui::rect().left(_margin).top(_margin).right(home.size().get_width() - _margin).height(20.f))
 		.alignment(lecui::text_alignment::center);
 
+	// add sort order
+	auto& sort = lecui::widgets::label::add(home, "sort");
+	sort
+		.text("Sort by: " + std::string(sort_presets()[_sort_preset].caption))
+		.tooltip("Click to change the sort order")
+		.color_text(lecui::color().red(100).green(100).blue(100))
+		.font_size(8.f)
+		.rect(lecui::rect()
+			.left(_margin)
+			.right(home.size().get_width() / 2.f)
+			.top(caption.rect().bottom() + _margin)
+			.height(_info_size))
+		.events().action = [this]() {
+		// the first click after "more like this" returns to the presets
+		if (!_similar_ids.empty())
+			end_similar();
+		else
+			_sort_preset = (_sort_preset + 1) % sort_presets().size();
+
+		try {
+			get_label("home/sort").text("Sort by: " + std::string(sort_presets()[_sort_preset].caption));
+		}
+		catch (const std::exception&) {}
+
+		sort_list();
+	};
+
+	// add filter
+	auto& filter = lecui::widgets::label::add(home, "filter");
+	filter
+		.text("Show: " + filter_presets()[_filter_preset].caption)
+		.tooltip("Click to change which images are shown")
+		.color_text(lecui::color().red(100).green(100).blue(100))
+		.font_size(8.f)
+		.alignment(lecui::text_alignment::right)
+		.rect(lecui::rect(sort.rect())
+			.left(sort.rect().right() + _margin)
+			.right(home.size().get_width() - _margin))
+		.events().action = [this]() {
+		if (!_similar_ids.empty())
+			end_similar();
+		else
+			_filter_preset = (_filter_preset + 1) % filter_presets().size();
+
+		try {
+			get_label("home/filter").text("Show: " + filter_presets()[_filter_preset].caption);
+		}
+		catch (const std::exception&) {}
+
+		sort_list();
+	};
+
+	// add search box
+	auto& search = lecui::widgets::text_field::add(home, "search");
+	search
+		.prompt("Search, e.g. blue landscape 4k size>2mb age<30")
+		.tooltip("Words match the start of file names and tags (orientation, aspect ratio, hd, fhd, 4k, colours, dark, bright).\n"
+			"Conditions: width, height, size, age (days) with =, <, <=, >, >=, and after:YYYY-MM-DD, before:YYYY-MM-DD")
+		.font_size(9.f)
+		.rect(lecui::rect()
+			.left(_margin)
+			.right(home.size().get_width() / 2.f)
+			.top(sort.rect().bottom())
+			.height(25.f))
+		.events().change = [this](const std::string& text) {
+		// searched as it is typed
+		_search_text = text;
+		filter_list();
+	};
+
 	// add table view
 	auto& list = lecui::widgets::table_view::add(home, "list");
 	list
@@ -53,10 +178,9 @@ void main_form::add_home_page() {
 		.rect(lecui::rect()
 			.left(_margin)
 			.right(home.size().get_width() / 2.f)
-			.top(caption.rect().bottom() + _margin)
-			.bottom(home.size().get_height() - _margin))
+			.top(search.rect().bottom() + _margin / 2.f)
+			.bottom(home.size().get_height() - _margin - _info_size))
 		.fixed_number_column(true)
-		.user_sort(true)
 		.columns({
 			{ "Name", 170 },
 			{ "Size", 50 },
@@ -65,31 +189,27 @@ void main_form::add_home_page() {
 		)
 		.events().selection = [this](const std::vector<lecui::table_row>& rows) {
 		_displayed_image.full_path.clear();
+		_displayed_id = invalid_image_id;
 		std::string filename;
 
 		if (rows.size() == 1) {
 			try {
 				filename = lecui::get::text(rows[0].at("Name"));
 
-				for (const auto& it : _pictures) {
-					std::string filename_;
-					get_filename_from_full_path(it.full_path, filename_);
-					if (filename == filename_) {
-						_displayed_image = it;
-						break;
-					}
+				image_id id = 0;
+				if (_library.find(filename, id)) {
+					_displayed_image = _pictures.get(id);
+					_displayed_id = id;
 				}
 
 				auto& image = get_image_view("home/image");
 				auto& file_info = get_label("home/file_info");
 
 				if (!_displayed_image.full_path.empty()) {
-					image.file(_displayed_image.full_path);
-
-					std::string file_info_text = "Resolution: " + std::to_string(_displayed_image.width) + "x" + std::to_string(_displayed_image.height);
-					file_info_text += ", Size: " + leccore::format_size(_displayed_image.file_size);
-
-					file_info.text(file_info_text);
+					// show a placeholder until the background decoder has the preview ready
+					image.file("");
+					file_info.text("Loading preview ...");
+					request_preview(id);
 				}
 				else {
 					image.file("");
@@ -102,6 +222,53 @@ void main_form::add_home_page() {
 		}
 	};
 
+	// add list pager
+	auto& previous = lecui::widgets::label::add(home, "list_previous");
+	previous
+		.text("< Previous")
+		.tooltip("Show the previous page of images")
+		.color_text(lecui::color().red(100).green(100).blue(100))
+		.font_size(8.f)
+		.rect(lecui::rect()
+			.left(list.rect().left())
+			.width(list.rect().width() / 4.f)
+			.top(list.rect().bottom())
+			.height(_info_size))
+		.events().action = [this]() {
+		if (_list_first == 0)
+			return;
+
+		_list_first -= (std::min)(_list_first, _list_page_size);
+		populate_list();
+	};
+
+	auto& next = lecui::widgets::label::add(home, "list_next");
+	next
+		.text("Next >")
+		.tooltip("Show the next page of images")
+		.color_text(lecui::color().red(100).green(100).blue(100))
+		.font_size(8.f)
+		.alignment(lecui::text_alignment::right)
+		.rect(lecui::rect(previous.rect())
+			.right(list.rect().right())
+			.left(list.rect().right() - previous.rect().width()))
+		.events().action = [this]() {
+		if (_list_first + _list_page_size >= _library.size())
+			return;
+
+		_list_first += _list_page_size;
+		populate_list();
+	};
+
+	auto& range = lecui::widgets::label::add(home, "list_range");
+	range
+		.color_text(lecui::color().red(150).green(150).blue(150))
+		.font_size(8.f)
+		.alignment(lecui::text_alignment::center)
+		.rect(lecui::rect(previous.rect())
+			.left(previous.rect().right())
+			.right(next.rect().left()));
+
 	// add image
 	auto& image = lecui::widgets::image_view::add(home, "image");
 	image
@@ -165,8 +332,7 @@ void main_form::add_home_page() {
 		.padding(0.f)
 		.events().action = [&]() {
 		if (!_displayed_image.full_path.empty()) {
-			std::string directory;
-			get_directory_from_full_path(_displayed_image.full_path, directory);
+			const std::string directory(path_directory(_displayed_image.full_path));
 			if (!directory.empty()) {
 				std::string error;
 				if (!leccore::shell::open(directory, error))
@@ -174,4 +340,182 @@ void main_form::add_home_page() {
 			}
 		}
 	};
+
+	auto& similar = lecui::widgets::label::add(home, "similar");
+	similar
+		.text("More like this")
+		.tooltip("Show the images that look most like this one")
+		.color_text(lecui::color().red(100).green(100).blue(100))
+		.font_size(8.f)
+		.alignment(lecui::text_alignment::center)
+		.rect(lecui::rect()
+			.size(100.f, _info_size)
+			.place(rc_ref, 90.f, 50.f))
+		.events().action = [this]() { show_similar(); };
+}
+
+void main_form::show_similar() {
+	if (_displayed_id == invalid_image_id)
+		return;
+
+	if (_similarity.empty())
+		_similarity.build(_pictures);
+
+	feature_vector features;
+	if (!_similarity.features(_displayed_id, features)) {
+		message("The features of this image have not been computed yet. Please try again after the next scan.");
+		return;
+	}
+
+	// the image itself first, then the closest matches
+	_similar_ids = { _displayed_id };
+	for (const auto& it : _similarity.query(features, _list_page_size - 1, _displayed_id))
+		_similar_ids.push_back(it.id);
+
+	try {
+		get_label("home/filter").text("Show: images like " + std::string(_pictures.name(_displayed_id)));
+	}
+	catch (const std::exception&) {}
+
+	sort_list();
+}
+
+void main_form::end_similar() {
+	if (_similar_ids.empty())
+		return;
+
+	_similar_ids.clear();
+
+	try {
+		get_label("home/filter").text("Show: " + filter_presets()[_filter_preset].caption);
+	}
+	catch (const std::exception&) {}
+}
+
+void main_form::sort_list(bool keep_page) {
+	// the table displays the precomputed permutation instead of sorting its own strings
+	if (!_similar_ids.empty())
+		_sorted = _similar_ids;
+	else
+		_sorted = _sort_engine.query(filter_presets()[_filter_preset].filter, sort_presets()[_sort_preset].order);
+
+	filter_list(keep_page);
+}
+
+void main_form::filter_list(bool keep_page) {
+	// searches only narrow the sorted ids; the table formats the rows on screen
+	if (_search_text.empty())
+		_library.order(_sorted);
+	else
+		_library.order(_search.query(_search_text).filter(_sorted));
+
+	if (!keep_page || _list_first >= _library.size())
+		_list_first = 0;
+
+	populate_list();
+}
+
+void main_form::populate_list() {
+	try {
+		auto& list = get_table_view("home/list");
+
+		// only the rows in the current window are formatted and handed to the table
+		list.data().clear();
+
+		for (const auto& row : _library.window(_list_first, _list_page_size)) {
+			lecui::table_row table_row = {
+				{ "Name", row.name },
+				{ "Size", row.size },
+				{ "Orientation", row.orientation }
+			};
+
+			list.data().push_back(table_row);
+		}
+
+		// update the pager
+		std::string range_text;
+
+		if (_library.size() > 0) {
+			const size_t last = (std::min)(_list_first + _list_page_size, _library.size());
+			range_text = std::to_string(_list_first + 1) + " - " + std::to_string(last) +
+				" of " + std::to_string(_library.size());
+		}
+
+		get_label("home/list_range").text(range_text);
+		update();
+	}
+	catch (const std::exception&) {}
+}
+
+void main_form::request_preview(image_id id) {
+	try {
+		if (!_previews) {
+			// decode previews at the size they are displayed at
+			auto& image = get_image_view("home/image");
+			const auto scale = get_dpi_scale();
+
+			_previews = std::make_unique<preview_loader>(
+				leccore::user_folder::temp() + "\\spotlight_images_previews",
+				static_cast<unsigned int>(image.rect().width() * scale),
+				static_cast<unsigned int>(image.rect().height() * scale),
+				_setting_preview_cache_mb * 1024 * 1024);
+		}
+	}
+	catch (const std::exception&) {
+		return;
+	}
+
+	// prefetch the rows above and below the selection
+	std::vector<std::string> prefetch;
+
+	size_t position = 0;
+	if (_library.position(id, position)) {
+		if (position + 1 < _library.size())
+			prefetch.push_back(_pictures.full_path(_library.at(position + 1)));
+
+		if (position > 0)
+			prefetch.push_back(_pictures.full_path(_library.at(position - 1)));
+	}
+
+	_previews->request(_displayed_image.full_path, prefetch);
+
+	// for retention policies that keep the most recently viewed images
+	_retention->viewed(_displayed_image.full_path, std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+
+	if (!_timer_man.running("preview"))
+		_timer_man.add("preview", 30, [this]() { on_preview(); });
+}
+
+void main_form::on_preview() {
+	if (_displayed_image.full_path.empty() || !_previews) {
+		_timer_man.stop("preview");
+		return;
+	}
+
+	std::string preview_path;
+	if (!_previews->get(_displayed_image.full_path, preview_path))
+		return;
+
+	_timer_man.stop("preview");
+
+	try {
+		auto& image = get_image_view("home/image");
+		auto& file_info = get_label("home/file_info");
+
+		// fall back to the original if the preview could not be made
+		image.file(preview_path.empty() ? _displayed_image.full_path : preview_path);
+
+		std::string file_info_text = "Resolution: " + std::to_string(_displayed_image.width) + "x" + std::to_string(_displayed_image.height);
+		file_info_text += ", Size: " + leccore::format_size(_displayed_image.file_size);
+
+		const auto stats = _previews->cache_statistics();
+		const std::string cache_text = "Preview cache: " + std::to_string(stats.entries) + " images, " +
+			leccore::format_size(stats.resident_bytes) + ", " +
+			std::to_string(static_cast<int>(stats.hit_rate() * 100. + .5)) + "% hits";
+
+		file_info.text(file_info_text).tooltip(cache_text);
+		update();
+	}
+	catch (const std::exception&) {}
 }
@@ -85,7 +85,7 @@ void main_form::add_side_pane() {
 		.events().action = [&]() {
 		try {
 			add_back_button();
-			_page_man.show("settings");
+			show_page("settings");
 		}
 		catch (const std::exception& e) { message(e.what()); }
 	};
@@ -102,6 +102,6 @@ void main_form::add_side_pane() {
 		.png_resource(png_help)
 		.events().action = [this]() {
 		add_back_button();
-		_page_man.show("help");
+		show_page("help");
 	};
 }
@@ -23,8 +23,10 @@
 */
 
 #include "helper_functions.h"
+#include "path_utils.h"
 #include <Windows.h>
 #include <strsafe.h>	// for StringCchPrintfA
+#include <chrono>
 
 /// <summary>
 /// Get current module's full path, whether it's a .exe or a .dll.
@@ -53,41 +55,35 @@ bool get_module_full_path(std::string& full_path) {
 	return true;
 }
 
-bool get_directory_from_full_path(
-	const std::string& full_path,
-	std::string& directory) {
-	directory.clear();
-
-	const size_t last_slash_index = full_path.rfind('\\');
-
-	if (std::string::npos != last_slash_index)
-		directory = full_path.substr(0, last_slash_index);
-
-	return true;
+std::string get_current_folder() {
+	std::string full_path;
+	if (get_module_full_path(full_path))
+		return std::string(path_directory(full_path));
+	else
+		return std::string();
 }
 
-bool get_filename_from_full_path(
-	const std::string& full_path,
-	std::string& file_name) {
-	file_name.clear();
+long long get_process_uptime() {
+	FILETIME creation, exit, kernel, user, now;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
 
-	const size_t last_slash_idx = full_path.rfind('\\');
+	GetSystemTimeAsFileTime(&now);
 
-	if (std::string::npos != last_slash_idx) {
-		file_name = full_path;
-		file_name.erase(0, last_slash_idx + 1);
-	}
+	ULARGE_INTEGER start, end;
+	start.LowPart = creation.dwLowDateTime;
+	start.HighPart = creation.dwHighDateTime;
+	end.LowPart = now.dwLowDateTime;
+	end.HighPart = now.dwHighDateTime;
 
-	return true;
+	// file times are in 100 nanosecond intervals
+	return static_cast<long long>((end.QuadPart - start.QuadPart) / 10000);
 }
 
-std::string get_current_folder() {
-	std::string full_path;
-	if (get_module_full_path(full_path)) {
-		std::string current_folder;
-		return get_directory_from_full_path(full_path, current_folder) ?
-			current_folder : std::string();
-	}
-	else
-		return std::string();
+long long to_unix_time(std::filesystem::file_time_type file_time) {
+	const auto system_time = std::chrono::system_clock::now() +
+		std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			file_time - std::filesystem::file_time_type::clock::now());
+
+	return std::chrono::duration_cast<std::chrono::seconds>(system_time.time_since_epoch()).count();
 }
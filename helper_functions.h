@@ -26,50 +26,33 @@
 
 #include <string>
 #include <vector>
+#include <filesystem>
 
 /// <summary>
-/// Extract file name from full path.
+/// Get the folder from which this module is running.
 /// </summary>
 /// 
-/// <param name="full_path">
-/// The full path, e.g. C:\\MyFolder\\myFile.txt
-/// </param>
-/// 
-/// <param name="file_name">
-/// The directory in which file specified in sFullPath is.
-/// </param>
-/// 
 /// <returns>
-/// Returns true if successful, else false.
+/// The full path to the current folder.
 /// </returns>
-bool get_filename_from_full_path(
-	const std::string& full_path,
-	std::string& file_name);
+std::string get_current_folder();
 
 /// <summary>
-/// Extract directory from full path.
+/// Get the time elapsed since the current process was created.
 /// </summary>
 /// 
-/// <param name="full_path">
-/// The full path, e.g. C:\\MyFolder\\myFile.txt
-/// </param>
-/// 
-/// <param name="directory">
-/// The directory in which file specified in full_path is.
-/// </param>
-/// 
 /// <returns>
-/// Returns true if successful, else false.
+/// The elapsed time, in milliseconds, or 0 if it cannot be determined.
 /// </returns>
-bool get_directory_from_full_path(
-	const std::string& full_path,
-	std::string& directory);
+long long get_process_uptime();
 
 /// <summary>
-/// Get the folder from which this module is running.
+/// Convert a file time to seconds since the Unix epoch.
 /// </summary>
 /// 
+/// <param name="file_time">The file time.</param>
+/// 
 /// <returns>
-/// The full path to the current folder.
+/// The number of seconds since the Unix epoch.
 /// </returns>
-std::string get_current_folder();
+long long to_unix_time(std::filesystem::file_time_type file_time);
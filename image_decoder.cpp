@@ -0,0 +1,269 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_decoder.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+
+#include <Windows.h>
+#include <wincodec.h>
+#pragma comment(lib, "windowscodecs.lib")
+
+namespace {
+	/// <summary>
+	/// Minimal owner of a COM interface pointer.
+	/// </summary>
+	template <typename T>
+	class com_ptr {
+	public:
+		com_ptr() = default;
+		com_ptr(const com_ptr&) = delete;
+		com_ptr& operator=(const com_ptr&) = delete;
+		~com_ptr() {
+			if (_p)
+				_p->Release();
+		}
+
+		T** operator&() { return &_p; }
+		T* operator->() const { return _p; }
+		T* get() const { return _p; }
+
+	private:
+		T* _p = nullptr;
+	};
+
+	/// <summary>
+	/// Initializes COM for the calling thread for the lifetime of the object.
+	/// </summary>
+	class com_scope {
+	public:
+		com_scope() : _result(CoInitializeEx(NULL, COINIT_MULTITHREADED)) {}
+		~com_scope() {
+			// RPC_E_CHANGED_MODE means the thread was already initialized differently, which is fine
+			if (SUCCEEDED(_result))
+				CoUninitialize();
+		}
+
+	private:
+		const HRESULT _result;
+	};
+
+	std::wstring widen(const std::string& value) {
+		if (value.empty())
+			return std::wstring();
+
+		const int length = MultiByteToWideChar(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), NULL, 0);
+		std::wstring wide(static_cast<size_t>(length), L'\0');
+		MultiByteToWideChar(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), &wide[0], length);
+		return wide;
+	}
+}
+
+bool decode_image(const std::string& full_path,
+	unsigned int max_width,
+	unsigned int max_height,
+	bitmap& image,
+	std::string& error) {
+	image = bitmap();
+
+	com_scope com;
+
+	com_ptr<IWICImagingFactory> factory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)))) {
+		error = "Unable to create the imaging factory";
+		return false;
+	}
+
+	com_ptr<IWICBitmapDecoder> decoder;
+	if (FAILED(factory->CreateDecoderFromFilename(widen(full_path).c_str(), NULL, GENERIC_READ,
+		WICDecodeMetadataCacheOnDemand, &decoder))) {
+		error = "Unable to decode " + full_path;
+		return false;
+	}
+
+	com_ptr<IWICBitmapFrameDecode> frame;
+	UINT width = 0, height = 0;
+	if (FAILED(decoder->GetFrame(0, &frame)) || FAILED(frame->GetSize(&width, &height)) ||
+		width == 0 || height == 0) {
+		error = "Unable to decode " + full_path;
+		return false;
+	}
+
+	// fit within the maximum size without scaling up
+	double scale = 1.;
+	if (max_width)
+		scale = (std::min)(scale, static_cast<double>(max_width) / width);
+	if (max_height)
+		scale = (std::min)(scale, static_cast<double>(max_height) / height);
+
+	const UINT target_width = (std::max)(1u, static_cast<UINT>(width * scale + .5));
+	const UINT target_height = (std::max)(1u, static_cast<UINT>(height * scale + .5));
+
+	IWICBitmapSource* source = frame.get();
+
+	com_ptr<IWICBitmapScaler> scaler;
+	if (target_width != width || target_height != height) {
+		if (FAILED(factory->CreateBitmapScaler(&scaler)) ||
+			FAILED(scaler->Initialize(frame.get(), target_width, target_height, WICBitmapInterpolationModeFant))) {
+			error = "Unable to scale " + full_path;
+			return false;
+		}
+
+		source = scaler.get();
+	}
+
+	com_ptr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateFormatConverter(&converter)) ||
+		FAILED(converter->Initialize(source, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone,
+			NULL, 0., WICBitmapPaletteTypeCustom))) {
+		error = "Unable to convert " + full_path;
+		return false;
+	}
+
+	const UINT stride = target_width * 4;
+	std::vector<std::uint8_t> pixels(static_cast<size_t>(stride) * target_height);
+
+	if (FAILED(converter->CopyPixels(NULL, stride, static_cast<UINT>(pixels.size()), pixels.data()))) {
+		error = "Unable to decode " + full_path;
+		return false;
+	}
+
+	image.width = target_width;
+	image.height = target_height;
+	image.pixels = std::move(pixels);
+	return true;
+}
+
+bool save_bitmap(const bitmap& image,
+	const std::string& full_path,
+	std::string& error) {
+	BITMAPINFOHEADER info = {};
+	info.biSize = sizeof(info);
+	info.biWidth = static_cast<LONG>(image.width);
+	info.biHeight = -static_cast<LONG>(image.height);	// top-down
+	info.biPlanes = 1;
+	info.biBitCount = 32;
+	info.biCompression = BI_RGB;
+	info.biSizeImage = static_cast<DWORD>(image.pixels.size());
+
+	BITMAPFILEHEADER header = {};
+	header.bfType = 0x4D42;	// "BM"
+	header.bfOffBits = sizeof(header) + sizeof(info);
+	header.bfSize = header.bfOffBits + info.biSizeImage;
+
+	std::ofstream file(full_path, std::ios::binary | std::ios::trunc);
+
+	if (!file) {
+		error = "Unable to create " + full_path;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(&info), sizeof(info));
+	file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+
+	if (!file) {
+		error = "Unable to write " + full_path;
+		return false;
+	}
+
+	return true;
+}
+
+bool save_jpeg(const bitmap& image,
+	const std::string& full_path,
+	float quality,
+	std::string& error) {
+	if (image.width == 0 || image.height == 0 ||
+		image.pixels.size() < static_cast<size_t>(image.width) * image.height * 4) {
+		error = "Invalid image";
+		return false;
+	}
+
+	com_scope com;
+
+	com_ptr<IWICImagingFactory> factory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)))) {
+		error = "Unable to create the imaging factory";
+		return false;
+	}
+
+	const std::string temp_path = full_path + ".tmp";
+	bool ok = false;
+
+	{
+		com_ptr<IWICBitmap> source;
+		com_ptr<IWICFormatConverter> converter;
+		com_ptr<IWICStream> stream;
+		com_ptr<IWICBitmapEncoder> encoder;
+		com_ptr<IWICBitmapFrameEncode> frame;
+		com_ptr<IPropertyBag2> properties;
+
+		ok = SUCCEEDED(factory->CreateBitmapFromMemory(image.width, image.height, GUID_WICPixelFormat32bppBGRA,
+			image.width * 4, static_cast<UINT>(image.pixels.size()), const_cast<BYTE*>(image.pixels.data()), &source)) &&
+			SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+			SUCCEEDED(converter->Initialize(source.get(), GUID_WICPixelFormat24bppBGR, WICBitmapDitherTypeNone,
+				NULL, 0., WICBitmapPaletteTypeCustom)) &&
+			SUCCEEDED(factory->CreateStream(&stream)) &&
+			SUCCEEDED(stream->InitializeFromFilename(widen(temp_path).c_str(), GENERIC_WRITE)) &&
+			SUCCEEDED(factory->CreateEncoder(GUID_ContainerFormatJpeg, NULL, &encoder)) &&
+			SUCCEEDED(encoder->Initialize(stream.get(), WICBitmapEncoderNoCache)) &&
+			SUCCEEDED(encoder->CreateNewFrame(&frame, &properties));
+
+		if (ok) {
+			PROPBAG2 option = {};
+			option.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+			VARIANT value;
+			VariantInit(&value);
+			value.vt = VT_R4;
+			value.fltVal = (std::min)(1.f, (std::max)(0.f, quality));
+
+			WICPixelFormatGUID format = GUID_WICPixelFormat24bppBGR;
+			ok = SUCCEEDED(properties->Write(1, &option, &value)) &&
+				SUCCEEDED(frame->Initialize(properties.get())) &&
+				SUCCEEDED(frame->SetSize(image.width, image.height)) &&
+				SUCCEEDED(frame->SetPixelFormat(&format)) &&
+				IsEqualGUID(format, GUID_WICPixelFormat24bppBGR) &&
+				SUCCEEDED(frame->WriteSource(converter.get(), NULL)) &&
+				SUCCEEDED(frame->Commit()) &&
+				SUCCEEDED(encoder->Commit());
+		}
+	}	// release the stream before renaming the file
+
+	if (!ok) {
+		std::remove(temp_path.c_str());
+		error = "Unable to encode " + full_path;
+		return false;
+	}
+
+	if (!MoveFileExA(temp_path.c_str(), full_path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		std::remove(temp_path.c_str());
+		error = "Unable to save " + full_path;
+		return false;
+	}
+
+	return true;
+}
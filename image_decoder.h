@@ -0,0 +1,99 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// A decoded image with 32 bit BGRA pixels, top row first and no row padding.
+/// </summary>
+struct bitmap {
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<std::uint8_t> pixels;
+};
+
+/// <summary>
+/// Decode an image, scaling it down to fit within a given size.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the image file.</param>
+/// <param name="max_width">The maximum width, in pixels, or 0 for no limit.</param>
+/// <param name="max_height">The maximum height, in pixels, or 0 for no limit.</param>
+/// <param name="image">The decoded image.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// The aspect ratio is preserved and images are never scaled up. Uses the
+/// Windows Imaging Component and can be called from any thread.
+/// </remarks>
+bool decode_image(const std::string& full_path,
+	unsigned int max_width,
+	unsigned int max_height,
+	bitmap& image,
+	std::string& error);
+
+/// <summary>
+/// Save an image as an uncompressed BMP file.
+/// </summary>
+/// 
+/// <param name="image">The image.</param>
+/// <param name="full_path">The full path to the file.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false.
+/// </returns>
+bool save_bitmap(const bitmap& image,
+	const std::string& full_path,
+	std::string& error);
+
+/// <summary>
+/// Encode an image as a JPEG file.
+/// </summary>
+/// 
+/// <param name="image">The image. The alpha channel is dropped.</param>
+/// <param name="full_path">The full path to the file.</param>
+/// <param name="quality">The JPEG quality, from 0 to 1.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// The file is written under a temporary name and renamed when complete, so
+/// an interrupted encode never leaves a partial file at the full path.
+/// </remarks>
+bool save_jpeg(const bitmap& image,
+	const std::string& full_path,
+	float quality,
+	std::string& error);
@@ -0,0 +1,566 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_history.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <cstring>
+
+namespace {
+	constexpr char index_magic[4] = { 'S', 'P', 'H', 'I' };
+	constexpr char log_magic[4] = { 'S', 'P', 'H', 'L' };
+	constexpr std::uint32_t history_version = 1;
+
+	struct file_header {
+		char magic[4];
+		std::uint32_t version;
+	};
+
+	struct index_header {
+		file_header file;
+		std::uint64_t count;
+		std::uint64_t names_bytes;
+	};
+
+	// one per entry, sorted by name, followed by the names
+	struct index_record {
+		std::uint64_t file_size;
+		std::int64_t fetched;
+		std::int64_t first_seen;
+		std::int64_t last_seen;
+		std::uint32_t name_offset;
+		std::uint32_t name_size;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint8_t bucket;
+		std::uint8_t reserved[7];
+	};
+
+	static_assert(sizeof(index_header) == 24 && sizeof(index_record) == 56,
+		"the index is written byte for byte");
+
+	// each log record is its size, a checksum of the payload, then the
+	// payload: this followed by the name
+	struct log_record {
+		std::uint64_t file_size;
+		std::int64_t fetched;
+		std::int64_t first_seen;
+		std::int64_t last_seen;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint8_t bucket;
+		std::uint8_t reserved[3];
+		std::uint32_t name_size;
+	};
+
+	static_assert(sizeof(log_record) == 48, "log records are written byte for byte");
+
+	std::uint32_t crc32(const unsigned char* data, size_t size) {
+		static const auto table = []() {
+			std::array<std::uint32_t, 256> table{};
+			for (std::uint32_t i = 0; i < 256; i++) {
+				std::uint32_t value = i;
+				for (int bit = 0; bit < 8; bit++)
+					value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+
+				table[i] = value;
+			}
+			return table;
+		}();
+
+		std::uint32_t crc = ~0u;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+	std::string log_path(const std::string& index_path) {
+		return index_path + ".log";
+	}
+
+	// the bucket is used as an index into aspect_buckets, so it is checked
+	// before it is trusted
+	bool valid_bucket(std::uint8_t bucket) {
+		return bucket < aspect_bucket_count || bucket == static_cast<std::uint8_t>(aspect_bucket::none);
+	}
+
+	history_entry make_entry(const index_record& record, std::string_view name) {
+		history_entry entry;
+		entry.asset = name;
+		entry.bucket = static_cast<aspect_bucket>(record.bucket);
+		entry.width = record.width;
+		entry.height = record.height;
+		entry.file_size = record.file_size;
+		entry.fetched = record.fetched;
+		entry.first_seen = record.first_seen;
+		entry.last_seen = record.last_seen;
+		return entry;
+	}
+
+	bool write_log_header(std::ofstream& log) {
+		file_header header = {};
+		memcpy(header.magic, log_magic, sizeof(header.magic));
+		header.version = history_version;
+		log.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return static_cast<bool>(log);
+	}
+
+	/// <summary>
+	/// Read the complete records of a log, in the order they were written.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The size of the log up to the end of the last complete record, or 0 if
+	/// the log is not a history log.
+	/// </returns>
+	size_t read_log(const std::string& full_path, std::vector<history_entry>& entries) {
+		std::ifstream file(full_path, std::ios::binary);
+		const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		file_header header;
+		if (data.size() < sizeof(header))
+			return 0;
+
+		memcpy(&header, data.data(), sizeof(header));
+		if (memcmp(header.magic, log_magic, sizeof(header.magic)) != 0 || header.version != history_version)
+			return 0;
+
+		const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+		size_t offset = sizeof(header);
+
+		for (;;) {
+			std::uint32_t framing[2];	// payload size, checksum
+			if (data.size() - offset < sizeof(framing))
+				break;
+
+			memcpy(framing, bytes + offset, sizeof(framing));
+			const size_t payload = framing[0];
+
+			if (payload < sizeof(log_record) || payload > data.size() - offset - sizeof(framing) ||
+				crc32(bytes + offset + sizeof(framing), payload) != framing[1])
+				break;
+
+			log_record record;
+			memcpy(&record, bytes + offset + sizeof(framing), sizeof(record));
+
+			if (record.name_size != payload - sizeof(record))
+				break;
+
+			// a complete record from a damaged or older file is skipped
+			if (!valid_bucket(record.bucket)) {
+				offset += sizeof(framing) + payload;
+				continue;
+			}
+
+			history_entry entry;
+			entry.asset.assign(data, offset + sizeof(framing) + sizeof(record), record.name_size);
+			entry.bucket = static_cast<aspect_bucket>(record.bucket);
+			entry.width = record.width;
+			entry.height = record.height;
+			entry.file_size = record.file_size;
+			entry.fetched = record.fetched;
+			entry.first_seen = record.first_seen;
+			entry.last_seen = record.last_seen;
+			entries.push_back(std::move(entry));
+
+			offset += sizeof(framing) + payload;
+		}
+
+		return offset;
+	}
+}
+
+image_history::~image_history() {
+	close();
+}
+
+bool image_history::open(const std::string& full_path, std::string& error) {
+	close();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_path = full_path;
+
+	if (!open_index(error))
+		return false;
+
+	// replay the log, dropping a record cut short by a crash
+	const auto log = log_path(_path);
+	std::vector<history_entry> replayed;
+	size_t valid_size = 0;
+
+	try {
+		if (std::filesystem::exists(log)) {
+			valid_size = read_log(log, replayed);
+
+			if (valid_size && valid_size < std::filesystem::file_size(log))
+				std::filesystem::resize_file(log, valid_size);
+		}
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		_index.close();
+		return false;
+	}
+
+	history_entry existing;
+	for (auto& it : replayed) {
+		if (!_log_entries.count(it.asset) && !find_index(it.asset, existing))
+			_size++;
+
+		auto name = it.asset;
+		_log_entries[std::move(name)] = std::move(it);
+	}
+
+	// a missing or unreadable log is started over
+	if (valid_size)
+		_log.open(log, std::ios::binary | std::ios::app);
+	else {
+		_log.open(log, std::ios::binary | std::ios::trunc);
+		if (_log)
+			write_log_header(_log);
+	}
+
+	if (!_log) {
+		error = "Unable to open " + log;
+		_index.close();
+		_log_entries.clear();
+		return false;
+	}
+
+	_log.flush();
+	return true;
+}
+
+bool image_history::open_index(std::string& error) {
+	_index.close();
+	_index_count = 0;
+	_size = 0;
+
+	if (!std::filesystem::exists(_path))
+		return true;
+
+	if (!_index.open(_path, error))
+		return false;
+
+	index_header header;
+	if (_index.size() < sizeof(header)) {
+		error = "Not an image history";
+		_index.close();
+		return false;
+	}
+
+	memcpy(&header, _index.data(), sizeof(header));
+
+	if (memcmp(header.file.magic, index_magic, sizeof(header.file.magic)) != 0 ||
+		header.file.version != history_version) {
+		error = "Not an image history, or an unsupported version";
+		_index.close();
+		return false;
+	}
+
+	if (header.count > (_index.size() - sizeof(header)) / sizeof(index_record) ||
+		sizeof(header) + header.count * sizeof(index_record) + header.names_bytes != _index.size()) {
+		error = "The image history is damaged";
+		_index.close();
+		return false;
+	}
+
+	// check every name is inside the file and every bucket is valid once, so
+	// lookups don't have to
+	for (size_t i = 0; i < header.count; i++) {
+		index_record record;
+		memcpy(&record, _index.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+
+		if (static_cast<std::uint64_t>(record.name_offset) + record.name_size > header.names_bytes ||
+			!valid_bucket(record.bucket)) {
+			error = "The image history is damaged";
+			_index.close();
+			return false;
+		}
+	}
+
+	_index_count = static_cast<size_t>(header.count);
+	_size = _index_count;
+	return true;
+}
+
+void image_history::close() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_log.is_open())
+		_log.close();
+
+	_log.clear();
+	_index.close();
+	_index_count = 0;
+	_log_entries.clear();
+	_size = 0;
+}
+
+bool image_history::find_index(std::string_view asset, history_entry& entry) const {
+	if (_index_count == 0)
+		return false;
+
+	const auto* records = _index.data() + sizeof(index_header);
+	const auto* names = reinterpret_cast<const char*>(records + _index_count * sizeof(index_record));
+
+	// binary search over the sorted records
+	size_t first = 0, last = _index_count;
+	while (first < last) {
+		const size_t middle = first + (last - first) / 2;
+
+		index_record record;
+		memcpy(&record, records + middle * sizeof(record), sizeof(record));
+
+		const std::string_view name(names + record.name_offset, record.name_size);
+		const int comparison = name.compare(asset);
+
+		if (comparison == 0) {
+			entry = make_entry(record, name);
+			return true;
+		}
+
+		if (comparison < 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return false;
+}
+
+bool image_history::record(const std::vector<history_entry>& seen, long long now, std::string& error) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_log.is_open()) {
+		error = "The image history is not open";
+		return false;
+	}
+
+	std::vector<unsigned char> buffer;
+
+	for (const auto& it : seen) {
+		history_entry entry = it;
+		entry.first_seen = now;
+		entry.last_seen = now;
+
+		history_entry existing;
+		const auto log_it = _log_entries.find(it.asset);
+
+		if (log_it != _log_entries.end())
+			entry.first_seen = log_it->second.first_seen;
+		else if (find_index(it.asset, existing))
+			entry.first_seen = existing.first_seen;
+		else
+			_size++;
+
+		log_record record = {};
+		record.file_size = entry.file_size;
+		record.fetched = entry.fetched;
+		record.first_seen = entry.first_seen;
+		record.last_seen = entry.last_seen;
+		record.width = entry.width;
+		record.height = entry.height;
+		record.bucket = static_cast<std::uint8_t>(entry.bucket);
+		record.name_size = static_cast<std::uint32_t>(entry.asset.size());
+
+		const std::uint32_t payload = static_cast<std::uint32_t>(sizeof(record) + entry.asset.size());
+		buffer.resize(sizeof(std::uint32_t) * 2 + payload);
+
+		memcpy(buffer.data() + sizeof(std::uint32_t) * 2, &record, sizeof(record));
+		memcpy(buffer.data() + sizeof(std::uint32_t) * 2 + sizeof(record), entry.asset.data(), entry.asset.size());
+
+		const std::uint32_t checksum = crc32(buffer.data() + sizeof(std::uint32_t) * 2, payload);
+		memcpy(buffer.data(), &payload, sizeof(payload));
+		memcpy(buffer.data() + sizeof(payload), &checksum, sizeof(checksum));
+
+		_log.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+		_log_entries[entry.asset] = std::move(entry);
+	}
+
+	_log.flush();
+
+	if (!_log) {
+		error = "Unable to write " + log_path(_path);
+		return false;
+	}
+
+	return true;
+}
+
+bool image_history::find(std::string_view asset, history_entry& entry) const {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto it = _log_entries.find(asset);
+	if (it != _log_entries.end()) {
+		entry = it->second;
+		return true;
+	}
+
+	return find_index(asset, entry);
+}
+
+std::vector<history_entry> image_history::entries() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return entries_locked();
+}
+
+std::vector<history_entry> image_history::entries_locked() const {
+	std::vector<history_entry> merged;
+	merged.reserve(_size);
+
+	const auto* records = _index_count ? _index.data() + sizeof(index_header) : nullptr;
+	const auto* names = _index_count ? reinterpret_cast<const char*>(records + _index_count * sizeof(index_record)) : nullptr;
+	auto log_it = _log_entries.begin();
+
+	// both are sorted by name, and the log is newer
+	for (size_t i = 0; i < _index_count; i++) {
+		index_record record;
+		memcpy(&record, records + i * sizeof(record), sizeof(record));
+		const std::string_view name(names + record.name_offset, record.name_size);
+
+		for (; log_it != _log_entries.end() && log_it->first < name; log_it++)
+			merged.push_back(log_it->second);
+
+		if (log_it != _log_entries.end() && log_it->first == name)
+			merged.push_back((log_it++)->second);
+		else
+			merged.push_back(make_entry(record, name));
+	}
+
+	for (; log_it != _log_entries.end(); log_it++)
+		merged.push_back(log_it->second);
+
+	return merged;
+}
+
+size_t image_history::size() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _size;
+}
+
+size_t image_history::log_size() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _log_entries.size();
+}
+
+bool image_history::compact(std::string& error) {
+	// merged under the same lock that truncates the log, so that no record()
+	// can slip in between and be lost
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_log.is_open()) {
+		error = "The image history is not open";
+		return false;
+	}
+
+	const auto merged = entries_locked();
+
+	std::vector<index_record> records(merged.size());
+	std::string names;
+
+	for (size_t i = 0; i < merged.size(); i++) {
+		const auto& entry = merged[i];
+		auto& record = records[i];
+		record = {};
+		record.file_size = entry.file_size;
+		record.fetched = entry.fetched;
+		record.first_seen = entry.first_seen;
+		record.last_seen = entry.last_seen;
+		record.name_offset = static_cast<std::uint32_t>(names.size());
+		record.name_size = static_cast<std::uint32_t>(entry.asset.size());
+		record.width = entry.width;
+		record.height = entry.height;
+		record.bucket = static_cast<std::uint8_t>(entry.bucket);
+		names += entry.asset;
+	}
+
+	index_header header = {};
+	memcpy(header.file.magic, index_magic, sizeof(header.file.magic));
+	header.file.version = history_version;
+	header.count = records.size();
+	header.names_bytes = names.size();
+
+	const std::string temp_path = _path + ".tmp";
+
+	try {
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+			if (!file) {
+				error = "Unable to create " + temp_path;
+				return false;
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if (!records.empty())
+				file.write(reinterpret_cast<const char*>(records.data()),
+					static_cast<std::streamsize>(records.size() * sizeof(index_record)));
+			file.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+			if (!file) {
+				error = "Unable to write " + temp_path;
+				return false;
+			}
+		}
+
+		// a mapped file cannot be replaced on Windows
+		_index.close();
+		std::filesystem::rename(temp_path, _path);
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+
+		// carry on with the old index
+		std::string reopen_error;
+		if (!open_index(reopen_error)) {}
+		_size = merged.size();
+		return false;
+	}
+
+	if (!open_index(error))
+		return false;
+
+	// only now is the log redundant
+	_log.close();
+	_log.clear();
+	_log.open(log_path(_path), std::ios::binary | std::ios::trunc);
+
+	if (!_log || !write_log_header(_log)) {
+		error = "Unable to reset " + log_path(_path);
+		return false;
+	}
+
+	_log.flush();
+	_log_entries.clear();
+	return true;
+}
+
+std::string image_history_path(const std::string& folder) {
+	return join_path(folder, ".history");
+}
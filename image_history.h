@@ -0,0 +1,169 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "aspect_buckets.h"
+#include "mapped_file.h"
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// What is known about a Spotlight asset that was ever fetched.
+/// </summary>
+struct history_entry {
+	std::string asset;	// the name of the asset in the Spotlight folder
+	aspect_bucket bucket = aspect_bucket::none;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned long long file_size = 0;
+	long long fetched = 0;	// the write time of the asset, in seconds since the Unix epoch
+	long long first_seen = 0;	// when the asset was first fetched, in seconds since the Unix epoch
+	long long last_seen = 0;	// when the asset was last seen in the Spotlight folder
+};
+
+/// <summary>
+/// Persistent record of every image ever fetched, including images that have
+/// since left the Spotlight folder or the library.
+/// </summary>
+/// 
+/// <remarks>
+/// Made of two files. The index is a sorted table of entries that is
+/// memory-mapped and searched in place. Changes since the index was written
+/// are appended to a log, which is replayed into memory when the history is
+/// opened. Each log record carries a checksum, so a record that was cut
+/// short by a crash is detected and the log is truncated to the last
+/// complete record. compact() merges the log into a new index. All member
+/// functions are thread-safe.
+/// </remarks>
+class image_history {
+public:
+	image_history() = default;
+	image_history(const image_history&) = delete;
+	image_history& operator=(const image_history&) = delete;
+	~image_history();
+
+	/// <summary>
+	/// Open the history, creating it if it doesn't exist.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the index. The log is kept next to it, with a .log extension.</param>
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if successful, else false.
+	/// </returns>
+	bool open(const std::string& full_path, std::string& error);
+
+	void close();
+
+	/// <summary>
+	/// Record that assets were seen.
+	/// </summary>
+	/// 
+	/// <param name="seen">
+	/// The assets. first_seen and last_seen are ignored: assets that are new to
+	/// the history are first seen now, and every asset is last seen now.
+	/// </param>
+	/// <param name="now">The current time, in seconds since the Unix epoch.</param>
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if the log was written, else false.
+	/// </returns>
+	bool record(const std::vector<history_entry>& seen, long long now, std::string& error);
+
+	/// <summary>
+	/// Look up an asset, in O(log n).
+	/// </summary>
+	/// 
+	/// <param name="asset">The name of the asset in the Spotlight folder.</param>
+	/// <param name="entry">The entry.</param>
+	/// 
+	/// <returns>
+	/// Returns true if the asset was ever fetched, else false.
+	/// </returns>
+	bool find(std::string_view asset, history_entry& entry) const;
+
+	/// <summary>
+	/// Get every entry, ordered by asset name.
+	/// </summary>
+	std::vector<history_entry> entries() const;
+
+	/// <summary>
+	/// Get the number of assets in the history.
+	/// </summary>
+	size_t size() const;
+
+	/// <summary>
+	/// Get the number of entries in the log, which compact() moves into the index.
+	/// </summary>
+	size_t log_size() const;
+
+	/// <summary>
+	/// Merge the log into the index.
+	/// </summary>
+	/// 
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if successful, else false. If the new index could not be
+	/// written the history is left as it was.
+	/// </returns>
+	/// 
+	/// <remarks>
+	/// The new index replaces the old one before the log is emptied, so a crash
+	/// in between only means the log is replayed again.
+	/// </remarks>
+	bool compact(std::string& error);
+
+	/// <summary>
+	/// The number of log entries above which callers should compact().
+	/// </summary>
+	static constexpr size_t compact_threshold = 1024;
+
+private:
+	bool find_index(std::string_view asset, history_entry& entry) const;
+	bool open_index(std::string& error);
+	std::vector<history_entry> entries_locked() const;	// entries(), with _mutex held
+
+	mutable std::mutex _mutex;
+	std::string _path;
+	mapped_file _index;
+	size_t _index_count = 0;
+	std::map<std::string, history_entry, std::less<>> _log_entries;	// newer than the index
+	std::ofstream _log;
+	size_t _size = 0;
+};
+
+/// <summary>
+/// Get the path of the image history of a library.
+/// </summary>
+std::string image_history_path(const std::string& folder);
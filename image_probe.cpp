@@ -0,0 +1,191 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_probe.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+	using file_ptr = std::unique_ptr<FILE, decltype(&fclose)>;
+
+	file_ptr open_file(const std::filesystem::path& full_path) {
+#ifdef _WIN32
+		// the native wide path, so that no conversion is needed
+		FILE* file = nullptr;
+		if (_wfopen_s(&file, full_path.c_str(), L"rb") != 0)
+			file = nullptr;
+		return file_ptr(file, &fclose);
+#else
+		return file_ptr(fopen(full_path.c_str(), "rb"), &fclose);
+#endif
+	}
+
+	std::uint32_t read_be16(const unsigned char* p) {
+		return (static_cast<std::uint32_t>(p[0]) << 8) | p[1];
+	}
+
+	std::uint32_t read_be32(const unsigned char* p) {
+		return (read_be16(p) << 16) | read_be16(p + 2);
+	}
+
+	bool is_sof_marker(unsigned char marker) {
+		// SOF0 to SOF15, excluding DHT (C4), JPG (C8) and DAC (CC)
+		return marker >= 0xC0 && marker <= 0xCF &&
+			marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+	}
+
+	bool probe_jpeg(FILE* file, unsigned int& width, unsigned int& height) {
+		unsigned char buffer[8];
+
+		for (;;) {
+			// find the next marker, skipping fill bytes
+			int c = fgetc(file);
+			if (c != 0xFF)
+				return false;
+
+			do {
+				c = fgetc(file);
+			} while (c == 0xFF);
+
+			if (c == EOF)
+				return false;
+
+			const auto marker = static_cast<unsigned char>(c);
+
+			// standalone markers have no length
+			if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+				continue;
+
+			// the image data starts before a frame header was found
+			if (marker == 0xD9 || marker == 0xDA)
+				return false;
+
+			if (fread(buffer, 1, 2, file) != 2)
+				return false;
+
+			const auto length = read_be16(buffer);
+			if (length < 2)
+				return false;
+
+			if (is_sof_marker(marker)) {
+				// precision (1), height (2), width (2)
+				if (length < 7 || fread(buffer, 1, 5, file) != 5)
+					return false;
+
+				height = read_be16(buffer + 1);
+				width = read_be16(buffer + 3);
+				return width > 0 && height > 0;
+			}
+
+			if (fseek(file, static_cast<long>(length) - 2, SEEK_CUR) != 0)
+				return false;
+		}
+	}
+
+	bool probe_png(FILE* file, unsigned int& width, unsigned int& height) {
+		// the rest of the signature (4), IHDR length (4), IHDR type (4), width (4), height (4)
+		unsigned char buffer[20];
+		if (fread(buffer, 1, sizeof(buffer), file) != sizeof(buffer))
+			return false;
+
+		if (buffer[0] != 0x0D || buffer[1] != 0x0A || buffer[2] != 0x1A || buffer[3] != 0x0A)
+			return false;
+
+		if (buffer[8] != 'I' || buffer[9] != 'H' || buffer[10] != 'D' || buffer[11] != 'R')
+			return false;
+
+		width = read_be32(buffer + 12);
+		height = read_be32(buffer + 16);
+		return width > 0 && height > 0;
+	}
+}
+
+bool probe_image(const std::filesystem::path& full_path,
+	unsigned int& width,
+	unsigned int& height) {
+	width = height = 0;
+
+	auto file = open_file(full_path);
+	if (!file)
+		return false;
+
+	unsigned char signature[2];
+	if (fread(signature, 1, 2, file.get()) != 2)
+		return false;
+
+	if (signature[0] == 0xFF && signature[1] == 0xD8)
+		return probe_jpeg(file.get(), width, height);
+
+	if (signature[0] == 0x89 && signature[1] == 'P') {
+		unsigned char ng[2];
+		if (fread(ng, 1, 2, file.get()) != 2 || ng[0] != 'N' || ng[1] != 'G')
+			return false;
+
+		return probe_png(file.get(), width, height);
+	}
+
+	return false;
+}
+
+bool is_complete_image(const std::filesystem::path& full_path) {
+	auto file = open_file(full_path);
+	if (!file)
+		return false;
+
+	unsigned char signature[2];
+	if (fread(signature, 1, 2, file.get()) != 2)
+		return false;
+
+	const bool jpeg = signature[0] == 0xFF && signature[1] == 0xD8;
+	const bool png = signature[0] == 0x89 && signature[1] == 'P';
+
+	if (!jpeg && !png)
+		return true;
+
+	// encoders sometimes pad the file after the end marker, so look at a short tail
+	unsigned char tail[64];
+	if (fseek(file.get(), 0, SEEK_END) != 0)
+		return false;
+
+	const long size = ftell(file.get());
+	const long tail_size = (std::min)(size, static_cast<long>(sizeof(tail)));
+
+	if (size < 0 || fseek(file.get(), size - tail_size, SEEK_SET) != 0 ||
+		fread(tail, 1, static_cast<size_t>(tail_size), file.get()) != static_cast<size_t>(tail_size))
+		return false;
+
+	for (long i = tail_size - 2; i >= 0; i--) {
+		if (jpeg && tail[i] == 0xFF && tail[i + 1] == 0xD9)
+			return true;
+
+		if (png && i + 4 <= tail_size && memcmp(tail + i, "IEND", 4) == 0)
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,64 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <filesystem>
+
+/// <summary>
+/// Read the dimensions of an image from its file header.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the image file.</param>
+/// <param name="width">The width of the image, in pixels.</param>
+/// <param name="height">The height of the image, in pixels.</param>
+/// 
+/// <returns>
+/// Returns true if the file is a JPEG or PNG image and its dimensions were
+/// read, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// Only the headers are read; the image is not decoded.
+/// </remarks>
+bool probe_image(const std::filesystem::path& full_path,
+	unsigned int& width,
+	unsigned int& height);
+
+/// <summary>
+/// Check whether an image file ends where its format says it should.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the image file.</param>
+/// 
+/// <returns>
+/// Returns false if the file is a JPEG without an end of image marker or a
+/// PNG without an IEND chunk near its end, which happens when a download is
+/// cut short. Returns true otherwise, including for other formats.
+/// </returns>
+/// 
+/// <remarks>
+/// Only the last few bytes of the file are read.
+/// </remarks>
+bool is_complete_image(const std::filesystem::path& full_path);
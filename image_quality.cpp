@@ -0,0 +1,379 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_quality.h"
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IMAGE_QUALITY_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define IMAGE_QUALITY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	// Rec. 709 luma weights scaled to add up to 256
+	constexpr unsigned int weight_b = 19;
+	constexpr unsigned int weight_g = 183;
+	constexpr unsigned int weight_r = 54;
+
+	// the squares of up to 2 * 4096 Laplacian values fit in a 32 bit lane, so
+	// the vector accumulators are flushed to 64 bits at least this often
+	constexpr unsigned int chunk_pixels = 4096;
+
+	struct laplacian_sums {
+		std::int64_t sum = 0;
+		std::uint64_t squares = 0;
+	};
+
+	void luminance_scalar(const std::uint8_t* bgra, size_t count, std::uint8_t* luma) {
+		for (size_t i = 0; i < count; i++, bgra += 4)
+			luma[i] = static_cast<std::uint8_t>((bgra[0] * weight_b + bgra[1] * weight_g + bgra[2] * weight_r) >> 8);
+	}
+
+	/// <summary>
+	/// The Laplacian of the pixels from first to last (exclusive) of a row that
+	/// has a row above and below it.
+	/// </summary>
+	void laplacian_scalar(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, laplacian_sums& sums) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		for (unsigned int x = first; x < last; x++) {
+			const int value = up[x] + down[x] + row[x - 1] + row[x + 1] - 4 * row[x];
+			sums.sum += value;
+			sums.squares += static_cast<std::uint64_t>(value * value);
+		}
+	}
+
+#if defined(IMAGE_QUALITY_X86)
+	void luminance_sse2(const std::uint8_t* bgra, size_t count, std::uint8_t* luma) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weights = _mm_setr_epi16(weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			__m128i y[4];
+
+			for (int k = 0; k < 4; k++) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra + (i + k * 4) * 4));
+				const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights);
+				const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights);
+				y[k] = _mm_srli_epi32(_mm_add_epi32(
+					_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))),
+					_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)))), 8);
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(luma + i),
+				_mm_packus_epi16(_mm_packs_epi32(y[0], y[1]), _mm_packs_epi32(y[2], y[3])));
+		}
+
+		luminance_scalar(bgra + i * 4, count - i, luma + i);
+	}
+
+	void laplacian_sse2(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, laplacian_sums& sums) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16(1);
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		auto load = [&zero](const std::uint8_t* p) {
+			return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+		};
+
+		unsigned int x = first;
+		while (last - x >= 8) {
+			const unsigned int end = x + (std::min)(chunk_pixels, (last - x) & ~7u);
+			__m128i sum = zero, squares = zero;
+
+			for (; x < end; x += 8) {
+				const __m128i neighbours = _mm_add_epi16(_mm_add_epi16(load(up + x), load(down + x)),
+					_mm_add_epi16(load(row + x - 1), load(row + x + 1)));
+				const __m128i value = _mm_sub_epi16(neighbours, _mm_slli_epi16(load(row + x), 2));
+
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(value, ones));
+				squares = _mm_add_epi32(squares, _mm_madd_epi16(value, value));
+			}
+
+			alignas(16) std::int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+			sums.sum += static_cast<std::int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), squares);
+			sums.squares += static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		}
+
+		laplacian_scalar(row, stride, x, last, sums);
+	}
+
+	TARGET_AVX2
+	void luminance_avx2(const std::uint8_t* bgra, size_t count, std::uint8_t* luma) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i weights = _mm256_setr_epi16(
+			weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0,
+			weight_b, weight_g, weight_r, 0, weight_b, weight_g, weight_r, 0);
+
+		// the packs interleave the 128 bit lanes, this puts the pixels back in order
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32) {
+			__m256i y[4];
+
+			for (int k = 0; k < 4; k++) {
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra + (i + k * 8) * 4));
+				const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), weights);
+				const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), weights);
+				y[k] = _mm256_srli_epi32(_mm256_add_epi32(
+					_mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))),
+					_mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)))), 8);
+			}
+
+			const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(y[0], y[1]), _mm256_packs_epi32(y[2], y[3]));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(luma + i), _mm256_permutevar8x32_epi32(packed, order));
+		}
+
+		luminance_scalar(bgra + i * 4, count - i, luma + i);
+	}
+
+	TARGET_AVX2
+	inline __m256i load_avx2(const std::uint8_t* p) {
+		return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+	}
+
+	TARGET_AVX2
+	void laplacian_avx2(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, laplacian_sums& sums) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i ones = _mm256_set1_epi16(1);
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		unsigned int x = first;
+		while (last - x >= 16) {
+			const unsigned int end = x + (std::min)(chunk_pixels, (last - x) & ~15u);
+			__m256i sum = zero, squares = zero;
+
+			for (; x < end; x += 16) {
+				const __m256i neighbours = _mm256_add_epi16(_mm256_add_epi16(load_avx2(up + x), load_avx2(down + x)),
+					_mm256_add_epi16(load_avx2(row + x - 1), load_avx2(row + x + 1)));
+				const __m256i value = _mm256_sub_epi16(neighbours, _mm256_slli_epi16(load_avx2(row + x), 2));
+
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(value, ones));
+				squares = _mm256_add_epi32(squares, _mm256_madd_epi16(value, value));
+			}
+
+			alignas(32) std::int32_t lanes[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+			for (const auto lane : lanes)
+				sums.sum += lane;
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), squares);
+			for (const auto lane : lanes)
+				sums.squares += static_cast<std::uint32_t>(lane);
+		}
+
+		laplacian_scalar(row, stride, x, last, sums);
+	}
+#endif
+
+#if defined(IMAGE_QUALITY_NEON)
+	void luminance_neon(const std::uint8_t* bgra, size_t count, std::uint8_t* luma) {
+		const uint8x8_t wb = vdup_n_u8(weight_b);
+		const uint8x8_t wg = vdup_n_u8(weight_g);
+		const uint8x8_t wr = vdup_n_u8(weight_r);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16x4_t v = vld4q_u8(bgra + i * 4);
+
+			uint16x8_t y_lo = vmull_u8(vget_low_u8(v.val[0]), wb);
+			y_lo = vmlal_u8(y_lo, vget_low_u8(v.val[1]), wg);
+			y_lo = vmlal_u8(y_lo, vget_low_u8(v.val[2]), wr);
+
+			uint16x8_t y_hi = vmull_u8(vget_high_u8(v.val[0]), wb);
+			y_hi = vmlal_u8(y_hi, vget_high_u8(v.val[1]), wg);
+			y_hi = vmlal_u8(y_hi, vget_high_u8(v.val[2]), wr);
+
+			vst1q_u8(luma + i, vcombine_u8(vshrn_n_u16(y_lo, 8), vshrn_n_u16(y_hi, 8)));
+		}
+
+		luminance_scalar(bgra + i * 4, count - i, luma + i);
+	}
+
+	void laplacian_neon(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, laplacian_sums& sums) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		auto load = [](const std::uint8_t* p) {
+			return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+		};
+
+		unsigned int x = first;
+		while (last - x >= 8) {
+			const unsigned int end = x + (std::min)(chunk_pixels, (last - x) & ~7u);
+			int32x4_t sum = vdupq_n_s32(0), squares = vdupq_n_s32(0);
+
+			for (; x < end; x += 8) {
+				const int16x8_t neighbours = vaddq_s16(vaddq_s16(load(up + x), load(down + x)),
+					vaddq_s16(load(row + x - 1), load(row + x + 1)));
+				const int16x8_t value = vsubq_s16(neighbours, vshlq_n_s16(load(row + x), 2));
+
+				sum = vpadalq_s16(sum, value);
+				squares = vmlal_s16(squares, vget_low_s16(value), vget_low_s16(value));
+				squares = vmlal_s16(squares, vget_high_s16(value), vget_high_s16(value));
+			}
+
+			sums.sum += vaddlvq_s32(sum);
+			sums.squares += static_cast<std::uint64_t>(vaddlvq_s32(squares));
+		}
+
+		laplacian_scalar(row, stride, x, last, sums);
+	}
+#endif
+
+	float entropy(const std::vector<std::uint8_t>& luma) {
+		if (luma.empty())
+			return 0.f;
+
+		// separate tables keep runs of equal values from serializing on one counter
+		std::uint32_t tables[4][256] = {};
+
+		size_t i = 0;
+		for (; i + 4 <= luma.size(); i += 4) {
+			tables[0][luma[i]]++;
+			tables[1][luma[i + 1]]++;
+			tables[2][luma[i + 2]]++;
+			tables[3][luma[i + 3]]++;
+		}
+
+		for (; i < luma.size(); i++)
+			tables[0][luma[i]]++;
+
+		const double total = static_cast<double>(luma.size());
+		double bits = 0.;
+
+		for (size_t value = 0; value < 256; value++) {
+			const auto count = tables[0][value] + tables[1][value] + tables[2][value] + tables[3][value];
+
+			if (count) {
+				const double p = count / total;
+				bits -= p * std::log2(p);
+			}
+		}
+
+		return static_cast<float>(bits);
+	}
+}
+
+void compute_quality(const bitmap& image, quality_scores& scores) {
+	if (image.pixels.size() < static_cast<size_t>(image.width) * image.height * 4) {
+		scores = quality_scores();
+		return;
+	}
+
+	compute_quality(image.pixels.data(), image.width, image.height, detect_simd_level(), scores);
+}
+
+void compute_quality(const std::uint8_t* bgra,
+	unsigned int width,
+	unsigned int height,
+	simd_level level,
+	quality_scores& scores) {
+	scores = quality_scores();
+
+	const size_t count = static_cast<size_t>(width) * height;
+	if (count == 0)
+		return;
+
+	auto laplacian = laplacian_scalar;
+
+	switch (level) {
+#if defined(IMAGE_QUALITY_X86)
+	case simd_level::sse2:
+		laplacian = laplacian_sse2;
+		break;
+	case simd_level::avx2:
+		laplacian = laplacian_avx2;
+		break;
+#elif defined(IMAGE_QUALITY_NEON)
+	case simd_level::neon:
+		laplacian = laplacian_neon;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	std::vector<std::uint8_t> luma(count);
+	luminance_plane(bgra, count, level, luma.data());
+
+	// the Laplacian is taken over the pixels that have all four neighbours
+	laplacian_sums sums;
+	for (unsigned int y = 1; y + 1 < height; y++)
+		if (width > 2)
+			laplacian(luma.data() + static_cast<size_t>(y) * width, width, 1, width - 1, sums);
+
+	if (width > 2 && height > 2) {
+		const double n = static_cast<double>(width - 2) * (height - 2);
+		const double mean = sums.sum / n;
+		scores.sharpness = static_cast<float>((std::max)(0., sums.squares / n - mean * mean));
+	}
+
+	scores.entropy = entropy(luma);
+	scores.computed = 1;
+}
+
+void luminance_plane(const std::uint8_t* bgra,
+	size_t count,
+	simd_level level,
+	std::uint8_t* luma) {
+	switch (level) {
+#if defined(IMAGE_QUALITY_X86)
+	case simd_level::sse2:
+		luminance_sse2(bgra, count, luma);
+		break;
+	case simd_level::avx2:
+		luminance_avx2(bgra, count, luma);
+		break;
+#elif defined(IMAGE_QUALITY_NEON)
+	case simd_level::neon:
+		luminance_neon(bgra, count, luma);
+		break;
+#endif
+	default:
+		luminance_scalar(bgra, count, luma);
+		break;
+	}
+}
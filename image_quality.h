@@ -0,0 +1,106 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/// <summary>
+/// Quality scores of an image, computed from a downscaled decode.
+/// </summary>
+/// 
+/// <remarks>
+/// Plain data so that it can be stored as a catalog column and written to
+/// snapshots as is.
+/// </remarks>
+struct quality_scores {
+	/// <summary>
+	/// The variance of the Laplacian of the luminance. Blurry and flat images
+	/// score low; sharp, detailed images score in the hundreds or more.
+	/// </summary>
+	float sharpness = 0.f;
+
+	/// <summary>
+	/// The Shannon entropy of the luminance histogram, in bits, from 0 for a
+	/// solid frame to 8.
+	/// </summary>
+	float entropy = 0.f;
+
+	std::uint8_t computed = 0;	// 0 if the image could not be analyzed
+	std::uint8_t truncated = 0;	// 1 if the file is cut short
+	std::uint8_t reserved[2] = {};	// keeps the layout free of padding
+};
+
+static_assert(std::is_trivially_copyable<quality_scores>::value && sizeof(quality_scores) == 12,
+	"quality_scores is written to snapshots byte for byte");
+
+/// <summary>
+/// Compute the sharpness and entropy of an image using the best instruction
+/// set available.
+/// </summary>
+/// 
+/// <param name="image">The image, ideally downscaled to a few hundred pixels across.</param>
+/// <param name="scores">The scores. The truncated flag is left clear.</param>
+void compute_quality(const bitmap& image, quality_scores& scores);
+
+/// <summary>
+/// Compute the sharpness and entropy of BGRA pixels with a specific instruction set.
+/// </summary>
+/// 
+/// <param name="bgra">The pixels, four bytes each, top row first and no row padding.</param>
+/// <param name="width">The width, in pixels.</param>
+/// <param name="height">The height, in pixels.</param>
+/// <param name="level">
+/// The instruction set to use. It must be supported, see simd_supported().
+/// </param>
+/// <param name="scores">The scores. The truncated flag is left clear.</param>
+/// 
+/// <remarks>
+/// Every instruction set produces exactly the same scores.
+/// </remarks>
+void compute_quality(const std::uint8_t* bgra,
+	unsigned int width,
+	unsigned int height,
+	simd_level level,
+	quality_scores& scores);
+
+/// <summary>
+/// Convert BGRA pixels to 8 bit luminance with a specific instruction set.
+/// </summary>
+/// 
+/// <param name="bgra">The pixels, four bytes each.</param>
+/// <param name="count">The number of pixels.</param>
+/// <param name="level">
+/// The instruction set to use. It must be supported, see simd_supported().
+/// </param>
+/// <param name="luma">The luminance of each pixel, count bytes.</param>
+void luminance_plane(const std::uint8_t* bgra,
+	size_t count,
+	simd_level level,
+	std::uint8_t* luma);
@@ -0,0 +1,77 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_signature.h"
+#include "image_quality.h"
+
+#include <algorithm>
+#include <vector>
+
+void compute_signature(const bitmap& image, image_signature& signature) {
+	signature = image_signature();
+
+	constexpr unsigned int grid = image_signature::grid;
+	const size_t count = static_cast<size_t>(image.width) * image.height;
+
+	if (image.width < grid || image.height < grid || image.pixels.size() < count * 4)
+		return;
+
+	std::vector<std::uint8_t> luma(count);
+	luminance_plane(image.pixels.data(), count, detect_simd_level(), luma.data());
+
+	// cell sums, a row of the image at a time
+	std::array<std::uint64_t, grid * grid> sums{};
+	std::vector<unsigned int> cell_of_column(image.width);
+	for (unsigned int x = 0; x < image.width; x++)
+		cell_of_column[x] = static_cast<unsigned int>(static_cast<std::uint64_t>(x) * grid / image.width);
+
+	for (unsigned int y = 0; y < image.height; y++) {
+		const auto* row = luma.data() + static_cast<size_t>(y) * image.width;
+		auto* cells = sums.data() + static_cast<size_t>(y) * grid / image.height * grid;
+
+		for (unsigned int x = 0; x < image.width; x++)
+			cells[cell_of_column[x]] += row[x];
+	}
+
+	std::array<std::uint32_t, grid * grid> means{};
+	for (unsigned int cy = 0; cy < grid; cy++)
+		for (unsigned int cx = 0; cx < grid; cx++) {
+			const std::uint64_t width = (static_cast<std::uint64_t>(cx + 1) * image.width + grid - 1) / grid -
+				(static_cast<std::uint64_t>(cx) * image.width + grid - 1) / grid;
+			const std::uint64_t height = (static_cast<std::uint64_t>(cy + 1) * image.height + grid - 1) / grid -
+				(static_cast<std::uint64_t>(cy) * image.height + grid - 1) / grid;
+
+			means[cy * grid + cx] = static_cast<std::uint32_t>(sums[cy * grid + cx] / (std::max)(1ull,
+				static_cast<unsigned long long>(width * height)));
+		}
+
+	// stretched, so that exposure matters less than composition
+	const auto range = std::minmax_element(means.begin(), means.end());
+	const std::uint32_t low = *range.first, span = *range.second - *range.first;
+
+	for (size_t i = 0; i < means.size(); i++)
+		signature.cells[i] = static_cast<std::uint8_t>(span ? ((means[i] - low) * 255 + span / 2) / span : 128);
+
+	signature.computed = 1;
+}
@@ -0,0 +1,67 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+/// <summary>
+/// A coarse picture of where an image is light and dark, for finding images
+/// with a similar composition.
+/// </summary>
+/// 
+/// <remarks>
+/// Plain data so that it can be stored as a catalog column and written to
+/// snapshots as is.
+/// </remarks>
+struct image_signature {
+	/// <summary>
+	/// The number of cells across and down.
+	/// </summary>
+	static constexpr unsigned int grid = 8;
+
+	/// <summary>
+	/// The mean luminance of each cell, row by row, stretched so that the
+	/// darkest cell is 0 and the lightest 255.
+	/// </summary>
+	std::array<std::uint8_t, grid * grid> cells{};
+
+	std::uint8_t computed = 0;	// 0 if the image could not be analyzed
+	std::uint8_t reserved = 0;	// keeps the layout free of padding
+};
+
+static_assert(std::is_trivially_copyable<image_signature>::value && sizeof(image_signature) == 66,
+	"image_signature is written to snapshots byte for byte");
+
+/// <summary>
+/// Compute the luminance signature of an image.
+/// </summary>
+/// 
+/// <param name="image">The image, ideally downscaled to a few hundred pixels across.</param>
+/// <param name="signature">The signature.</param>
+void compute_signature(const bitmap& image, image_signature& signature);
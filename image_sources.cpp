@@ -0,0 +1,281 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "image_sources.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <map>
+#include <cctype>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <ShlObj.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	/// <summary>
+	/// Get the name a file gets in the library, see library_lookup::file_name().
+	/// </summary>
+	std::filesystem::path::string_type library_name(const std::filesystem::path& file) {
+		const auto name = path_filename(file.native());
+		std::filesystem::path::string_type library(name);
+
+		if (!has_extension(name, ".jpg") && !has_extension(name, ".jpeg"))
+			library += std::filesystem::path(".jpg").native();
+
+		return library;
+	}
+}
+
+std::string profiles_folder() {
+#ifdef _WIN32
+	// the parent of the current user's profile
+	CHAR szPath[MAX_PATH];
+	if (SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_PROFILE, NULL, 0, szPath)))
+		return std::filesystem::path(szPath).parent_path().string();
+#endif
+
+	return std::string();
+}
+
+std::vector<image_source> profile_sources(const std::string& profiles) {
+	std::vector<image_source> sources;
+
+	// the separators in the sub-folder are converted for the platform
+	std::filesystem::path assets = std::filesystem::path("AppData") / "Local";
+	std::string subfolder = spotlight_assets_subfolder;
+
+	size_t start = 0;
+	while (start <= subfolder.size()) {
+		auto end = subfolder.find('\\', start);
+		if (end == std::string::npos)
+			end = subfolder.size();
+
+		assets /= subfolder.substr(start, end - start);
+		start = end + 1;
+	}
+
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(profiles, ec), end; !ec && it != end; it.increment(ec)) {
+		std::error_code directory_ec;
+		if (!it->is_directory(directory_ec))
+			continue;
+
+		const auto folder = it->path() / assets;
+		if (std::filesystem::is_directory(folder, directory_ec))
+			sources.push_back({ folder.string(), it->path().filename().string(), false });
+	}
+
+	// directory order is up to the file system
+	std::sort(sources.begin(), sources.end(), [](const image_source& a, const image_source& b) {
+		return a.root < b.root;
+		});
+
+	return sources;
+}
+
+std::vector<image_source> parse_source_folders(const std::string& folders) {
+	std::vector<image_source> sources;
+
+	size_t start = 0;
+	while (start < folders.size()) {
+		auto end = folders.find(';', start);
+		if (end == std::string::npos)
+			end = folders.size();
+
+		auto folder = folders.substr(start, end - start);
+
+		// trim spaces around each folder
+		const auto first = folder.find_first_not_of(' ');
+		const auto last = folder.find_last_not_of(' ');
+		folder = first == std::string::npos ? std::string() : folder.substr(first, last - first + 1);
+
+		if (!folder.empty())
+			sources.push_back({ folder, folder, true });
+
+		start = end + 1;
+	}
+
+	return sources;
+}
+
+std::string volume_of(const std::string& path) {
+#ifdef _WIN32
+	// the drive letter, or the server and share of a UNC path
+	auto volume = std::filesystem::path(path).root_name().string();
+	for (auto& c : volume)
+		c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+
+	return volume;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return std::string();
+
+	return std::to_string(static_cast<unsigned long long>(info.st_dev));
+#endif
+}
+
+void ingest_queue::add_producers(size_t count) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_producers += count;
+}
+
+void ingest_queue::producer_done() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_producers)
+			_producers--;
+	}
+
+	_ready.notify_all();
+}
+
+bool ingest_queue::push(source_file file) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_cancelled)
+			return false;
+
+		if (!_queued.emplace(library_name(file.path), file.file_size, file.write_time).second) {
+			_duplicates++;
+			return false;
+		}
+
+		_files.push_back(std::move(file));
+	}
+
+	_ready.notify_one();
+	return true;
+}
+
+bool ingest_queue::pop(source_file& file) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_ready.wait(lock, [this]() { return !_files.empty() || _producers == 0 || _cancelled; });
+
+	if (_files.empty() || _cancelled)
+		return false;
+
+	file = std::move(_files.front());
+	_files.pop_front();
+	return true;
+}
+
+void ingest_queue::cancel() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_cancelled = true;
+		_files.clear();
+	}
+
+	_ready.notify_all();
+}
+
+bool ingest_queue::cancelled() const {
+	return _cancelled;
+}
+
+size_t ingest_queue::duplicates() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _duplicates;
+}
+
+namespace {
+	/// <summary>
+	/// List one source into the queue.
+	/// </summary>
+	void scan_source(const image_source& source, size_t index, ingest_queue& queue, std::string& error) {
+		std::error_code ec;
+
+		auto push = [&](const std::filesystem::directory_entry& entry) {
+			std::error_code file_ec;
+			if (!entry.is_regular_file(file_ec))
+				return;
+
+			source_file file;
+			file.path = entry.path();
+			file.file_size = entry.file_size(file_ec);
+			file.write_time = entry.last_write_time(file_ec);
+			file.source = index;
+
+			if (!file_ec)
+				queue.push(std::move(file));
+		};
+
+		if (source.recursive) {
+			for (std::filesystem::recursive_directory_iterator it(source.root,
+				std::filesystem::directory_options::skip_permission_denied, ec), end;
+				!ec && it != end && !queue.cancelled(); it.increment(ec))
+				push(*it);
+		}
+		else {
+			for (std::filesystem::directory_iterator it(source.root, ec), end;
+				!ec && it != end && !queue.cancelled(); it.increment(ec))
+				push(*it);
+		}
+
+		if (ec)
+			error = source.root + ": " + ec.message();
+	}
+}
+
+source_scan::source_scan(const std::vector<image_source>& sources, ingest_queue& queue) :
+	_sources(sources), _errors(sources.size()) {
+	// group the sources by volume, keeping their order within each volume
+	std::map<std::string, std::vector<size_t>> volumes;
+	for (size_t i = 0; i < sources.size(); i++)
+		volumes[volume_of(sources[i].root)].push_back(i);
+
+	queue.add_producers(volumes.size());
+
+	for (const auto& volume : volumes)
+		_threads.emplace_back([this, &queue, indices = volume.second]() {
+			for (const auto i : indices)
+				scan_source(_sources[i], i, queue, _errors[i]);
+
+			queue.producer_done();
+			});
+}
+
+source_scan::~source_scan() {
+	wait();
+}
+
+void source_scan::wait() {
+	for (auto& it : _threads)
+		if (it.joinable())
+			it.join();
+}
+
+size_t source_scan::scanners() const {
+	return _threads.size();
+}
+
+const std::vector<std::string>& source_scan::errors() const {
+	return _errors;
+}
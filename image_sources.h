@@ -0,0 +1,208 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+/// <summary>
+/// Where Windows keeps the Spotlight assets, relative to a user's local
+/// application data folder.
+/// </summary>
+constexpr const char* spotlight_assets_subfolder =
+	"Packages\\Microsoft.Windows.ContentDeliveryManager_cw5n1h2txyewy\\LocalState\\Assets";
+
+/// <summary>
+/// A folder to fetch images from.
+/// </summary>
+struct image_source {
+	std::string root;	// the full path to the folder
+	std::string label;	// e.g. the user profile, for display
+	bool recursive = false;	// whether to look in sub-folders too
+};
+
+/// <summary>
+/// Get the folder that holds the user profiles, e.g. C:\Users.
+/// </summary>
+/// 
+/// <returns>
+/// The full path to the folder, or an empty string if it cannot be determined.
+/// </returns>
+std::string profiles_folder();
+
+/// <summary>
+/// Get the Spotlight folder of every user profile that has one.
+/// </summary>
+/// 
+/// <param name="profiles">The folder that holds the user profiles, see profiles_folder().</param>
+/// 
+/// <returns>
+/// One source per profile, labelled with the profile's folder name.
+/// </returns>
+std::vector<image_source> profile_sources(const std::string& profiles);
+
+/// <summary>
+/// Parse a list of drop folders separated by semicolons.
+/// </summary>
+/// 
+/// <returns>
+/// One recursive source per folder, labelled with the folder's path.
+/// </returns>
+std::vector<image_source> parse_source_folders(const std::string& folders);
+
+/// <summary>
+/// Get the volume a path is on. Paths on the same volume return the same string.
+/// </summary>
+std::string volume_of(const std::string& path);
+
+/// <summary>
+/// A file found by a source scanner.
+/// </summary>
+struct source_file {
+	std::filesystem::path path;
+	unsigned long long file_size = 0;
+	std::filesystem::file_time_type write_time;
+	size_t source = 0;	// the index of the source it was found in
+};
+
+/// <summary>
+/// Queue from the source scanners to the ingest, which drops duplicates.
+/// </summary>
+/// 
+/// <remarks>
+/// A file is a duplicate if a file with the same library name, size and write
+/// time was already queued from any source: Spotlight names its assets after
+/// their content, and copies of a file keep its size and write time. The
+/// library name is the one library_lookup::file_name() gives, so an asset
+/// and a copy of it with .jpg added are the same image, while two different
+/// files that happen to share a name are both queued, and get different
+/// library names from library_lookup::unique_names(). All member functions
+/// are thread-safe.
+/// </remarks>
+class ingest_queue {
+public:
+	/// <summary>
+	/// Register producers before they start pushing.
+	/// </summary>
+	void add_producers(size_t count);
+
+	/// <summary>
+	/// Called by a producer when it has pushed everything.
+	/// </summary>
+	void producer_done();
+
+	/// <summary>
+	/// Queue a file.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// Returns false if the file is a duplicate of one already queued, or if the
+	/// queue was cancelled, else true.
+	/// </returns>
+	bool push(source_file file);
+
+	/// <summary>
+	/// Take the next file, waiting for one if the producers are still busy.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// Returns false once every producer is done and the queue is empty, else true.
+	/// </returns>
+	bool pop(source_file& file);
+
+	/// <summary>
+	/// Drop the queued files and stop the producers. pop() then returns false.
+	/// </summary>
+	void cancel();
+	bool cancelled() const;
+
+	/// <summary>
+	/// Get the number of duplicates dropped.
+	/// </summary>
+	size_t duplicates() const;
+
+private:
+	mutable std::mutex _mutex;
+	std::condition_variable _ready;
+	std::deque<source_file> _files;
+	std::set<std::tuple<std::filesystem::path::string_type, unsigned long long,
+		std::filesystem::file_time_type>> _queued;	// library name, size and write time
+	size_t _producers = 0;
+	size_t _duplicates = 0;
+	std::atomic<bool> _cancelled{ false };
+};
+
+/// <summary>
+/// Scans sources into an ingest queue, with one thread per volume.
+/// </summary>
+/// 
+/// <remarks>
+/// Sources on different volumes are listed concurrently. Sources on the same
+/// volume are listed one after the other by the same thread, so they don't
+/// compete for the same disk. The destructor waits for the scanners.
+/// </remarks>
+class source_scan {
+public:
+	/// <summary>
+	/// Start scanning.
+	/// </summary>
+	/// 
+	/// <param name="sources">The sources.</param>
+	/// <param name="queue">The queue, which must outlive the scan.</param>
+	source_scan(const std::vector<image_source>& sources, ingest_queue& queue);
+	~source_scan();
+
+	source_scan(const source_scan&) = delete;
+	source_scan& operator=(const source_scan&) = delete;
+
+	/// <summary>
+	/// Wait for every scanner to finish.
+	/// </summary>
+	void wait();
+
+	/// <summary>
+	/// Get the number of scanner threads.
+	/// </summary>
+	size_t scanners() const;
+
+	/// <summary>
+	/// Get the errors listing each source, empty for sources that were listed.
+	/// Only valid after wait().
+	/// </summary>
+	const std::vector<std::string>& errors() const;
+
+private:
+	std::vector<image_source> _sources;
+	std::vector<std::string> _errors;	// one per source, each written only by its scanner
+	std::vector<std::thread> _threads;
+};
@@ -0,0 +1,82 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "install_mode.h"
+
+// leccore
+#include <liblec/leccore/settings.h>
+#include <liblec/leccore/system.h>
+
+// STL
+#include <filesystem>
+
+using namespace liblec;
+
+install_mode get_install_mode() {
+	install_mode mode;
+
+	// check if application is installed
+	std::string error;
+	leccore::registry reg(leccore::registry::scope::current_user);
+	if (!reg.do_read("Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + std::string(install_guid_32) + "_is1",
+		"InstallLocation", mode.install_location_32, error)) {
+	}
+	if (!reg.do_read("Software\\Microsoft\\Windows\\CurrentVersion\\Uninstall\\" + std::string(install_guid_64) + "_is1",
+		"InstallLocation", mode.install_location_64, error)) {
+	}
+
+	mode.installed = !mode.install_location_32.empty() || !mode.install_location_64.empty();
+
+	auto portable_file_exists = []()->bool {
+		try {
+			std::filesystem::path path(".portable");
+			return std::filesystem::exists(path) && std::filesystem::is_regular_file(path);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	};
+
+	if (mode.installed) {
+		// check if app is running from the install location
+		try {
+			const auto current_path = std::filesystem::current_path().string() + "\\";
+
+			if (current_path != mode.install_location_32 &&
+				current_path != mode.install_location_64) {
+				if (portable_file_exists()) {
+					mode.real_portable_mode = true;
+					mode.installed = false;	// run in portable mode
+				}
+			}
+		}
+		catch (const std::exception&) {}
+	}
+	else {
+		if (portable_file_exists())
+			mode.real_portable_mode = true;
+	}
+
+	return mode;
+}
@@ -0,0 +1,61 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+
+/// <summary>
+/// Where the app keeps its settings, as decided at startup.
+/// </summary>
+/// 
+/// <remarks>
+/// 1. If the app is installed and running from an install directory it is installed.
+/// 2. If it is installed and not running from an install directory it is also
+/// installed, unless there is a .portable file in the current directory.
+/// 3. If it is not installed then portable mode is used whether or not a .portable
+/// file exists in the current directory.
+/// Installed apps keep their settings in the registry, portable ones in
+/// spotlight_images.ini and their library in the current directory.
+/// </remarks>
+struct install_mode {
+	bool installed = false;
+	bool real_portable_mode = false;	// a .portable file was found
+	std::string install_location_32, install_location_64;
+};
+
+/// <summary>
+/// The setup's uninstall keys, under Software\Microsoft\Windows\CurrentVersion\Uninstall.
+/// </summary>
+constexpr const char* install_guid_32 = "{3FA54748-169E-4B63-9871-1D3367545A9A}";
+constexpr const char* install_guid_64 = "{7BC77A87-2034-4483-94A8-2774D1A3C494}";
+
+/// <summary>
+/// Check whether the app is installed or running in portable mode.
+/// </summary>
+/// 
+/// <returns>
+/// The install mode.
+/// </returns>
+install_mode get_install_mode();
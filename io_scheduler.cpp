@@ -0,0 +1,293 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "io_scheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	/// <summary>
+	/// Read the processor time since boot, busy and in total, in any unit.
+	/// </summary>
+	/// 
+	/// <param name="busy">
+	/// The time busy with other processes. This process's own time is left
+	/// out, so that a fetch doesn't pause because of its own work.
+	/// </param>
+	bool processor_times(unsigned long long& busy, unsigned long long& total) {
+#ifdef _WIN32
+		FILETIME idle_time, kernel_time, user_time;
+		if (!GetSystemTimes(&idle_time, &kernel_time, &user_time))
+			return false;
+
+		auto ticks = [](const FILETIME& time) {
+			return static_cast<unsigned long long>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+		};
+
+		// kernel time includes idle time
+		total = ticks(kernel_time) + ticks(user_time);
+		busy = total - ticks(idle_time);
+
+		// in the same unit, 100 ns, summed over all processors
+		FILETIME creation, exit, process_kernel, process_user;
+		if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &process_kernel, &process_user))
+			busy -= (std::min)(busy, ticks(process_kernel) + ticks(process_user));
+
+		return true;
+#else
+		std::ifstream stat("/proc/stat");
+		std::string cpu;
+		unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+
+		if (!(stat >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal) || cpu != "cpu")
+			return false;
+
+		total = user + nice + system + idle + iowait + irq + softirq + steal;
+		busy = total - idle - iowait;
+
+		// utime and stime are the 14th and 15th fields, in the same clock ticks;
+		// the name in the 2nd can contain spaces, so counting starts after it
+		std::string line;
+		std::getline(std::ifstream("/proc/self/stat"), line);
+		const auto name_end = line.rfind(')');
+
+		if (name_end != std::string::npos) {
+			std::istringstream fields(line.substr(name_end + 1));
+			std::string skipped;
+			unsigned long long process_user = 0, process_system = 0;
+
+			for (int field = 3; field < 14; field++)
+				fields >> skipped;
+
+			if (fields >> process_user >> process_system)
+				busy -= (std::min)(busy, process_user + process_system);
+		}
+
+		return true;
+#endif
+	}
+
+	bool on_battery() {
+#ifdef _WIN32
+		SYSTEM_POWER_STATUS status;
+		return GetSystemPowerStatus(&status) && status.ACLineStatus == 0;
+#else
+		// on battery if there is a mains supply and none of them is online
+		bool mains = false;
+		std::error_code ec;
+
+		for (std::filesystem::directory_iterator it("/sys/class/power_supply", ec), end;
+			!ec && it != end; it.increment(ec)) {
+			std::string type, online;
+			std::ifstream(it->path() / "type") >> type;
+
+			if (type != "Mains")
+				continue;
+
+			mains = true;
+			std::ifstream(it->path() / "online") >> online;
+
+			if (online == "1")
+				return false;
+		}
+
+		return mains;
+#endif
+	}
+
+	// the priority of the innermost io_priority_scope on each thread
+	thread_local io_priority thread_io_priority = io_priority::normal;
+
+#ifdef __linux__
+	constexpr int ioprio_who_process = 1;
+	constexpr int ioprio_class_shift = 13;
+	constexpr int ioprio_class_best_effort = 2;
+	constexpr int ioprio_class_idle = 3;
+#endif
+}
+
+bool parse_io_priority(const std::string& name, io_priority& priority) {
+	if (name == "normal")
+		priority = io_priority::normal;
+	else if (name == "low")
+		priority = io_priority::low;
+	else if (name == "background")
+		priority = io_priority::background;
+	else
+		return false;
+
+	return true;
+}
+
+io_priority_scope::io_priority_scope(io_priority priority) :
+	_priority(priority),
+	_outer(thread_io_priority) {
+	thread_io_priority = _priority;
+
+#ifdef _WIN32
+	// fails if the thread is already in background mode, in which case the
+	// outer scope ends it
+	if (_priority == io_priority::background)
+		_previous = SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) ? 1 : 0;
+#elif defined(__linux__)
+	if (_priority != io_priority::normal) {
+		_previous = static_cast<int>(syscall(SYS_ioprio_get, ioprio_who_process, 0));
+
+		const int value = _priority == io_priority::background ?
+			ioprio_class_idle << ioprio_class_shift :
+			ioprio_class_best_effort << ioprio_class_shift | 7;
+
+		if (syscall(SYS_ioprio_set, ioprio_who_process, 0, value) != 0)
+			_previous = -1;
+	}
+#endif
+}
+
+io_priority_scope::~io_priority_scope() {
+#ifdef _WIN32
+	if (_priority == io_priority::background && _previous)
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+#elif defined(__linux__)
+	if (_priority != io_priority::normal && _previous >= 0)
+		syscall(SYS_ioprio_set, ioprio_who_process, 0, _previous);
+#endif
+
+	thread_io_priority = _outer;
+}
+
+io_priority current_io_priority() {
+	return thread_io_priority;
+}
+
+#ifdef _WIN32
+void set_io_priority_hint(void* file) {
+	if (thread_io_priority == io_priority::normal)
+		return;
+
+	FILE_IO_PRIORITY_HINT_INFO hint;
+	hint.PriorityHint = thread_io_priority == io_priority::background ? IoPriorityHintVeryLow : IoPriorityHintLow;
+	SetFileInformationByHandle(file, FileIoPriorityHintInfo, &hint, sizeof(hint));
+}
+#endif
+
+io_scheduler::io_scheduler(const io_limits& limits) :
+	_limits(limits),
+	_tokens(static_cast<double>(limits.bytes_per_second)),
+	_refilled(clock::now()) {}
+
+const io_limits& io_scheduler::limits() const {
+	return _limits;
+}
+
+bool io_scheduler::paused() {
+	if (!_limits.pause_on_battery && !_limits.pause_above_load)
+		return false;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto now = clock::now();
+	if (_total_before && now - _checked < std::chrono::seconds(1))
+		return _paused;
+
+	_checked = now;
+	_paused = _limits.pause_on_battery && on_battery();
+
+	// the load over the time since the last sample
+	unsigned long long busy = 0, total = 0;
+	if (_limits.pause_above_load && processor_times(busy, total)) {
+		if (_total_before && total > _total_before) {
+			// another process's time ending can make the time left over shrink
+			const auto load = 100 * (busy > _busy_before ? busy - _busy_before : 0) / (total - _total_before);
+			_paused = _paused || load > _limits.pause_above_load;
+		}
+
+		_busy_before = busy;
+		_total_before = total;
+	}
+
+	return _paused;
+}
+
+bool io_scheduler::acquire(unsigned long long bytes, const fetch_job* job) {
+	auto stopped = [job]() {
+		return job && job->stop_requested();
+	};
+
+	const auto start = clock::now();
+	bool go = true;
+
+	while (go && paused()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		go = !stopped();
+	}
+
+	// take the bytes from the bucket, then wait off any debt
+	auto deadline = clock::now();
+
+	if (go && _limits.bytes_per_second) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		const auto now = clock::now();
+		const double rate = static_cast<double>(_limits.bytes_per_second);
+		const double elapsed = std::chrono::duration<double>(now - _refilled).count();
+
+		_tokens = (std::min)(rate, _tokens + elapsed * rate) - static_cast<double>(bytes);
+		_refilled = now;
+
+		if (_tokens < 0.)
+			deadline = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-_tokens / rate));
+	}
+
+	for (auto now = clock::now(); go && now < deadline; now = clock::now()) {
+		std::this_thread::sleep_for((std::min)(deadline - now, clock::duration(std::chrono::milliseconds(100))));
+		go = !stopped();
+	}
+
+	const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+	if (waited > 0) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_waited_ms += static_cast<unsigned long long>(waited);
+	}
+
+	return go && !stopped();
+}
+
+unsigned long long io_scheduler::waited_ms() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _waited_ms;
+}
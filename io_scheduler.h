@@ -0,0 +1,166 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "fetch_job.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+/// <summary>
+/// How much of the disk (and processor) file work may take from other programs.
+/// </summary>
+enum class io_priority : std::uint8_t {
+	normal = 0,
+	low,		// low I/O priority hint on the files copied
+	background,	// background mode: very low I/O and memory priority
+};
+
+/// <summary>
+/// Limits on file work.
+/// </summary>
+struct io_limits {
+	io_priority priority = io_priority::normal;
+	unsigned long long bytes_per_second = 0;	// 0 for no cap
+	bool pause_on_battery = false;
+	unsigned int pause_above_load = 0;	// pause while the processor is busier than this percentage, 0 to never pause
+};
+
+/// <summary>
+/// Parse a priority name: normal, low or background.
+/// </summary>
+/// 
+/// <returns>
+/// Returns false if the name is not a priority, else true.
+/// </returns>
+bool parse_io_priority(const std::string& name, io_priority& priority);
+
+/// <summary>
+/// Run the current thread at an I/O priority for the lifetime of the object.
+/// </summary>
+/// 
+/// <remarks>
+/// On Windows, background uses THREAD_MODE_BACKGROUND_BEGIN, which lowers the
+/// thread's I/O and memory priority. Windows has no thread I/O priority short
+/// of that, so low is applied to each file the copies open instead, with
+/// set_io_priority_hint(). On Linux the thread's I/O class is set to idle or
+/// to the lowest best effort level.
+/// </remarks>
+class io_priority_scope {
+public:
+	explicit io_priority_scope(io_priority priority);
+	~io_priority_scope();
+
+	io_priority_scope(const io_priority_scope&) = delete;
+	io_priority_scope& operator=(const io_priority_scope&) = delete;
+
+private:
+	io_priority _priority;
+	io_priority _outer;
+	int _previous = 0;
+};
+
+/// <summary>
+/// Get the priority of the innermost io_priority_scope on the current thread.
+/// </summary>
+/// 
+/// <returns>
+/// The priority, or normal outside of any scope.
+/// </returns>
+io_priority current_io_priority();
+
+#ifdef _WIN32
+/// <summary>
+/// Give a file the I/O priority hint of the current thread's priority: low
+/// for low, very low for background. Does nothing at normal priority.
+/// </summary>
+/// 
+/// <param name="file">The file's HANDLE.</param>
+void set_io_priority_hint(void* file);
+#endif
+
+/// <summary>
+/// Paces file work: copies, deletes, image decodes and encodes.
+/// </summary>
+/// 
+/// <remarks>
+/// Work asks for its bytes with acquire() before doing them. The bandwidth
+/// cap is a token bucket holding up to one second of bytes: a request takes
+/// its bytes from the bucket, going into debt if it has to, and then waits
+/// until the debt is paid back at the capped rate. Requests also wait while
+/// the system is on battery or busy, if the limits say so; the system state
+/// is sampled at most once a second. Waits are done in short slices so that
+/// a stop request is noticed quickly. All member functions are thread-safe.
+/// </remarks>
+class io_scheduler {
+public:
+	explicit io_scheduler(const io_limits& limits = io_limits());
+
+	const io_limits& limits() const;
+
+	/// <summary>
+	/// Wait until work on a number of bytes may go ahead.
+	/// </summary>
+	/// 
+	/// <param name="bytes">The bytes about to be read or written.</param>
+	/// <param name="job">The fetch the work is part of, for stop requests. Can be null.</param>
+	/// 
+	/// <returns>
+	/// Returns false if the job was asked to stop while waiting, else true.
+	/// </returns>
+	bool acquire(unsigned long long bytes, const fetch_job* job = nullptr);
+
+	/// <summary>
+	/// Check whether work is paused because of the battery or the system load.
+	/// </summary>
+	bool paused();
+
+	/// <summary>
+	/// Get the total time spent waiting in acquire(), in milliseconds.
+	/// </summary>
+	unsigned long long waited_ms() const;
+
+	/// <summary>
+	/// The nominal cost, in bytes, of an operation that moves no data, such as
+	/// deleting a file.
+	/// </summary>
+	static constexpr unsigned long long metadata_cost = 64 * 1024;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	const io_limits _limits;
+
+	mutable std::mutex _mutex;
+	double _tokens = 0.;
+	clock::time_point _refilled;
+	clock::time_point _checked;
+	bool _paused = false;
+	unsigned long long _busy_before = 0;
+	unsigned long long _total_before = 0;
+	unsigned long long _waited_ms = 0;
+};
@@ -0,0 +1,1033 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "jpeg_optimizer.h"
+#include "aspect_buckets.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+	constexpr std::uint8_t marker_soi = 0xD8;
+	constexpr std::uint8_t marker_eoi = 0xD9;
+	constexpr std::uint8_t marker_sos = 0xDA;
+	constexpr std::uint8_t marker_dht = 0xC4;
+	constexpr std::uint8_t marker_dri = 0xDD;
+	constexpr std::uint8_t marker_dnl = 0xDC;
+	constexpr std::uint8_t marker_com = 0xFE;
+	constexpr std::uint8_t marker_rst0 = 0xD0;
+
+	// codes up to this many bits are decoded with a single table lookup
+	constexpr int lookup_bits = 9;
+
+	/// <summary>
+	/// A Huffman table as defined by a DHT segment, with what it takes to
+	/// decode it.
+	/// </summary>
+	struct huffman_table {
+		bool defined = false;
+		std::array<std::uint8_t, 17> counts{};	// number of codes of each length, from 1 to 16
+		std::array<std::uint8_t, 256> values{};
+		std::array<int, 18> max_code{};
+		std::array<int, 17> min_code{};
+		std::array<int, 17> value_index{};
+		std::array<std::uint16_t, 1 << lookup_bits> lookup{};	// length << 8 | value, 0 for longer codes
+	};
+
+	/// <summary>
+	/// Build the decoding tables of a Huffman table from its counts and values.
+	/// </summary>
+	bool build_decoder(huffman_table& table) {
+		int code = 0, index = 0;
+		table.lookup.fill(0);
+
+		for (int length = 1; length <= 16; length++) {
+			const int count = table.counts[length];
+			table.value_index[length] = index;
+			table.min_code[length] = code;
+
+			for (int i = 0; i < count; i++, code++, index++) {
+				if (length <= lookup_bits) {
+					const int shift = lookup_bits - length;
+					for (int fill = 0; fill < (1 << shift); fill++)
+						table.lookup[(code << shift) | fill] =
+						static_cast<std::uint16_t>(length << 8 | table.values[index]);
+				}
+			}
+
+			table.max_code[length] = count ? code - 1 : -1;
+
+			// the codes of a length must fit in that many bits
+			if (code > (1 << length))
+				return false;
+
+			code <<= 1;
+		}
+
+		table.max_code[17] = 0x7FFFFFFF;
+		table.defined = true;
+		return true;
+	}
+
+	/// <summary>
+	/// One Huffman coded symbol and the extra bits that follow it, or a restart
+	/// marker.
+	/// </summary>
+	struct coded_symbol {
+		std::uint8_t table;		// DC tables 0 to 3, AC tables 4 to 7, or restart_mark
+		std::uint8_t symbol;	// the restart marker's number for restart_mark
+		std::uint16_t bits;		// the extra bits, as many as the symbol's size
+
+		bool operator==(const coded_symbol& other) const {
+			return table == other.table && symbol == other.symbol && bits == other.bits;
+		}
+	};
+
+	constexpr std::uint8_t restart_mark = 0xFF;
+
+	int extra_bit_count(const coded_symbol& symbol) {
+		// DC symbols are sizes, AC symbols are a run and a size
+		return symbol.table < 4 ? symbol.symbol : symbol.symbol & 0x0F;
+	}
+
+	/// <summary>
+	/// Reads the entropy coded data of a scan, removing stuffed zero bytes.
+	/// </summary>
+	class bit_reader {
+	public:
+		bit_reader(const std::uint8_t* data, size_t size, size_t position) :
+			_data(data), _size(size), _position(position) {}
+
+		/// <summary>
+		/// Get the next n bits, n from 0 to 16.
+		/// </summary>
+		std::uint32_t get(int n) {
+			if (n == 0)
+				return 0;
+
+			if (_count < n)
+				fill();
+
+			const auto value = static_cast<std::uint32_t>(_buffer >> (64 - n));
+			_buffer <<= n;
+			_count -= n;
+			return value;
+		}
+
+		/// <summary>
+		/// Decode a symbol, or return -1 if the bits are not a code of the table.
+		/// </summary>
+		int decode(const huffman_table& table) {
+			if (_count < 16)
+				fill();
+
+			const auto entry = table.lookup[static_cast<size_t>(_buffer >> (64 - lookup_bits))];
+			if (entry) {
+				const int length = entry >> 8;
+				_buffer <<= length;
+				_count -= length;
+				return entry & 0xFF;
+			}
+
+			for (int length = lookup_bits + 1; length <= 16; length++) {
+				const int code = static_cast<int>(_buffer >> (64 - length));
+
+				if (code <= table.max_code[length]) {
+					_buffer <<= length;
+					_count -= length;
+					return table.values[static_cast<size_t>(table.value_index[length] + code - table.min_code[length])];
+				}
+			}
+
+			return -1;
+		}
+
+		/// <summary>
+		/// Whether bits past the end of the data were used, which only happens
+		/// with damaged files.
+		/// </summary>
+		bool overrun() const {
+			return _count < _padding * 8;
+		}
+
+		/// <summary>
+		/// Skip the restart marker that should follow, discarding the padding bits.
+		/// </summary>
+		bool restart(int number) {
+			if (overrun() || _position + 1 >= _size ||
+				_data[_position] != 0xFF || _data[_position + 1] != marker_rst0 + number)
+				return false;
+
+			_position += 2;
+			_buffer = 0;
+			_count = 0;
+			_padding = 0;
+			return true;
+		}
+
+		/// <summary>
+		/// The position of the first byte that was not read.
+		/// </summary>
+		size_t position() const {
+			return _position;
+		}
+
+	private:
+		void fill() {
+			while (_count <= 56) {
+				std::uint8_t byte = 0;
+
+				// stop at markers, feeding zeros instead
+				if (_position < _size && _data[_position] != 0xFF) {
+					byte = _data[_position++];
+				}
+				else if (_position + 1 < _size && _data[_position + 1] == 0x00) {
+					byte = 0xFF;
+					_position += 2;
+				}
+				else if (_padding <= 8)
+					_padding++;	// the buffer holds 8 bytes, so 9 always means an overrun
+
+				_buffer |= static_cast<std::uint64_t>(byte) << (56 - _count);
+				_count += 8;
+			}
+		}
+
+		const std::uint8_t* _data;
+		size_t _size;
+		size_t _position;
+		std::uint64_t _buffer = 0;
+		int _count = 0;
+		int _padding = 0;
+	};
+
+	/// <summary>
+	/// Writes entropy coded data, stuffing a zero byte after each 0xFF.
+	/// </summary>
+	class bit_writer {
+	public:
+		explicit bit_writer(std::string& output) : _output(output) {}
+
+		void put(std::uint32_t value, int n) {
+			_buffer = (_buffer << n) | (value & ((1u << n) - 1));
+			_count += n;
+
+			while (_count >= 8) {
+				const auto byte = static_cast<char>((_buffer >> (_count - 8)) & 0xFF);
+				_output.push_back(byte);
+				if (byte == static_cast<char>(0xFF))
+					_output.push_back(0);
+
+				_count -= 8;
+			}
+		}
+
+		/// <summary>
+		/// Pad the last byte with ones.
+		/// </summary>
+		void flush() {
+			if (_count)
+				put(0x7F, 8 - _count);
+		}
+
+	private:
+		std::string& _output;
+		std::uint64_t _buffer = 0;
+		int _count = 0;
+	};
+
+	struct frame_component {
+		std::uint8_t id = 0;
+		int h = 1;
+		int v = 1;
+	};
+
+	/// <summary>
+	/// A marker segment, or a scan with its header and decoded symbols.
+	/// </summary>
+	struct jpeg_item {
+		std::uint8_t marker = 0;
+		const std::uint8_t* payload = nullptr;	// after the length
+		size_t length = 0;	// of the payload
+		std::vector<coded_symbol> symbols;	// scans only
+	};
+
+	std::uint16_t read_u16(const std::uint8_t* p) {
+		return static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+	}
+
+	bool unsupported_frame(std::uint8_t marker) {
+		// everything but baseline and extended sequential Huffman coding
+		return marker >= 0xC2 && marker <= 0xCF && marker != marker_dht && marker != 0xCC;
+	}
+
+	/// <summary>
+	/// Decode the symbols of a scan.
+	/// </summary>
+	bool decode_scan(const std::uint8_t* data, size_t size, size_t& position,
+		const jpeg_item& header,
+		const std::vector<frame_component>& components,
+		unsigned int width, unsigned int height,
+		unsigned int restart_interval,
+		const std::array<huffman_table, 8>& tables,
+		std::vector<coded_symbol>& symbols,
+		std::string& error) {
+		error = "Invalid scan";
+
+		if (header.length < 1)
+			return false;
+
+		const int count = header.payload[0];
+		if (count < 1 || count > 4 || header.length != static_cast<size_t>(4 + 2 * count))
+			return false;
+
+		struct scan_component {
+			int h, v, dc, ac;
+			unsigned int blocks_wide, blocks_high;
+		};
+
+		int h_max = 1, v_max = 1;
+		for (const auto& it : components) {
+			h_max = (std::max)(h_max, it.h);
+			v_max = (std::max)(v_max, it.v);
+		}
+
+		std::vector<scan_component> scan;
+		for (int i = 0; i < count; i++) {
+			const auto id = header.payload[1 + i * 2];
+			const auto selectors = header.payload[2 + i * 2];
+
+			const auto it = std::find_if(components.begin(), components.end(),
+				[id](const frame_component& c) { return c.id == id; });
+
+			if (it == components.end() || (selectors >> 4) > 3 || (selectors & 0x0F) > 3)
+				return false;
+
+			scan_component component;
+			component.h = it->h;
+			component.v = it->v;
+			component.dc = selectors >> 4;
+			component.ac = 4 + (selectors & 0x0F);
+
+			// the component's own size in blocks, used when it is alone in the scan
+			const unsigned int component_width = (width * it->h + h_max - 1) / h_max;
+			const unsigned int component_height = (height * it->v + v_max - 1) / v_max;
+			component.blocks_wide = (component_width + 7) / 8;
+			component.blocks_high = (component_height + 7) / 8;
+
+			if (!tables[component.dc].defined || !tables[component.ac].defined) {
+				error = "Missing Huffman table";
+				return false;
+			}
+
+			scan.push_back(component);
+		}
+
+		// only sequential scans: spectral selection 0 to 63, no approximation
+		const auto* tail = header.payload + 1 + count * 2;
+		if (tail[0] != 0 || tail[1] != 63 || tail[2] != 0) {
+			error = "Unsupported scan";
+			return false;
+		}
+
+		size_t mcus = 0;
+		if (count == 1) {
+			mcus = static_cast<size_t>(scan[0].blocks_wide) * scan[0].blocks_high;
+			scan[0].h = scan[0].v = 1;
+		}
+		else
+			mcus = static_cast<size_t>((width + 8 * h_max - 1) / (8 * h_max)) *
+			((height + 8 * v_max - 1) / (8 * v_max));
+
+		bit_reader reader(data, size, position);
+
+		// every symbol takes at least one bit, and overruns are caught after each
+		// MCU, which has at most 10 blocks of 64 symbols and an end of block
+		const size_t max_symbols = 8 * (size - position) + 10 * 65;
+
+		auto decode_block = [&](const scan_component& component) {
+			if (symbols.size() + 65 > max_symbols)
+				return false;
+
+			const int dc_size = reader.decode(tables[component.dc]);
+			if (dc_size < 0 || dc_size > 15)
+				return false;
+
+			symbols.push_back({ static_cast<std::uint8_t>(component.dc), static_cast<std::uint8_t>(dc_size),
+				static_cast<std::uint16_t>(reader.get(dc_size)) });
+
+			for (int k = 1; k < 64;) {
+				const int run_size = reader.decode(tables[component.ac]);
+				if (run_size < 0)
+					return false;
+
+				const int run = run_size >> 4, ac_size = run_size & 0x0F;
+
+				if (ac_size == 0) {
+					symbols.push_back({ static_cast<std::uint8_t>(component.ac), static_cast<std::uint8_t>(run_size), 0 });
+
+					if (run != 15)
+						break;	// end of block
+
+					k += 16;
+					if (k > 64)
+						return false;
+				}
+				else {
+					k += run;
+					if (k > 63)
+						return false;
+
+					symbols.push_back({ static_cast<std::uint8_t>(component.ac), static_cast<std::uint8_t>(run_size),
+						static_cast<std::uint16_t>(reader.get(ac_size)) });
+					k++;
+				}
+			}
+
+			return true;
+		};
+
+		int next_restart = 0;
+		for (size_t mcu = 0; mcu < mcus; mcu++) {
+			if (restart_interval && mcu && mcu % restart_interval == 0) {
+				if (!reader.restart(next_restart))
+					return false;
+
+				symbols.push_back({ restart_mark, static_cast<std::uint8_t>(next_restart), 0 });
+				next_restart = (next_restart + 1) % 8;
+			}
+
+			for (const auto& component : scan)
+				for (int block = 0; block < component.h * component.v; block++)
+					if (!decode_block(component))
+						return false;
+
+			// stop at the first MCU that reads past the data, rather than decoding
+			// the padding of a file that claims far more MCUs than it has
+			if (reader.overrun()) {
+				error = "Truncated scan";
+				return false;
+			}
+		}
+
+		position = reader.position();
+		error.clear();
+		return true;
+	}
+
+	/// <summary>
+	/// Split a JPEG file into its segments and decode its scans.
+	/// </summary>
+	bool parse_jpeg(const std::string& input, std::vector<jpeg_item>& items, std::string& error) {
+		const auto* data = reinterpret_cast<const std::uint8_t*>(input.data());
+		const size_t size = input.size();
+
+		if (size < 4 || data[0] != 0xFF || data[1] != marker_soi) {
+			error = "Not a JPEG file";
+			return false;
+		}
+
+		std::array<huffman_table, 8> tables;
+		std::vector<frame_component> components;
+		unsigned int width = 0, height = 0, restart_interval = 0;
+		bool has_frame = false;
+
+		size_t position = 2;
+		for (;;) {
+			// skip anything up to the next marker, including fill bytes
+			while (position + 1 < size && (data[position] != 0xFF ||
+				data[position + 1] == 0xFF || data[position + 1] == 0x00))
+				position++;
+
+			if (position + 1 >= size) {
+				error = "Missing end of image";
+				return false;
+			}
+
+			const std::uint8_t marker = data[position + 1];
+			position += 2;
+
+			if (marker == marker_eoi)
+				break;
+
+			if ((marker >= marker_rst0 && marker <= marker_rst0 + 7) || marker == 0x01 || marker == marker_soi)
+				continue;
+
+			if (position + 2 > size) {
+				error = "Truncated segment";
+				return false;
+			}
+
+			const size_t length = read_u16(data + position);
+			if (length < 2 || position + length > size) {
+				error = "Truncated segment";
+				return false;
+			}
+
+			jpeg_item item;
+			item.marker = marker;
+			item.payload = data + position + 2;
+			item.length = length - 2;
+			position += length;
+
+			if (unsupported_frame(marker) || marker == marker_dnl) {
+				error = "Only baseline and sequential Huffman coded files are supported";
+				return false;
+			}
+
+			if (marker == 0xC0 || marker == 0xC1) {
+				if (has_frame || item.length < 6) {
+					error = "Invalid frame";
+					return false;
+				}
+
+				height = read_u16(item.payload + 1);
+				width = read_u16(item.payload + 3);
+				const int count = item.payload[5];
+
+				if (width == 0 || height == 0 || count < 1 || item.length != static_cast<size_t>(6 + count * 3)) {
+					error = "Invalid frame";
+					return false;
+				}
+
+				for (int i = 0; i < count; i++) {
+					frame_component component;
+					component.id = item.payload[6 + i * 3];
+					component.h = item.payload[7 + i * 3] >> 4;
+					component.v = item.payload[7 + i * 3] & 0x0F;
+
+					if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) {
+						error = "Invalid frame";
+						return false;
+					}
+
+					components.push_back(component);
+				}
+
+				has_frame = true;
+			}
+			else if (marker == marker_dht) {
+				size_t offset = 0;
+				while (offset < item.length) {
+					if (offset + 17 > item.length) {
+						error = "Invalid Huffman table";
+						return false;
+					}
+
+					const auto kind = item.payload[offset];
+					if ((kind >> 4) > 1 || (kind & 0x0F) > 3) {
+						error = "Invalid Huffman table";
+						return false;
+					}
+
+					auto& table = tables[(kind >> 4) * 4 + (kind & 0x0F)];
+					size_t total = 0;
+					for (int length = 1; length <= 16; length++) {
+						table.counts[length] = item.payload[offset + length];
+						total += table.counts[length];
+					}
+
+					if (total > 256 || offset + 17 + total > item.length) {
+						error = "Invalid Huffman table";
+						return false;
+					}
+
+					std::memcpy(table.values.data(), item.payload + offset + 17, total);
+					if (!build_decoder(table)) {
+						error = "Invalid Huffman table";
+						return false;
+					}
+
+					offset += 17 + total;
+				}
+			}
+			else if (marker == marker_dri) {
+				if (item.length != 2) {
+					error = "Invalid restart interval";
+					return false;
+				}
+
+				restart_interval = read_u16(item.payload);
+			}
+			else if (marker == marker_sos) {
+				if (!has_frame) {
+					error = "Scan before frame";
+					return false;
+				}
+
+				if (!decode_scan(data, size, position, item, components, width, height,
+					restart_interval, tables, item.symbols, error))
+					return false;
+			}
+
+			items.push_back(std::move(item));
+		}
+
+		if (!has_frame) {
+			error = "Missing frame";
+			return false;
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Check whether an Exif segment rotates or mirrors the image.
+	/// </summary>
+	bool exif_orients_image(const std::uint8_t* payload, size_t length) {
+		if (length < 14 || std::memcmp(payload, "Exif\0\0", 6) != 0)
+			return false;
+
+		const auto* tiff = payload + 6;
+		const size_t tiff_length = length - 6;
+		const bool little = tiff[0] == 'I' && tiff[1] == 'I';
+		if (!little && !(tiff[0] == 'M' && tiff[1] == 'M'))
+			return false;
+
+		auto u16 = [&](size_t offset) -> unsigned int {
+			return little ? tiff[offset] | tiff[offset + 1] << 8 : tiff[offset] << 8 | tiff[offset + 1];
+		};
+
+		const size_t ifd = little ?
+			(tiff[4] | tiff[5] << 8 | tiff[6] << 16 | static_cast<size_t>(tiff[7]) << 24) :
+			(static_cast<size_t>(tiff[4]) << 24 | tiff[5] << 16 | tiff[6] << 8 | tiff[7]);
+
+		if (ifd + 2 > tiff_length)
+			return false;
+
+		const unsigned int entries = u16(ifd);
+		for (unsigned int i = 0; i < entries; i++) {
+			const size_t entry = ifd + 2 + i * 12;
+			if (entry + 12 > tiff_length)
+				break;
+
+			// orientation, a short that is 1 for images displayed as stored
+			if (u16(entry) == 0x0112)
+				return u16(entry + 8) != 1;
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Whether a segment has to be kept when stripping metadata.
+	/// </summary>
+	bool keep_segment(const jpeg_item& item) {
+		auto starts_with = [&item](const char* prefix, size_t length) {
+			return item.length >= length && std::memcmp(item.payload, prefix, length) == 0;
+		};
+
+		switch (item.marker) {
+		case 0xE0:
+			return starts_with("JFIF\0", 5);
+		case 0xE1:
+			return exif_orients_image(item.payload, item.length);
+		case 0xE2:
+			return starts_with("ICC_PROFILE\0", 12);
+		case 0xEE:
+			// the Adobe segment says how the colours were transformed
+			return starts_with("Adobe", 5);
+		case marker_com:
+			return false;
+		default:
+			return item.marker < 0xE0 || item.marker > 0xEF;
+		}
+	}
+
+	/// <summary>
+	/// Build a Huffman table with the shortest codes for the frequencies, no
+	/// longer than 16 bits, as described in Annex K.2 of the JPEG standard.
+	/// </summary>
+	void optimal_table(const std::array<std::uint64_t, 256>& frequencies,
+		std::array<std::uint8_t, 17>& counts,
+		std::vector<std::uint8_t>& values) {
+		std::array<std::uint64_t, 257> frequency{};
+		std::array<int, 257> code_size{};
+		std::array<int, 257> others;
+		others.fill(-1);
+
+		std::copy(frequencies.begin(), frequencies.end(), frequency.begin());
+
+		// a reserved symbol ensures no code is all ones
+		frequency[256] = 1;
+
+		for (;;) {
+			// the two least frequent trees, preferring the higher symbol on ties
+			int c1 = -1, c2 = -1;
+			std::uint64_t v1 = UINT64_MAX, v2 = UINT64_MAX;
+
+			for (int i = 0; i <= 256; i++)
+				if (frequency[i] && frequency[i] <= v1) {
+					v1 = frequency[i];
+					c1 = i;
+				}
+
+			for (int i = 0; i <= 256; i++)
+				if (frequency[i] && frequency[i] <= v2 && i != c1) {
+					v2 = frequency[i];
+					c2 = i;
+				}
+
+			if (c2 < 0)
+				break;
+
+			frequency[c1] += frequency[c2];
+			frequency[c2] = 0;
+
+			code_size[c1]++;
+			while (others[c1] >= 0) {
+				c1 = others[c1];
+				code_size[c1]++;
+			}
+
+			others[c1] = c2;
+
+			code_size[c2]++;
+			while (others[c2] >= 0) {
+				c2 = others[c2];
+				code_size[c2]++;
+			}
+		}
+
+		std::array<int, 258> bits{};
+		for (int i = 0; i <= 256; i++)
+			if (code_size[i])
+				bits[static_cast<size_t>(code_size[i])]++;
+
+		// move codes longer than 16 bits up the tree
+		for (int i = 257; i > 16; i--)
+			while (bits[i] > 0) {
+				int j = i - 2;
+				while (bits[j] == 0)
+					j--;
+
+				bits[i] -= 2;
+				bits[i - 1]++;
+				bits[j + 1] += 2;
+				bits[j]--;
+			}
+
+		// drop the reserved symbol's code, which is one of the longest
+		int longest = 16;
+		while (bits[longest] == 0)
+			longest--;
+		bits[longest]--;
+
+		counts.fill(0);
+		for (int i = 1; i <= 16; i++)
+			counts[i] = static_cast<std::uint8_t>(bits[i]);
+
+		values.clear();
+		for (int size = 1; size <= 256; size++)
+			for (int symbol = 0; symbol < 256; symbol++)
+				if (code_size[symbol] == size)
+					values.push_back(static_cast<std::uint8_t>(symbol));
+	}
+
+	void put_u16(std::string& output, size_t value) {
+		output.push_back(static_cast<char>((value >> 8) & 0xFF));
+		output.push_back(static_cast<char>(value & 0xFF));
+	}
+
+	void put_segment(std::string& output, const jpeg_item& item) {
+		output.push_back(static_cast<char>(0xFF));
+		output.push_back(static_cast<char>(item.marker));
+		put_u16(output, item.length + 2);
+		output.append(reinterpret_cast<const char*>(item.payload), item.length);
+	}
+
+	/// <summary>
+	/// Write a scan preceded by the optimal Huffman tables for its symbols.
+	/// </summary>
+	void put_scan(std::string& output, const jpeg_item& scan) {
+		std::array<std::array<std::uint64_t, 256>, 8> frequencies{};
+		std::array<bool, 8> used{};
+
+		for (const auto& it : scan.symbols)
+			if (it.table != restart_mark) {
+				frequencies[it.table][it.symbol]++;
+				used[it.table] = true;
+			}
+
+		std::string tables;
+		std::array<std::array<std::uint32_t, 256>, 8> codes{};
+		std::array<std::array<std::uint8_t, 256>, 8> sizes{};
+
+		for (size_t table = 0; table < 8; table++) {
+			if (!used[table])
+				continue;
+
+			std::array<std::uint8_t, 17> counts;
+			std::vector<std::uint8_t> values;
+			optimal_table(frequencies[table], counts, values);
+
+			tables.push_back(static_cast<char>((table / 4) << 4 | (table % 4)));
+			tables.append(reinterpret_cast<const char*>(counts.data() + 1), 16);
+			tables.append(reinterpret_cast<const char*>(values.data()), values.size());
+
+			// canonical codes, as in Annex C
+			std::uint32_t code = 0;
+			size_t index = 0;
+			for (int length = 1; length <= 16; length++) {
+				for (int i = 0; i < counts[length]; i++, index++, code++) {
+					codes[table][values[index]] = code;
+					sizes[table][values[index]] = static_cast<std::uint8_t>(length);
+				}
+
+				code <<= 1;
+			}
+		}
+
+		output.push_back(static_cast<char>(0xFF));
+		output.push_back(static_cast<char>(marker_dht));
+		put_u16(output, tables.size() + 2);
+		output += tables;
+
+		put_segment(output, scan);
+
+		bit_writer writer(output);
+		for (const auto& it : scan.symbols) {
+			if (it.table == restart_mark) {
+				writer.flush();
+				output.push_back(static_cast<char>(0xFF));
+				output.push_back(static_cast<char>(marker_rst0 + it.symbol));
+				continue;
+			}
+
+			writer.put(codes[it.table][it.symbol], sizes[it.table][it.symbol]);
+			writer.put(it.bits, extra_bit_count(it));
+		}
+
+		writer.flush();
+	}
+}
+
+bool optimize_jpeg(const std::string& input,
+	bool strip_metadata,
+	std::string& output,
+	std::string& error) {
+	output.clear();
+
+	std::vector<jpeg_item> items;
+	if (!parse_jpeg(input, items, error))
+		return false;
+
+	output.reserve(input.size());
+	output.push_back(static_cast<char>(0xFF));
+	output.push_back(static_cast<char>(marker_soi));
+
+	for (const auto& it : items) {
+		if (it.marker == marker_sos)
+			put_scan(output, it);
+		else if (it.marker != marker_dht && (!strip_metadata || keep_segment(it)))
+			put_segment(output, it);
+	}
+
+	output.push_back(static_cast<char>(0xFF));
+	output.push_back(static_cast<char>(marker_eoi));
+
+	// decode the result and make sure every scan carries the same symbols
+	std::vector<jpeg_item> check;
+	std::string check_error;
+	bool same = parse_jpeg(output, check, check_error);
+
+	auto next_scan = [](const std::vector<jpeg_item>& list, size_t& index) {
+		while (index < list.size() && list[index].marker != marker_sos)
+			index++;
+		return index < list.size();
+	};
+
+	size_t a = 0, b = 0;
+	while (same) {
+		const bool more_a = next_scan(items, a), more_b = next_scan(check, b);
+		if (!more_a || !more_b) {
+			same = more_a == more_b;
+			break;
+		}
+
+		same = items[a++].symbols == check[b++].symbols;
+	}
+
+	if (!same) {
+		output.clear();
+		error = "Re-encoded data does not match the original";
+		return false;
+	}
+
+	return true;
+}
+
+bool optimize_jpeg_file(const std::string& full_path,
+	bool strip_metadata,
+	jpeg_optimize_result& result) {
+	result = jpeg_optimize_result();
+	result.full_path = full_path;
+
+	std::string input;
+	{
+		std::ifstream file(full_path, std::ios::binary);
+		if (!file) {
+			result.error = "Unable to read " + full_path;
+			return false;
+		}
+
+		input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	result.bytes_before = result.bytes_after = input.size();
+
+	std::string output;
+	if (!optimize_jpeg(input, strip_metadata, output, result.error))
+		return false;
+
+	if (output.size() >= input.size())
+		return true;
+
+	std::error_code ec;
+	const auto write_time = std::filesystem::last_write_time(full_path, ec);
+	if (ec) {
+		result.error = ec.message();
+		return false;
+	}
+
+	// write alongside then swap in, so that an interrupted write never leaves
+	// a damaged image in the library
+	const std::string temp_path = full_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write(output.data(), static_cast<std::streamsize>(output.size()));
+
+		if (!file) {
+			file.close();
+			std::filesystem::remove(temp_path, ec);
+			result.error = "Unable to write " + temp_path;
+			return false;
+		}
+	}
+
+	std::filesystem::last_write_time(temp_path, write_time, ec);
+	if (!ec)
+		std::filesystem::rename(temp_path, full_path, ec);
+
+	if (ec) {
+		result.error = ec.message();
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	result.bytes_after = output.size();
+	return true;
+}
+
+void optimize_jpeg_files(const std::vector<std::string>& paths,
+	bool strip_metadata,
+	std::vector<jpeg_optimize_result>& results,
+	io_scheduler* io) {
+	results.assign(paths.size(), jpeg_optimize_result());
+
+	const size_t threads = (std::min)(paths.size(),
+		static_cast<size_t>((std::max)(1u, std::thread::hardware_concurrency())));
+
+	std::atomic<size_t> next{ 0 };
+	auto work = [&]() {
+		io_priority_scope priority(io ? io->limits().priority : io_priority::normal);
+
+		for (size_t i = next++; i < paths.size(); i = next++) {
+			if (io) {
+				// the file is read, and written back if it shrinks
+				std::error_code ec;
+				const auto size = std::filesystem::file_size(paths[i], ec);
+				if (!ec)
+					io->acquire(2 * size);
+			}
+
+			// a failure must not escape the worker thread and end the process
+			try {
+				optimize_jpeg_file(paths[i], strip_metadata, results[i]);
+			}
+			catch (const std::exception& e) {
+				results[i] = jpeg_optimize_result();
+				results[i].full_path = paths[i];
+				results[i].error = e.what();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < threads; i++)
+		workers.emplace_back(work);
+
+	work();
+
+	for (auto& it : workers)
+		it.join();
+}
+
+bool optimize_library(const std::string& folder,
+	bool strip_metadata,
+	std::vector<jpeg_optimize_result>& results,
+	std::string& error,
+	io_scheduler* io) {
+	results.clear();
+
+	std::vector<std::string> paths;
+
+	try {
+		if (!std::filesystem::is_directory(folder)) {
+			error = "Unable to read " + folder;
+			return false;
+		}
+
+		for (const auto& bucket : aspect_buckets) {
+			const std::filesystem::path bucket_folder = std::filesystem::path(folder) / bucket.folder;
+
+			if (!std::filesystem::is_directory(bucket_folder))
+				continue;
+
+			for (const auto& it : std::filesystem::directory_iterator(bucket_folder)) {
+				if (!it.is_regular_file())
+					continue;
+
+				const auto& path = it.path().native();
+
+				if (has_extension(path, ".jpg") || has_extension(path, ".jpeg"))
+					paths.push_back(it.path().string());
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		return false;
+	}
+
+	optimize_jpeg_files(paths, strip_metadata, results, io);
+	return true;
+}
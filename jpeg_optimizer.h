@@ -0,0 +1,131 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "io_scheduler.h"
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The outcome of optimizing one JPEG file.
+/// </summary>
+struct jpeg_optimize_result {
+	std::string full_path;
+	unsigned long long bytes_before = 0;
+	unsigned long long bytes_after = 0;	// the same as bytes_before if the file was left as it was
+	std::string error;	// why the file was left as it was, empty if it was optimized or already optimal
+
+	unsigned long long saved() const {
+		return bytes_before - bytes_after;
+	}
+};
+
+/// <summary>
+/// Losslessly re-encode a baseline JPEG with Huffman tables built for its data.
+/// </summary>
+/// 
+/// <param name="input">The JPEG file's bytes.</param>
+/// <param name="strip_metadata">
+/// Whether to drop comments and application segments that do not affect how
+/// the image is displayed. JFIF, ICC profile and Adobe segments are always
+/// kept, and so is Exif data that rotates the image.
+/// </param>
+/// <param name="output">The re-encoded file.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false. Progressive, arithmetic coded and
+/// lossless files are not supported.
+/// </returns>
+/// 
+/// <remarks>
+/// The quantized coefficients are carried over exactly, so the decoded pixels
+/// do not change. The output is decoded again and compared with the input's
+/// coefficients before it is returned.
+/// </remarks>
+bool optimize_jpeg(const std::string& input,
+	bool strip_metadata,
+	std::string& output,
+	std::string& error);
+
+/// <summary>
+/// Optimize a JPEG file in place.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the file.</param>
+/// <param name="strip_metadata">See optimize_jpeg().</param>
+/// <param name="result">The sizes before and after.</param>
+/// 
+/// <returns>
+/// Returns true if the file was optimized or was already optimal, else false,
+/// with the reason in the result's error.
+/// </returns>
+/// 
+/// <remarks>
+/// The file is only replaced if it gets smaller, and it keeps its last write
+/// time so that it is not fetched again and its variants stay up to date.
+/// </remarks>
+bool optimize_jpeg_file(const std::string& full_path,
+	bool strip_metadata,
+	jpeg_optimize_result& result);
+
+/// <summary>
+/// Optimize JPEG files in place, on one thread per core.
+/// </summary>
+/// 
+/// <param name="paths">The full paths to the files.</param>
+/// <param name="strip_metadata">See optimize_jpeg().</param>
+/// <param name="results">The result for each file, in the order of the paths.</param>
+/// <param name="io">Paces and prioritizes the work, if not null.</param>
+void optimize_jpeg_files(const std::vector<std::string>& paths,
+	bool strip_metadata,
+	std::vector<jpeg_optimize_result>& results,
+	io_scheduler* io = nullptr);
+
+/// <summary>
+/// Optimize every JPEG file in a library's aspect ratio bucket folders.
+/// </summary>
+/// 
+/// <param name="folder">The library folder.</param>
+/// <param name="strip_metadata">See optimize_jpeg().</param>
+/// <param name="results">The result for each file.</param>
+/// <param name="error">Error information.</param>
+/// <param name="io">Paces and prioritizes the work, if not null.</param>
+/// 
+/// <returns>
+/// Returns true if the library folder could be read, else false. Files that
+/// cannot be optimized do not cause the function to fail.
+/// </returns>
+/// 
+/// <remarks>
+/// Meant for a background pass over a library fetched before optimization
+/// was turned on. Files that are already optimal are decoded but not written.
+/// </remarks>
+bool optimize_library(const std::string& folder,
+	bool strip_metadata,
+	std::vector<jpeg_optimize_result>& results,
+	std::string& error,
+	io_scheduler* io = nullptr);
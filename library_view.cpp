@@ -0,0 +1,109 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "library_view.h"
+#include "aspect_buckets.h"
+
+#include <algorithm>
+#include <numeric>
+
+// leccore
+#include <liblec/leccore/system.h>
+
+void library_view::reset(const image_catalog& pictures) {
+	_pictures = &pictures;
+	_window.clear();
+
+	// index the file names so selections can be resolved without a scan
+	_index.clear();
+	_index.reserve(pictures.size());
+
+	for (image_id id = 0; id < pictures.size(); id++)
+		_index.emplace(pictures.name(id), id);
+
+	std::vector<image_id> order(pictures.size());
+	std::iota(order.begin(), order.end(), 0);
+	this->order(std::move(order));
+}
+
+void library_view::order(std::vector<image_id> order) {
+	_order = std::move(order);
+	_window.clear();
+
+	// keep the inverse permutation for looking up positions
+	_positions.assign(_pictures ? _pictures->size() : 0, static_cast<size_t>(-1));
+
+	for (size_t i = 0; i < _order.size(); i++)
+		_positions[_order[i]] = i;
+}
+
+size_t library_view::size() const {
+	return _pictures ? _order.size() : 0;
+}
+
+const std::vector<library_view::row>& library_view::window(size_t first, size_t count) {
+	_window.clear();
+
+	if (!_pictures || first >= _order.size())
+		return _window;
+
+	const size_t last = (std::min)(first + count, _order.size());
+	_window.reserve(last - first);
+
+	for (size_t i = first; i < last; i++) {
+		const auto id = _order[i];
+		const auto bucket = classify_aspect(_pictures->width(id), _pictures->height(id));
+
+		_window.push_back({
+			std::string(_pictures->name(id)),
+			liblec::leccore::format_size(_pictures->file_size(id)),
+			bucket != aspect_bucket::none ? bucket_spec(bucket).folder :
+			_pictures->orientation(id) == image_orientation::landscape ? "Landscape" : "Portrait"
+			});
+	}
+
+	return _window;
+}
+
+bool library_view::find(const std::string& file_name, image_id& id) const {
+	const auto it = _index.find(file_name);
+
+	if (it == _index.end())
+		return false;
+
+	id = it->second;
+	return true;
+}
+
+image_id library_view::at(size_t position) const {
+	return _order[position];
+}
+
+bool library_view::position(image_id id, size_t& position) const {
+	if (id >= _positions.size() || _positions[id] == static_cast<size_t>(-1))
+		return false;
+
+	position = _positions[id];
+	return true;
+}
@@ -0,0 +1,130 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "catalog.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+/// <summary>
+/// Row provider for the library table. Rows are formatted on demand, one
+/// window at a time, so the cost of displaying the library scales with the
+/// number of rows on screen rather than with the number of images.
+/// </summary>
+class library_view {
+public:
+	/// <summary>
+	/// A formatted table row.
+	/// </summary>
+	struct row {
+		std::string name;
+		std::string size;
+		std::string orientation;
+	};
+
+	/// <summary>
+	/// Point the view at a catalog of images.
+	/// </summary>
+	/// 
+	/// <param name="pictures">
+	/// The catalog. It must outlive the view and must not be modified until the
+	/// next call to reset(). The images are displayed in catalog order until
+	/// order() is called.
+	/// </param>
+	void reset(const image_catalog& pictures);
+
+	/// <summary>
+	/// Set the order in which the images are displayed.
+	/// </summary>
+	/// 
+	/// <param name="order">
+	/// The ids of the images to display, in display order. Images not in the
+	/// list are not displayed.
+	/// </param>
+	void order(std::vector<image_id> order);
+
+	/// <summary>
+	/// Get the number of rows in the view.
+	/// </summary>
+	size_t size() const;
+
+	/// <summary>
+	/// Format a window of rows.
+	/// </summary>
+	/// 
+	/// <param name="first">The index of the first row in the window.</param>
+	/// <param name="count">The maximum number of rows in the window.</param>
+	/// 
+	/// <returns>
+	/// The formatted rows. The reference is valid until the next call to window()
+	/// or reset().
+	/// </returns>
+	const std::vector<row>& window(size_t first, size_t count);
+
+	/// <summary>
+	/// Find the index of an image from its file name.
+	/// </summary>
+	/// 
+	/// <param name="file_name">The file name, as displayed in the table.</param>
+	/// <param name="id">The id of the image in the catalog.</param>
+	/// 
+	/// <returns>
+	/// Returns true if the image was found, else false.
+	/// </returns>
+	bool find(const std::string& file_name, image_id& id) const;
+
+	/// <summary>
+	/// Get the image displayed at a position.
+	/// </summary>
+	/// 
+	/// <param name="position">The position, in display order.</param>
+	/// 
+	/// <returns>
+	/// The id of the image.
+	/// </returns>
+	image_id at(size_t position) const;
+
+	/// <summary>
+	/// Find the position at which an image is displayed.
+	/// </summary>
+	/// 
+	/// <param name="id">The id of the image.</param>
+	/// <param name="position">The position, in display order.</param>
+	/// 
+	/// <returns>
+	/// Returns true if the image is displayed, else false.
+	/// </returns>
+	bool position(image_id id, size_t& position) const;
+
+private:
+	const image_catalog* _pictures = nullptr;
+	std::unordered_map<std::string_view, image_id> _index;
+	std::vector<image_id> _order;
+	std::vector<size_t> _positions;
+	std::vector<row> _window;
+};
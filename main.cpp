@@ -23,6 +23,7 @@
 */
 
 #include "gui.h"
+#include "fetch_cli.h"
 
 // gui app using main
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
@@ -40,8 +41,18 @@
 /// /update: update exe running in temp directory. For overwriting files in install directory with the unzipped update files.
 /// /recentupdate: new exe running from the install directory for the first time after an update.
 /// /systemtray: start application in the background. Only the system tray will be visible and no splash screen will be displayed.
+/// /trace: save the time taken by each startup phase to spotlight_images_startup.txt in the temp folder.
+/// /fetch [/folder path] [/minsharpness value] [/minentropy value] [/variants widths] [/filter lanczos|mitchell] [/crop bucket] [/optimize] [/allprofiles] [/sources folders] [/background] [/maxmbps value] [/iouring]: fetch images without creating any UI and write a JSON summary to the standard output.
+/// Returns 0 if images were fetched, 1 on error and 2 if no images were found.
+/// /optimize [/folder path] [/keepmetadata] [/background] [/maxmbps value]: losslessly optimize the JPEG files already in the library and write the bytes saved as JSON to the standard output.
+/// /history [/folder path] [/asset name]: write the record of every image ever fetched, or of one Spotlight asset, as JSON to the standard output.
+/// /benchmark [name]: run the engine micro-benchmarks and write the results as JSON to the standard output.
 /// </remarks>
-int main() {
+int main(int argc, char* argv[]) {
+	// headless commands run before any UI (or GDI+) is initialized
+	if (is_headless_command(argc, argv))
+		return run_headless_command(argc, argv);
+
 	bool restart = false;
 
 	do {
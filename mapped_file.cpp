@@ -0,0 +1,147 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#endif
+
+mapped_file::~mapped_file() {
+	close();
+}
+
+#ifdef _WIN32
+bool mapped_file::open(const std::string& full_path, std::string& error) {
+	close();
+
+	HANDLE file = CreateFileA(full_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		error = "Unable to open " + full_path;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		error = "Unable to map an empty file";
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		error = "Unable to map " + full_path;
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		error = "Unable to map " + full_path;
+		return false;
+	}
+
+	_file = file;
+	_mapping = mapping;
+	_data = static_cast<const unsigned char*>(view);
+	_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void mapped_file::close() {
+	if (_data)
+		UnmapViewOfFile(_data);
+
+	if (_mapping)
+		CloseHandle(_mapping);
+
+	if (_file)
+		CloseHandle(_file);
+
+	_data = nullptr;
+	_size = 0;
+	_mapping = nullptr;
+	_file = nullptr;
+}
+#else
+bool mapped_file::open(const std::string& full_path, std::string& error) {
+	close();
+
+	const int file = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0) {
+		error = "Unable to open " + full_path + ": " + strerror(errno);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		::close(file);
+		error = "Unable to map an empty file";
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED) {
+		::close(file);
+		error = "Unable to map " + full_path + ": " + strerror(errno);
+		return false;
+	}
+
+	_file = file;
+	_data = static_cast<const unsigned char*>(view);
+	_size = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void mapped_file::close() {
+	if (_data)
+		munmap(const_cast<unsigned char*>(_data), _size);
+
+	if (_file >= 0)
+		::close(_file);
+
+	_data = nullptr;
+	_size = 0;
+	_file = -1;
+}
+#endif
+
+const unsigned char* mapped_file::data() const {
+	return _data;
+}
+
+size_t mapped_file::size() const {
+	return _size;
+}
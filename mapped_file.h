@@ -0,0 +1,70 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// Read-only memory mapping of a file.
+/// </summary>
+class mapped_file {
+public:
+	mapped_file() = default;
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file();
+
+	/// <summary>
+	/// Map a file into memory.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the file.</param>
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if successful, else false. Empty files cannot be mapped.
+	/// </returns>
+	bool open(const std::string& full_path, std::string& error);
+
+	/// <summary>
+	/// Unmap the file.
+	/// </summary>
+	void close();
+
+	const unsigned char* data() const;
+	size_t size() const;
+
+private:
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#else
+	int _file = -1;
+#endif
+};
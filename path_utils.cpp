@@ -0,0 +1,170 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "path_utils.h"
+
+#include <algorithm>
+
+namespace {
+	template <typename Char>
+	bool starts_with(std::basic_string_view<Char> text, const char* prefix) {
+		for (size_t i = 0; prefix[i]; i++)
+			if (i >= text.size() || text[i] != static_cast<Char>(prefix[i]))
+				return false;
+
+		return true;
+	}
+
+	template <typename Char>
+	bool is_drive(std::basic_string_view<Char> text) {
+		return text.size() >= 2 && text[1] == Char(':') &&
+			((text[0] >= Char('A') && text[0] <= Char('Z')) || (text[0] >= Char('a') && text[0] <= Char('z')));
+	}
+
+	// the end of the component that starts at first
+	template <typename Char>
+	size_t component_end(std::basic_string_view<Char> path, size_t first) {
+		while (first < path.size() && !is_path_separator(path[first]))
+			first++;
+
+		return first;
+	}
+
+	// the length of the root of a path, e.g. 2 for C:\Folder, 14 for
+	// \\server\share\Folder and 6 for \\?\C:\Folder; a POSIX path's leading '/'
+	// is not part of the root
+	template <typename Char>
+	size_t root_length(std::basic_string_view<Char> path) {
+#ifndef _WIN32
+		// drive letters and the rest are ordinary names elsewhere
+		(void)path;
+		return 0;
+#else
+		size_t length = 0;
+
+		if (starts_with(path, "\\\\?\\") || starts_with(path, "\\\\.\\")) {
+			length = 4;
+
+			// \\?\UNC\server\share
+			if (starts_with(path.substr(length), "UNC\\"))
+				return (std::min)(component_end(path, component_end(path, length + 4) + 1), path.size());
+		}
+		else if (path.size() > 2 && is_path_separator(path[0]) && is_path_separator(path[1]) &&
+			!is_path_separator(path[2]))
+			// \\server\share
+			return (std::min)(component_end(path, component_end(path, 2) + 1), path.size());
+
+		if (is_drive(path.substr(length)))
+			length += 2;
+
+		return length;
+#endif
+	}
+
+	// the last separator after the root, or npos
+	template <typename Char>
+	size_t last_separator(std::basic_string_view<Char> path, size_t root) {
+		for (size_t i = path.size(); i > root; i--)
+			if (is_path_separator(path[i - 1]))
+				return i - 1;
+
+		return std::basic_string_view<Char>::npos;
+	}
+
+	template <typename Char>
+	std::basic_string_view<Char> filename(std::basic_string_view<Char> path) {
+		const auto root = (std::min)(root_length(path), path.size());
+		const auto separator = last_separator(path, root);
+
+		return path.substr(separator == std::basic_string_view<Char>::npos ? root : separator + 1);
+	}
+
+	template <typename Char>
+	std::basic_string_view<Char> directory(std::basic_string_view<Char> path) {
+		const auto root = (std::min)(root_length(path), path.size());
+		const auto separator = last_separator(path, root);
+
+		if (separator == std::basic_string_view<Char>::npos)
+			return path.substr(0, root);
+
+		// a file in the POSIX root keeps its separator
+		return path.substr(0, (std::max)(separator, root == 0 && separator == 0 ? size_t(1) : root));
+	}
+
+	template <typename Char>
+	std::basic_string_view<Char> extension(std::basic_string_view<Char> path) {
+		const auto name = filename(path);
+		const auto dot = name.rfind(Char('.'));
+
+		return dot == std::basic_string_view<Char>::npos || dot == 0 ?
+			std::basic_string_view<Char>() : name.substr(dot);
+	}
+
+	template <typename Char>
+	std::basic_string_view<Char> stem(std::basic_string_view<Char> path) {
+		const auto name = filename(path);
+		return name.substr(0, name.size() - extension(path).size());
+	}
+
+	template <typename Char>
+	bool has(std::basic_string_view<Char> path, std::string_view wanted) {
+		const auto found = extension(path);
+
+		return found.size() == wanted.size() &&
+			std::equal(found.begin(), found.end(), wanted.begin(), [](Char a, char b) {
+			return (a >= Char('A') && a <= Char('Z') ? a - Char('A') + Char('a') : a) == static_cast<Char>(b);
+				});
+	}
+}
+
+std::string_view path_filename(std::string_view path) { return filename(path); }
+std::wstring_view path_filename(std::wstring_view path) { return filename(path); }
+
+std::string_view path_directory(std::string_view path) { return directory(path); }
+std::wstring_view path_directory(std::wstring_view path) { return directory(path); }
+
+std::string_view path_extension(std::string_view path) { return extension(path); }
+std::wstring_view path_extension(std::wstring_view path) { return extension(path); }
+
+std::string_view path_stem(std::string_view path) { return stem(path); }
+std::wstring_view path_stem(std::wstring_view path) { return stem(path); }
+
+bool has_extension(std::string_view path, std::string_view extension) { return has(path, extension); }
+bool has_extension(std::wstring_view path, std::string_view extension) { return has(path, extension); }
+
+void join_path(std::string_view directory, std::string_view name, std::string& path) {
+	path.assign(directory);
+
+	if (!directory.empty() && !is_path_separator(directory.back()))
+		path += path_separator;
+
+	path.append(name);
+}
+
+std::string join_path(std::string_view directory, std::string_view name) {
+	std::string path;
+	path.reserve(directory.size() + 1 + name.size());
+	join_path(directory, name, path);
+	return path;
+}
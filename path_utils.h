@@ -0,0 +1,114 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/// <summary>
+/// Path utilities that work on slices of the path instead of copies.
+/// </summary>
+/// 
+/// <remarks>
+/// '/' separates components on every platform. On Windows '\\' does too, and
+/// the roots of Windows paths are recognized: drive letters (C:), UNC shares
+/// (\\server\share) and the long path prefixes \\?\ and \\.\, including
+/// \\?\UNC\server\share. Elsewhere a backslash is an ordinary character in
+/// a file name. The wide overloads take native Windows paths. The returned
+/// views point into the given path, so they must not outlive it.
+/// </remarks>
+
+/// <summary>
+/// The separator that join_path() puts between components.
+/// </summary>
+#ifdef _WIN32
+constexpr char path_separator = '\\';
+#else
+constexpr char path_separator = '/';
+#endif
+
+/// <summary>
+/// Check whether a character separates path components.
+/// </summary>
+constexpr bool is_path_separator(wchar_t c) {
+#ifdef _WIN32
+	return c == L'\\' || c == L'/';
+#else
+	return c == L'/';
+#endif
+}
+
+/// <summary>
+/// Get the file name of a path: everything after the last separator, e.g.
+/// file.jpg for C:\Folder\file.jpg. Empty if the path ends with a separator
+/// or is only a root.
+/// </summary>
+std::string_view path_filename(std::string_view path);
+std::wstring_view path_filename(std::wstring_view path);
+
+/// <summary>
+/// Get the directory of a path: everything before the last separator, e.g.
+/// C:\Folder for C:\Folder\file.jpg and C: for C:\file.jpg. Empty if the path
+/// has no directory; "/" for a file in the POSIX root.
+/// </summary>
+std::string_view path_directory(std::string_view path);
+std::wstring_view path_directory(std::wstring_view path);
+
+/// <summary>
+/// Get the extension of a path's file name, with the dot, e.g. .jpg. Empty if
+/// there is none; a name that starts with its only dot has no extension.
+/// </summary>
+std::string_view path_extension(std::string_view path);
+std::wstring_view path_extension(std::wstring_view path);
+
+/// <summary>
+/// Get a path's file name without its extension, e.g. file for
+/// C:\Folder\file.jpg.
+/// </summary>
+std::string_view path_stem(std::string_view path);
+std::wstring_view path_stem(std::wstring_view path);
+
+/// <summary>
+/// Check a path's extension, ignoring ASCII case.
+/// </summary>
+/// 
+/// <param name="path">The path.</param>
+/// <param name="extension">The extension, with the dot, in lower case, e.g. .jpg.</param>
+bool has_extension(std::string_view path, std::string_view extension);
+bool has_extension(std::wstring_view path, std::string_view extension);
+
+/// <summary>
+/// Join a directory and a name with path_separator unless the directory
+/// already ends with a separator.
+/// </summary>
+/// 
+/// <param name="directory">The directory. Can be empty, then the result is the name.</param>
+/// <param name="name">The name to add.</param>
+/// <param name="path">
+/// Receives the path. Its memory is reused, so joining into the same string
+/// in a loop stops allocating once it is large enough.
+/// </param>
+void join_path(std::string_view directory, std::string_view name, std::string& path);
+std::string join_path(std::string_view directory, std::string_view name);
@@ -0,0 +1,113 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "preview_cache.h"
+
+preview_cache::preview_cache(size_t budget) :
+	_budget(budget) {}
+
+void preview_cache::budget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_budget = bytes;
+	evict();
+}
+
+std::shared_ptr<const bitmap> preview_cache::find(const std::string& key) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto it = _lookup.find(key);
+	if (it == _lookup.end()) {
+		_stats.misses++;
+		return nullptr;
+	}
+
+	_stats.hits++;
+	_entries.splice(_entries.begin(), _entries, it->second);
+	return it->second->image;
+}
+
+std::shared_ptr<const bitmap> preview_cache::peek(const std::string& key) const {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto it = _lookup.find(key);
+	return it == _lookup.end() ? nullptr : it->second->image;
+}
+
+void preview_cache::insert(const std::string& key, std::shared_ptr<const bitmap> image) {
+	if (!image)
+		return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const size_t bytes = sizeof(bitmap) + image->pixels.capacity();
+
+	const auto it = _lookup.find(key);
+	if (it != _lookup.end()) {
+		_stats.resident_bytes -= it->second->bytes;
+		it->second->image = std::move(image);
+		it->second->bytes = bytes;
+		_entries.splice(_entries.begin(), _entries, it->second);
+	}
+	else {
+		_entries.push_front({ key, std::move(image), bytes });
+		_lookup[key] = _entries.begin();
+	}
+
+	_stats.resident_bytes += bytes;
+	evict();
+}
+
+void preview_cache::pin(const std::string& key) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pinned.insert(key);
+}
+
+void preview_cache::unpin(const std::string& key) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pinned.erase(key);
+	evict();
+}
+
+preview_cache::statistics preview_cache::stats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto stats = _stats;
+	stats.entries = _entries.size();
+	return stats;
+}
+
+void preview_cache::evict() {
+	// walk from the least recently used end, skipping pinned images
+	auto it = _entries.end();
+
+	while (_stats.resident_bytes > _budget && it != _entries.begin()) {
+		--it;
+
+		if (_pinned.count(it->key))
+			continue;
+
+		_stats.resident_bytes -= it->bytes;
+		_lookup.erase(it->key);
+		it = _entries.erase(it);
+	}
+}
@@ -0,0 +1,121 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+/// <summary>
+/// Least-recently-used cache of decoded images with a memory budget.
+/// </summary>
+/// 
+/// <remarks>
+/// Pinned images are never evicted, even when they take the cache over its
+/// budget. All member functions are thread-safe.
+/// </remarks>
+class preview_cache {
+public:
+	struct statistics {
+		unsigned long long hits = 0;
+		unsigned long long misses = 0;
+		size_t resident_bytes = 0;
+		size_t entries = 0;
+
+		double hit_rate() const {
+			return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.;
+		}
+	};
+
+	/// <summary>
+	/// Create a cache.
+	/// </summary>
+	/// 
+	/// <param name="budget">The maximum number of bytes of pixels to keep.</param>
+	explicit preview_cache(size_t budget);
+
+	/// <summary>
+	/// Change the budget, evicting images as necessary.
+	/// </summary>
+	void budget(size_t bytes);
+
+	/// <summary>
+	/// Look up an image and mark it as the most recently used.
+	/// </summary>
+	/// 
+	/// <param name="key">The key of the image.</param>
+	/// 
+	/// <returns>
+	/// The image, or nullptr if it is not in the cache. Counts as a hit or a miss.
+	/// </returns>
+	std::shared_ptr<const bitmap> find(const std::string& key);
+
+	/// <summary>
+	/// Look up an image without affecting its recency or the statistics.
+	/// </summary>
+	std::shared_ptr<const bitmap> peek(const std::string& key) const;
+
+	/// <summary>
+	/// Add an image as the most recently used, evicting the least recently used
+	/// unpinned images until the cache is within its budget.
+	/// </summary>
+	void insert(const std::string& key, std::shared_ptr<const bitmap> image);
+
+	/// <summary>
+	/// Pin an image so it cannot be evicted. The key doesn't need to be in the
+	/// cache yet.
+	/// </summary>
+	void pin(const std::string& key);
+
+	/// <summary>
+	/// Unpin an image.
+	/// </summary>
+	void unpin(const std::string& key);
+
+	statistics stats() const;
+
+private:
+	struct entry {
+		std::string key;
+		std::shared_ptr<const bitmap> image;
+		size_t bytes;
+	};
+
+	void evict();
+
+	mutable std::mutex _mutex;
+	size_t _budget;
+
+	// most recently used first
+	std::list<entry> _entries;
+	std::unordered_map<std::string, std::list<entry>::iterator> _lookup;
+	std::unordered_set<std::string> _pinned;
+	statistics _stats;
+};
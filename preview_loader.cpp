@@ -0,0 +1,191 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "preview_loader.h"
+#include "image_decoder.h"
+#include "path_utils.h"
+
+#include <filesystem>
+#include <cstdio>
+
+preview_loader::preview_loader(const std::string& cache_folder,
+	unsigned int max_width,
+	unsigned int max_height,
+	size_t cache_budget) :
+	_cache_folder(cache_folder),
+	_max_width(max_width),
+	_max_height(max_height),
+	_cache(cache_budget) {
+	try {
+		std::filesystem::create_directories(_cache_folder);
+	}
+	catch (const std::exception&) {}
+
+	_worker = std::thread([this]() { run(); });
+}
+
+preview_loader::~preview_loader() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+		_queue.clear();
+	}
+
+	_condition.notify_one();
+
+	if (_worker.joinable())
+		_worker.join();
+
+	if (!_saved_file.empty())
+		std::remove(_saved_file.c_str());
+}
+
+void preview_loader::request(const std::string& full_path,
+	const std::vector<std::string>& prefetch) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// drop requests for images that are no longer of interest
+		_queue.clear();
+
+		// keep the displayed image in the cache no matter how much is prefetched
+		if (_displayed != full_path) {
+			if (!_displayed.empty())
+				_cache.unpin(_displayed);
+
+			_cache.pin(full_path);
+			_displayed = full_path;
+		}
+
+		// queued even if it is cached, so that the worker writes its preview file
+		if (_failed.find(full_path) == _failed.end()) {
+			_cache.find(full_path);
+			_queue.push_back(full_path);
+		}
+
+		for (const auto& it : prefetch)
+			if (_failed.find(it) == _failed.end() && !_cache.peek(it))
+				_queue.push_back(it);
+	}
+
+	_condition.notify_one();
+}
+
+bool preview_loader::get(const std::string& full_path, std::string& preview_path) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_failed.find(full_path) != _failed.end()) {
+		preview_path.clear();
+		return true;
+	}
+
+	if (full_path != _saved_path)
+		return false;
+
+	preview_path = _saved_file;
+	return true;
+}
+
+void preview_loader::reset() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_queue.clear();
+	_failed.clear();
+}
+
+preview_cache::statistics preview_loader::cache_statistics() const {
+	return _cache.stats();
+}
+
+std::string preview_loader::preview_file(const std::string& full_path) const {
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx_%ux%u.bmp",
+		static_cast<unsigned long long>(std::hash<std::string>()(full_path)), _max_width, _max_height);
+
+	return join_path(_cache_folder, name);
+}
+
+void preview_loader::run() {
+	for (;;) {
+		std::string full_path;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this]() { return _stop || !_queue.empty(); });
+
+			if (_stop)
+				return;
+
+			full_path = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		if (!_cache.peek(full_path)) {
+			auto image = std::make_shared<bitmap>();
+			std::string error;
+
+			if (decode_image(full_path, _max_width, _max_height, *image, error)) {
+				image->pixels.shrink_to_fit();
+				_cache.insert(full_path, std::move(image));
+			}
+			else {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_failed.insert(full_path);
+				continue;
+			}
+		}
+
+		save_if_displayed(full_path);
+	}
+}
+
+void preview_loader::save_if_displayed(const std::string& full_path) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (full_path != _displayed || full_path == _saved_path)
+			return;
+	}
+
+	const auto image = _cache.peek(full_path);
+	if (!image)
+		return;
+
+	// written without the lock, so that the UI thread's get() doesn't wait for it
+	std::string file = preview_file(full_path), error;
+	const bool saved = save_bitmap(*image, file, error);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!saved) {
+		// falls back to the original, like an image that could not be decoded
+		_failed.insert(full_path);
+		return;
+	}
+
+	// only the displayed preview is kept on disk
+	if (!_saved_file.empty() && _saved_file != file)
+		std::remove(_saved_file.c_str());
+
+	_saved_path = full_path;
+	_saved_file = std::move(file);
+}
@@ -0,0 +1,129 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "preview_cache.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/// <summary>
+/// Decodes image previews on a background thread.
+/// </summary>
+/// 
+/// <remarks>
+/// Each preview is scaled down to the preview size and kept in a memory
+/// budgeted cache, so going back to an image doesn't decode it again. Only the
+/// displayed preview is written to the cache folder, as an uncompressed bitmap,
+/// and it is written by the background thread too, so get() does no file work.
+/// A new request cancels the requests that haven't started yet, so moving
+/// quickly through a list only decodes the images that end up selected and
+/// their neighbours.
+/// </remarks>
+class preview_loader {
+public:
+	/// <summary>
+	/// Start the background decoder.
+	/// </summary>
+	/// 
+	/// <param name="cache_folder">The folder to save previews to. It is created if it doesn't exist.</param>
+	/// <param name="max_width">The maximum width of a preview, in pixels.</param>
+	/// <param name="max_height">The maximum height of a preview, in pixels.</param>
+	/// <param name="cache_budget">The memory budget for decoded previews, in bytes.</param>
+	preview_loader(const std::string& cache_folder,
+		unsigned int max_width,
+		unsigned int max_height,
+		size_t cache_budget);
+	preview_loader(const preview_loader&) = delete;
+	preview_loader& operator=(const preview_loader&) = delete;
+
+	/// <summary>
+	/// Stop the decoder and delete the preview it saved.
+	/// </summary>
+	~preview_loader();
+
+	/// <summary>
+	/// Request a preview. The image is pinned in the cache until another
+	/// preview is requested.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the image to preview.</param>
+	/// <param name="prefetch">Images to decode after it, in order of priority.</param>
+	void request(const std::string& full_path,
+		const std::vector<std::string>& prefetch);
+
+	/// <summary>
+	/// Get a preview.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the image.</param>
+	/// <param name="preview_path">
+	/// The full path to the preview, or an empty string if the image could not
+	/// be decoded.
+	/// </param>
+	/// 
+	/// <returns>
+	/// Returns true if the preview is ready, else false.
+	/// </returns>
+	bool get(const std::string& full_path, std::string& preview_path);
+
+	/// <summary>
+	/// Forget the queued requests and the images that could not be decoded,
+	/// for when the images may have changed.
+	/// </summary>
+	void reset();
+
+	/// <summary>
+	/// Get the cache statistics.
+	/// </summary>
+	preview_cache::statistics cache_statistics() const;
+
+private:
+	void run();
+	void save_if_displayed(const std::string& full_path);
+	std::string preview_file(const std::string& full_path) const;
+
+	const std::string _cache_folder;
+	const unsigned int _max_width;
+	const unsigned int _max_height;
+
+	preview_cache _cache;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::deque<std::string> _queue;
+	std::unordered_set<std::string> _failed;
+	std::string _displayed;
+	std::string _saved_path;
+	std::string _saved_file;
+	bool _stop = false;
+
+	std::thread _worker;
+};
@@ -0,0 +1,491 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RESAMPLER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define RESAMPLER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	constexpr double pi = 3.14159265358979323846;
+
+	double sinc(double x) {
+		if (x == 0.)
+			return 1.;
+
+		x *= pi;
+		return std::sin(x) / x;
+	}
+
+	double lanczos3(double x) {
+		x = std::fabs(x);
+		return x < 3. ? sinc(x) * sinc(x / 3.) : 0.;
+	}
+
+	double mitchell(double x) {
+		constexpr double b = 1. / 3., c = 1. / 3.;
+		x = std::fabs(x);
+
+		if (x < 1.)
+			return ((12. - 9. * b - 6. * c) * x * x * x + (-18. + 12. * b + 6. * c) * x * x + (6. - 2. * b)) / 6.;
+
+		if (x < 2.)
+			return ((-b - 6. * c) * x * x * x + (6. * b + 30. * c) * x * x + (-12. * b - 48. * c) * x + (8. * b + 24. * c)) / 6.;
+
+		return 0.;
+	}
+
+	/// <summary>
+	/// The source pixels and weights that make up each output pixel along one
+	/// axis. Every output pixel has the same number of taps, padded with zero
+	/// weights, so the kernels need no bounds checks.
+	/// </summary>
+	struct contributions {
+		unsigned int taps = 0;
+		std::vector<unsigned int> first;
+		std::vector<float> weights;
+	};
+
+	contributions compute_contributions(unsigned int source_size, unsigned int target_size,
+		resample_filter filter) {
+		const double scale = static_cast<double>(source_size) / target_size;
+
+		// widen the filter when scaling down so that it also low-pass filters
+		const double filter_scale = (std::max)(scale, 1.);
+		const double support = (filter == resample_filter::lanczos3 ? 3. : 2.) * filter_scale;
+		auto function = filter == resample_filter::lanczos3 ? lanczos3 : mitchell;
+
+		contributions result;
+
+		// an even tap count lets the AVX2 kernel take two taps at a time
+		result.taps = static_cast<unsigned int>(std::ceil(support * 2.)) + 2;
+		result.taps += result.taps % 2;
+		result.taps = (std::min)(result.taps, source_size);
+
+		result.first.resize(target_size);
+		result.weights.assign(static_cast<size_t>(target_size) * result.taps, 0.f);
+
+		for (unsigned int i = 0; i < target_size; i++) {
+			const double centre = (i + .5) * scale;
+			const int left = (std::max)(0, static_cast<int>(std::floor(centre - support)));
+			const int right = (std::min)(static_cast<int>(source_size), static_cast<int>(std::ceil(centre + support)));
+
+			// keep the window inside the source
+			const unsigned int first = (std::min)(static_cast<unsigned int>(left), source_size - result.taps);
+			result.first[i] = first;
+
+			float* weights = &result.weights[static_cast<size_t>(i) * result.taps];
+			double total = 0.;
+
+			for (int j = left; j < right && static_cast<unsigned int>(j) < first + result.taps; j++) {
+				const double weight = function((j + .5 - centre) / filter_scale);
+				weights[j - first] = static_cast<float>(weight);
+				total += weight;
+			}
+
+			// normalize so that flat areas keep their value
+			if (total != 0.)
+				for (unsigned int t = 0; t < result.taps; t++)
+					weights[t] = static_cast<float>(weights[t] / total);
+		}
+
+		return result;
+	}
+
+	std::uint8_t to_byte(float value) {
+		const long rounded = std::lrintf(value);
+		return static_cast<std::uint8_t>(rounded < 0 ? 0 : rounded > 255 ? 255 : rounded);
+	}
+
+	/// <summary>
+	/// Resample rows horizontally into a buffer of four floats per pixel.
+	/// </summary>
+	struct horizontal_pass {
+		const bitmap& source;
+		const contributions& columns;
+		unsigned int width;
+		float* output;
+
+		const std::uint8_t* row(unsigned int y) const {
+			return source.pixels.data() + static_cast<size_t>(y) * source.width * 4;
+		}
+
+		float* output_row(unsigned int y) const {
+			return output + static_cast<size_t>(y) * width * 4;
+		}
+	};
+
+	/// <summary>
+	/// Resample rows of the horizontal pass's buffer vertically into the target.
+	/// </summary>
+	struct vertical_pass {
+		const float* input;
+		const contributions& rows;
+		bitmap& target;
+	};
+
+	void horizontal_scalar(const horizontal_pass& pass, unsigned int y0, unsigned int y1) {
+		for (unsigned int y = y0; y < y1; y++) {
+			const std::uint8_t* row = pass.row(y);
+			float* out = pass.output_row(y);
+
+			for (unsigned int x = 0; x < pass.width; x++, out += 4) {
+				const std::uint8_t* pixel = row + static_cast<size_t>(pass.columns.first[x]) * 4;
+				const float* weights = &pass.columns.weights[static_cast<size_t>(x) * pass.columns.taps];
+				float sum[4] = {};
+
+				for (unsigned int t = 0; t < pass.columns.taps; t++, pixel += 4)
+					for (int c = 0; c < 4; c++)
+						sum[c] += pixel[c] * weights[t];
+
+				memcpy(out, sum, sizeof(sum));
+			}
+		}
+	}
+
+	void vertical_scalar(const vertical_pass& pass, unsigned int y0, unsigned int y1) {
+		const size_t stride = static_cast<size_t>(pass.target.width) * 4;
+
+		for (unsigned int y = y0; y < y1; y++) {
+			const float* first = pass.input + pass.rows.first[y] * stride;
+			const float* weights = &pass.rows.weights[static_cast<size_t>(y) * pass.rows.taps];
+			std::uint8_t* out = pass.target.pixels.data() + y * stride;
+
+			for (size_t k = 0; k < stride; k++) {
+				float sum = 0.f;
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++)
+					sum += first[t * stride + k] * weights[t];
+
+				out[k] = to_byte(sum);
+			}
+		}
+	}
+
+#if defined(RESAMPLER_X86)
+	void horizontal_sse2(const horizontal_pass& pass, unsigned int y0, unsigned int y1) {
+		const __m128i zero = _mm_setzero_si128();
+
+		for (unsigned int y = y0; y < y1; y++) {
+			const std::uint8_t* row = pass.row(y);
+			float* out = pass.output_row(y);
+
+			for (unsigned int x = 0; x < pass.width; x++, out += 4) {
+				const std::uint8_t* pixel = row + static_cast<size_t>(pass.columns.first[x]) * 4;
+				const float* weights = &pass.columns.weights[static_cast<size_t>(x) * pass.columns.taps];
+				__m128 sum = _mm_setzero_ps();
+
+				// one pixel, all four channels, per tap
+				for (unsigned int t = 0; t < pass.columns.taps; t++, pixel += 4) {
+					int value;
+					memcpy(&value, pixel, sizeof(value));
+					const __m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero), zero);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(weights[t])));
+				}
+
+				_mm_storeu_ps(out, sum);
+			}
+		}
+	}
+
+	void vertical_sse2(const vertical_pass& pass, unsigned int y0, unsigned int y1) {
+		const size_t stride = static_cast<size_t>(pass.target.width) * 4;
+
+		for (unsigned int y = y0; y < y1; y++) {
+			const float* first = pass.input + pass.rows.first[y] * stride;
+			const float* weights = &pass.rows.weights[static_cast<size_t>(y) * pass.rows.taps];
+			std::uint8_t* out = pass.target.pixels.data() + y * stride;
+
+			size_t k = 0;
+			for (; k + 16 <= stride; k += 16) {
+				__m128 sum[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++) {
+					const float* in = first + t * stride + k;
+					const __m128 weight = _mm_set1_ps(weights[t]);
+
+					for (int v = 0; v < 4; v++)
+						sum[v] = _mm_add_ps(sum[v], _mm_mul_ps(_mm_loadu_ps(in + v * 4), weight));
+				}
+
+				// round to nearest, then saturate to bytes
+				const __m128i low = _mm_packs_epi32(_mm_cvtps_epi32(sum[0]), _mm_cvtps_epi32(sum[1]));
+				const __m128i high = _mm_packs_epi32(_mm_cvtps_epi32(sum[2]), _mm_cvtps_epi32(sum[3]));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(low, high));
+			}
+
+			for (; k < stride; k++) {
+				float sum = 0.f;
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++)
+					sum += first[t * stride + k] * weights[t];
+
+				out[k] = to_byte(sum);
+			}
+		}
+	}
+
+	TARGET_AVX2
+	void horizontal_avx2(const horizontal_pass& pass, unsigned int y0, unsigned int y1) {
+		for (unsigned int y = y0; y < y1; y++) {
+			const std::uint8_t* row = pass.row(y);
+			float* out = pass.output_row(y);
+
+			for (unsigned int x = 0; x < pass.width; x++, out += 4) {
+				const std::uint8_t* pixel = row + static_cast<size_t>(pass.columns.first[x]) * 4;
+				const float* weights = &pass.columns.weights[static_cast<size_t>(x) * pass.columns.taps];
+				__m256 sum = _mm256_setzero_ps();
+
+				// two pixels per tap pair; the tap count is even unless the source is tiny
+				unsigned int t = 0;
+				for (; t + 2 <= pass.columns.taps; t += 2, pixel += 8) {
+					const __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+						_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel))));
+					const __m256 weight = _mm256_insertf128_ps(
+						_mm256_castps128_ps256(_mm_set1_ps(weights[t])), _mm_set1_ps(weights[t + 1]), 1);
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(values, weight));
+				}
+
+				__m128 total = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+				for (; t < pass.columns.taps; t++, pixel += 4) {
+					int value;
+					memcpy(&value, pixel, sizeof(value));
+					const __m128 values = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(value)));
+					total = _mm_add_ps(total, _mm_mul_ps(values, _mm_set1_ps(weights[t])));
+				}
+
+				_mm_storeu_ps(out, total);
+			}
+		}
+	}
+
+	TARGET_AVX2
+	void vertical_avx2(const vertical_pass& pass, unsigned int y0, unsigned int y1) {
+		const size_t stride = static_cast<size_t>(pass.target.width) * 4;
+
+		// the packs interleave the 128 bit lanes, this puts the bytes back in order
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+		for (unsigned int y = y0; y < y1; y++) {
+			const float* first = pass.input + pass.rows.first[y] * stride;
+			const float* weights = &pass.rows.weights[static_cast<size_t>(y) * pass.rows.taps];
+			std::uint8_t* out = pass.target.pixels.data() + y * stride;
+
+			size_t k = 0;
+			for (; k + 32 <= stride; k += 32) {
+				__m256 sum[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++) {
+					const float* in = first + t * stride + k;
+					const __m256 weight = _mm256_set1_ps(weights[t]);
+
+					for (int v = 0; v < 4; v++)
+						sum[v] = _mm256_add_ps(sum[v], _mm256_mul_ps(_mm256_loadu_ps(in + v * 8), weight));
+				}
+
+				const __m256i low = _mm256_packs_epi32(_mm256_cvtps_epi32(sum[0]), _mm256_cvtps_epi32(sum[1]));
+				const __m256i high = _mm256_packs_epi32(_mm256_cvtps_epi32(sum[2]), _mm256_cvtps_epi32(sum[3]));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k),
+					_mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), order));
+			}
+
+			for (; k < stride; k++) {
+				float sum = 0.f;
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++)
+					sum += first[t * stride + k] * weights[t];
+
+				out[k] = to_byte(sum);
+			}
+		}
+	}
+#endif
+
+#if defined(RESAMPLER_NEON)
+	void horizontal_neon(const horizontal_pass& pass, unsigned int y0, unsigned int y1) {
+		for (unsigned int y = y0; y < y1; y++) {
+			const std::uint8_t* row = pass.row(y);
+			float* out = pass.output_row(y);
+
+			for (unsigned int x = 0; x < pass.width; x++, out += 4) {
+				const std::uint8_t* pixel = row + static_cast<size_t>(pass.columns.first[x]) * 4;
+				const float* weights = &pass.columns.weights[static_cast<size_t>(x) * pass.columns.taps];
+				float32x4_t sum = vdupq_n_f32(0.f);
+
+				for (unsigned int t = 0; t < pass.columns.taps; t++, pixel += 4) {
+					std::uint32_t value;
+					memcpy(&value, pixel, sizeof(value));
+					const uint16x8_t widened = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(value)));
+					const float32x4_t values = vcvtq_f32_u32(vmovl_u16(vget_low_u16(widened)));
+					sum = vaddq_f32(sum, vmulq_n_f32(values, weights[t]));
+				}
+
+				vst1q_f32(out, sum);
+			}
+		}
+	}
+
+	void vertical_neon(const vertical_pass& pass, unsigned int y0, unsigned int y1) {
+		const size_t stride = static_cast<size_t>(pass.target.width) * 4;
+
+		for (unsigned int y = y0; y < y1; y++) {
+			const float* first = pass.input + pass.rows.first[y] * stride;
+			const float* weights = &pass.rows.weights[static_cast<size_t>(y) * pass.rows.taps];
+			std::uint8_t* out = pass.target.pixels.data() + y * stride;
+
+			size_t k = 0;
+			for (; k + 16 <= stride; k += 16) {
+				float32x4_t sum[4] = { vdupq_n_f32(0.f), vdupq_n_f32(0.f), vdupq_n_f32(0.f), vdupq_n_f32(0.f) };
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++) {
+					const float* in = first + t * stride + k;
+
+					for (int v = 0; v < 4; v++)
+						sum[v] = vaddq_f32(sum[v], vmulq_n_f32(vld1q_f32(in + v * 4), weights[t]));
+				}
+
+				const int16x8_t low = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(sum[0])), vqmovn_s32(vcvtnq_s32_f32(sum[1])));
+				const int16x8_t high = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(sum[2])), vqmovn_s32(vcvtnq_s32_f32(sum[3])));
+				vst1q_u8(out + k, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+			}
+
+			for (; k < stride; k++) {
+				float sum = 0.f;
+
+				for (unsigned int t = 0; t < pass.rows.taps; t++)
+					sum += first[t * stride + k] * weights[t];
+
+				out[k] = to_byte(sum);
+			}
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Split rows into one contiguous range per thread.
+	/// </summary>
+	template <typename function>
+	void parallel_rows(unsigned int rows, unsigned int threads, function work) {
+		// not worth a thread for fewer than this many rows
+		constexpr unsigned int min_rows = 32;
+		threads = (std::max)(1u, (std::min)(threads, rows / min_rows));
+
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threads; i++)
+			workers.emplace_back(work,
+				static_cast<unsigned int>(static_cast<unsigned long long>(rows) * i / threads),
+				static_cast<unsigned int>(static_cast<unsigned long long>(rows) * (i + 1) / threads));
+
+		work(0u, rows / threads);
+
+		for (auto& it : workers)
+			it.join();
+	}
+}
+
+bool resample(const bitmap& source,
+	unsigned int width,
+	unsigned int height,
+	resample_filter filter,
+	bitmap& target) {
+	return resample(source, width, height, filter, detect_simd_level(), 0, target);
+}
+
+bool resample(const bitmap& source,
+	unsigned int width,
+	unsigned int height,
+	resample_filter filter,
+	simd_level level,
+	unsigned int threads,
+	bitmap& target) {
+	target = bitmap();
+
+	if (width == 0 || height == 0 || source.width == 0 || source.height == 0 ||
+		source.pixels.size() < static_cast<size_t>(source.width) * source.height * 4)
+		return false;
+
+	if (threads == 0)
+		threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+	auto horizontal = horizontal_scalar;
+	auto vertical = vertical_scalar;
+
+	switch (level) {
+#if defined(RESAMPLER_X86)
+	case simd_level::sse2:
+		horizontal = horizontal_sse2;
+		vertical = vertical_sse2;
+		break;
+	case simd_level::avx2:
+		horizontal = horizontal_avx2;
+		vertical = vertical_avx2;
+		break;
+#elif defined(RESAMPLER_NEON)
+	case simd_level::neon:
+		horizontal = horizontal_neon;
+		vertical = vertical_neon;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	const auto columns = compute_contributions(source.width, width, filter);
+	const auto rows = compute_contributions(source.height, height, filter);
+
+	std::vector<float> buffer(static_cast<size_t>(width) * source.height * 4);
+	const horizontal_pass first_pass{ source, columns, width, buffer.data() };
+
+	parallel_rows(source.height, threads, [&](unsigned int y0, unsigned int y1) {
+		horizontal(first_pass, y0, y1);
+		});
+
+	target.width = width;
+	target.height = height;
+	target.pixels.resize(static_cast<size_t>(width) * height * 4);
+	const vertical_pass second_pass{ buffer.data(), rows, target };
+
+	parallel_rows(height, threads, [&](unsigned int y0, unsigned int y1) {
+		vertical(second_pass, y0, y1);
+		});
+
+	return true;
+}
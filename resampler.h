@@ -0,0 +1,82 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+#include "cpu_features.h"
+
+/// <summary>
+/// Reconstruction filters for resampling.
+/// </summary>
+enum class resample_filter {
+	lanczos3,	// sharpest, with slight ringing on hard edges
+	mitchell,	// Mitchell-Netravali (B = C = 1/3), softer with almost no ringing
+};
+
+/// <summary>
+/// Resize an image with a separable filter.
+/// </summary>
+/// 
+/// <param name="source">The image to resize.</param>
+/// <param name="width">The width of the result, in pixels.</param>
+/// <param name="height">The height of the result, in pixels.</param>
+/// <param name="filter">The reconstruction filter.</param>
+/// <param name="target">The resized image.</param>
+/// 
+/// <returns>
+/// Returns false if either image would be empty, else true.
+/// </returns>
+/// 
+/// <remarks>
+/// Resamples horizontally then vertically through a floating point buffer,
+/// using the best instruction set available. Rows are split across one
+/// thread per core.
+/// </remarks>
+bool resample(const bitmap& source,
+	unsigned int width,
+	unsigned int height,
+	resample_filter filter,
+	bitmap& target);
+
+/// <summary>
+/// Resize an image with a specific instruction set and number of threads.
+/// </summary>
+/// 
+/// <param name="level">
+/// The instruction set to use. It must be supported, see simd_supported().
+/// </param>
+/// <param name="threads">The number of threads, or 0 for one per core.</param>
+/// 
+/// <remarks>
+/// Instruction sets sum in different orders, so their results can differ by
+/// one in the last bit of a channel.
+/// </remarks>
+bool resample(const bitmap& source,
+	unsigned int width,
+	unsigned int height,
+	resample_filter filter,
+	simd_level level,
+	unsigned int threads,
+	bitmap& target);
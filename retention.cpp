@@ -0,0 +1,517 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "retention.h"
+#include "variants.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+	constexpr const char* ledger_header = "spotlight_images retention 1";
+
+	// evicted images are forgotten after this long, by which time Windows has
+	// long since dropped them from the Spotlight folder
+	constexpr long long eviction_memory = 180ll * 24 * 60 * 60;
+
+	long long unix_now() {
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+void retention_ledger::link(const std::string& path, const entry& image) {
+	auto& bucket = _buckets[static_cast<size_t>(image.bucket)];
+	bucket.totals.count++;
+	bucket.totals.bytes += image.bytes;
+	bucket.by_fetched.insert({ image.fetched, &path });
+	bucket.by_recency.insert({ image.recency(), &path });
+
+	_totals.count++;
+	_totals.bytes += image.bytes;
+}
+
+void retention_ledger::unlink(const std::string& path, const entry& image) {
+	auto& bucket = _buckets[static_cast<size_t>(image.bucket)];
+	bucket.totals.count--;
+	bucket.totals.bytes -= image.bytes;
+	bucket.by_fetched.erase({ image.fetched, &path });
+	bucket.by_recency.erase({ image.recency(), &path });
+
+	_totals.count--;
+	_totals.bytes -= image.bytes;
+}
+
+void retention_ledger::clear() {
+	_entries.clear();
+	_buckets = {};
+	_totals = {};
+	_evicted.clear();
+}
+
+void retention_ledger::add(const std::string& full_path,
+	aspect_bucket bucket,
+	unsigned long long bytes,
+	long long fetched) {
+	if (bucket == aspect_bucket::none)
+		return;
+
+	std::lock_guard<std::mutex> lock(_lock);
+
+	auto it = _entries.find(full_path);
+	if (it == _entries.end())
+		it = _entries.emplace(full_path, entry{ bucket, bytes, fetched, 0 }).first;
+	else {
+		unlink(it->first, it->second);
+		it->second.bucket = bucket;
+		it->second.bytes = bytes;
+		it->second.fetched = fetched;
+	}
+
+	link(it->first, it->second);
+	_evicted.erase(full_path);
+}
+
+void retention_ledger::viewed(const std::string& full_path, long long when) {
+	std::lock_guard<std::mutex> lock(_lock);
+
+	auto it = _entries.find(full_path);
+	if (it == _entries.end() || when <= it->second.viewed)
+		return;
+
+	auto& bucket = _buckets[static_cast<size_t>(it->second.bucket)];
+	bucket.by_recency.erase({ it->second.recency(), &it->first });
+	it->second.viewed = when;
+	bucket.by_recency.insert({ it->second.recency(), &it->first });
+}
+
+bool retention_ledger::remove(const std::string& full_path) {
+	std::lock_guard<std::mutex> lock(_lock);
+
+	auto it = _entries.find(full_path);
+	if (it == _entries.end())
+		return false;
+
+	unlink(it->first, it->second);
+	_entries.erase(it);
+	return true;
+}
+
+void retention_ledger::evicted(const std::string& full_path, long long when) {
+	remove(full_path);
+
+	std::lock_guard<std::mutex> lock(_lock);
+	_evicted[full_path] = when;
+}
+
+bool retention_ledger::contains(const std::string& full_path) const {
+	std::lock_guard<std::mutex> lock(_lock);
+	return _entries.count(full_path) != 0;
+}
+
+bool retention_ledger::was_evicted(const std::string& full_path) const {
+	std::lock_guard<std::mutex> lock(_lock);
+	return _evicted.count(full_path) != 0;
+}
+
+size_t retention_ledger::size() const {
+	std::lock_guard<std::mutex> lock(_lock);
+	return _entries.size();
+}
+
+std::vector<std::string> retention_ledger::evicted_paths() const {
+	std::lock_guard<std::mutex> lock(_lock);
+
+	std::vector<std::string> paths;
+	paths.reserve(_evicted.size());
+
+	for (const auto& it : _evicted)
+		paths.push_back(it.first);
+
+	return paths;
+}
+
+retention_totals retention_ledger::totals(aspect_bucket bucket) const {
+	if (bucket == aspect_bucket::none)
+		return retention_totals();
+
+	std::lock_guard<std::mutex> lock(_lock);
+	return _buckets[static_cast<size_t>(bucket)].totals;
+}
+
+retention_totals retention_ledger::totals() const {
+	std::lock_guard<std::mutex> lock(_lock);
+	return _totals;
+}
+
+std::vector<std::string> retention_ledger::plan(const retention_policies& policies, long long now) const {
+	std::lock_guard<std::mutex> lock(_lock);
+
+	std::vector<std::string> paths;
+
+	for (size_t i = 0; i < aspect_bucket_count; i++) {
+		const auto& policy = policies[i];
+		const auto& bucket = _buckets[i];
+
+		if (policy.unlimited())
+			continue;
+
+		retention_totals remaining = bucket.totals;
+		std::unordered_set<const std::string*> chosen;
+
+		auto choose = [&](const std::string* path) {
+			chosen.insert(path);
+			paths.push_back(*path);
+			remaining.count--;
+			remaining.bytes -= _entries.at(*path).bytes;
+		};
+
+		if (policy.max_age)
+			for (const auto& it : bucket.by_fetched) {
+				if (now - it.first <= policy.max_age)
+					break;
+
+				choose(it.second);
+			}
+
+		const auto& order = policy.order == retention_order::oldest_fetched ?
+			bucket.by_fetched : bucket.by_recency;
+
+		for (const auto& it : order) {
+			const bool over_count = policy.max_count && remaining.count > policy.max_count;
+			const bool over_bytes = policy.max_bytes && remaining.bytes > policy.max_bytes;
+
+			if (!over_count && !over_bytes)
+				break;
+
+			if (!chosen.count(it.second))
+				choose(it.second);
+		}
+	}
+
+	return paths;
+}
+
+bool retention_ledger::scan(const std::string& folder, std::string& error) {
+	struct found {
+		aspect_bucket bucket = aspect_bucket::none;
+		unsigned long long bytes = 0;
+		bool exists = false;
+	};
+
+	// images are aged from when they came into the library, as apply_retention
+	// does, and the files don't record that, so new entries start now
+	const long long now = unix_now();
+
+	std::unordered_map<std::string, found> images;
+
+	try {
+		for (const auto& spec : aspect_buckets) {
+			const std::filesystem::path bucket_folder = std::filesystem::path(folder) / spec.folder;
+
+			if (!std::filesystem::is_directory(bucket_folder))
+				continue;
+
+			for (const auto& it : std::filesystem::directory_iterator(bucket_folder)) {
+				if (!it.is_regular_file())
+					continue;
+
+				const std::string path = it.path().string();
+				std::string original;
+
+				if (variant_original(path, original)) {
+					// counted with the original, if it turns out to exist
+					images[original].bytes += it.file_size();
+					continue;
+				}
+
+				auto& image = images[path];
+				image.bucket = spec.bucket;
+				image.bytes += it.file_size();
+				image.exists = true;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_lock);
+
+	// keep what is known about fetches, views and evictions
+	std::unordered_map<std::string, std::pair<long long, long long>> known;
+	for (const auto& it : _entries)
+		known.emplace(it.first, std::make_pair(it.second.fetched, it.second.viewed));
+
+	auto evicted = std::move(_evicted);
+	clear();
+	_evicted = std::move(evicted);
+	_entries.reserve(images.size());
+
+	for (const auto& it : images) {
+		if (!it.second.exists)
+			continue;	// variants whose original was deleted
+
+		const auto known_it = known.find(it.first);
+		const auto inserted = _entries.emplace(it.first, entry{ it.second.bucket, it.second.bytes,
+			known_it == known.end() ? now : known_it->second.first,
+			known_it == known.end() ? 0 : known_it->second.second }).first;
+
+		link(inserted->first, inserted->second);
+		_evicted.erase(it.first);
+	}
+
+	return true;
+}
+
+bool retention_ledger::save(const std::string& full_path, std::string& error) const {
+	const long long now = unix_now();
+	const std::string temp_path = full_path + ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::trunc);
+		if (!file) {
+			error = "Unable to write " + temp_path;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(_lock);
+		file << ledger_header << '\n';
+
+		// tab separated, with the path last since it may contain anything but a tab or newline
+		for (const auto& it : _entries)
+			file << "I\t" << static_cast<int>(it.second.bucket) << '\t' << it.second.bytes << '\t' <<
+			it.second.fetched << '\t' << it.second.viewed << '\t' << it.first << '\n';
+
+		for (const auto& it : _evicted)
+			if (now - it.second < eviction_memory)
+				file << "E\t" << it.second << '\t' << it.first << '\n';
+
+		if (!file) {
+			error = "Unable to write " + temp_path;
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, full_path, ec);
+	if (ec) {
+		error = ec.message();
+		return false;
+	}
+
+	return true;
+}
+
+bool retention_ledger::load(const std::string& full_path, std::string& error) {
+	std::ifstream file(full_path);
+	if (!file) {
+		error = "Unable to read " + full_path;
+		return false;
+	}
+
+	std::string line;
+	if (!std::getline(file, line) || line != ledger_header) {
+		error = "Unsupported retention ledger";
+		return false;
+	}
+
+	std::vector<std::pair<std::string, entry>> images;
+	std::vector<std::pair<std::string, long long>> evicted;
+
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string kind, path;
+
+		if (!std::getline(fields, kind, '\t'))
+			continue;
+
+		if (kind == "I") {
+			int bucket = 0;
+			entry image{};
+			fields >> bucket >> image.bytes >> image.fetched >> image.viewed;
+			fields.ignore(1);
+
+			if (!fields || !std::getline(fields, path) || path.empty() ||
+				bucket < 0 || bucket >= static_cast<int>(aspect_bucket_count))
+				continue;
+
+			image.bucket = static_cast<aspect_bucket>(bucket);
+			images.emplace_back(std::move(path), image);
+		}
+		else if (kind == "E") {
+			long long when = 0;
+			fields >> when;
+			fields.ignore(1);
+
+			if (fields && std::getline(fields, path) && !path.empty())
+				evicted.emplace_back(std::move(path), when);
+		}
+	}
+
+	// images the user deleted since the ledger was saved would keep counting
+	// towards the totals, and plan() would pick them instead of images that
+	// are still there; checked before locking, so that viewed() doesn't wait
+	images.erase(std::remove_if(images.begin(), images.end(), [](const std::pair<std::string, entry>& it) {
+		std::error_code ec;
+		return !std::filesystem::exists(it.first, ec) && !ec;
+		}), images.end());
+
+	std::lock_guard<std::mutex> lock(_lock);
+	clear();
+
+	for (auto& it : images) {
+		const auto inserted = _entries.emplace(std::move(it.first), it.second);
+		if (inserted.second)
+			link(inserted.first->first, inserted.first->second);
+	}
+
+	for (auto& it : evicted)
+		_evicted[std::move(it.first)] = it.second;
+
+	return true;
+}
+
+bool evict_images(retention_ledger& ledger,
+	const std::vector<std::string>& paths,
+	size_t batch_size,
+	unsigned int pause_ms,
+	std::vector<std::string>& removed,
+	io_scheduler* io,
+	const fetch_job* job) {
+	removed.clear();
+	io_priority_scope priority(io ? io->limits().priority : io_priority::normal);
+	bool all_removed = true;
+	batch_size = (std::max)(batch_size, static_cast<size_t>(1));
+
+	for (size_t first = 0; first < paths.size(); first += batch_size) {
+		if (first)
+			std::this_thread::sleep_for(std::chrono::milliseconds(pause_ms));
+
+		const size_t last = (std::min)(paths.size(), first + batch_size);
+		const std::unordered_set<std::string> batch(paths.begin() + first, paths.begin() + last);
+
+		// one delete for each image, the variants ride along
+		if (io && !io->acquire(io_scheduler::metadata_cost * (last - first), job)) {
+			all_removed = false;
+			break;
+		}
+
+		// the variants, found with one listing of each folder in the batch
+		std::unordered_set<std::string_view> folders;
+		for (const auto& it : batch) {
+			const auto directory = path_directory(it);
+			if (!directory.empty())
+				folders.insert(directory);
+		}
+
+		for (const auto& folder : folders) {
+			std::error_code ec;
+			for (std::filesystem::directory_iterator it(folder, ec), end; !ec && it != end; it.increment(ec)) {
+				std::string original;
+				if (variant_original(it->path().string(), original) && batch.count(original))
+					std::filesystem::remove(it->path(), ec);
+			}
+		}
+
+		const long long now = unix_now();
+
+		for (size_t i = first; i < last; i++) {
+			std::error_code ec;
+			std::filesystem::remove(paths[i], ec);
+
+			if (ec) {
+				all_removed = false;
+				continue;
+			}
+
+			ledger.evicted(paths[i], now);
+			removed.push_back(paths[i]);
+		}
+	}
+
+	return all_removed;
+}
+
+std::string retention_ledger_path(const std::string& folder) {
+	return join_path(folder, ".retention");
+}
+
+bool apply_retention(const retention_policies& policies,
+	const variant_options& variants,
+	retention_ledger& ledger,
+	image_catalog& images,
+	std::vector<std::string>& removed,
+	io_scheduler* io,
+	const fetch_job* job) {
+	removed.clear();
+	const long long now = unix_now();
+
+	for (image_id id = 0; id < images.size(); id++) {
+		const auto path = images.full_path(id);
+		if (ledger.contains(path))
+			continue;
+
+		std::error_code ec;
+		auto bytes = std::filesystem::file_size(path, ec);
+		if (ec)
+			continue;
+
+		for (const auto width : variants.widths) {
+			const auto size = std::filesystem::file_size(variant_path(path, width, variants.crop), ec);
+			if (!ec)
+				bytes += size;
+		}
+
+		// the catalog's fetch time is the asset's write time; the policies age
+		// images from when they came into the library, as scan() does
+		ledger.add(path, classify_aspect(images.width(id), images.height(id)), bytes, now);
+	}
+
+	const bool all_removed = evict_images(ledger, ledger.plan(policies, now), 16, 50, removed, io, job);
+
+	if (!removed.empty()) {
+		const std::unordered_set<std::string> gone(removed.begin(), removed.end());
+
+		image_catalog kept;
+		kept.reserve(images.size());
+
+		for (image_id id = 0; id < images.size(); id++)
+			if (!gone.count(images.full_path(id)))
+				kept.add(images.directory(id), images.name(id), images.orientation(id), images.file_size(id),
+					images.width(id), images.height(id), images.fetched(id),
+					images.colours(id), images.quality(id), images.crops(id), images.signature(id));
+
+		images = std::move(kept);
+	}
+
+	return all_removed;
+}
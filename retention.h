@@ -0,0 +1,295 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "aspect_buckets.h"
+#include "catalog.h"
+#include "io_scheduler.h"
+#include "variants.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Which images are removed first when a bucket is over its limits.
+/// </summary>
+enum class retention_order : std::uint8_t {
+	oldest_fetched = 0,
+	least_recently_viewed,	// images never viewed count as viewed when they were fetched
+};
+
+/// <summary>
+/// The limits of one aspect ratio bucket. Zero means no limit.
+/// </summary>
+struct retention_policy {
+	size_t max_count = 0;
+	unsigned long long max_bytes = 0;	// including the image's variants
+	long long max_age = 0;	// seconds since the image was fetched
+	retention_order order = retention_order::oldest_fetched;
+
+	bool unlimited() const {
+		return max_count == 0 && max_bytes == 0 && max_age == 0;
+	}
+};
+
+using retention_policies = std::array<retention_policy, aspect_bucket_count>;
+
+/// <summary>
+/// The size of a bucket.
+/// </summary>
+struct retention_totals {
+	size_t count = 0;
+	unsigned long long bytes = 0;
+};
+
+/// <summary>
+/// Keeps track of the images in a library and decides which to remove.
+/// </summary>
+/// 
+/// <remarks>
+/// Totals are kept per bucket and updated as images are added and removed,
+/// so they are read in constant time and the library folder only has to be
+/// scanned once, when there is no saved ledger. Each bucket also keeps its
+/// images ordered by fetch time and by last view, so planning an eviction
+/// only visits the images that are evicted.
+/// 
+/// Removed images are remembered so that fetching does not copy them back
+/// while they are still in the Spotlight folder.
+/// 
+/// All methods are thread safe.
+/// </remarks>
+class retention_ledger {
+public:
+	retention_ledger() = default;
+	retention_ledger(const retention_ledger&) = delete;
+	retention_ledger& operator=(const retention_ledger&) = delete;
+
+	/// <summary>
+	/// Add an image, or update it if it is already in the ledger.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the image.</param>
+	/// <param name="bucket">The bucket the image is in.</param>
+	/// <param name="bytes">The size of the image and its variants, in bytes.</param>
+	/// <param name="fetched">When the image came into the library, in seconds since the Unix epoch.</param>
+	void add(const std::string& full_path,
+		aspect_bucket bucket,
+		unsigned long long bytes,
+		long long fetched);
+
+	/// <summary>
+	/// Record that an image was viewed.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the image.</param>
+	/// <param name="when">When it was viewed, in seconds since the Unix epoch.</param>
+	void viewed(const std::string& full_path, long long when);
+
+	/// <summary>
+	/// Remove an image, for example because its file no longer exists.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// Returns true if the image was in the ledger, else false.
+	/// </returns>
+	bool remove(const std::string& full_path);
+
+	/// <summary>
+	/// Remove an image that was evicted, remembering it so it is not fetched again.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the image.</param>
+	/// <param name="when">When it was evicted, in seconds since the Unix epoch.</param>
+	void evicted(const std::string& full_path, long long when);
+
+	bool contains(const std::string& full_path) const;
+	bool was_evicted(const std::string& full_path) const;
+	size_t size() const;
+
+	/// <summary>
+	/// Get the full paths of the images that were evicted.
+	/// </summary>
+	std::vector<std::string> evicted_paths() const;
+
+	/// <summary>
+	/// Get the totals of a bucket, in constant time.
+	/// </summary>
+	retention_totals totals(aspect_bucket bucket) const;
+
+	/// <summary>
+	/// Get the totals of the whole library, in constant time.
+	/// </summary>
+	retention_totals totals() const;
+
+	/// <summary>
+	/// Work out which images to remove to bring every bucket within its policy.
+	/// </summary>
+	/// 
+	/// <param name="policies">The policy of each bucket.</param>
+	/// <param name="now">The current time, in seconds since the Unix epoch.</param>
+	/// 
+	/// <returns>
+	/// The full paths of the images to remove: first the images that are too
+	/// old, then images in the policy's order until the bucket is within its
+	/// count and size limits.
+	/// </returns>
+	std::vector<std::string> plan(const retention_policies& policies, long long now) const;
+
+	/// <summary>
+	/// Build the ledger from the files in a library's bucket folders.
+	/// </summary>
+	/// 
+	/// <param name="folder">The library folder.</param>
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if successful, else false.
+	/// </returns>
+	/// 
+	/// <remarks>
+	/// Variants are counted with their original. Images the ledger already has
+	/// keep their fetch time; when the others came into the library isn't
+	/// recorded anywhere, so they are taken to have come now, as images added
+	/// by apply_retention are. Taking their write time instead would age a
+	/// whole existing library at once.
+	/// </remarks>
+	bool scan(const std::string& folder, std::string& error);
+
+	/// <summary>
+	/// Save the ledger to a file.
+	/// </summary>
+	bool save(const std::string& full_path, std::string& error) const;
+
+	/// <summary>
+	/// Load a ledger saved with save(), replacing the contents of this one.
+	/// Images whose files no longer exist, e.g. because the user deleted them,
+	/// are left out.
+	/// </summary>
+	bool load(const std::string& full_path, std::string& error);
+
+private:
+	struct entry {
+		aspect_bucket bucket;
+		unsigned long long bytes;
+		long long fetched;
+		long long viewed;	// 0 if never viewed
+
+		long long recency() const {
+			return viewed > fetched ? viewed : fetched;
+		}
+	};
+
+	using order_key = std::pair<long long, const std::string*>;
+
+	struct order_less {
+		bool operator()(const order_key& a, const order_key& b) const {
+			return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+		}
+	};
+
+	struct bucket_index {
+		retention_totals totals;
+		std::set<order_key, order_less> by_fetched;
+		std::set<order_key, order_less> by_recency;
+	};
+
+	void link(const std::string& path, const entry& image);
+	void unlink(const std::string& path, const entry& image);
+	void clear();
+
+	mutable std::mutex _lock;
+
+	// the indexes point at the keys of _entries, which stay put when the map grows
+	std::unordered_map<std::string, entry> _entries;
+	std::array<bucket_index, aspect_bucket_count> _buckets;
+	retention_totals _totals;
+	std::unordered_map<std::string, long long> _evicted;
+};
+
+/// <summary>
+/// Delete images and their variants in small batches, pausing in between so
+/// that a large eviction does not hog the disk.
+/// </summary>
+/// 
+/// <param name="ledger">The ledger, which records each eviction.</param>
+/// <param name="paths">The full paths to the images, from retention_ledger::plan().</param>
+/// <param name="batch_size">The number of images to delete between pauses.</param>
+/// <param name="pause_ms">The pause between batches, in milliseconds.</param>
+/// <param name="removed">The full paths to the images that were removed.</param>
+/// <param name="io">Paces and prioritizes the deletes, if not null.</param>
+/// <param name="job">Stops the deletes while they are paced, if not null.</param>
+/// 
+/// <returns>
+/// Returns true if every image was removed, else false. Images that are
+/// already gone count as removed.
+/// </returns>
+bool evict_images(retention_ledger& ledger,
+	const std::vector<std::string>& paths,
+	size_t batch_size,
+	unsigned int pause_ms,
+	std::vector<std::string>& removed,
+	io_scheduler* io = nullptr,
+	const fetch_job* job = nullptr);
+
+/// <summary>
+/// Get the path of a library's retention ledger.
+/// </summary>
+std::string retention_ledger_path(const std::string& folder);
+
+/// <summary>
+/// Bring a library within its retention policies after a fetch.
+/// </summary>
+/// 
+/// <param name="policies">The policy of each bucket.</param>
+/// <param name="variants">The variants made by the fetch, so that their size is counted.</param>
+/// <param name="ledger">The library's ledger.</param>
+/// <param name="images">
+/// The catalog from the fetch. Images it has that the ledger doesn't are
+/// added to the ledger, and evicted images are removed from it.
+/// </param>
+/// <param name="removed">The full paths to the images that were evicted.</param>
+/// <param name="io">Paces and prioritizes the deletes, if not null.</param>
+/// <param name="job">Stops the deletes while they are paced, if not null.</param>
+/// 
+/// <returns>
+/// Returns true if every image that had to be evicted was, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// Only new images are looked up on disk; everything else comes from the
+/// ledger's running totals.
+/// </remarks>
+bool apply_retention(const retention_policies& policies,
+	const variant_options& variants,
+	retention_ledger& ledger,
+	image_catalog& images,
+	std::vector<std::string>& removed,
+	io_scheduler* io = nullptr,
+	const fetch_job* job = nullptr);
@@ -0,0 +1,190 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "scan_arena.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace {
+	// copy characters into an arena; it only frees them all at once anyway
+	std::string_view copy_to(std::pmr::memory_resource* memory, std::string_view first, std::string_view second = {},
+		std::string_view third = {}) {
+		const size_t size = first.size() + second.size() + third.size();
+		auto* text = static_cast<char*>(memory->allocate((std::max)(size, static_cast<size_t>(1)), alignof(char)));
+
+		std::copy(third.begin(), third.end(),
+			std::copy(second.begin(), second.end(),
+				std::copy(first.begin(), first.end(), text)));
+
+		return std::string_view(text, size);
+	}
+}
+
+scan_arena::scan_arena(std::pmr::memory_resource* upstream) :
+	_scan(64 * 1024, upstream),
+	_file(_file_buffer.data(), _file_buffer.size(), upstream) {}
+
+std::pmr::memory_resource* scan_arena::scan() {
+	return &_scan;
+}
+
+std::pmr::memory_resource* scan_arena::file() {
+	return &_file;
+}
+
+void scan_arena::next_file() {
+	// back to the start of the buffer, returning anything a long path needed
+	_file.release();
+}
+
+library_lookup::library_lookup(const std::string& folder,
+	const image_catalog& known,
+	const std::unordered_set<std::string>& excluded,
+	scan_arena& arena) :
+	_arena(arena),
+	_known(arena.scan()),
+	_excluded(arena.scan()),
+	_known_paths(arena.scan()) {
+	for (size_t i = 0; i < aspect_bucket_count; i++)
+		join_path(folder, aspect_buckets[i].folder, _bucket_folders[i]);
+
+	// all the paths first, so that the views into them stay valid
+	size_t bytes = 0;
+	for (image_id id = 0; id < known.size(); id++)
+		bytes += known.directory(id).size() + 1 + known.name(id).size();
+
+	_known_paths.reserve(bytes);
+	for (image_id id = 0; id < known.size(); id++) {
+		_known_paths.append(known.directory(id));
+		_known_paths += path_separator;
+		_known_paths.append(known.name(id));
+	}
+
+	_known.reserve(known.size());
+	size_t offset = 0;
+	for (image_id id = 0; id < known.size(); id++) {
+		const size_t size = known.directory(id).size() + 1 + known.name(id).size();
+		_known.emplace(std::string_view(_known_paths).substr(offset, size), id);
+		offset += size;
+	}
+
+	_excluded.reserve(excluded.size());
+	for (const auto& it : excluded)
+		_excluded.insert(it);
+}
+
+std::string_view library_lookup::source_name(const std::filesystem::path& source) const {
+#ifdef _WIN32
+	// windows paths are wide, so the name is converted straight into the arena
+	const std::wstring_view name = path_filename(source.native());
+	const int size = WideCharToMultiByte(CP_ACP, 0, name.data(), static_cast<int>(name.size()), NULL, 0, NULL, NULL);
+	auto* text = static_cast<char*>(_arena.scan()->allocate((std::max)(size, 1), alignof(char)));
+	WideCharToMultiByte(CP_ACP, 0, name.data(), static_cast<int>(name.size()), text, size, NULL, NULL);
+	return std::string_view(text, size);
+#else
+	return copy_to(_arena.scan(), path_filename(source.native()));
+#endif
+}
+
+std::string_view library_lookup::file_name(std::string_view source_name) const {
+	return has_extension(source_name, ".jpg") || has_extension(source_name, ".jpeg") ?
+		source_name :
+		copy_to(_arena.scan(), source_name, ".jpg");
+}
+
+size_t library_lookup::unique_names(std::pmr::vector<library_name>& names) const {
+	// the file that keeps each name, by bucket and lower case name
+	std::pmr::unordered_map<std::pmr::string, size_t> owners(_arena.scan());
+	owners.reserve(names.size());
+
+	std::pmr::vector<const size_t*> owner_of(names.size(), _arena.scan());
+	std::pmr::string key(_arena.scan());
+
+	auto first = [](const library_name& a, const library_name& b) {
+		return a.source_index != b.source_index ? a.source_index < b.source_index : *a.source < *b.source;
+	};
+
+	for (size_t i = 0; i < names.size(); i++) {
+		key.assign(1, static_cast<char>('0' + static_cast<int>(names[i].bucket)));
+		for (const char c : names[i].file_name)
+			key += c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+
+		const auto result = owners.emplace(key, i);
+		if (!result.second && first(names[i], names[result.first->second]))
+			result.first->second = i;
+
+		// the nodes of the map never move
+		owner_of[i] = &result.first->second;
+	}
+
+	size_t renamed = 0;
+	for (size_t i = 0; i < names.size(); i++) {
+		if (*owner_of[i] == i)
+			continue;
+
+		names[i].file_name = unique_file_name(names[i].file_name, *names[i].source);
+		renamed++;
+	}
+
+	return renamed;
+}
+
+std::string_view library_lookup::unique_file_name(std::string_view file_name, const std::filesystem::path& source) const {
+	// FNV-1a, which unlike std::hash is the same in every build
+	std::uint32_t hash = 2166136261u;
+	for (const auto c : source.native()) {
+		hash ^= static_cast<std::uint32_t>(c);
+		hash *= 16777619u;
+	}
+
+	char suffix[10];
+	snprintf(suffix, sizeof(suffix), "_%08x", hash);
+
+	const auto extension = path_extension(file_name);
+	return copy_to(_arena.scan(), file_name.substr(0, file_name.size() - extension.size()), suffix, extension);
+}
+
+std::string_view library_lookup::library_path(aspect_bucket bucket, std::string_view file_name) const {
+	return copy_to(_arena.file(), bucket_folder(bucket), std::string_view(&path_separator, 1), file_name);
+}
+
+bool library_lookup::excluded(std::string_view library_path) const {
+	return _excluded.count(library_path) != 0;
+}
+
+image_id library_lookup::find(std::string_view library_path) const {
+	const auto it = _known.find(library_path);
+	return it == _known.end() ? invalid_image_id : it->second;
+}
+
+const std::string& library_lookup::bucket_folder(aspect_bucket bucket) const {
+	return _bucket_folders[static_cast<size_t>(bucket)];
+}
@@ -0,0 +1,190 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "aspect_buckets.h"
+#include "catalog.h"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// Memory for the temporary data of one scan of the sources.
+/// </summary>
+/// 
+/// <remarks>
+/// Data that lives for the whole scan, such as lookup tables and the names of
+/// the candidates, comes from scan(). Data that only lives while one file is
+/// looked at comes from file(), which next_file() releases; it starts in a
+/// buffer inside the arena, so in the steady state it costs no heap
+/// allocations at all. Not thread-safe: a scan's files are looked at on one
+/// thread.
+/// </remarks>
+class scan_arena {
+public:
+	explicit scan_arena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+	scan_arena(const scan_arena&) = delete;
+	scan_arena& operator=(const scan_arena&) = delete;
+
+	std::pmr::memory_resource* scan();
+	std::pmr::memory_resource* file();
+
+	/// <summary>
+	/// Release the memory of the file just looked at.
+	/// </summary>
+	void next_file();
+
+private:
+	std::pmr::monotonic_buffer_resource _scan;
+	alignas(std::max_align_t) std::array<std::byte, 4096> _file_buffer;
+	std::pmr::monotonic_buffer_resource _file;
+};
+
+/// <summary>
+/// A file of a scan on its way into the library.
+/// </summary>
+struct library_name {
+	aspect_bucket bucket = aspect_bucket::none;
+	std::string_view file_name;	// from library_lookup::file_name()
+	const std::filesystem::path* source = nullptr;
+	size_t source_index = 0;	// the index of the source it was found in
+};
+
+/// <summary>
+/// Where a scan's files go in a library, and what the library knows about them.
+/// </summary>
+/// 
+/// <remarks>
+/// The tables are built once per scan in the scan's arena, keyed by views of
+/// the catalog's and the excluded set's paths, so looking up a file makes no
+/// copies. Both must outlive the lookup.
+/// </remarks>
+class library_lookup {
+public:
+	/// <summary>
+	/// Build the tables for a scan.
+	/// </summary>
+	/// 
+	/// <param name="folder">The library folder.</param>
+	/// <param name="known">The images the library already has.</param>
+	/// <param name="excluded">Library paths not to fetch again.</param>
+	/// <param name="arena">The scan's arena.</param>
+	library_lookup(const std::string& folder,
+		const image_catalog& known,
+		const std::unordered_set<std::string>& excluded,
+		scan_arena& arena);
+
+	/// <summary>
+	/// Get the file name of a source file, converted to a narrow string on
+	/// Windows.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The name, in the arena's scan memory, so it is valid for the whole scan.
+	/// </returns>
+	std::string_view source_name(const std::filesystem::path& source) const;
+
+	/// <summary>
+	/// Get the library file name for a source file: Spotlight assets have no
+	/// extension, files in drop folders may already have one.
+	/// </summary>
+	/// 
+	/// <param name="source_name">The name returned by source_name().</param>
+	/// 
+	/// <returns>
+	/// The source's name with .jpg added unless it already ends in .jpg or
+	/// .jpeg, in any case. Like the source name, it is in the arena's scan
+	/// memory.
+	/// </returns>
+	std::string_view file_name(std::string_view source_name) const;
+
+	/// <summary>
+	/// Make sure that no two files of a scan go to the same library path.
+	/// </summary>
+	/// 
+	/// <param name="names">The files, whose names are changed where needed.</param>
+	/// 
+	/// <returns>
+	/// The number of files that were renamed.
+	/// </returns>
+	/// 
+	/// <remarks>
+	/// Different files can share a name, e.g. IMG_1000.jpg in two drop folders.
+	/// The file from the first source, or the first by path within a source,
+	/// keeps the name; the others get a suffix made from a hash of their source
+	/// path, so that they get the same name in every fetch. Names are compared
+	/// ignoring ASCII case, as they are on Windows. The new names are in the
+	/// arena's scan memory.
+	/// </remarks>
+	size_t unique_names(std::pmr::vector<library_name>& names) const;
+
+	/// <summary>
+	/// Get the full path a file goes to in the library.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The path, in the arena's file memory, so it is only valid until
+	/// scan_arena::next_file().
+	/// </returns>
+	std::string_view library_path(aspect_bucket bucket, std::string_view file_name) const;
+
+	/// <summary>
+	/// Check whether a library path is excluded from the fetch.
+	/// </summary>
+	bool excluded(std::string_view library_path) const;
+
+	/// <summary>
+	/// Find an image the library already has.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The image's id in the known catalog, or invalid_image_id.
+	/// </returns>
+	image_id find(std::string_view library_path) const;
+
+	/// <summary>
+	/// Get the folder of a bucket in the library.
+	/// </summary>
+	const std::string& bucket_folder(aspect_bucket bucket) const;
+
+private:
+	std::string_view unique_file_name(std::string_view file_name, const std::filesystem::path& source) const;
+
+	scan_arena& _arena;
+	std::array<std::string, aspect_bucket_count> _bucket_folders;
+	std::pmr::unordered_map<std::string_view, image_id> _known;
+	std::pmr::unordered_set<std::string_view> _excluded;
+
+	// the known catalog's paths, which it only keeps in pieces
+	std::pmr::string _known_paths;
+};
@@ -0,0 +1,474 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "search_index.h"
+#include "aspect_buckets.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cctype>
+#include <limits>
+
+namespace {
+	char lower(char c) {
+		return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+
+	bool alphanumeric(char c) {
+		return std::isalnum(static_cast<unsigned char>(c)) != 0;
+	}
+
+	/// <summary>
+	/// Split text into lower case words of letters and digits.
+	/// </summary>
+	void split_words(std::string_view text, std::vector<std::string>& words) {
+		std::string word;
+
+		for (const char c : text) {
+			if (alphanumeric(c))
+				word += lower(c);
+			else if (!word.empty()) {
+				words.push_back(word);
+				word.clear();
+			}
+		}
+
+		if (!word.empty())
+			words.push_back(word);
+	}
+
+	/// <summary>
+	/// Name a colour, roughly as a person would.
+	/// </summary>
+	const char* colour_name(std::uint32_t rgb) {
+		const int r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+		const int max = (std::max)({ r, g, b }), min = (std::min)({ r, g, b });
+
+		if (max - min < 48)
+			return max < 64 ? "black" : min > 192 ? "white" : "grey";
+
+		// hue, in degrees
+		const int chroma = max - min;
+		int hue = 0;
+		if (max == r)
+			hue = (60 * (g - b) / chroma + 360) % 360;
+		else if (max == g)
+			hue = 60 * (b - r) / chroma + 120;
+		else
+			hue = 60 * (r - g) / chroma + 240;
+
+		if (hue < 20 || hue >= 330) return "red";
+		if (hue < 45) return max <= 160 ? "brown" : "orange";
+		if (hue < 70) return "yellow";
+		if (hue < 165) return "green";
+		if (hue < 195) return "cyan";
+		if (hue < 260) return "blue";
+		if (hue < 300) return "purple";
+		return "pink";
+	}
+
+	/// <summary>
+	/// The Unix time at the start of a UTC date.
+	/// </summary>
+	long long unix_time(int year, unsigned int month, unsigned int day) {
+		// days from civil, proleptic Gregorian calendar
+		year -= month <= 2;
+		const long long era = (year >= 0 ? year : year - 399) / 400;
+		const unsigned int year_of_era = static_cast<unsigned int>(year - era * 400);
+		const unsigned int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		const unsigned int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+		return (era * 146097 + static_cast<long long>(day_of_era) - 719468) * 86400;
+	}
+
+	/// <summary>
+	/// Parse YYYY, YYYY-MM or YYYY-MM-DD.
+	/// </summary>
+	bool parse_date(std::string_view text, long long& time) {
+		unsigned int parts[3] = { 0, 1, 1 };
+		size_t part = 0, digits = 0;
+
+		for (const char c : text) {
+			if (c == '-') {
+				if (digits == 0 || ++part == 3)
+					return false;
+
+				parts[part] = 0;
+				digits = 0;
+			}
+			else if (std::isdigit(static_cast<unsigned char>(c)) && digits < 4) {
+				parts[part] = parts[part] * 10 + (c - '0');
+				digits++;
+			}
+			else
+				return false;
+		}
+
+		if (digits == 0 || parts[0] < 1970 || parts[1] < 1 || parts[1] > 12 || parts[2] < 1 || parts[2] > 31)
+			return false;
+
+		time = unix_time(static_cast<int>(parts[0]), parts[1], parts[2]);
+		return true;
+	}
+
+	/// <summary>
+	/// Parse a number with an optional size unit, e.g. 1920, 1.5mb or 500kb.
+	/// </summary>
+	bool parse_number(std::string_view text, bool sizes, double& value) {
+		size_t i = 0;
+		value = 0.;
+		double scale = 1.;
+		bool fraction = false, digits = false;
+
+		for (; i < text.size(); i++) {
+			const char c = text[i];
+
+			if (std::isdigit(static_cast<unsigned char>(c))) {
+				if (fraction)
+					scale /= 10.;
+
+				value = value * 10. + (c - '0');
+				digits = true;
+			}
+			else if (c == '.' && !fraction)
+				fraction = true;
+			else
+				break;
+		}
+
+		if (!digits)
+			return false;
+
+		value *= fraction ? scale : 1.;
+
+		std::string unit;
+		for (; i < text.size(); i++)
+			unit += lower(text[i]);
+
+		if (unit.empty())
+			return true;
+
+		if (!sizes)
+			return false;
+
+		if (unit == "b") return true;
+		if (unit == "k" || unit == "kb") { value *= 1024.; return true; }
+		if (unit == "m" || unit == "mb") { value *= 1024. * 1024.; return true; }
+		if (unit == "g" || unit == "gb") { value *= 1024. * 1024. * 1024.; return true; }
+		return false;
+	}
+
+	/// <summary>
+	/// An inclusive range of values.
+	/// </summary>
+	struct range {
+		long long min = (std::numeric_limits<long long>::min)();
+		long long max = (std::numeric_limits<long long>::max)();
+
+		bool contains(long long value) const {
+			return value >= min && value <= max;
+		}
+
+		bool limited() const {
+			return min != (std::numeric_limits<long long>::min)() ||
+				max != (std::numeric_limits<long long>::max)();
+		}
+	};
+
+	/// <summary>
+	/// Narrow a range with a comparison, e.g. "&gt;=" and 1920.
+	/// </summary>
+	void narrow(range& values, std::string_view comparison, long long value) {
+		if (comparison == "=" || comparison == ":") {
+			values.min = (std::max)(values.min, value);
+			values.max = (std::min)(values.max, value);
+		}
+		else if (comparison == ">")
+			values.min = (std::max)(values.min, value + 1);
+		else if (comparison == ">=")
+			values.min = (std::max)(values.min, value);
+		else if (comparison == "<")
+			values.max = (std::min)(values.max, value - 1);
+		else if (comparison == "<=")
+			values.max = (std::min)(values.max, value);
+	}
+
+	/// <summary>
+	/// The numeric conditions of a search.
+	/// </summary>
+	struct conditions {
+		range width, height, size, fetched;
+
+		bool limited() const {
+			return width.limited() || height.limited() || size.limited() || fetched.limited();
+		}
+	};
+
+	/// <summary>
+	/// Try to read a word as a condition.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// Returns true if the word is a condition, even one that is still being
+	/// typed, else false.
+	/// </returns>
+	bool parse_condition(std::string_view word, conditions& found) {
+		const auto colon = word.find(':');
+		if (colon != std::string_view::npos) {
+			std::string key;
+			for (const char c : word.substr(0, colon))
+				key += lower(c);
+
+			if (key != "after" && key != "before")
+				return false;
+
+			long long time = 0;
+			if (parse_date(word.substr(colon + 1), time)) {
+				if (key == "after")
+					narrow(found.fetched, ">=", time);
+				else
+					narrow(found.fetched, "<", time);
+			}
+
+			return true;
+		}
+
+		const auto split = word.find_first_of("<>=");
+		if (split == std::string_view::npos || split == 0)
+			return false;
+
+		std::string key;
+		for (const char c : word.substr(0, split))
+			key += lower(c);
+
+		range* values = nullptr;
+		bool age = false;
+
+		if (key == "width" || key == "w")
+			values = &found.width;
+		else if (key == "height" || key == "h")
+			values = &found.height;
+		else if (key == "size")
+			values = &found.size;
+		else if (key == "age")
+			age = true;
+		else
+			return false;
+
+		auto rest = word.substr(split);
+		const size_t operator_size = rest.size() > 1 && rest[1] == '=' ? 2 : 1;
+		const auto comparison = rest.substr(0, operator_size);
+		rest.remove_prefix(operator_size);
+
+		double value = 0.;
+		if (!parse_number(rest, values == &found.size, value))
+			return true;
+
+		if (!age) {
+			narrow(*values, comparison, static_cast<long long>(value + .5));
+			return true;
+		}
+
+		// an age in days is a fetch time with the comparison reversed
+		const long long now = std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		const long long time = now - static_cast<long long>(value * 86400.);
+
+		if (comparison == "<") narrow(found.fetched, ">", time);
+		else if (comparison == "<=") narrow(found.fetched, ">=", time);
+		else if (comparison == ">") narrow(found.fetched, "<", time);
+		else if (comparison == ">=") narrow(found.fetched, "<=", time);
+		else {
+			// the whole day
+			narrow(found.fetched, ">", time - 86400);
+			narrow(found.fetched, "<=", time);
+		}
+
+		return true;
+	}
+}
+
+bool image_set::contains(image_id id) const {
+	const size_t word = id / 64;
+	return word < _bits.size() && (_bits[word] >> (id % 64) & 1);
+}
+
+size_t image_set::count() const {
+	return _count;
+}
+
+std::vector<image_id> image_set::filter(const std::vector<image_id>& ids) const {
+	std::vector<image_id> kept;
+	kept.reserve(_count);
+
+	for (const auto id : ids)
+		if (contains(id))
+			kept.push_back(id);
+
+	return kept;
+}
+
+void image_tags(const image_catalog& pictures, image_id id, std::vector<std::string>& tags) {
+	tags.clear();
+
+	// the words of the file name, without the extension
+	split_words(path_stem(pictures.name(id)), tags);
+
+	const auto width = pictures.width(id), height = pictures.height(id);
+	tags.push_back(pictures.orientation(id) == image_orientation::landscape ? "landscape" : "portrait");
+
+	const auto bucket = classify_aspect(width, height);
+	for (const auto& it : aspect_buckets)
+		if (it.bucket == bucket)
+			split_words(it.folder, tags);
+
+	// resolution classes include the ones below them
+	const auto long_side = (std::max)(width, height), short_side = (std::min)(width, height);
+	if (long_side >= 1280 && short_side >= 720) tags.push_back("hd");
+	if (long_side >= 1920 && short_side >= 1080) tags.push_back("fhd");
+	if (long_side >= 3840 && short_side >= 2160) tags.push_back("4k");
+
+	// the colours that cover a tenth of the image or more
+	const auto& colours = pictures.colours(id);
+	if (colours.computed) {
+		for (size_t bin = 0; bin < colours.histogram.size(); bin++)
+			if (colours.histogram[bin] >= 26) {
+				const auto channel = [bin](size_t shift) {
+					return static_cast<std::uint32_t>((bin >> shift & 3) * 64 + 32);
+				};
+
+				tags.push_back(colour_name(channel(4) << 16 | channel(2) << 8 | channel(0)));
+			}
+
+		if (colours.suits_dark_theme())
+			tags.push_back("dark");
+		else if (colours.luminance >= 160)
+			tags.push_back("bright");
+	}
+
+	std::sort(tags.begin(), tags.end());
+	tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+}
+
+void search_index::reset(const image_catalog& pictures) {
+	clear();
+	_pictures = &pictures;
+	update();
+}
+
+void search_index::update() {
+	if (!_pictures)
+		return;
+
+	std::vector<std::string> tags;
+
+	for (auto id = static_cast<image_id>(_indexed); id < _pictures->size(); id++) {
+		image_tags(*_pictures, id, tags);
+
+		for (const auto& tag : tags) {
+			auto it = _tags.find(tag);
+			if (it == _tags.end())
+				it = _tags.emplace(tag, std::vector<image_id>()).first;
+
+			it->second.push_back(id);
+		}
+	}
+
+	_indexed = _pictures->size();
+}
+
+void search_index::clear() {
+	_pictures = nullptr;
+	_indexed = 0;
+	_tags.clear();
+}
+
+size_t search_index::size() const {
+	return _indexed;
+}
+
+image_set search_index::query(std::string_view text) const {
+	image_set matches;
+	matches._bits.assign((_indexed + 63) / 64, 0);
+
+	// sort out the conditions from the words
+	conditions found;
+	std::vector<std::string> words;
+
+	size_t start = 0;
+	while (start < text.size()) {
+		auto end = text.find(' ', start);
+		if (end == std::string_view::npos)
+			end = text.size();
+
+		const auto word = text.substr(start, end - start);
+		if (!word.empty() && !parse_condition(word, found))
+			split_words(word, words);
+
+		start = end + 1;
+	}
+
+	// start with every image, then keep the ones that have a tag starting with each word
+	for (size_t i = 0; i < _indexed; i++)
+		matches._bits[i / 64] |= 1ull << (i % 64);
+
+	std::vector<std::uint64_t> word_matches;
+
+	for (const auto& word : words) {
+		word_matches.assign(matches._bits.size(), 0);
+
+		for (auto it = _tags.lower_bound(word);
+			it != _tags.end() && it->first.compare(0, word.size(), word) == 0; it++)
+			for (const auto id : it->second)
+				word_matches[id / 64] |= 1ull << (id % 64);
+
+		for (size_t i = 0; i < matches._bits.size(); i++)
+			matches._bits[i] &= word_matches[i];
+	}
+
+	// then check the conditions on what is left, reading the columns directly
+	if (found.limited()) {
+		const auto& widths = _pictures->widths();
+		const auto& heights = _pictures->heights();
+		const auto& sizes = _pictures->file_sizes();
+		const auto& fetched = _pictures->fetched_times();
+
+		for (size_t word = 0; word < matches._bits.size(); word++) {
+			auto bits = matches._bits[word];
+
+			for (auto id = static_cast<image_id>(word * 64); bits; id++, bits >>= 1)
+				if ((bits & 1) && (!found.width.contains(widths[id]) ||
+					!found.height.contains(heights[id]) ||
+					!found.size.contains(static_cast<long long>(sizes[id])) ||
+					!found.fetched.contains(fetched[id])))
+					matches._bits[word] &= ~(1ull << (id % 64));
+		}
+	}
+
+	for (const auto bits : matches._bits)
+		matches._count += std::bitset<64>(bits).count();
+
+	return matches;
+}
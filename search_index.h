@@ -0,0 +1,135 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "catalog.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// A set of images, one bit per image id.
+/// </summary>
+class image_set {
+public:
+	bool contains(image_id id) const;
+
+	/// <summary>
+	/// Get the number of images in the set.
+	/// </summary>
+	size_t count() const;
+
+	/// <summary>
+	/// Keep the ids that are in the set.
+	/// </summary>
+	/// 
+	/// <param name="ids">The ids, in any order.</param>
+	/// 
+	/// <returns>
+	/// The ids that are in the set, in the same order.
+	/// </returns>
+	std::vector<image_id> filter(const std::vector<image_id>& ids) const;
+
+private:
+	friend class search_index;
+	std::vector<std::uint64_t> _bits;
+	size_t _count = 0;
+};
+
+/// <summary>
+/// Get the search tags of an image: the words in its file name, its
+/// orientation, its aspect ratio bucket, its resolution class (hd, fhd, 4k)
+/// and the names of its main colours.
+/// </summary>
+/// 
+/// <param name="pictures">The catalog.</param>
+/// <param name="id">The id of the image.</param>
+/// <param name="tags">The tags, in lower case and without duplicates.</param>
+void image_tags(const image_catalog& pictures, image_id id, std::vector<std::string>& tags);
+
+/// <summary>
+/// Search index over the images in a catalog.
+/// </summary>
+/// 
+/// <remarks>
+/// Each tag maps to the ids of the images that have it. Ids are appended as
+/// images are indexed, so every list stays sorted and indexing new images
+/// never touches the old ones. Numeric conditions are checked against the
+/// catalog's columns for the images the tags leave.
+/// </remarks>
+class search_index {
+public:
+	/// <summary>
+	/// Index a catalog.
+	/// </summary>
+	/// 
+	/// <param name="pictures">
+	/// The catalog. It must outlive the index. Images may be added to it, but
+	/// it must not be cleared until the next call to reset().
+	/// </param>
+	void reset(const image_catalog& pictures);
+
+	/// <summary>
+	/// Index the images added to the catalog since the last call to reset()
+	/// or update().
+	/// </summary>
+	void update();
+
+	void clear();
+
+	/// <summary>
+	/// Get the number of images indexed.
+	/// </summary>
+	size_t size() const;
+
+	/// <summary>
+	/// Find the images that match a search.
+	/// </summary>
+	/// 
+	/// <param name="text">
+	/// The search, as words separated by spaces. An image has to match every
+	/// word. A plain word matches the start of any of the image's tags, see
+	/// image_tags(). A word can also be a condition: width, height, size or age
+	/// followed by =, &lt;, &lt;=, &gt; or &gt;= and a number, e.g. width&gt;=1920,
+	/// size&lt;2mb or age&lt;7 (days since the image was fetched), or
+	/// after:YYYY-MM-DD and before:YYYY-MM-DD on the fetch date. Conditions
+	/// that are still being typed, e.g. size&gt;, are ignored.
+	/// </param>
+	/// 
+	/// <returns>
+	/// The matching images.
+	/// </returns>
+	image_set query(std::string_view text) const;
+
+private:
+	const image_catalog* _pictures = nullptr;
+	size_t _indexed = 0;
+
+	// tag to the ids of the images that have it, in ascending order
+	std::map<std::string, std::vector<image_id>, std::less<>> _tags;
+};
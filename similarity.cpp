@@ -0,0 +1,367 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "similarity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMILARITY_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SIMILARITY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	// leaves are scanned rather than split further
+	constexpr std::uint32_t leaf_size = 16;
+
+	unsigned int distance_scalar(const std::uint8_t* a, const std::uint8_t* b) {
+		unsigned int sum = 0;
+		for (size_t i = 0; i < feature_size; i++)
+			sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+
+		return sum;
+	}
+
+#if defined(SIMILARITY_X86)
+	unsigned int distance_sse2(const std::uint8_t* a, const std::uint8_t* b) {
+		__m128i sum = _mm_setzero_si128();
+
+		for (size_t i = 0; i < feature_size; i += 16)
+			sum = _mm_add_epi64(sum, _mm_sad_epu8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+
+		return static_cast<unsigned int>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+	}
+
+	TARGET_AVX2
+	unsigned int distance_avx2(const std::uint8_t* a, const std::uint8_t* b) {
+		__m256i sum = _mm256_setzero_si256();
+
+		for (size_t i = 0; i < feature_size; i += 32)
+			sum = _mm256_add_epi64(sum, _mm256_sad_epu8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))));
+
+		const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		return static_cast<unsigned int>(_mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+	}
+#endif
+
+#if defined(SIMILARITY_NEON)
+	unsigned int distance_neon(const std::uint8_t* a, const std::uint8_t* b) {
+		uint16x8_t sum = vdupq_n_u16(0);
+
+		for (size_t i = 0; i < feature_size; i += 16)
+			sum = vpadalq_u8(sum, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+
+		return vaddlvq_u16(sum);
+	}
+#endif
+
+	auto distance_function(simd_level level) {
+		switch (level) {
+#if defined(SIMILARITY_X86)
+		case simd_level::sse2:
+			return distance_sse2;
+		case simd_level::avx2:
+			return distance_avx2;
+#elif defined(SIMILARITY_NEON)
+		case simd_level::neon:
+			return distance_neon;
+#endif
+		default:
+			return distance_scalar;
+		}
+	}
+
+	/// <summary>
+	/// The best results so far, worst on top.
+	/// </summary>
+	class result_heap {
+	public:
+		explicit result_heap(size_t count) : _count(count) {}
+
+		/// <summary>
+		/// The distance a candidate has to beat, or tie, to be kept.
+		/// </summary>
+		unsigned int bound() const {
+			return _heap.size() < _count ? ~0u : _heap.top().distance;
+		}
+
+		void offer(image_id id, unsigned int distance) {
+			if (_heap.size() < _count)
+				_heap.push({ id, distance });
+			else if (worse(_heap.top(), { id, distance })) {
+				_heap.pop();
+				_heap.push({ id, distance });
+			}
+		}
+
+		std::vector<similar_image> sorted() {
+			std::vector<similar_image> results;
+			results.reserve(_heap.size());
+
+			for (; !_heap.empty(); _heap.pop())
+				results.push_back(_heap.top());
+
+			std::reverse(results.begin(), results.end());
+			return results;
+		}
+
+	private:
+		static bool worse(const similar_image& a, const similar_image& b) {
+			return a.distance != b.distance ? a.distance > b.distance : a.id > b.id;
+		}
+
+		struct less {
+			bool operator()(const similar_image& a, const similar_image& b) const {
+				return worse(b, a);
+			}
+		};
+
+		size_t _count;
+		std::priority_queue<similar_image, std::vector<similar_image>, less> _heap;
+	};
+}
+
+bool make_features(const colour_stats& colours,
+	const image_signature& signature,
+	feature_vector& features) {
+	if (!colours.computed || !signature.computed)
+		return false;
+
+	static const auto root = []() {
+		std::array<std::uint8_t, 256> table{};
+		for (size_t i = 0; i < table.size(); i++)
+			table[i] = static_cast<std::uint8_t>(std::lround(std::sqrt(i / 255.) * 255.));
+		return table;
+	}();
+
+	static_assert(std::tuple_size<decltype(colour_stats::histogram)>::value + image_signature::grid * image_signature::grid == feature_size,
+		"the feature vector is the histogram followed by the signature");
+
+	for (size_t i = 0; i < colours.histogram.size(); i++)
+		features[i] = root[colours.histogram[i]];
+
+	std::copy(signature.cells.begin(), signature.cells.end(), features.begin() + colours.histogram.size());
+	return true;
+}
+
+unsigned int feature_distance(const feature_vector& a, const feature_vector& b, simd_level level) {
+	return distance_function(level)(a.data(), b.data());
+}
+
+void similarity_index::clear() {
+	_ids.clear();
+	_vectors.clear();
+	_nodes.clear();
+}
+
+size_t similarity_index::size() const {
+	return _ids.size();
+}
+
+bool similarity_index::empty() const {
+	return _ids.empty();
+}
+
+void similarity_index::build(const image_catalog& pictures, simd_level level) {
+	std::vector<image_id> ids;
+	std::vector<feature_vector> vectors;
+	ids.reserve(pictures.size());
+	vectors.reserve(pictures.size());
+
+	feature_vector features;
+	for (image_id id = 0; id < pictures.size(); id++)
+		if (make_features(pictures.colours(id), pictures.signature(id), features)) {
+			ids.push_back(id);
+			vectors.push_back(features);
+		}
+
+	build(ids, vectors, level);
+}
+
+void similarity_index::build(const std::vector<image_id>& ids,
+	const std::vector<feature_vector>& vectors,
+	simd_level level) {
+	clear();
+	_distance = distance_function(level);
+
+	const auto count = static_cast<std::uint32_t>((std::min)(ids.size(), vectors.size()));
+	if (count == 0)
+		return;
+
+	std::vector<std::uint32_t> order(count);
+	for (std::uint32_t i = 0; i < count; i++)
+		order[i] = i;
+
+	_nodes.reserve(2 * count / leaf_size + 1);
+
+	std::uint32_t seed = 0x9e3779b9u;
+	build_node(order, 0, count, vectors, seed);
+
+	// store the vectors in tree order
+	_ids.resize(count);
+	_vectors.resize(count);
+	for (std::uint32_t i = 0; i < count; i++) {
+		_ids[i] = ids[order[i]];
+		_vectors[i] = vectors[order[i]];
+	}
+}
+
+std::int32_t similarity_index::build_node(std::vector<std::uint32_t>& order,
+	std::uint32_t first, std::uint32_t last,
+	const std::vector<feature_vector>& source, std::uint32_t& seed) {
+	const auto index = static_cast<std::int32_t>(_nodes.size());
+	_nodes.push_back(node{ first, 0, 0 });
+
+	if (last - first <= leaf_size) {
+		_nodes[index].count = last - first;
+		return index;
+	}
+
+	// a pseudo-random vantage point, moved to the front of the range
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	std::swap(order[first], order[first + seed % (last - first)]);
+
+	const auto& vantage = source[order[first]];
+	std::vector<std::pair<unsigned int, std::uint32_t>> distances;
+	distances.reserve(last - first - 1);
+
+	for (auto i = first + 1; i < last; i++)
+		distances.push_back({ _distance(vantage.data(), source[order[i]].data()), order[i] });
+
+	// split at the median: closer vectors inside, the rest outside
+	const auto middle = distances.begin() + distances.size() / 2;
+	std::nth_element(distances.begin(), middle, distances.end());
+
+	for (size_t i = 0; i < distances.size(); i++)
+		order[first + 1 + i] = distances[i].second;
+
+	const auto split = first + 1 + static_cast<std::uint32_t>(distances.size() / 2);
+	_nodes[index].threshold = middle->first;
+
+	const auto inside = build_node(order, first + 1, split, source, seed);
+	const auto outside = build_node(order, split, last, source, seed);
+	_nodes[index].inside = inside;
+	_nodes[index].outside = outside;
+	return index;
+}
+
+bool similarity_index::features(image_id id, feature_vector& features) const {
+	const auto it = std::find(_ids.begin(), _ids.end(), id);
+	if (it == _ids.end())
+		return false;
+
+	features = _vectors[static_cast<size_t>(it - _ids.begin())];
+	return true;
+}
+
+std::vector<similar_image> similarity_index::query(const feature_vector& features,
+	size_t count,
+	image_id exclude) const {
+	_last_query_distances = 0;
+	if (_nodes.empty() || count == 0)
+		return {};
+
+	result_heap results(count);
+
+	auto offer = [&](std::uint32_t position) {
+		_last_query_distances++;
+		const auto distance = _distance(features.data(), _vectors[position].data());
+
+		if (_ids[position] != exclude)
+			results.offer(_ids[position], distance);
+
+		return distance;
+	};
+
+	// depth first, nearer side first, so the bound tightens early
+	std::vector<std::int32_t> stack{ 0 };
+	while (!stack.empty()) {
+		const auto& current = _nodes[static_cast<size_t>(stack.back())];
+		stack.pop_back();
+
+		if (current.count) {
+			for (auto i = current.first; i < current.first + current.count; i++)
+				offer(i);
+
+			continue;
+		}
+
+		const auto distance = offer(current.first);
+		const auto bound = results.bound();
+
+		// the triangle inequality bounds the distance to everything in each subtree
+		const bool visit_inside = current.inside >= 0 &&
+			(bound == ~0u || distance <= current.threshold + bound);
+		const bool visit_outside = current.outside >= 0 &&
+			(bound == ~0u || distance + bound >= current.threshold);
+
+		if (distance < current.threshold) {
+			if (visit_outside)
+				stack.push_back(current.outside);
+			if (visit_inside)
+				stack.push_back(current.inside);
+		}
+		else {
+			if (visit_inside)
+				stack.push_back(current.inside);
+			if (visit_outside)
+				stack.push_back(current.outside);
+		}
+	}
+
+	return results.sorted();
+}
+
+std::vector<similar_image> similarity_index::brute_force(const feature_vector& features,
+	size_t count,
+	image_id exclude) const {
+	result_heap results(count);
+
+	for (size_t i = 0; i < _ids.size(); i++)
+		if (_ids[i] != exclude)
+			results.offer(_ids[i], _distance(features.data(), _vectors[i].data()));
+
+	_last_query_distances = _ids.size();
+	return count ? results.sorted() : std::vector<similar_image>();
+}
+
+size_t similarity_index::last_query_distances() const {
+	return _last_query_distances;
+}
@@ -0,0 +1,166 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "catalog.h"
+#include "cpu_features.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// The number of bytes in an image's feature vector: its colour histogram
+/// followed by its luminance signature.
+/// </summary>
+constexpr size_t feature_size = 128;
+
+using feature_vector = std::array<std::uint8_t, feature_size>;
+
+/// <summary>
+/// Build the feature vector of an image.
+/// </summary>
+/// 
+/// <param name="colours">The colour statistics of the image.</param>
+/// <param name="signature">The luminance signature of the image.</param>
+/// <param name="features">The feature vector.</param>
+/// 
+/// <returns>
+/// Returns false if either was not computed, else true.
+/// </returns>
+/// 
+/// <remarks>
+/// The histogram shares are square rooted so that one dominant colour does
+/// not outweigh the rest of the image.
+/// </remarks>
+bool make_features(const colour_stats& colours,
+	const image_signature& signature,
+	feature_vector& features);
+
+/// <summary>
+/// The distance between two feature vectors with a specific instruction set:
+/// the sum of the absolute differences of their bytes.
+/// </summary>
+/// 
+/// <remarks>
+/// A metric, which is what lets the index prune. Every instruction set
+/// returns exactly the same distance.
+/// </remarks>
+unsigned int feature_distance(const feature_vector& a, const feature_vector& b, simd_level level);
+
+/// <summary>
+/// An image found by a similarity query.
+/// </summary>
+struct similar_image {
+	image_id id;
+	unsigned int distance;
+};
+
+/// <summary>
+/// Nearest-neighbour index over the feature vectors of a catalog.
+/// </summary>
+/// 
+/// <remarks>
+/// A vantage point tree: each node splits its images by their distance to
+/// one of them, so a query skips every subtree that the triangle inequality
+/// shows cannot beat the results found so far. The vectors are stored in
+/// tree order so that leaves are scanned contiguously. Images without
+/// computed features are not indexed.
+/// </remarks>
+class similarity_index {
+public:
+	/// <summary>
+	/// Index a catalog.
+	/// </summary>
+	/// 
+	/// <param name="pictures">The catalog. The index keeps its own copy of the features.</param>
+	/// <param name="level">The instruction set for distances, see simd_supported().</param>
+	void build(const image_catalog& pictures, simd_level level = detect_simd_level());
+
+	/// <summary>
+	/// Index feature vectors directly.
+	/// </summary>
+	/// 
+	/// <param name="ids">The id of each vector.</param>
+	/// <param name="vectors">The vectors.</param>
+	/// <param name="level">The instruction set for distances, see simd_supported().</param>
+	void build(const std::vector<image_id>& ids,
+		const std::vector<feature_vector>& vectors,
+		simd_level level = detect_simd_level());
+
+	void clear();
+	size_t size() const;
+	bool empty() const;
+
+	/// <summary>
+	/// Check whether an image is indexed, and get its feature vector.
+	/// </summary>
+	bool features(image_id id, feature_vector& features) const;
+
+	/// <summary>
+	/// Find the images most similar to a feature vector.
+	/// </summary>
+	/// 
+	/// <param name="features">The feature vector to compare with.</param>
+	/// <param name="count">The number of images to find.</param>
+	/// <param name="exclude">An image to leave out, usually the one being compared with.</param>
+	/// 
+	/// <returns>
+	/// Up to count images, closest first. Ties are ordered by id.
+	/// </returns>
+	std::vector<similar_image> query(const feature_vector& features,
+		size_t count,
+		image_id exclude = invalid_image_id) const;
+
+	/// <summary>
+	/// The same as query(), comparing with every image. For measuring the index.
+	/// </summary>
+	std::vector<similar_image> brute_force(const feature_vector& features,
+		size_t count,
+		image_id exclude = invalid_image_id) const;
+
+	/// <summary>
+	/// The number of distances computed by the last query, for measuring the index.
+	/// </summary>
+	size_t last_query_distances() const;
+
+private:
+	struct node {
+		std::uint32_t first;	// the vantage point, or the first vector of a leaf
+		std::uint32_t count;	// vectors in a leaf, 0 for inner nodes
+		std::uint32_t threshold;	// the median distance to the vantage point
+		std::int32_t inside = -1;	// nodes with vectors closer than the threshold
+		std::int32_t outside = -1;
+	};
+
+	std::int32_t build_node(std::vector<std::uint32_t>& order, std::uint32_t first, std::uint32_t last,
+		const std::vector<feature_vector>& source, std::uint32_t& seed);
+
+	unsigned int (*_distance)(const std::uint8_t*, const std::uint8_t*) = nullptr;
+	std::vector<image_id> _ids;	// in tree order
+	std::vector<feature_vector> _vectors;	// in tree order
+	std::vector<node> _nodes;
+	mutable size_t _last_query_distances = 0;
+};
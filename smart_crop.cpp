@@ -0,0 +1,301 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "smart_crop.h"
+#include "image_quality.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SMART_CROP_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SMART_CROP_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	// how much of its energy a window at the very edge gives up to one in the
+	// centre, so that a subject has to be clearly off centre to pull the crop
+	constexpr double centre_prior = .15;
+
+	/// <summary>
+	/// The energy of the pixels from first to last (exclusive) of a row that
+	/// has a row above and below it.
+	/// </summary>
+	void energy_scalar(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, std::uint8_t* energy) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		for (unsigned int x = first; x < last; x++) {
+			const int dx = row[x + 1] > row[x - 1] ? row[x + 1] - row[x - 1] : row[x - 1] - row[x + 1];
+			const int dy = down[x] > up[x] ? down[x] - up[x] : up[x] - down[x];
+			energy[x] = static_cast<std::uint8_t>((std::min)(255, dx + dy));
+		}
+	}
+
+#if defined(SMART_CROP_X86)
+	inline __m128i absdiff_sse2(__m128i a, __m128i b) {
+		return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+	}
+
+	void energy_sse2(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, std::uint8_t* energy) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		auto load = [](const std::uint8_t* p) {
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		};
+
+		unsigned int x = first;
+		for (; last - x >= 16; x += 16) {
+			const __m128i dx = absdiff_sse2(load(row + x + 1), load(row + x - 1));
+			const __m128i dy = absdiff_sse2(load(down + x), load(up + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(energy + x), _mm_adds_epu8(dx, dy));
+		}
+
+		energy_scalar(row, stride, x, last, energy);
+	}
+
+	TARGET_AVX2
+	inline __m256i absdiff_avx2(__m256i a, __m256i b) {
+		return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+	}
+
+	TARGET_AVX2
+	inline __m256i load_avx2(const std::uint8_t* p) {
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+
+	TARGET_AVX2
+	void energy_avx2(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, std::uint8_t* energy) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		unsigned int x = first;
+		for (; last - x >= 32; x += 32) {
+			const __m256i dx = absdiff_avx2(load_avx2(row + x + 1), load_avx2(row + x - 1));
+			const __m256i dy = absdiff_avx2(load_avx2(down + x), load_avx2(up + x));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(energy + x), _mm256_adds_epu8(dx, dy));
+		}
+
+		energy_scalar(row, stride, x, last, energy);
+	}
+#endif
+
+#if defined(SMART_CROP_NEON)
+	void energy_neon(const std::uint8_t* row, size_t stride,
+		unsigned int first, unsigned int last, std::uint8_t* energy) {
+		const std::uint8_t* up = row - stride;
+		const std::uint8_t* down = row + stride;
+
+		unsigned int x = first;
+		for (; last - x >= 16; x += 16) {
+			const uint8x16_t dx = vabdq_u8(vld1q_u8(row + x + 1), vld1q_u8(row + x - 1));
+			const uint8x16_t dy = vabdq_u8(vld1q_u8(down + x), vld1q_u8(up + x));
+			vst1q_u8(energy + x, vqaddq_u8(dx, dy));
+		}
+
+		energy_scalar(row, stride, x, last, energy);
+	}
+#endif
+
+	/// <summary>
+	/// The start of the window of a given length that keeps the most of a
+	/// line of sums, with the centre prior applied.
+	/// </summary>
+	unsigned int best_window(const std::vector<std::uint64_t>& sums, unsigned int window) {
+		const unsigned int count = static_cast<unsigned int>(sums.size());
+		if (window >= count)
+			return 0;
+
+		std::vector<std::uint64_t> prefix(count + 1, 0);
+		for (unsigned int i = 0; i < count; i++)
+			prefix[i + 1] = prefix[i] + sums[i];
+
+		const unsigned int positions = count - window + 1;
+		const double centre = (positions - 1) / 2.;
+
+		unsigned int best = 0;
+		double best_score = -1., best_distance = 0.;
+
+		for (unsigned int position = 0; position < positions; position++) {
+			const double distance = centre > 0. ? (position > centre ? position - centre : centre - position) / centre : 0.;
+			const double score = (prefix[position + window] - prefix[position]) * (1. - centre_prior * distance);
+
+			// ties go to the window nearest the centre
+			if (score > best_score || (score == best_score && distance < best_distance)) {
+				best = position;
+				best_score = score;
+				best_distance = distance;
+			}
+		}
+
+		return best;
+	}
+
+	std::uint16_t to_fraction(unsigned int value, unsigned int total) {
+		return static_cast<std::uint16_t>((static_cast<std::uint64_t>(value) * crop_box::one + total / 2) / total);
+	}
+}
+
+void edge_energy(const std::uint8_t* luma,
+	unsigned int width,
+	unsigned int height,
+	simd_level level,
+	std::uint8_t* energy) {
+	auto kernel = energy_scalar;
+
+	switch (level) {
+#if defined(SMART_CROP_X86)
+	case simd_level::sse2:
+		kernel = energy_sse2;
+		break;
+	case simd_level::avx2:
+		kernel = energy_avx2;
+		break;
+#elif defined(SMART_CROP_NEON)
+	case simd_level::neon:
+		kernel = energy_neon;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	std::memset(energy, 0, static_cast<size_t>(width) * height);
+
+	if (width < 3 || height < 3)
+		return;
+
+	for (unsigned int y = 1; y + 1 < height; y++) {
+		const size_t offset = static_cast<size_t>(y) * width;
+		kernel(luma + offset, width, 1, width - 1, energy + offset);
+	}
+}
+
+crop_box find_crop(const std::uint8_t* energy,
+	unsigned int width,
+	unsigned int height,
+	unsigned int ratio_width,
+	unsigned int ratio_height) {
+	crop_box box;
+
+	if (width == 0 || height == 0 || ratio_width == 0 || ratio_height == 0)
+		return box;
+
+	const bool wider = static_cast<std::uint64_t>(width) * ratio_height > static_cast<std::uint64_t>(height) * ratio_width;
+
+	if (wider) {
+		// full height, slid across the columns
+		const unsigned int window = (std::max)(1u, static_cast<unsigned int>(
+			(static_cast<std::uint64_t>(height) * ratio_width + ratio_height / 2) / ratio_height));
+
+		std::vector<std::uint64_t> columns(width, 0);
+		for (unsigned int y = 0; y < height; y++) {
+			const std::uint8_t* row = energy + static_cast<size_t>(y) * width;
+			for (unsigned int x = 0; x < width; x++)
+				columns[x] += row[x];
+		}
+
+		const unsigned int left = best_window(columns, window);
+		box.left = to_fraction(left, width);
+		box.width = to_fraction((std::min)(window, width - left), width);
+	}
+	else {
+		// full width, slid down the rows
+		const unsigned int window = (std::max)(1u, static_cast<unsigned int>(
+			(static_cast<std::uint64_t>(width) * ratio_height + ratio_width / 2) / ratio_width));
+
+		std::vector<std::uint64_t> rows(height, 0);
+		for (unsigned int y = 0; y < height; y++) {
+			const std::uint8_t* row = energy + static_cast<size_t>(y) * width;
+			std::uint64_t sum = 0;
+			for (unsigned int x = 0; x < width; x++)
+				sum += row[x];
+			rows[y] = sum;
+		}
+
+		const unsigned int top = best_window(rows, window);
+		box.top = to_fraction(top, height);
+		box.height = to_fraction((std::min)(window, height - top), height);
+	}
+
+	return box;
+}
+
+void compute_crops(const bitmap& image, crop_set& crops) {
+	crops = crop_set();
+
+	const size_t count = static_cast<size_t>(image.width) * image.height;
+	if (count == 0 || image.pixels.size() < count * 4)
+		return;
+
+	const auto level = detect_simd_level();
+
+	std::vector<std::uint8_t> luma(count), energy(count);
+	luminance_plane(image.pixels.data(), count, level, luma.data());
+	edge_energy(luma.data(), image.width, image.height, level, energy.data());
+
+	for (size_t i = 0; i < aspect_bucket_count; i++)
+		crops.boxes[i] = find_crop(energy.data(), image.width, image.height,
+			aspect_buckets[i].ratio_width, aspect_buckets[i].ratio_height);
+
+	crops.computed = 1;
+}
+
+bool crop_bitmap(const bitmap& image, const crop_box& box, bitmap& cropped) {
+	cropped = bitmap();
+
+	const unsigned int left = static_cast<unsigned int>(static_cast<std::uint64_t>(box.left) * image.width / crop_box::one);
+	const unsigned int top = static_cast<unsigned int>(static_cast<std::uint64_t>(box.top) * image.height / crop_box::one);
+	const unsigned int width = (std::min)(image.width - (std::min)(left, image.width),
+		static_cast<unsigned int>((static_cast<std::uint64_t>(box.width) * image.width + crop_box::one / 2) / crop_box::one));
+	const unsigned int height = (std::min)(image.height - (std::min)(top, image.height),
+		static_cast<unsigned int>((static_cast<std::uint64_t>(box.height) * image.height + crop_box::one / 2) / crop_box::one));
+
+	if (width == 0 || height == 0 || image.pixels.size() < static_cast<size_t>(image.width) * image.height * 4)
+		return false;
+
+	cropped.width = width;
+	cropped.height = height;
+	cropped.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	for (unsigned int y = 0; y < height; y++)
+		std::memcpy(cropped.pixels.data() + static_cast<size_t>(y) * width * 4,
+			image.pixels.data() + (static_cast<size_t>(top + y) * image.width + left) * 4,
+			static_cast<size_t>(width) * 4);
+
+	return true;
+}
@@ -0,0 +1,129 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "image_decoder.h"
+#include "cpu_features.h"
+#include "aspect_buckets.h"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+/// <summary>
+/// A crop window, in 1/65535ths of the image's width and height so that it
+/// applies to the image at any resolution.
+/// </summary>
+struct crop_box {
+	static constexpr std::uint16_t one = 65535;
+
+	std::uint16_t left = 0;
+	std::uint16_t top = 0;
+	std::uint16_t width = one;
+	std::uint16_t height = one;
+};
+
+/// <summary>
+/// The crop window of an image for each aspect ratio bucket.
+/// </summary>
+/// 
+/// <remarks>
+/// Plain data so that it can be stored as a catalog column and written to
+/// snapshots as is.
+/// </remarks>
+struct crop_set {
+	std::array<crop_box, aspect_bucket_count> boxes{};
+	std::uint8_t computed = 0;	// 0 if the image could not be analyzed
+	std::uint8_t reserved = 0;	// keeps the layout free of padding
+};
+
+static_assert(std::is_trivially_copyable<crop_set>::value && sizeof(crop_set) == aspect_bucket_count * 8 + 2,
+	"crop_set is written to snapshots byte for byte");
+
+/// <summary>
+/// Compute the edge energy of a luminance plane with a specific instruction set.
+/// </summary>
+/// 
+/// <param name="luma">The luminance, one byte per pixel.</param>
+/// <param name="width">The width, in pixels.</param>
+/// <param name="height">The height, in pixels.</param>
+/// <param name="level">
+/// The instruction set to use. It must be supported, see simd_supported().
+/// </param>
+/// <param name="energy">
+/// The sum of the horizontal and vertical gradients of each pixel, saturated
+/// at 255, width * height bytes. The border is zero.
+/// </param>
+/// 
+/// <remarks>
+/// Every instruction set produces exactly the same map.
+/// </remarks>
+void edge_energy(const std::uint8_t* luma,
+	unsigned int width,
+	unsigned int height,
+	simd_level level,
+	std::uint8_t* energy);
+
+/// <summary>
+/// Find the crop window with a given aspect ratio that keeps the most energy.
+/// </summary>
+/// 
+/// <param name="energy">The energy map from edge_energy().</param>
+/// <param name="width">The width of the map, in pixels.</param>
+/// <param name="height">The height of the map, in pixels.</param>
+/// <param name="ratio_width">The width part of the aspect ratio.</param>
+/// <param name="ratio_height">The height part of the aspect ratio.</param>
+/// 
+/// <returns>
+/// The largest window with the aspect ratio, slid along the image's long axis
+/// to where it keeps the most energy. A mild preference for the centre keeps
+/// featureless images centred.
+/// </returns>
+crop_box find_crop(const std::uint8_t* energy,
+	unsigned int width,
+	unsigned int height,
+	unsigned int ratio_width,
+	unsigned int ratio_height);
+
+/// <summary>
+/// Compute the crop window of an image for every aspect ratio bucket.
+/// </summary>
+/// 
+/// <param name="image">The image, ideally downscaled to a few hundred pixels across.</param>
+/// <param name="crops">The crop windows.</param>
+void compute_crops(const bitmap& image, crop_set& crops);
+
+/// <summary>
+/// Copy the part of an image inside a crop window.
+/// </summary>
+/// 
+/// <param name="image">The image.</param>
+/// <param name="box">The crop window.</param>
+/// <param name="cropped">The cropped image.</param>
+/// 
+/// <returns>
+/// Returns false if the window is empty at the image's resolution, else true.
+/// </returns>
+bool crop_bitmap(const bitmap& image, const crop_box& box, bitmap& cropped);
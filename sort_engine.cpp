@@ -0,0 +1,216 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "sort_engine.h"
+#include "aspect_buckets.h"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <array>
+#include <cstring>
+
+namespace {
+	constexpr size_t max_keys = 5;
+
+	struct sort_entry {
+		std::array<std::uint64_t, max_keys> keys;
+		image_id id;
+	};
+
+	/// <summary>
+	/// Sort entries on several threads, then merge the sorted runs.
+	/// </summary>
+	template <typename iterator, typename compare>
+	void parallel_sort(iterator first, iterator last, compare comp) {
+		const size_t count = static_cast<size_t>(last - first);
+		const size_t threads = (std::min)(static_cast<size_t>((std::max)(1u, std::thread::hardware_concurrency())),
+			count / sort_engine::parallel_threshold + 1);
+
+		if (threads < 2) {
+			std::sort(first, last, comp);
+			return;
+		}
+
+		// sort one run per thread
+		std::vector<iterator> bounds;
+		for (size_t i = 0; i <= threads; i++)
+			bounds.push_back(first + static_cast<std::ptrdiff_t>(count * i / threads));
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threads; i++)
+			workers.emplace_back([&, i]() { std::sort(bounds[i], bounds[i + 1], comp); });
+
+		for (auto& it : workers)
+			it.join();
+
+		// merge neighbouring runs until one is left
+		while (bounds.size() > 2) {
+			std::vector<iterator> merged{ bounds.front() };
+			workers.clear();
+
+			for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+				workers.emplace_back([&, i]() { std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], comp); });
+				merged.push_back(bounds[i + 2]);
+			}
+
+			// an odd run out is carried over to the next round
+			if (bounds.size() % 2 == 0)
+				merged.push_back(bounds.back());
+
+			for (auto& it : workers)
+				it.join();
+
+			bounds.swap(merged);
+		}
+	}
+}
+
+void sort_engine::reset(const image_catalog& pictures) {
+	_pictures = &pictures;
+
+	const auto count = static_cast<image_id>(pictures.size());
+
+	// rank the names once so that sorting by name compares integers
+	std::vector<image_id> by_name(count);
+	std::iota(by_name.begin(), by_name.end(), 0);
+	std::sort(by_name.begin(), by_name.end(), [&](image_id a, image_id b) {
+		return pictures.name(a) < pictures.name(b);
+		});
+
+	_name_ranks.assign(count, 0);
+	for (image_id rank = 0; rank < count; rank++)
+		_name_ranks[by_name[rank]] = rank;
+
+	const auto& widths = pictures.widths();
+	const auto& heights = pictures.heights();
+
+	_resolutions.resize(count);
+	for (image_id id = 0; id < count; id++)
+		_resolutions[id] = static_cast<std::uint64_t>(widths[id]) * heights[id];
+
+	// the bits of a non-negative float order the same way as its value
+	const auto& qualities = pictures.qualities();
+
+	_sharpness.resize(count);
+	for (image_id id = 0; id < count; id++) {
+		std::uint32_t bits = 0;
+		const float sharpness = (std::max)(0.f, qualities[id].sharpness);
+		memcpy(&bits, &sharpness, sizeof(bits));
+		_sharpness[id] = bits;
+	}
+}
+
+std::uint64_t sort_engine::key(sort_key key, image_id id) const {
+	switch (key) {
+	case sort_key::name: return _name_ranks[id];
+	case sort_key::orientation: return static_cast<std::uint64_t>(_pictures->orientation(id));
+	case sort_key::resolution: return _resolutions[id];
+	case sort_key::size: return _pictures->file_size(id);
+	case sort_key::date:
+		// offset so that times before the epoch still order correctly as unsigned
+		return static_cast<std::uint64_t>(_pictures->fetched(id)) ^ (1ull << 63);
+	case sort_key::sharpness: return _sharpness[id];
+	default: return 0;
+	}
+}
+
+std::vector<image_id> sort_engine::query(const library_filter& filter,
+	const std::vector<sort_order>& order) const {
+	std::vector<image_id> ids;
+
+	if (!_pictures)
+		return ids;
+
+	// select
+	const auto& orientations = _pictures->orientations();
+	const auto& sizes = _pictures->file_sizes();
+	const auto& widths = _pictures->widths();
+	const auto& heights = _pictures->heights();
+	const auto& colours = _pictures->colours();
+	const auto count = static_cast<image_id>(_pictures->size());
+
+	ids.reserve(count);
+
+	for (image_id id = 0; id < count; id++) {
+		const bool landscape = orientations[id] == image_orientation::landscape;
+
+		if ((landscape && !filter.landscape) || (!landscape && !filter.portrait))
+			continue;
+
+		if (widths[id] < filter.min_width || heights[id] < filter.min_height)
+			continue;
+
+		if (sizes[id] < filter.min_size || (filter.max_size && sizes[id] > filter.max_size))
+			continue;
+
+		if (filter.dark_theme_only && !colours[id].suits_dark_theme())
+			continue;
+
+		if (filter.buckets != ~0u) {
+			const auto bucket = classify_aspect(widths[id], heights[id]);
+			if (bucket == aspect_bucket::none || !(filter.buckets & (1u << static_cast<unsigned int>(bucket))))
+				continue;
+		}
+
+		ids.push_back(id);
+	}
+
+	if (order.empty())
+		return ids;
+
+	// gather the keys next to each id, inverting descending keys so a single
+	// ascending comparison handles both directions
+	const size_t key_count = (std::min)(order.size(), max_keys);
+	std::vector<sort_entry> entries(ids.size());
+
+	for (size_t i = 0; i < ids.size(); i++) {
+		auto& entry = entries[i];
+		entry.id = ids[i];
+
+		for (size_t k = 0; k < key_count; k++) {
+			const auto value = key(order[k].key, entry.id);
+			entry.keys[k] = order[k].descending ? ~value : value;
+		}
+	}
+
+	// ties are broken on the id, which makes the sort stable with respect to catalog order
+	auto comp = [key_count](const sort_entry& a, const sort_entry& b) {
+		for (size_t k = 0; k < key_count; k++)
+			if (a.keys[k] != b.keys[k])
+				return a.keys[k] < b.keys[k];
+
+		return a.id < b.id;
+	};
+
+	if (entries.size() > parallel_threshold)
+		parallel_sort(entries.begin(), entries.end(), comp);
+	else
+		std::sort(entries.begin(), entries.end(), comp);
+
+	for (size_t i = 0; i < entries.size(); i++)
+		ids[i] = entries[i].id;
+
+	return ids;
+}
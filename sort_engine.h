@@ -0,0 +1,113 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "catalog.h"
+
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// The attributes the library can be sorted by.
+/// </summary>
+enum class sort_key : std::uint8_t {
+	name = 0,
+	orientation,
+	resolution,
+	size,
+	date,
+	sharpness,
+};
+
+/// <summary>
+/// A single level of a multi-key sort.
+/// </summary>
+struct sort_order {
+	sort_key key;
+	bool descending = false;
+};
+
+/// <summary>
+/// Criteria for selecting images from the library.
+/// </summary>
+struct library_filter {
+	bool landscape = true;
+	bool portrait = true;
+	unsigned int min_width = 0;
+	unsigned int min_height = 0;
+	unsigned long long min_size = 0;
+	unsigned long long max_size = 0;	// 0 means no upper limit
+	bool dark_theme_only = false;	// only images that suit the dark theme
+	std::uint32_t buckets = ~0u;	// one bit per aspect_bucket to include
+};
+
+/// <summary>
+/// Sort and filter engine for an image_catalog.
+/// </summary>
+/// 
+/// <remarks>
+/// Numeric sort keys are computed once in reset(), so queries compare integers
+/// instead of display strings. Sorts are stable: images that compare equal on
+/// every key keep their catalog order. Large libraries are sorted on several
+/// threads.
+/// </remarks>
+class sort_engine {
+public:
+	/// <summary>
+	/// Precompute the sort keys for a catalog.
+	/// </summary>
+	/// 
+	/// <param name="pictures">
+	/// The catalog. It must outlive the engine and must not be modified until
+	/// the next call to reset().
+	/// </param>
+	void reset(const image_catalog& pictures);
+
+	/// <summary>
+	/// Select and order images.
+	/// </summary>
+	/// 
+	/// <param name="filter">The criteria an image has to meet to be selected.</param>
+	/// <param name="order">The sort keys, most significant first.</param>
+	/// 
+	/// <returns>
+	/// The ids of the selected images, in sorted order.
+	/// </returns>
+	std::vector<image_id> query(const library_filter& filter,
+		const std::vector<sort_order>& order) const;
+
+	/// <summary>
+	/// The number of images above which sorting is split across threads.
+	/// </summary>
+	static constexpr size_t parallel_threshold = 16384;
+
+private:
+	const image_catalog* _pictures = nullptr;
+	std::vector<std::uint32_t> _name_ranks;
+	std::vector<std::uint64_t> _resolutions;
+	std::vector<std::uint32_t> _sharpness;
+
+	std::uint64_t key(sort_key key, image_id id) const;
+};
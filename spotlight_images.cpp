@@ -24,154 +24,490 @@
 
 #include <string>
 #include <filesystem>
+#include <chrono>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <Windows.h>
 #include <ShlObj.h>
 
-#include <GdiPlus.h>
-#pragma comment(lib, "GdiPlus.lib")
-
 #include "spotlight_images.h"
+#include "image_probe.h"
+#include "image_decoder.h"
+#include "aspect_buckets.h"
 #include "helper_functions.h"
+#include "file_copy.h"
+#include "batch_copy.h"
+#include "scan_arena.h"
+#include "path_utils.h"
 
 /// <summary>
-/// The minimum size of the smallest side in a valid Windows Spotlight image.
+/// The size images are decoded at to compute their colour statistics, quality
+/// scores, crop windows and signatures. Large enough to keep fine detail for
+/// the sharpness score.
 /// </summary>
-constexpr auto SPOTLIGHT_MIN = 700;
+constexpr auto ANALYSIS_SIZE = 512;
 
 /// <summary>
 /// Algorithm for checking if a given image is a valid Windows Spotlight image.
 /// </summary>
 /// 
-/// <param name="gdibitmap">
-/// A reference to the Gdiplus bitmap.
+/// <param name="width">
+/// The width of the image, in pixels.
+/// </param>
+/// 
+/// <param name="height">
+/// The height of the image, in pixels.
+/// </param>
+/// 
+/// <param name="bucket">
+/// The aspect ratio bucket of the image.
 /// </param>
 /// 
 /// <returns>
 /// Returns true if the image is valid, else false.
 /// </returns>
-bool is_valid_spotlight_image(Gdiplus::Bitmap& gdibitmap) {
+bool is_valid_spotlight_image(unsigned int width, unsigned int height, aspect_bucket& bucket) {
 	// check square images
-	if (gdibitmap.GetWidth() == gdibitmap.GetHeight())
+	bucket = classify_aspect(width, height);
+	if (bucket == aspect_bucket::none)
 		return false;
 
-	const bool is_landscape = gdibitmap.GetWidth() > gdibitmap.GetHeight();
-
 	// check small images that are probably not what we're looking for
-	if (is_landscape && gdibitmap.GetHeight() < SPOTLIGHT_MIN)
-		return false;
+	return (std::min)(width, height) >= bucket_spec(bucket).min_short_side;
+}
+
+std::string spotlight_assets_folder() {
+	CHAR szPath[MAX_PATH];
+	if (SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, szPath))) {
+		/*
+		** C:\Users\<username>\AppData\ (Vista onwards) or
+		** C:\Documents and Settings\<username>\AppData\ (XP)
+		*/
+		return std::string(szPath) + "\\" + spotlight_assets_subfolder;
+	}
 	else
-		if (!is_landscape && gdibitmap.GetWidth() < SPOTLIGHT_MIN)
-			return false;
+		return std::string();
+}
 
-	return true;
+bool fetch_images(const std::string& folder,
+	image_catalog& images,
+	std::string& error) {
+	return fetch_images(folder, image_catalog(), fetch_options(), images, error);
 }
 
-std::vector<image_info> fetch_images(const std::string& folder) {
-	auto get_app_data_folder = []() {
-		CHAR szPath[MAX_PATH];
-		if (SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, szPath))) {
-			/*
-			** C:\Users\<username>\AppData\ (Vista onwards) or
-			** C:\Documents and Settings\<username>\AppData\ (XP)
-			*/
-			return std::string(szPath);
-		}
-		else
-			return std::string();
+bool fetch_images(const std::string& folder,
+	const image_catalog& known,
+	const fetch_options& options,
+	image_catalog& images,
+	std::string& error) {
+	std::vector<jpeg_optimize_result> optimized;
+	return fetch_images(folder, known, options, images, optimized, error);
+}
+
+namespace {
+	/// <summary>
+	/// A file in the Spotlight folder that passed the header checks.
+	/// </summary>
+	struct candidate {
+		std::filesystem::path source;
+		aspect_bucket bucket = aspect_bucket::none;
+		unsigned int width = 0;
+		unsigned int height = 0;
+		unsigned long long file_size = 0;
+		unsigned long long library_size = 0;	// of the library's copy, which optimizing makes smaller
+		long long fetched = 0;
+		size_t source_index = 0;
+		std::string_view asset;	// the source's file name, in the scan's arena
+		std::string_view file_name;	// in the scan's arena
+		bool analyzed = false;
+		colour_stats colours;
+		quality_scores quality;
+		crop_set crops;
+		image_signature signature;
 	};
 
-	// get Windows spotlight directory for current user
-	std::string path = get_app_data_folder() +
-		"\\Packages\\Microsoft.Windows.ContentDeliveryManager_cw5n1h2txyewy\\LocalState\\Assets";
+	/// <summary>
+	/// Decode an image once at analysis size and compute all its statistics.
+	/// </summary>
+	void analyze(candidate& image) {
+		const std::string source_path = image.source.string();
+
+		bitmap sample;
+		std::string error;
+		if (decode_image(source_path, ANALYSIS_SIZE, ANALYSIS_SIZE, sample, error)) {
+			compute_colour_stats(sample, image.colours);
+			compute_quality(sample, image.quality);
+			compute_crops(sample, image.crops);
+			compute_signature(sample, image.signature);
+		}
+
+		image.quality.truncated = is_complete_image(source_path) ? 0 : 1;
+		image.analyzed = true;
+	}
+
+	/// <summary>
+	/// Analyze images on one thread per core. Decoding dominates, and each
+	/// image is independent.
+	/// </summary>
+	void analyze_all(std::pmr::vector<candidate>& candidates, const fetch_job* job, io_scheduler* io) {
+		std::vector<candidate*> pending;
+		for (auto& it : candidates)
+			if (!it.analyzed)
+				pending.push_back(&it);
+
+		const size_t threads = (std::min)(pending.size(),
+			static_cast<size_t>((std::max)(1u, std::thread::hardware_concurrency())));
+
+		std::atomic<size_t> next{ 0 };
+		auto work = [&]() {
+			io_priority_scope priority(io ? io->limits().priority : io_priority::normal);
+
+			for (size_t i = next++; i < pending.size() && !(job && job->stop_requested()); i = next++) {
+				if (io && !io->acquire(pending[i]->file_size, job))
+					break;
+
+				analyze(*pending[i]);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threads; i++)
+			workers.emplace_back(work);
+
+		work();
+
+		for (auto& it : workers)
+			it.join();
+	}
+
+	bool meets_options(const candidate& image, const fetch_options& options) {
+		if (options.skip_truncated && image.quality.truncated)
+			return false;
+
+		// images that could not be decoded are only rejected by the truncation check
+		if (!image.quality.computed)
+			return true;
+
+		return image.quality.sharpness >= options.min_sharpness &&
+			image.quality.entropy >= options.min_entropy;
+	}
+}
+
+bool fetch_images(const std::string& folder,
+	const image_catalog& known,
+	const fetch_options& options,
+	image_catalog& images,
+	std::vector<jpeg_optimize_result>& optimized,
+	std::string& error) {
+	images.clear();
+	optimized.clear();
+
+	// the copies, variants and history run on this thread
+	io_priority_scope priority(options.io ? options.io->limits().priority : io_priority::normal);
 
-	// get the list of files in the spotlight folder
-	std::vector<std::filesystem::path> file_list;
-	for (const auto& entry : std::filesystem::directory_iterator(path))
-		if (entry.is_regular_file())
-			file_list.push_back(entry.path());
+	// the current user's Spotlight folder unless other sources are given
+	std::vector<image_source> sources = options.sources;
 
-	std::vector<image_info> images;
+	if (sources.empty()) {
+		const std::string path = spotlight_assets_folder();
+
+		if (path.empty()) {
+			error = "Unable to locate the local application data folder";
+			return false;
+		}
+
+		sources.push_back({ path, "Spotlight", false });
+	}
 
 	try {
-		// eliminate files that don't make sense
-		for (auto& it : file_list) {
-			// get path
-			const std::string source_path = it.string();
-
-			// create GDI+ bitmap from file
-			Gdiplus::Bitmap* p_gdibitmap =
-				new Gdiplus::Bitmap(std::basic_string<TCHAR>(source_path.begin(), source_path.end()).c_str());
-
-			// get status information
-			Gdiplus::Status status = p_gdibitmap->GetLastStatus();
-
-			// check if an error occured
-			if (status != 0) {
-				// delete bitmap from memory
-				if (p_gdibitmap) {
-					delete p_gdibitmap;
-					p_gdibitmap = NULL;
-				}
+		// if the "Windows SpotLight' folder doesn't exist, create it
+		std::filesystem::create_directory(folder);
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		return false;
+	}
+
+	// the scan's temporary data comes from an arena, so that the files that are
+	// skipped, which is most of them, cost no heap allocations
+	scan_arena arena;
+	const library_lookup lookup(folder, known, options.excluded, arena);
+
+	// list the sources concurrently and eliminate files that don't make sense
+	// as they come in
+	ingest_queue queue;
+	source_scan scan(sources, queue);
+
+	std::pmr::vector<candidate> candidates(arena.scan());
+	source_file file;
+
+	// false if the image is excluded, else reuse its statistics if the library
+	// already has it unchanged
+	auto check_library = [&](candidate& image) {
+		const auto new_file = lookup.library_path(image.bucket, image.file_name);
+		if (lookup.excluded(new_file))
+			return false;
+
+		// only analyze new and changed images; the library's copy keeps the
+		// source's write time, and optimizing it may have made it smaller
+		const auto known_id = lookup.find(new_file);
+		image.library_size = image.file_size;
+
+		if (known_id != invalid_image_id &&
+			known.colours(known_id).computed &&
+			known.quality(known_id).computed &&
+			known.crops(known_id).computed &&
+			known.signature(known_id).computed &&
+			known.file_size(known_id) <= image.file_size &&
+			known.fetched(known_id) == image.fetched) {
+			image.library_size = known.file_size(known_id);
+			image.colours = known.colours(known_id);
+			image.quality = known.quality(known_id);
+			image.crops = known.crops(known_id);
+			image.signature = known.signature(known_id);
+			image.analyzed = true;
+		}
+
+		return true;
+	};
+
+	while (queue.pop(file)) {
+		if (options.job) {
+			if (options.job->stop_requested()) {
+				queue.cancel();
+				break;
 			}
-			else {
-				// skip invalid images
-				if (!is_valid_spotlight_image(*p_gdibitmap))
+
+			options.job->file_seen();
+		}
+
+		arena.next_file();
+
+		// read the dimensions from the file header, skipping files that aren't images
+		candidate image;
+		if (!probe_image(file.path, image.width, image.height))
+			continue;
+
+		// skip invalid images
+		if (!is_valid_spotlight_image(image.width, image.height, image.bucket))
+			continue;
+
+		image.asset = lookup.source_name(file.path);
+		image.file_name = lookup.file_name(image.asset);
+		image.file_size = file.file_size;
+		image.fetched = to_unix_time(file.write_time);
+		image.source_index = file.source;
+
+		if (!check_library(image))
+			continue;
+
+		image.source = std::move(file.path);
+		candidates.push_back(std::move(image));
+	}
+
+	scan.wait();
+
+	// only fail if none of the sources could be read
+	const auto& scan_errors = scan.errors();
+	if (std::all_of(scan_errors.begin(), scan_errors.end(), [](const std::string& it) { return !it.empty(); })) {
+		error = scan_errors.empty() ? "No sources to fetch from" : scan_errors.front();
+		return false;
+	}
+
+	// different files can share a name, and copying them to one library path at
+	// once would corrupt it, so they get unique names and are looked up again
+	std::pmr::vector<library_name> names(arena.scan());
+	names.reserve(candidates.size());
+	for (const auto& image : candidates)
+		names.push_back({ image.bucket, image.file_name, &image.source, image.source_index });
+
+	if (lookup.unique_names(names)) {
+		size_t kept = 0;
+		for (size_t i = 0; i < candidates.size(); i++) {
+			auto& image = candidates[i];
+
+			if (names[i].file_name.data() != image.file_name.data()) {
+				arena.next_file();
+
+				image.file_name = names[i].file_name;
+				image.analyzed = false;
+
+				if (!check_library(image))
 					continue;
+			}
 
-				const bool is_landscape = p_gdibitmap->GetWidth() > p_gdibitmap->GetHeight();
+			if (kept != i)
+				candidates[kept] = std::move(image);
+
+			kept++;
+		}
 
-				// get file name
-				std::string file_name;
-				get_filename_from_full_path(it.string(), file_name);
+		candidates.resize(kept);
+	}
 
-				// create new folder
-				std::string new_folder = folder;
+	analyze_all(candidates, options.job, options.io);
 
-				try {
-					// if the "Windows SpotLight' folder doesn't exist, create it
-					std::filesystem::create_directory(new_folder);
+	auto stopped = [&options]() {
+		return options.job && options.job->stop_requested();
+	};
 
-					if (is_landscape)
-						new_folder += "\\Landscape";
-					else
-						new_folder += "\\Portrait";
+	// copy the accepted images as one batch, so that the copies can overlap
+	std::vector<const candidate*> accepted;
+	std::vector<copy_request> requests;
+	accepted.reserve(candidates.size());
+	requests.reserve(candidates.size());
 
-					// if the sub-folder doesn't exist, create it
-					std::filesystem::create_directory(new_folder);
+	for (auto& image : candidates) {
+		if (stopped())
+			break;
 
-					std::string new_file = new_folder + "\\" + file_name + ".jpg";
+		if (!meets_options(image, options))
+			continue;
 
-					// if the file exists, delete it
-					std::filesystem::directory_entry destination_path(new_file);
+		if (options.job)
+			options.job->file_accepted();
 
-					if (destination_path.exists())
-						std::remove(new_file.c_str());
+		// each aspect ratio bucket has its own sub-folder; if it doesn't exist, create it
+		const auto& new_folder = lookup.bucket_folder(image.bucket);
 
-					// save the image to the new file with the .jpg extension
-					std::filesystem::copy_file(it, new_file);
+		std::error_code ec;
+		std::filesystem::create_directory(new_folder, ec);
+		if (ec) {
+			// to-do: log error
+			continue;
+		}
 
-					images.push_back({
-						is_landscape ? image_orientation::landscape :
-						image_orientation::portrait,
-						new_file,
-						std::filesystem::file_size(it),
-						p_gdibitmap->GetWidth(),
-						p_gdibitmap->GetHeight()
-						});
-				}
-				catch (const std::exception&) {
+		// save the image to the new file with the .jpg extension, skipping the copy
+		// if the file was already fetched (the copy keeps the source's write time)
+		copy_request request;
+		request.source = std::move(image.source);
+		request.destination = lookup.library_path(image.bucket, image.file_name);
+		requests.push_back(std::move(request));
+		accepted.push_back(&image);
+	}
+
+	copy_batch_stats copy_stats;
+	copy_if_newer_batch(requests, options.backend, options.job, options.io, options.copier, copy_stats);
+
+	// the size of each library file, as the catalog records it
+	std::vector<unsigned long long> library_sizes(accepted.size());
+	for (size_t i = 0; i < accepted.size(); i++)
+		library_sizes[i] = requests[i].copied ? accepted[i]->file_size : accepted[i]->library_size;
+
+	// optimize the new copies before they are cataloged, so that the catalog
+	// gets their final size; optimizing keeps the write time, so the files are
+	// not copied again, and is lossless, so the variants are the same
+	if (options.optimize_jpeg && !stopped()) {
+		std::vector<std::string> copied;
+		std::vector<size_t> copied_images;
+
+		for (size_t i = 0; i < accepted.size(); i++) {
+			if (requests[i].succeeded && requests[i].copied) {
+				copied.push_back(requests[i].destination.string());
+				copied_images.push_back(i);
+			}
+		}
+
+		if (!copied.empty())
+			optimize_jpeg_files(copied, true, optimized, options.io);
+
+		for (size_t k = 0; k < optimized.size(); k++)
+			if (optimized[k].error.empty())
+				library_sizes[copied_images[k]] = optimized[k].bytes_after;
+	}
+
+	images.reserve(accepted.size());
+	std::vector<history_entry> seen;
+	std::string new_file;	// reused, so that it stops allocating after the first few images
+
+	for (size_t i = 0; i < accepted.size(); i++) {
+		if (stopped())
+			break;
+
+		if (!requests[i].succeeded) {
+			// to-do: log error
+			continue;
+		}
+
+		const auto& image = *accepted[i];
+		const auto& spec = bucket_spec(image.bucket);
+		const auto& new_folder = lookup.bucket_folder(image.bucket);
+
+		try {
+			join_path(new_folder, image.file_name, new_file);
+
+			if (!options.variants.widths.empty()) {
+				// stop like the copies do, rather than making variants regardless
+				if (options.io && !options.io->acquire(library_sizes[i], options.job))
+					break;
+
+				unsigned int written = 0;
+				std::string variant_error;
+				if (!make_variants(new_file, options.variants, image.crops, written, variant_error)) {
 					// to-do: log error
 				}
+			}
 
-				// delete bitmap from memory
-				if (p_gdibitmap) {
-					delete p_gdibitmap;
-					p_gdibitmap = NULL;
-				}
+			images.add(
+				new_folder,
+				image.file_name,
+				spec.orientation,
+				library_sizes[i],
+				image.width,
+				image.height,
+				image.fetched,
+				image.colours,
+				image.quality,
+				image.crops,
+				image.signature);
+
+			if (options.history) {
+				history_entry entry;
+				entry.asset.assign(image.asset);
+				entry.bucket = image.bucket;
+				entry.width = image.width;
+				entry.height = image.height;
+				entry.file_size = image.file_size;
+				entry.fetched = image.fetched;
+				seen.push_back(std::move(entry));
 			}
 		}
+		catch (const std::exception&) {
+			// to-do: log error
+		}
 	}
-	catch (const std::exception&) {
+
+	if (options.history) {
+		const long long now = std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+
+		std::string history_error;
+		if (!options.history->record(seen, now, history_error)) {
+			// to-do: log error
+		}
+
+		if (options.history->log_size() > image_history::compact_threshold &&
+			!options.history->compact(history_error)) {
+			// to-do: log error
+		}
+	}
+
+	images.shrink_to_fit();
+
+	if (stopped()) {
+		error = "The fetch was stopped";
+		return false;
+	}
+
+	return true;
+}
+
+image_catalog fetch_images(const std::string& folder) {
+	image_catalog images;
+	std::string error;
+	if (!fetch_images(folder, images, error)) {
 		// to-do: log error
 	}
 
@@ -24,20 +24,44 @@
 
 #pragma once
 
+#include "catalog.h"
+#include "variants.h"
+#include "jpeg_optimizer.h"
+#include "image_history.h"
+#include "image_sources.h"
+#include "fetch_job.h"
+#include "io_scheduler.h"
+#include "file_copy.h"
+#include "batch_copy.h"
+
 #include <string>
-#include <vector>
+#include <unordered_set>
 
-enum class image_orientation {
-	portrait = 0,
-	landscape,
-};
+/// <summary>
+/// Get the folder in which Windows stores Spotlight assets for the current user.
+/// </summary>
+/// 
+/// <returns>
+/// The full path to the folder, or an empty string if it cannot be determined.
+/// </returns>
+std::string spotlight_assets_folder();
 
-struct image_info {
-	image_orientation orientation;
-	std::string full_path;
-	unsigned long long file_size = 0;
-	unsigned int width = 0;
-	unsigned int height = 0;
+/// <summary>
+/// Quality thresholds an image has to meet to be fetched.
+/// </summary>
+struct fetch_options {
+	float min_sharpness = 0.f;	// see quality_scores::sharpness
+	float min_entropy = 0.f;	// see quality_scores::entropy
+	bool skip_truncated = true;	// skip files that are cut short
+	variant_options variants;	// resized copies to make of each image
+	bool optimize_jpeg = false;	// losslessly shrink newly copied files, see jpeg_optimizer.h
+	std::unordered_set<std::string> excluded;	// library paths not to fetch again, such as evicted images
+	image_history* history = nullptr;	// records the images fetched, if not null; must be open
+	std::vector<image_source> sources;	// the folders to fetch from, the current user's Spotlight folder if empty
+	fetch_job* job = nullptr;	// for stopping the fetch and reading its progress, if not null
+	io_scheduler* io = nullptr;	// paces and prioritizes reads and writes, if not null
+	copy_engine* copier = nullptr;	// picks the fastest way to copy into the library, if not null and io_uring isn't used
+	copy_backend backend = copy_backend::thread_pool;	// how the accepted images are copied into the library
 };
 
 /// <summary>
@@ -46,16 +70,99 @@ struct image_info {
 /// 
 /// <param name="folder">The folder to save the images to.</param>
 /// 
-/// <remarks>
-/// Creates a folder within the module's directory named "Spotlight" then
-/// copies Windows Spotlight images available in the current user's profile
-/// into subfolders /Portrait and /Landscape depending on their orientation.
-/// If images with the same names already exist they are overwritten.
+/// <param name="images">A catalog of all the files fetched.</param>
+/// 
+/// <param name="error">Error information.</param>
 /// 
-/// This function uses GdiPlus. Ensure Gdiplus is initialized before calling.
+/// <remarks>
+/// Creates the folder if it doesn't exist then copies Windows Spotlight
+/// images available in the current user's profile, or in the sources given
+/// in the options, into one subfolder per aspect ratio bucket (see
+/// aspect_buckets.h). Sources are listed concurrently and files with the
+/// same name are only fetched once, see image_sources.h. Images are identified from
+/// their file headers, then decoded at a reduced size, in parallel, to compute
+/// their colour statistics, quality scores, crop windows and signatures.
+/// Truncated files are skipped.
+/// If images with the same names already exist they are overwritten if the
+/// Spotlight asset is newer. Resized variants are made, and new files are
+/// losslessly optimized, if the options ask for them.
 /// </remarks>
 /// 
 /// <returns>
-/// Returns a list image_info objects for all the files fetched.
+/// Returns true if the Spotlight folder could be read, else false. Errors
+/// copying individual files do not cause the function to fail.
+/// </returns>
+bool fetch_images(const std::string& folder,
+	image_catalog& images,
+	std::string& error);
+
+/// <summary>
+/// Fetch Windows Spotlight images, reusing what is known from a previous fetch.
+/// </summary>
+/// 
+/// <param name="folder">The folder to save the images to.</param>
+/// 
+/// <param name="known">
+/// A catalog from a previous fetch. Images whose size and date haven't changed
+/// take their analysis results from it instead of being decoded again.
+/// </param>
+/// 
+/// <param name="options">The quality thresholds and variants to make.</param>
+/// 
+/// <param name="images">A catalog of all the files fetched.</param>
+/// 
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if the Spotlight folder could be read, else false. Also
+/// returns false if the fetch was stopped through options.job, with the
+/// images fetched until then.
+/// </returns>
+bool fetch_images(const std::string& folder,
+	const image_catalog& known,
+	const fetch_options& options,
+	image_catalog& images,
+	std::string& error);
+
+/// <summary>
+/// Fetch Windows Spotlight images, reporting the bytes saved by optimization.
+/// </summary>
+/// 
+/// <param name="folder">The folder to save the images to.</param>
+/// 
+/// <param name="known">See the overload above.</param>
+/// 
+/// <param name="options">The quality thresholds, variants and optimization.</param>
+/// 
+/// <param name="images">A catalog of all the files fetched.</param>
+/// 
+/// <param name="optimized">
+/// The result of optimizing each newly copied file. Empty unless the options
+/// ask for optimization.
+/// </param>
+/// 
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if the Spotlight folder could be read, else false. Also
+/// returns false if the fetch was stopped through options.job, with the
+/// images fetched until then.
+/// </returns>
+bool fetch_images(const std::string& folder,
+	const image_catalog& known,
+	const fetch_options& options,
+	image_catalog& images,
+	std::vector<jpeg_optimize_result>& optimized,
+	std::string& error);
+
+/// <summary>
+/// Fetch Windows Spotlight images.
+/// </summary>
+/// 
+/// <param name="folder">The folder to save the images to.</param>
+/// 
+/// <returns>
+/// Returns a catalog of all the files fetched. The catalog is empty if the
+/// Spotlight folder could not be read.
 /// </returns>
-std::vector<image_info> fetch_images(const std::string& folder);
+image_catalog fetch_images(const std::string& folder);
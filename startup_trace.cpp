@@ -0,0 +1,73 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "startup_trace.h"
+#include "helper_functions.h"
+
+#include <fstream>
+
+startup_trace::startup_trace() :
+	_uptime_at_start(get_process_uptime()),
+	_start(std::chrono::steady_clock::now()) {
+	_phases.reserve(16);
+}
+
+void startup_trace::mark(const std::string& phase) {
+	_phases.push_back({ phase, std::chrono::steady_clock::now() });
+}
+
+long long startup_trace::elapsed() const {
+	const auto last = _phases.empty() ? _start : _phases.back().time;
+	return _uptime_at_start +
+		std::chrono::duration_cast<std::chrono::milliseconds>(last - _start).count();
+}
+
+std::string startup_trace::report() const {
+	std::string text = "process start to trace start: " + std::to_string(_uptime_at_start) + " ms\n";
+
+	auto previous = _start;
+
+	for (const auto& it : _phases) {
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(it.time - previous).count();
+		const auto total = _uptime_at_start +
+			std::chrono::duration_cast<std::chrono::milliseconds>(it.time - _start).count();
+
+		text += it.name + ": " + std::to_string(duration) + " ms (at " + std::to_string(total) + " ms)\n";
+		previous = it.time;
+	}
+
+	return text;
+}
+
+bool startup_trace::save(const std::string& full_path, std::string& error) const {
+	std::ofstream file(full_path, std::ios::out | std::ios::trunc);
+
+	if (!file) {
+		error = "Unable to open " + full_path;
+		return false;
+	}
+
+	file << report();
+	return true;
+}
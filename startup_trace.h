@@ -0,0 +1,89 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/// <summary>
+/// Records the time at which each startup phase completes.
+/// </summary>
+/// 
+/// <remarks>
+/// Times are reported relative to the creation of the process, so they
+/// include the time taken to load the executable and its libraries.
+/// </remarks>
+class startup_trace {
+public:
+	startup_trace();
+
+	/// <summary>
+	/// Record the completion of a phase.
+	/// </summary>
+	/// 
+	/// <param name="phase">The name of the phase.</param>
+	void mark(const std::string& phase);
+
+	/// <summary>
+	/// Get the time from process creation to the last recorded phase.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The time, in milliseconds.
+	/// </returns>
+	long long elapsed() const;
+
+	/// <summary>
+	/// Format the trace, one phase per line.
+	/// </summary>
+	/// 
+	/// <returns>
+	/// The phases with their duration and the time since process creation.
+	/// </returns>
+	std::string report() const;
+
+	/// <summary>
+	/// Save the trace to a file.
+	/// </summary>
+	/// 
+	/// <param name="full_path">The full path to the file.</param>
+	/// <param name="error">Error information.</param>
+	/// 
+	/// <returns>
+	/// Returns true if successful, else false.
+	/// </returns>
+	bool save(const std::string& full_path, std::string& error) const;
+
+private:
+	struct phase {
+		std::string name;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	long long _uptime_at_start;
+	std::chrono::steady_clock::time_point _start;
+	std::vector<phase> _phases;
+};
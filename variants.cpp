@@ -0,0 +1,194 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#include "variants.h"
+#include "image_probe.h"
+#include "path_utils.h"
+
+#include <algorithm>
+#include <filesystem>
+
+std::vector<unsigned int> parse_variant_widths(const std::string& list) {
+	std::vector<unsigned int> widths;
+	unsigned long long value = 0;
+	bool in_number = false;
+
+	for (size_t i = 0; i <= list.size(); i++) {
+		const char c = i < list.size() ? list[i] : ',';
+
+		if (c >= '0' && c <= '9') {
+			value = (std::min)(value * 10 + static_cast<unsigned int>(c - '0'), 1000000ull);
+			in_number = true;
+		}
+		else {
+			if (in_number && value > 0)
+				widths.push_back(static_cast<unsigned int>(value));
+
+			value = 0;
+			in_number = false;
+		}
+	}
+
+	std::sort(widths.begin(), widths.end());
+	widths.erase(std::unique(widths.begin(), widths.end()), widths.end());
+	return widths;
+}
+
+std::string variant_path(const std::string& full_path,
+	unsigned int width,
+	aspect_bucket crop) {
+	std::string path(full_path, 0, full_path.size() - path_extension(full_path).size());
+	path += "_" + std::to_string(width);
+
+	if (crop != aspect_bucket::none)
+		path += "_" + std::to_string(bucket_spec(crop).ratio_width) + "x" +
+		std::to_string(bucket_spec(crop).ratio_height);
+
+	path += ".jpg";
+	return path;
+}
+
+bool variant_original(const std::string& full_path, std::string& original) {
+	const size_t name_start = full_path.size() - path_filename(full_path).size();
+
+	// variants are always written as .jpg
+	if (!has_extension(full_path, ".jpg"))
+		return false;
+
+	size_t end = full_path.size() - 4;
+
+	// the digits before end, returning where they start or npos if there are none
+	auto digits = [&full_path, name_start](size_t end) {
+		size_t start = end;
+		while (start > name_start && full_path[start - 1] >= '0' && full_path[start - 1] <= '9')
+			start--;
+
+		return start == end ? std::string::npos : start;
+	};
+
+	// an optional _<ratio width>x<ratio height> for cropped variants
+	const auto ratio_height = digits(end);
+	if (ratio_height != std::string::npos && ratio_height > name_start && full_path[ratio_height - 1] == 'x') {
+		const auto ratio_width = digits(ratio_height - 1);
+		if (ratio_width != std::string::npos && ratio_width > name_start && full_path[ratio_width - 1] == '_')
+			end = ratio_width - 1;
+	}
+
+	// then _<width>
+	const auto width = digits(end);
+	if (width == std::string::npos || width <= name_start + 1 || full_path[width - 1] != '_')
+		return false;
+
+	original = full_path.substr(0, width - 1) + ".jpg";
+	return true;
+}
+
+bool make_variants(const std::string& full_path,
+	const variant_options& options,
+	const crop_set& crops,
+	unsigned int& written,
+	std::string& error) {
+	written = 0;
+
+	unsigned int width = 0, height = 0;
+	if (!probe_image(full_path, width, height)) {
+		error = "Unable to read " + full_path;
+		return false;
+	}
+
+	const bool cropped = options.crop != aspect_bucket::none;
+
+	// the widest a cropped variant can be, so that up-to-date variants are
+	// found without decoding the original
+	if (cropped && crops.computed)
+		width = static_cast<unsigned int>(static_cast<unsigned long long>(
+			crops.boxes[static_cast<size_t>(options.crop)].width) * width / crop_box::one);
+
+	// work out which variants are missing or older than the original
+	std::vector<unsigned int> pending;
+
+	try {
+		const auto original_time = std::filesystem::last_write_time(full_path);
+
+		for (const auto it : options.widths) {
+			if (it >= width)
+				continue;
+
+			const auto path = variant_path(full_path, it, options.crop);
+			std::error_code ec;
+			const auto variant_time = std::filesystem::last_write_time(path, ec);
+
+			if (ec || variant_time < original_time)
+				pending.push_back(it);
+		}
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+		return false;
+	}
+
+	if (pending.empty())
+		return true;
+
+	bitmap original;
+	if (!decode_image(full_path, 0, 0, original, error))
+		return false;
+
+	if (cropped) {
+		crop_set computed;
+		if (!crops.computed)
+			compute_crops(original, computed);
+
+		const auto& box = (crops.computed ? crops : computed).boxes[static_cast<size_t>(options.crop)];
+
+		bitmap window;
+		if (!crop_bitmap(original, box, window)) {
+			error = "Unable to crop " + full_path;
+			return false;
+		}
+
+		original = std::move(window);
+	}
+
+	for (const auto it : pending) {
+		if (it >= original.width)
+			continue;
+
+		const auto variant_height = (std::max)(1u,
+			static_cast<unsigned int>((static_cast<unsigned long long>(original.height) * it + original.width / 2) / original.width));
+
+		bitmap variant;
+		if (!resample(original, it, variant_height, options.filter, variant)) {
+			error = "Unable to resize " + full_path;
+			return false;
+		}
+
+		if (!save_jpeg(variant, variant_path(full_path, it, options.crop), options.quality, error))
+			return false;
+
+		written++;
+	}
+
+	return true;
+}
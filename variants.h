@@ -0,0 +1,111 @@
+/*
+** MIT License
+**
+** Copyright(c) 2021 Alec Musasa
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this softwareand associated documentation files(the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions :
+**
+** The above copyright noticeand this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+*/
+
+#pragma once
+
+#include "resampler.h"
+#include "smart_crop.h"
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The resized copies to make of each fetched image.
+/// </summary>
+struct variant_options {
+	std::vector<unsigned int> widths;	// empty to make no variants
+	resample_filter filter = resample_filter::lanczos3;
+	float quality = .9f;	// JPEG quality, from 0 to 1
+	aspect_bucket crop = aspect_bucket::none;	// the bucket to smart crop to, none to keep the whole image
+};
+
+/// <summary>
+/// Parse a list of widths such as "1280, 1920, 2560".
+/// </summary>
+/// 
+/// <param name="list">The widths, separated by commas or spaces.</param>
+/// 
+/// <returns>
+/// The widths in ascending order without duplicates. Entries that are not
+/// positive numbers are ignored.
+/// </returns>
+std::vector<unsigned int> parse_variant_widths(const std::string& list);
+
+/// <summary>
+/// Get the path of a variant of an image.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the original image.</param>
+/// <param name="width">The width of the variant.</param>
+/// <param name="crop">The bucket the variant is cropped to, or none.</param>
+/// 
+/// <returns>
+/// The path of the variant, next to the original: name.jpg becomes
+/// name_1920.jpg, or name_1920_21x9.jpg when cropped to the Ultrawide bucket.
+/// </returns>
+std::string variant_path(const std::string& full_path,
+	unsigned int width,
+	aspect_bucket crop = aspect_bucket::none);
+
+/// <summary>
+/// Get the original image a variant was made from.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to a file.</param>
+/// <param name="original">The full path to the original image.</param>
+/// 
+/// <returns>
+/// Returns true if the file is named like a variant (see variant_path()),
+/// else false. Whether the original exists is not checked.
+/// </returns>
+bool variant_original(const std::string& full_path, std::string& original);
+
+/// <summary>
+/// Make the resized variants of an image that are missing or out of date.
+/// </summary>
+/// 
+/// <param name="full_path">The full path to the original image.</param>
+/// <param name="options">The variants to make.</param>
+/// <param name="crops">
+/// The smart crop windows of the image, from the catalog. Only used when the
+/// options ask for a crop; they are computed from the original if missing.
+/// </param>
+/// <param name="written">The number of variants written.</param>
+/// <param name="error">Error information.</param>
+/// 
+/// <returns>
+/// Returns true if successful, else false.
+/// </returns>
+/// 
+/// <remarks>
+/// Images are never scaled up, so widths at or above the original's are
+/// skipped. The original is decoded once for all the variants, and each
+/// variant is encoded once; variants newer than the original are left as
+/// they are. Cropped variants are never wider than the crop window.
+/// </remarks>
+bool make_variants(const std::string& full_path,
+	const variant_options& options,
+	const crop_set& crops,
+	unsigned int& written,
+	std::string& error);